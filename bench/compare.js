@@ -0,0 +1,56 @@
+'use strict'
+
+/**
+ * Compares two `node bench --json` result files, scenario by scenario, and
+ * exits with 1 if any metric got worse by more than the threshold.
+ *
+ * usage: node bench/compare.js <base.json> <head.json> [--threshold <percent>]
+ */
+
+const fs = require('fs')
+
+// the metrics that are compared, and whether more is better
+const metrics = [
+  ['writesPerSec', (r) => r.writesPerSec, true],
+  ['cpuPerAudioSecond', (r) => r.cpuPerAudioSecond, false],
+  ['heapAllocPerSec', (r) => r.heapAllocPerSec, false],
+  ['eventLoopLag.p99', (r) => r.eventLoopLag.p99, false],
+  ['latency.p99', (r) => r.latency.p99, false]
+]
+
+function main (argv) {
+  let threshold = 10
+  const files = []
+  for (let i = 0; i < argv.length; i++) {
+    if (argv[i] === '--threshold') threshold = Number(argv[++i])
+    else files.push(argv[i])
+  }
+  if (files.length !== 2 || !(threshold >= 0)) {
+    console.error('usage: node bench/compare.js <base.json> <head.json> [--threshold <percent>]')
+    return 2
+  }
+
+  const [base, head] = files.map((file) => JSON.parse(fs.readFileSync(file, 'utf8')))
+  const baseResults = new Map(base.results.map((r) => [r.name, r]))
+  let regressions = 0
+
+  for (const result of head.results) {
+    const before = baseResults.get(result.name)
+    if (!before) continue
+    for (const [name, get, higherIsBetter] of metrics) {
+      const a = get(before)
+      const b = get(result)
+      if (!(a > 0)) continue
+      const change = (b - a) / a * 100
+      const worse = higherIsBetter ? change < -threshold : change > threshold
+      if (worse) regressions++
+      console.log('%s %s %s  %s %s', (change >= 0 ? '+' : '') + change.toFixed(1).padStart(7) + '%',
+        worse ? 'WORSE' : '     ', name.padEnd(18), result.name, `(${a.toPrecision(4)} -> ${b.toPrecision(4)})`)
+    }
+  }
+
+  console.log('%d regression(s) over %d%%', regressions, threshold)
+  return regressions > 0 ? 1 : 0
+}
+
+process.exitCode = main(process.argv.slice(2))
@@ -0,0 +1,184 @@
+'use strict'
+
+/**
+ * Benchmarks the Speaker write path.
+ *
+ * Every scenario runs in a process of its own (see bench/write.js) and reports
+ * writes per second, CPU time per second of audio, JS heap allocated per
+ * second, event loop lag, write-to-heard latency and the native write path
+ * histograms. By default each dimension is swept on its own from a baseline of
+ * 1024 frame chunks of 16 bit stereo on one speaker; `--matrix` runs every
+ * combination instead.
+ *
+ * usage: node bench [options]
+ *
+ *   --backend <name>     backend to play through, "bench" if it is built in
+ *   --device <device>    device to open
+ *   --realtime           pace the "bench" backend like a real device
+ *   --seconds <n>        seconds of audio per speaker, 2 by default
+ *   --chunks <list>      frames per write, 256,1024,4096 by default
+ *   --formats <list>     s16, s24, s32 and/or f32, s16,f32 by default
+ *   --channels <list>    1,2 by default
+ *   --speakers <list>    concurrent speakers, 1,4,16,64 by default
+ *   --matrix             every combination rather than one sweep per dimension
+ *   --json <file>        write the results as JSON, to stdout for "-"
+ */
+
+const fs = require('fs')
+const path = require('path')
+const { fork } = require('child_process')
+const Speaker = require('../')
+
+const formats = {
+  s16: { bitDepth: 16, float: false },
+  s24: { bitDepth: 24, float: false },
+  s32: { bitDepth: 32, float: false },
+  f32: { bitDepth: 32, float: true }
+}
+
+function parseArgs (argv) {
+  const list = (value) => value.split(',').filter(Boolean)
+  const numbers = (value) => list(value).map(Number)
+  const opts = {
+    backend: Speaker.backends().some((b) => b.name === 'bench') ? 'bench' : null,
+    device: null,
+    realtime: false,
+    seconds: 2,
+    chunks: [256, 1024, 4096],
+    formats: ['s16', 'f32'],
+    channels: [1, 2],
+    speakers: [1, 4, 16, 64],
+    matrix: false,
+    json: null
+  }
+  for (let i = 0; i < argv.length; i++) {
+    const arg = argv[i]
+    const value = () => {
+      if (i + 1 >= argv.length) throw new Error(`${arg} needs a value`)
+      return argv[++i]
+    }
+    if (arg === '--backend') opts.backend = value()
+    else if (arg === '--device') opts.device = value()
+    else if (arg === '--realtime') opts.realtime = true
+    else if (arg === '--seconds') opts.seconds = Number(value())
+    else if (arg === '--chunks') opts.chunks = numbers(value())
+    else if (arg === '--formats') opts.formats = list(value())
+    else if (arg === '--channels') opts.channels = numbers(value())
+    else if (arg === '--speakers') opts.speakers = numbers(value())
+    else if (arg === '--matrix') opts.matrix = true
+    else if (arg === '--json') opts.json = value()
+    else throw new Error(`unknown option ${arg}`)
+  }
+  for (const format of opts.formats) {
+    if (!formats[format]) throw new Error(`unknown format ${format}`)
+  }
+  if (opts.realtime) {
+    if (opts.backend !== 'bench') throw new Error('--realtime needs the "bench" backend')
+    opts.device = opts.device ? `realtime,${opts.device}` : 'realtime'
+  }
+  return opts
+}
+
+/**
+ * Returns the scenarios to run: every combination with `--matrix`, otherwise
+ * the baseline plus one sweep per dimension, without duplicates.
+ */
+
+function scenarios (opts) {
+  const dims = {
+    chunk: opts.chunks,
+    format: opts.formats,
+    channels: opts.channels,
+    speakers: opts.speakers
+  }
+  const baseline = {
+    chunk: dims.chunk.includes(1024) ? 1024 : dims.chunk[0],
+    format: dims.format.includes('s16') ? 's16' : dims.format[0],
+    channels: dims.channels.includes(2) ? 2 : dims.channels[0],
+    speakers: dims.speakers[0]
+  }
+
+  let combos = [{}]
+  if (opts.matrix) {
+    for (const dim of Object.keys(dims)) {
+      combos = [].concat(...combos.map((c) => dims[dim].map((v) => Object.assign({}, c, { [dim]: v }))))
+    }
+  } else {
+    combos = [baseline]
+    for (const dim of Object.keys(dims)) {
+      for (const v of dims[dim]) combos.push(Object.assign({}, baseline, { [dim]: v }))
+    }
+  }
+
+  const seen = new Set()
+  return combos.map((c) => {
+    const name = `chunk=${c.chunk} format=${c.format} channels=${c.channels} speakers=${c.speakers}`
+    return { name, params: c }
+  }).filter((s) => !seen.has(s.name) && seen.add(s.name))
+}
+
+function run (scenario, opts) {
+  const { chunk, format, channels, speakers } = scenario.params
+  const arg = Object.assign({
+    backend: opts.backend,
+    device: opts.device,
+    chunk,
+    channels,
+    speakers,
+    sampleRate: 44100,
+    seconds: opts.seconds
+  }, formats[format])
+
+  return new Promise((resolve, reject) => {
+    const child = fork(path.join(__dirname, 'write.js'), [JSON.stringify(arg)])
+    let result = null
+    child.on('message', (message) => { result = message })
+    child.on('error', reject)
+    child.on('exit', (code) => {
+      if (result && result.error) reject(new Error(`${scenario.name}: ${result.error}`))
+      else if (!result) reject(new Error(`${scenario.name}: exited with code ${code}`))
+      else resolve(result)
+    })
+  })
+}
+
+function fixed (n, digits) {
+  return n.toFixed(digits).padStart(10)
+}
+
+async function main () {
+  const opts = parseArgs(process.argv.slice(2))
+  const results = []
+
+  console.error('backend: %s, device: %s, %d s of audio per speaker',
+    opts.backend || Speaker.module_name, opts.device || 'default', opts.seconds)
+  console.error('%s %s %s %s %s %s  %s', 'writes/s'.padStart(10), 'cpu/s'.padStart(10),
+    'heap KiB/s'.padStart(10), 'lag p99'.padStart(10), 'lat p50'.padStart(10), 'lat p99'.padStart(10), 'scenario')
+  for (const scenario of scenarios(opts)) {
+    const result = await run(scenario, opts)
+    results.push(Object.assign({ name: scenario.name, params: scenario.params }, result))
+    console.error('%s %s %s %s %s %s  %s', fixed(result.writesPerSec, 0), fixed(result.cpuPerAudioSecond, 4),
+      fixed(result.heapAllocPerSec / 1024, 1), fixed(result.eventLoopLag.p99, 2), fixed(result.latency.p50, 2),
+      fixed(result.latency.p99, 2), scenario.name)
+  }
+
+  if (opts.json) {
+    const json = JSON.stringify({
+      date: new Date().toISOString(),
+      node: process.version,
+      platform: process.platform,
+      arch: process.arch,
+      backend: opts.backend || Speaker.module_name,
+      device: opts.device,
+      seconds: opts.seconds,
+      results
+    }, null, 2) + '\n'
+    if (opts.json === '-') process.stdout.write(json)
+    else fs.writeFileSync(opts.json, json)
+  }
+}
+
+main().catch((err) => {
+  console.error(err.message)
+  process.exitCode = 1
+})
@@ -0,0 +1,80 @@
+'use strict'
+
+/**
+ * Compares writing to a Speaker that opens the output device in this process
+ * with one that plays through the "speakerd" helper process.
+ *
+ * Reports the throughput of pushing `--seconds` worth of audio through as fast
+ * as the backend takes it, and the time each `samplesPerFrame` sized chunk takes
+ * to be accepted. Against a real device both are bounded by the hardware, so
+ * build with `--mpg123-backend=dummy` to see the transport itself.
+ *
+ *   node bench/remote.js [--seconds 30] [--chunk 4096]
+ */
+
+const Speaker = require('../')
+
+const args = process.argv.slice(2)
+const option = (name, value) => {
+  const i = args.indexOf(`--${name}`)
+  return i === -1 ? value : Number(args[i + 1])
+}
+const seconds = option('seconds', 30)
+const chunkSize = option('chunk', 4096)
+
+const format = { channels: 2, bitDepth: 16, sampleRate: 44100 }
+const total = seconds * format.sampleRate * format.channels * format.bitDepth / 8
+
+function run (outOfProcess) {
+  return new Promise((resolve, reject) => {
+    const speaker = new Speaker(Object.assign({ outOfProcess }, format))
+    const chunk = Buffer.alloc(chunkSize)
+    const latencies = []
+    let written = 0
+    let start
+
+    const next = () => {
+      if (written >= total) {
+        const elapsed = Number(process.hrtime.bigint() - start) / 1e9
+        speaker.on('close', () => resolve({ elapsed, latencies }))
+        return speaker.end()
+      }
+      const t = process.hrtime.bigint()
+      speaker.write(chunk, () => {
+        latencies.push(Number(process.hrtime.bigint() - t) / 1e3)
+        written += chunk.length
+        next()
+      })
+    }
+
+    speaker.on('error', reject)
+    speaker.once('open', () => { start = process.hrtime.bigint() })
+    speaker._open()
+    next()
+  })
+}
+
+function percentile (sorted, p) {
+  return sorted[Math.min(sorted.length - 1, Math.floor(sorted.length * p))]
+}
+
+function report (name, { elapsed, latencies }) {
+  latencies.sort((a, b) => a - b)
+  const rate = total / elapsed / (1024 * 1024)
+  console.log(`${name.padEnd(16)} ${rate.toFixed(1).padStart(8)} MiB/s ` +
+    `${(total / elapsed / (total / seconds)).toFixed(1).padStart(8)}x realtime   ` +
+    `write p50 ${percentile(latencies, 0.5).toFixed(1)}us ` +
+    `p99 ${percentile(latencies, 0.99).toFixed(1)}us ` +
+    `max ${latencies[latencies.length - 1].toFixed(1)}us`)
+}
+
+async function main () {
+  console.log(`${Speaker.module_name} backend, ${seconds}s of audio in ${chunkSize} byte chunks`)
+  report('in-process', await run(false))
+  report('out-of-process', await run(true))
+}
+
+main().catch((err) => {
+  console.error(err)
+  process.exit(1)
+})
@@ -0,0 +1,121 @@
+'use strict'
+
+/**
+ * Runs one benchmark scenario: `speakers` Speakers writing `seconds` of audio
+ * each, in chunks of `chunk` frames, as fast as the backend takes it. Forked by
+ * bench/index.js with the scenario as JSON in argv, and sends the results back
+ * over IPC. Runs in a process of its own so that CPU time, heap and event loop
+ * numbers belong to the one scenario.
+ */
+
+const v8 = require('v8')
+const { monitorEventLoopDelay } = require('perf_hooks')
+const Speaker = require('../')
+
+const scenario = JSON.parse(process.argv[2])
+
+/**
+ * Sums the heap growth between samples, so that what a GC frees in between
+ * doesn't hide what was allocated. Misses what gets allocated and collected
+ * within one sample, so it is a lower bound.
+ */
+
+function heapSampler (interval) {
+  let last = v8.getHeapStatistics().used_heap_size
+  let allocated = 0
+  const sample = () => {
+    const used = v8.getHeapStatistics().used_heap_size
+    if (used > last) allocated += used - last
+    last = used
+  }
+  const timer = setInterval(sample, interval)
+  return () => {
+    clearInterval(timer)
+    sample()
+    return allocated
+  }
+}
+
+function percentile (sorted, q) {
+  if (sorted.length === 0) return 0
+  return sorted[Math.min(sorted.length - 1, Math.floor(q * sorted.length))]
+}
+
+function play (options, chunk, frames, latencies) {
+  return new Promise((resolve, reject) => {
+    const speaker = new Speaker(options)
+    const blockAlign = options.channels * options.bitDepth / 8
+    let left = frames
+    speaker.on('error', reject)
+    speaker.on('close', resolve)
+
+    const next = () => {
+      while (left > 0) {
+        const n = Math.min(left, chunk.length / blockAlign)
+        left -= n
+        const start = process.hrtime()
+        const data = n * blockAlign === chunk.length ? chunk : chunk.slice(0, n * blockAlign)
+        const more = speaker.write(data, () => {
+          // until this chunk is heard: written, plus what the device holds
+          const [s, ns] = process.hrtime(start)
+          latencies.push(s * 1e3 + ns / 1e6 + (speaker.delay() || 0))
+        })
+        if (!more) return speaker.once('drain', next)
+      }
+      speaker.end()
+    }
+    next()
+  })
+}
+
+async function main () {
+  const { backend, device, chunk, bitDepth, float, channels, sampleRate, speakers, seconds } = scenario
+  const options = { backend, device, bitDepth, float, signed: true, channels, sampleRate, samplesPerFrame: chunk }
+  const buffer = Buffer.alloc(chunk * channels * bitDepth / 8)
+  const frames = Math.round(seconds * sampleRate)
+  const latencies = []
+
+  const lag = monitorEventLoopDelay({ resolution: 1 })
+  const before = Speaker.metrics()
+  const heap = heapSampler(5)
+  const cpu = process.cpuUsage()
+  const start = process.hrtime()
+
+  lag.enable()
+  const all = []
+  for (let i = 0; i < speakers; i++) all.push(play(options, buffer, frames, latencies))
+  await Promise.all(all)
+  lag.disable()
+
+  const [s, ns] = process.hrtime(start)
+  const elapsed = s + ns / 1e9
+  const used = process.cpuUsage(cpu)
+  const allocated = heap()
+  const after = Speaker.metrics()
+  const writes = after.writeTime.count - before.writeTime.count
+
+  latencies.sort((a, b) => a - b)
+  process.send({
+    elapsed,
+    writesPerSec: writes / elapsed,
+    // CPU seconds per second of audio played, all speakers together
+    cpuPerAudioSecond: (used.user + used.system) / 1e6 / (seconds * speakers),
+    heapAllocPerSec: allocated / elapsed,
+    eventLoopLag: {
+      p50: lag.percentile(50) / 1e6,
+      p99: lag.percentile(99) / 1e6,
+      max: lag.max / 1e6
+    },
+    latency: {
+      p50: percentile(latencies, 0.5),
+      p99: percentile(latencies, 0.99),
+      max: latencies.length ? latencies[latencies.length - 1] : 0
+    },
+    // process-wide, and only this scenario ran in the process
+    native: after
+  })
+}
+
+main().catch((err) => {
+  process.send({ error: err.stack || String(err) })
+})
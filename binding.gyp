@@ -3,11 +3,101 @@
     {
       'target_name': 'binding',
       'sources': [
+        'src/backends.c',
         'src/binding.c',
+        'src/clips.c',
+        'src/decode.c',
+        'src/drift.c',
+        'src/dsp.c',
+        'src/filesink.c',
+        'src/idle.c',
+        'src/jitter.c',
+        'src/metrics.c',
+        'src/pace.c',
+        'src/playlist.c',
+        'src/probe.c',
+        'src/radio.c',
+        'src/remote.c',
+        'src/ring.c',
       ],
       'dependencies': [
+        'deps/mpg123/mpg123.gyp:mpg123',
         'deps/mpg123/mpg123.gyp:output'
       ],
+      'conditions': [
+        ['OS!="win"', {
+          'dependencies': [
+            'deps/mpg123/mpg123.gyp:http',
+            'deps/mpg123/mpg123.gyp:xfermem'
+          ],
+        }],
+      ],
+    },
+    {
+      # the drift correction against a simulated device, run by test/test.js
+      'target_name': 'drift_test',
+      'type': 'executable',
+      'sources': [
+        'test/test_drift.c',
+        'src/drift.c',
+        'src/dsp.c',
+      ],
+      'dependencies': [
+        'deps/mpg123/mpg123.gyp:output'
+      ],
+      'conditions': [
+        ['OS!="win"', {
+          'link_settings': {
+            'libraries': [
+              '-lm',
+            ]
+          },
+        }],
+      ],
     }
+  ],
+  'conditions': [
+    ['OS!="win"', {
+      'targets': [
+        {
+          # the pacing of the output threads against simulated devices, run
+          # by test/test.js; it has a clock of its own in place of libuv's
+          'target_name': 'pace_test',
+          'type': 'executable',
+          'sources': [
+            'test/test_pace.c',
+            'src/pace.c',
+            'src/dsp.c',
+          ],
+          'dependencies': [
+            'deps/mpg123/mpg123.gyp:output'
+          ],
+          'link_settings': {
+            'libraries': [
+              '-lm',
+            ]
+          },
+        },
+        {
+          # helper process for the "outOfProcess" option
+          'target_name': 'speakerd',
+          'type': 'executable',
+          'sources': [
+            'src/speakerd.c',
+            'src/backends.c',
+            'src/dsp.c',
+          ],
+          'dependencies': [
+            'deps/mpg123/mpg123.gyp:output',
+            'deps/mpg123/mpg123.gyp:xfermem'
+          ],
+          'link_settings': {
+            'libraries': [
+              '-lm',
+            ]
+          },
+        }
+      ]
+    }]
   ]
 }
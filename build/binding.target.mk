@@ -0,0 +1,187 @@
+# This file is generated by gyp; do not edit.
+
+TOOLSET := target
+TARGET := binding
+DEFS_Debug := \
+	'-DNODE_GYP_MODULE_NAME=binding' \
+	'-DUSING_UV_SHARED=1' \
+	'-DUSING_V8_SHARED=1' \
+	'-DV8_DEPRECATION_WARNINGS=1' \
+	'-D_GLIBCXX_USE_CXX11_ABI=1' \
+	'-D_FILE_OFFSET_BITS=64' \
+	'-D_LARGEFILE_SOURCE' \
+	'-D__STDC_FORMAT_MACROS' \
+	'-DOPENSSL_NO_PINSHARED' \
+	'-DOPENSSL_THREADS' \
+	'-DOPT_X86_64' \
+	'-DREAL_IS_FLOAT' \
+	'-DSPEAKER_BACKEND_BENCH' \
+	'-DBUILDING_NODE_EXTENSION' \
+	'-DDEBUG' \
+	'-D_DEBUG'
+
+# Flags passed to all source files.
+CFLAGS_Debug := \
+	-fPIC \
+	-pthread \
+	-Wall \
+	-Wextra \
+	-Wno-unused-parameter \
+	-m64 \
+	-g \
+	-O0
+
+# Flags passed to only C files.
+CFLAGS_C_Debug :=
+
+# Flags passed to only C++ files.
+CFLAGS_CC_Debug := \
+	-fno-rtti \
+	-fno-exceptions \
+	-std=gnu++17
+
+INCS_Debug := \
+	-I/root/.nvm/versions/node/v20.19.5/include/node \
+	-I/root/.nvm/versions/node/v20.19.5/src \
+	-I/root/.nvm/versions/node/v20.19.5/deps/openssl/config \
+	-I/root/.nvm/versions/node/v20.19.5/deps/openssl/openssl/include \
+	-I/root/.nvm/versions/node/v20.19.5/deps/uv/include \
+	-I/root/.nvm/versions/node/v20.19.5/deps/zlib \
+	-I/root/.nvm/versions/node/v20.19.5/deps/v8/include \
+	-I$(srcdir)/deps/mpg123/src/libmpg123 \
+	-I$(srcdir)/deps/mpg123/config/linux/x64 \
+	-I$(srcdir)/deps/mpg123/src \
+	-I$(srcdir)/deps/mpg123/src/output
+
+DEFS_Release := \
+	'-DNODE_GYP_MODULE_NAME=binding' \
+	'-DUSING_UV_SHARED=1' \
+	'-DUSING_V8_SHARED=1' \
+	'-DV8_DEPRECATION_WARNINGS=1' \
+	'-D_GLIBCXX_USE_CXX11_ABI=1' \
+	'-D_FILE_OFFSET_BITS=64' \
+	'-D_LARGEFILE_SOURCE' \
+	'-D__STDC_FORMAT_MACROS' \
+	'-DOPENSSL_NO_PINSHARED' \
+	'-DOPENSSL_THREADS' \
+	'-DOPT_X86_64' \
+	'-DREAL_IS_FLOAT' \
+	'-DSPEAKER_BACKEND_BENCH' \
+	'-DBUILDING_NODE_EXTENSION'
+
+# Flags passed to all source files.
+CFLAGS_Release := \
+	-fPIC \
+	-pthread \
+	-Wall \
+	-Wextra \
+	-Wno-unused-parameter \
+	-m64 \
+	-O3 \
+	-fno-omit-frame-pointer
+
+# Flags passed to only C files.
+CFLAGS_C_Release :=
+
+# Flags passed to only C++ files.
+CFLAGS_CC_Release := \
+	-fno-rtti \
+	-fno-exceptions \
+	-std=gnu++17
+
+INCS_Release := \
+	-I/root/.nvm/versions/node/v20.19.5/include/node \
+	-I/root/.nvm/versions/node/v20.19.5/src \
+	-I/root/.nvm/versions/node/v20.19.5/deps/openssl/config \
+	-I/root/.nvm/versions/node/v20.19.5/deps/openssl/openssl/include \
+	-I/root/.nvm/versions/node/v20.19.5/deps/uv/include \
+	-I/root/.nvm/versions/node/v20.19.5/deps/zlib \
+	-I/root/.nvm/versions/node/v20.19.5/deps/v8/include \
+	-I$(srcdir)/deps/mpg123/src/libmpg123 \
+	-I$(srcdir)/deps/mpg123/config/linux/x64 \
+	-I$(srcdir)/deps/mpg123/src \
+	-I$(srcdir)/deps/mpg123/src/output
+
+OBJS := \
+	$(obj).target/$(TARGET)/src/backends.o \
+	$(obj).target/$(TARGET)/src/binding.o \
+	$(obj).target/$(TARGET)/src/clips.o \
+	$(obj).target/$(TARGET)/src/decode.o \
+	$(obj).target/$(TARGET)/src/drift.o \
+	$(obj).target/$(TARGET)/src/dsp.o \
+	$(obj).target/$(TARGET)/src/filesink.o \
+	$(obj).target/$(TARGET)/src/idle.o \
+	$(obj).target/$(TARGET)/src/jitter.o \
+	$(obj).target/$(TARGET)/src/metrics.o \
+	$(obj).target/$(TARGET)/src/pace.o \
+	$(obj).target/$(TARGET)/src/playlist.o \
+	$(obj).target/$(TARGET)/src/probe.o \
+	$(obj).target/$(TARGET)/src/radio.o \
+	$(obj).target/$(TARGET)/src/remote.o \
+	$(obj).target/$(TARGET)/src/ring.o
+
+# Add to the list of files we specially track dependencies for.
+all_deps += $(OBJS)
+
+# Make sure our dependencies are built before any of us.
+$(OBJS): | $(builddir)/libmpg123.a $(builddir)/liboutput.a $(builddir)/libhttp.a $(builddir)/libxfermem.a $(obj).target/deps/mpg123/libmpg123.a $(obj).target/deps/mpg123/liboutput.a $(obj).target/deps/mpg123/libhttp.a $(obj).target/deps/mpg123/libxfermem.a
+
+# CFLAGS et al overrides must be target-local.
+# See "Target-specific Variable Values" in the GNU Make manual.
+$(OBJS): TOOLSET := $(TOOLSET)
+$(OBJS): GYP_CFLAGS := $(DEFS_$(BUILDTYPE)) $(INCS_$(BUILDTYPE))  $(CFLAGS_$(BUILDTYPE)) $(CFLAGS_C_$(BUILDTYPE))
+$(OBJS): GYP_CXXFLAGS := $(DEFS_$(BUILDTYPE)) $(INCS_$(BUILDTYPE))  $(CFLAGS_$(BUILDTYPE)) $(CFLAGS_CC_$(BUILDTYPE))
+
+# Suffix rules, putting all outputs into $(obj).
+
+$(obj).$(TOOLSET)/$(TARGET)/%.o: $(srcdir)/%.c FORCE_DO_CMD
+	@$(call do_cmd,cc,1)
+
+# Try building from generated source, too.
+
+$(obj).$(TOOLSET)/$(TARGET)/%.o: $(obj).$(TOOLSET)/%.c FORCE_DO_CMD
+	@$(call do_cmd,cc,1)
+
+$(obj).$(TOOLSET)/$(TARGET)/%.o: $(obj)/%.c FORCE_DO_CMD
+	@$(call do_cmd,cc,1)
+
+# End of this set of suffix rules
+### Rules for final target.
+LDFLAGS_Debug := \
+	-pthread \
+	-rdynamic \
+	-m64
+
+LDFLAGS_Release := \
+	-pthread \
+	-rdynamic \
+	-m64
+
+LIBS := \
+	-lrt
+
+$(obj).target/binding.node: GYP_LDFLAGS := $(LDFLAGS_$(BUILDTYPE))
+$(obj).target/binding.node: LIBS := $(LIBS)
+$(obj).target/binding.node: TOOLSET := $(TOOLSET)
+$(obj).target/binding.node: $(OBJS) $(obj).target/deps/mpg123/libmpg123.a $(obj).target/deps/mpg123/liboutput.a $(obj).target/deps/mpg123/libhttp.a $(obj).target/deps/mpg123/libxfermem.a FORCE_DO_CMD
+	$(call do_cmd,solink_module)
+
+all_deps += $(obj).target/binding.node
+# Add target alias
+.PHONY: binding
+binding: $(builddir)/binding.node
+
+# Copy this to the executable output path.
+$(builddir)/binding.node: TOOLSET := $(TOOLSET)
+$(builddir)/binding.node: $(obj).target/binding.node FORCE_DO_CMD
+	$(call do_cmd,copy)
+
+all_deps += $(builddir)/binding.node
+# Short alias for building this executable.
+.PHONY: binding.node
+binding.node: $(obj).target/binding.node $(builddir)/binding.node
+
+# Add executable to "all" target.
+.PHONY: all
+all: $(builddir)/binding.node
+
@@ -0,0 +1,227 @@
+# This file is generated by gyp; do not edit.
+
+TOOLSET := target
+TARGET := mpg123
+DEFS_Debug := \
+	'-DNODE_GYP_MODULE_NAME=mpg123' \
+	'-DUSING_UV_SHARED=1' \
+	'-DUSING_V8_SHARED=1' \
+	'-DV8_DEPRECATION_WARNINGS=1' \
+	'-D_GLIBCXX_USE_CXX11_ABI=1' \
+	'-D_FILE_OFFSET_BITS=64' \
+	'-D_LARGEFILE_SOURCE' \
+	'-D__STDC_FORMAT_MACROS' \
+	'-DOPENSSL_NO_PINSHARED' \
+	'-DOPENSSL_THREADS' \
+	'-DPIC' \
+	'-DNOXFERMEM' \
+	'-DHAVE_CONFIG_H' \
+	'-DOPT_X86_64' \
+	'-DREAL_IS_FLOAT' \
+	'-DDEBUG' \
+	'-D_DEBUG'
+
+# Flags passed to all source files.
+CFLAGS_Debug := \
+	-fPIC \
+	-pthread \
+	-Wall \
+	-Wextra \
+	-Wno-unused-parameter \
+	-ffp-contract=off \
+	-Wno-sign-compare \
+	-Wno-empty-body \
+	-Wno-shift-negative-value \
+	-Wno-unused-value \
+	-Wno-array-bounds \
+	-m64 \
+	-g \
+	-O0
+
+# Flags passed to only C files.
+CFLAGS_C_Debug :=
+
+# Flags passed to only C++ files.
+CFLAGS_CC_Debug := \
+	-fno-rtti \
+	-fno-exceptions \
+	-std=gnu++17
+
+INCS_Debug := \
+	-I/root/.nvm/versions/node/v20.19.5/include/node \
+	-I/root/.nvm/versions/node/v20.19.5/src \
+	-I/root/.nvm/versions/node/v20.19.5/deps/openssl/config \
+	-I/root/.nvm/versions/node/v20.19.5/deps/openssl/openssl/include \
+	-I/root/.nvm/versions/node/v20.19.5/deps/uv/include \
+	-I/root/.nvm/versions/node/v20.19.5/deps/zlib \
+	-I/root/.nvm/versions/node/v20.19.5/deps/v8/include \
+	-I$(srcdir)/deps/mpg123/src/libmpg123 \
+	-I$(srcdir)/deps/mpg123/config/linux/x64
+
+DEFS_Release := \
+	'-DNODE_GYP_MODULE_NAME=mpg123' \
+	'-DUSING_UV_SHARED=1' \
+	'-DUSING_V8_SHARED=1' \
+	'-DV8_DEPRECATION_WARNINGS=1' \
+	'-D_GLIBCXX_USE_CXX11_ABI=1' \
+	'-D_FILE_OFFSET_BITS=64' \
+	'-D_LARGEFILE_SOURCE' \
+	'-D__STDC_FORMAT_MACROS' \
+	'-DOPENSSL_NO_PINSHARED' \
+	'-DOPENSSL_THREADS' \
+	'-DPIC' \
+	'-DNOXFERMEM' \
+	'-DHAVE_CONFIG_H' \
+	'-DOPT_X86_64' \
+	'-DREAL_IS_FLOAT' \
+	'-DNDEBUG'
+
+# Flags passed to all source files.
+CFLAGS_Release := \
+	-fPIC \
+	-pthread \
+	-Wall \
+	-Wextra \
+	-Wno-unused-parameter \
+	-ffp-contract=off \
+	-Wno-sign-compare \
+	-Wno-empty-body \
+	-Wno-shift-negative-value \
+	-Wno-unused-value \
+	-Wno-array-bounds \
+	-m64 \
+	-O3 \
+	-fno-omit-frame-pointer
+
+# Flags passed to only C files.
+CFLAGS_C_Release :=
+
+# Flags passed to only C++ files.
+CFLAGS_CC_Release := \
+	-fno-rtti \
+	-fno-exceptions \
+	-std=gnu++17
+
+INCS_Release := \
+	-I/root/.nvm/versions/node/v20.19.5/include/node \
+	-I/root/.nvm/versions/node/v20.19.5/src \
+	-I/root/.nvm/versions/node/v20.19.5/deps/openssl/config \
+	-I/root/.nvm/versions/node/v20.19.5/deps/openssl/openssl/include \
+	-I/root/.nvm/versions/node/v20.19.5/deps/uv/include \
+	-I/root/.nvm/versions/node/v20.19.5/deps/zlib \
+	-I/root/.nvm/versions/node/v20.19.5/deps/v8/include \
+	-I$(srcdir)/deps/mpg123/src/libmpg123 \
+	-I$(srcdir)/deps/mpg123/config/linux/x64
+
+OBJS := \
+	$(obj).target/$(TARGET)/deps/mpg123/src/libmpg123/compat.o \
+	$(obj).target/$(TARGET)/deps/mpg123/src/libmpg123/parse.o \
+	$(obj).target/$(TARGET)/deps/mpg123/src/libmpg123/frame.o \
+	$(obj).target/$(TARGET)/deps/mpg123/src/libmpg123/format.o \
+	$(obj).target/$(TARGET)/deps/mpg123/src/libmpg123/dct64.o \
+	$(obj).target/$(TARGET)/deps/mpg123/src/libmpg123/equalizer.o \
+	$(obj).target/$(TARGET)/deps/mpg123/src/libmpg123/id3.o \
+	$(obj).target/$(TARGET)/deps/mpg123/src/libmpg123/optimize.o \
+	$(obj).target/$(TARGET)/deps/mpg123/src/libmpg123/readers.o \
+	$(obj).target/$(TARGET)/deps/mpg123/src/libmpg123/tabinit.o \
+	$(obj).target/$(TARGET)/deps/mpg123/src/libmpg123/libmpg123.o \
+	$(obj).target/$(TARGET)/deps/mpg123/src/libmpg123/index.o \
+	$(obj).target/$(TARGET)/deps/mpg123/src/libmpg123/stringbuf.o \
+	$(obj).target/$(TARGET)/deps/mpg123/src/libmpg123/icy.o \
+	$(obj).target/$(TARGET)/deps/mpg123/src/libmpg123/icy2utf8.o \
+	$(obj).target/$(TARGET)/deps/mpg123/src/libmpg123/ntom.o \
+	$(obj).target/$(TARGET)/deps/mpg123/src/libmpg123/synth.o \
+	$(obj).target/$(TARGET)/deps/mpg123/src/libmpg123/synth_8bit.o \
+	$(obj).target/$(TARGET)/deps/mpg123/src/libmpg123/layer1.o \
+	$(obj).target/$(TARGET)/deps/mpg123/src/libmpg123/layer2.o \
+	$(obj).target/$(TARGET)/deps/mpg123/src/libmpg123/layer3.o \
+	$(obj).target/$(TARGET)/deps/mpg123/src/libmpg123/layer3_simd.o \
+	$(obj).target/$(TARGET)/deps/mpg123/src/libmpg123/feature.o \
+	$(obj).target/$(TARGET)/deps/mpg123/src/libmpg123/dct64_x86_64.o \
+	$(obj).target/$(TARGET)/deps/mpg123/src/libmpg123/dct64_x86_64_float.o \
+	$(obj).target/$(TARGET)/deps/mpg123/src/libmpg123/synth_s32.o \
+	$(obj).target/$(TARGET)/deps/mpg123/src/libmpg123/synth_real.o \
+	$(obj).target/$(TARGET)/deps/mpg123/src/libmpg123/synth_stereo_x86_64.o \
+	$(obj).target/$(TARGET)/deps/mpg123/src/libmpg123/synth_stereo_x86_64_float.o \
+	$(obj).target/$(TARGET)/deps/mpg123/src/libmpg123/synth_stereo_x86_64_s32.o \
+	$(obj).target/$(TARGET)/deps/mpg123/src/libmpg123/synth_x86_64.o \
+	$(obj).target/$(TARGET)/deps/mpg123/src/libmpg123/synth_x86_64_s32.o \
+	$(obj).target/$(TARGET)/deps/mpg123/src/libmpg123/synth_x86_64_float.o
+
+# Add to the list of files we specially track dependencies for.
+all_deps += $(OBJS)
+
+# CFLAGS et al overrides must be target-local.
+# See "Target-specific Variable Values" in the GNU Make manual.
+$(OBJS): TOOLSET := $(TOOLSET)
+$(OBJS): GYP_CFLAGS := $(DEFS_$(BUILDTYPE)) $(INCS_$(BUILDTYPE))  $(CFLAGS_$(BUILDTYPE)) $(CFLAGS_C_$(BUILDTYPE))
+$(OBJS): GYP_CXXFLAGS := $(DEFS_$(BUILDTYPE)) $(INCS_$(BUILDTYPE))  $(CFLAGS_$(BUILDTYPE)) $(CFLAGS_CC_$(BUILDTYPE))
+
+# Suffix rules, putting all outputs into $(obj).
+
+$(obj).$(TOOLSET)/$(TARGET)/%.o: $(srcdir)/%.S FORCE_DO_CMD
+	@$(call do_cmd,cc,1)
+
+$(obj).$(TOOLSET)/$(TARGET)/%.o: $(srcdir)/%.c FORCE_DO_CMD
+	@$(call do_cmd,cc,1)
+
+# Try building from generated source, too.
+
+$(obj).$(TOOLSET)/$(TARGET)/%.o: $(obj).$(TOOLSET)/%.S FORCE_DO_CMD
+	@$(call do_cmd,cc,1)
+
+$(obj).$(TOOLSET)/$(TARGET)/%.o: $(obj).$(TOOLSET)/%.c FORCE_DO_CMD
+	@$(call do_cmd,cc,1)
+
+$(obj).$(TOOLSET)/$(TARGET)/%.o: $(obj)/%.S FORCE_DO_CMD
+	@$(call do_cmd,cc,1)
+
+$(obj).$(TOOLSET)/$(TARGET)/%.o: $(obj)/%.c FORCE_DO_CMD
+	@$(call do_cmd,cc,1)
+
+# End of this set of suffix rules
+### Rules for final target.
+LDFLAGS_Debug := \
+	-pthread \
+	-rdynamic \
+	-m64
+
+LDFLAGS_Release := \
+	-pthread \
+	-rdynamic \
+	-m64
+
+LIBS :=
+
+$(obj).target/deps/mpg123/libmpg123.a: GYP_LDFLAGS := $(LDFLAGS_$(BUILDTYPE))
+$(obj).target/deps/mpg123/libmpg123.a: LIBS := $(LIBS)
+$(obj).target/deps/mpg123/libmpg123.a: TOOLSET := $(TOOLSET)
+$(obj).target/deps/mpg123/libmpg123.a: $(OBJS)
+	$(call create_archive,$@,$^)
+
+# Add target alias
+.PHONY: mpg123
+mpg123: $(obj).target/deps/mpg123/libmpg123.a
+
+# Add target alias to "all" target.
+.PHONY: all
+all: mpg123
+
+# Add target alias
+.PHONY: mpg123
+mpg123: $(builddir)/libmpg123.a
+
+# Copy this to the static library output path.
+$(builddir)/libmpg123.a: TOOLSET := $(TOOLSET)
+$(builddir)/libmpg123.a: $(obj).target/deps/mpg123/libmpg123.a FORCE_DO_CMD
+	$(call do_cmd,copy)
+
+all_deps += $(builddir)/libmpg123.a
+# Short alias for building this static library.
+.PHONY: libmpg123.a
+libmpg123.a: $(obj).target/deps/mpg123/libmpg123.a $(builddir)/libmpg123.a
+
+# Add static library to "all" target.
+.PHONY: all
+all: $(builddir)/libmpg123.a
+
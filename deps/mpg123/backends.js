@@ -0,0 +1,50 @@
+'use strict'
+
+/**
+ * Prints the output modules that can be built besides the default one, for
+ * the "mpg123_backends" variable of mpg123.gyp: the ones whose libraries
+ * are installed, and those that don't need any.
+ *
+ * usage: node backends.js <OS> <default backend>
+ */
+
+const fs = require('fs')
+const { spawnSync } = require('child_process')
+
+const [os, backend] = process.argv.slice(2)
+
+function pkgConfig (name) {
+  const result = spawnSync('pkg-config', ['--exists', name])
+  return !result.error && result.status === 0
+}
+
+function header (name) {
+  return ['/usr/include', '/usr/local/include'].some((dir) => fs.existsSync(`${dir}/${name}`))
+}
+
+const candidates = {
+  linux: {
+    alsa: () => pkgConfig('alsa'),
+    pulse: () => pkgConfig('libpulse-simple'),
+    jack: () => pkgConfig('jack'),
+    oss: () => header('sys/soundcard.h'),
+    sdl: () => pkgConfig('sdl2'),
+    openal: () => pkgConfig('openal')
+  },
+  mac: {
+    coreaudio: () => true,
+    openal: () => true,
+    pulse: () => pkgConfig('libpulse-simple'),
+    jack: () => pkgConfig('jack'),
+    sdl: () => pkgConfig('sdl2')
+  },
+  win: {
+    win32: () => true
+  }
+}
+candidates.freebsd = candidates.linux
+
+const found = Object.keys(candidates[os] || {}).filter((name) => candidates[os][name]())
+found.push('bench', 'dummy')
+
+console.log(found.filter((name) => name !== backend).join(' '))
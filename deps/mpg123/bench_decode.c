@@ -0,0 +1,533 @@
+/*
+  Measures decoding speed. Generates a corpus of MPEG 1, 2 and 2.5 Layer I,
+  II and III streams, mono and stereo, CBR and VBR, and decodes each of them
+  with every decoder that libmpg123 was built with, into every output
+  encoding it supports, reporting MB/s of MPEG data, the realtime factor and
+  CPU cycles per output sample.
+
+  The streams are valid but random: allocations, scale factors and samples
+  for Layers I and II, and Huffman coded spectra for Layer III, written with
+  libmpg123's own allocation and Huffman tables so that they decode without
+  errors, and fill their frames like an encoder would. Each case runs for at
+  least the number of seconds given on the command line (0.1 by default).
+
+  Prints FAIL and exits with 1 if a stream doesn't decode to the number of
+  samples that were generated.
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#ifdef WIN32
+#include <windows.h>
+#endif
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <x86intrin.h>
+#endif
+#define HAVE_RDTSC 1
+#endif
+
+#include "mpg123lib_intern.h"
+#include "huffman.h"
+#include "l2tables.h"
+
+#define SECONDS 10   /* of audio per stream */
+
+typedef struct {
+  unsigned char *data;
+  size_t size;      /* bytes allocated */
+  size_t bits;      /* bits written */
+} bitwriter;
+
+static unsigned long seed = 1;
+
+/* deterministic, so that every run decodes the same corpus */
+static unsigned long random_bits(int n) {
+  seed = seed * 1103515245ul + 12345ul;
+  return ((seed >> 8) & 0xffffff) >> (24 - n);
+}
+
+static int random_below(int n) {
+  return (int) (random_bits(16) * (unsigned long) n >> 16);
+}
+
+/* mostly small values, like real spectra and allocations */
+static int random_small(int max) {
+  int v = 0;
+  while (v < max && random_bits(2) != 0) v++;
+  return v;
+}
+
+static void put(bitwriter *w, unsigned long value, int n) {
+  while (n-- > 0) {
+    size_t byte = w->bits >> 3;
+    if (byte >= w->size) {
+      w->size = w->size ? w->size * 2 : 65536;
+      w->data = realloc(w->data, w->size);
+      memset(w->data + byte, 0, w->size - byte);
+    }
+    if ((value >> n) & 1) w->data[byte] |= 0x80 >> (w->bits & 7);
+    w->bits++;
+  }
+}
+
+/* pads with zeros up to `bits` */
+static void pad(bitwriter *w, size_t bits) {
+  while (w->bits < bits) put(w, 0, 1);
+}
+
+typedef struct {
+  const char *name;
+  int version;      /* 1, 2, or 25 for MPEG 2.5 */
+  int layer;
+  int channels;
+  int bitrate;      /* index, or 0 for VBR */
+} stream_spec;
+
+static const stream_spec specs[] = {
+  { "MPEG 1 Layer I stereo CBR", 1, 1, 2, 12 },
+  { "MPEG 1 Layer I mono CBR", 1, 1, 1, 6 },
+  { "MPEG 1 Layer I stereo VBR", 1, 1, 2, 0 },
+  { "MPEG 1 Layer II stereo CBR", 1, 2, 2, 10 },
+  { "MPEG 1 Layer II mono CBR", 1, 2, 1, 6 },
+  { "MPEG 1 Layer II stereo VBR", 1, 2, 2, 0 },
+  { "MPEG 1 Layer III stereo CBR", 1, 3, 2, 9 },
+  { "MPEG 1 Layer III mono CBR", 1, 3, 1, 5 },
+  { "MPEG 1 Layer III stereo VBR", 1, 3, 2, 0 },
+  { "MPEG 2 Layer I stereo CBR", 2, 1, 2, 8 },
+  { "MPEG 2 Layer II stereo CBR", 2, 2, 2, 8 },
+  { "MPEG 2 Layer III stereo CBR", 2, 3, 2, 8 },
+  { "MPEG 2 Layer III mono CBR", 2, 3, 1, 4 },
+  { "MPEG 2 Layer III stereo VBR", 2, 3, 2, 0 },
+  { "MPEG 2.5 Layer III stereo CBR", 25, 3, 2, 4 },
+  { "MPEG 2.5 Layer III mono VBR", 25, 3, 1, 0 }
+};
+
+static const int bitrates[2][3][16] = {
+  {
+    { 0, 32, 64, 96, 128, 160, 192, 224, 256, 288, 320, 352, 384, 416, 448 },
+    { 0, 32, 48, 56, 64, 80, 96, 112, 128, 160, 192, 224, 256, 320, 384 },
+    { 0, 32, 40, 48, 56, 64, 80, 96, 112, 128, 160, 192, 224, 256, 320 }
+  },
+  {
+    { 0, 32, 48, 56, 64, 80, 96, 112, 128, 144, 160, 176, 192, 224, 256 },
+    { 0, 8, 16, 24, 32, 40, 48, 56, 64, 80, 96, 112, 128, 144, 160 },
+    { 0, 8, 16, 24, 32, 40, 48, 56, 64, 80, 96, 112, 128, 144, 160 }
+  }
+};
+
+/* the first sampling rate of each version */
+static long spec_rate(const stream_spec *s) {
+  return s->version == 1 ? 44100 : s->version == 2 ? 22050 : 11025;
+}
+
+static int spec_samples(const stream_spec *s) {
+  return s->layer == 1 ? 384 : (s->layer == 3 && s->version != 1) ? 576 : 1152;
+}
+
+/* Layer II stereo streams at low bitrates and mono ones at high ones aren't
+ * allowed, and 32 kbit/s Layer I stereo frames can't hold their allocation:
+ * VBR picks from what is left */
+static int vbr_bitrate(const stream_spec *s) {
+  if (s->layer == 2 && s->version == 1) return s->channels == 2 ? 8 + random_below(7) : 4 + random_below(7);
+  if (s->layer == 1 && s->channels == 2) return 2 + random_below(13);
+  return 1 + random_below(14);
+}
+
+static void put_header(bitwriter *w, const stream_spec *s, int bitrate) {
+  put(w, 0x7ff, 11);
+  put(w, s->version == 1 ? 3 : s->version == 2 ? 2 : 0, 2);
+  put(w, 4 - s->layer, 2);
+  put(w, 1, 1);                       /* no CRC */
+  put(w, bitrate, 4);
+  put(w, 0, 2);                       /* the first rate of the version */
+  put(w, 0, 1);                       /* no padding */
+  put(w, 0, 1);
+  put(w, s->channels == 2 ? 0 : 3, 2); /* stereo or mono */
+  put(w, 0, 2);
+  put(w, 0, 3);                       /* copyright, original, emphasis */
+}
+
+static void layer1_frame(bitwriter *w, const stream_spec *s, size_t end) {
+  int ba[2][SBLIMIT];
+  long budget = (long) (end - w->bits) - 4 * SBLIMIT * s->channels;
+  int sb, ch, i;
+
+  for (sb = 0; sb < SBLIMIT; sb++) {
+    for (ch = 0; ch < s->channels; ch++) {
+      int b = sb < 24 ? random_small(14) : 0;
+      while (b > 0 && 6 + 12 * (b + 1) > budget) b--;
+      if (b > 0) budget -= 6 + 12 * (b + 1);
+      ba[ch][sb] = b;
+    }
+  }
+  for (sb = 0; sb < SBLIMIT; sb++)
+    for (ch = 0; ch < s->channels; ch++) put(w, ba[ch][sb], 4);
+  for (sb = 0; sb < SBLIMIT; sb++)
+    for (ch = 0; ch < s->channels; ch++)
+      if (ba[ch][sb]) put(w, 10 + random_below(40), 6);
+  for (i = 0; i < 12; i++)
+    for (sb = 0; sb < SBLIMIT; sb++)
+      for (ch = 0; ch < s->channels; ch++)
+        if (ba[ch][sb]) put(w, random_bits(ba[ch][sb] + 1), ba[ch][sb] + 1);
+}
+
+/* the same choice as II_select_table() */
+static const struct al_table *layer2_table(const stream_spec *s, int bitrate, int *sblimit) {
+  static const int translate[3][2][16] = {
+    { { 0,2,2,2,2,2,2,0,0,0,1,1,1,1,1,0 }, { 0,2,2,0,0,0,1,1,1,1,1,1,1,1,1,0 } },
+    { { 0,2,2,2,2,2,2,0,0,0,0,0,0,0,0,0 }, { 0,2,2,0,0,0,0,0,0,0,0,0,0,0,0,0 } },
+    { { 0,3,3,3,3,3,3,0,0,0,1,1,1,1,1,0 }, { 0,3,3,0,0,0,1,1,1,1,1,1,1,1,1,0 } }
+  };
+  static const struct al_table *tables[5] = { alloc_0, alloc_1, alloc_2, alloc_3, alloc_4 };
+  static const int sblims[5] = { 27, 30, 8, 12, 30 };
+  int table = s->version == 1 ? translate[0][2 - s->channels][bitrate] : 4;
+
+  *sblimit = sblims[table];
+  return tables[table];
+}
+
+static void layer2_frame(bitwriter *w, const stream_spec *s, int bitrate, size_t end) {
+  const struct al_table *rows[SBLIMIT], *row;
+  int ba[2][SBLIMIT], scfsi[2][SBLIMIT];
+  int sblimit, sb, ch, i, j;
+  long budget = (long) (end - w->bits);
+  static const int scales[4] = { 3, 2, 1, 2 };
+
+  row = layer2_table(s, bitrate, &sblimit);
+  for (sb = 0; sb < sblimit; sb++) {
+    rows[sb] = row;
+    budget -= row->bits * s->channels;
+    row += 1 << row->bits;
+  }
+  for (sb = 0; sb < sblimit; sb++) {
+    for (ch = 0; ch < s->channels; ch++) {
+      int b = random_small((1 << rows[sb]->bits) - 1);
+      long cost;
+      scfsi[ch][sb] = random_bits(2);
+      for (;;) {
+        const struct al_table *q = rows[sb] + b;
+        cost = b == 0 ? 0 : 2 + 6 * scales[scfsi[ch][sb]] + 12 * (q->d > 0 ? q->bits : 3 * q->bits);
+        if (cost <= budget) break;
+        b--;
+      }
+      budget -= cost;
+      ba[ch][sb] = b;
+    }
+  }
+
+  for (sb = 0; sb < sblimit; sb++)
+    for (ch = 0; ch < s->channels; ch++) put(w, ba[ch][sb], rows[sb]->bits);
+  for (sb = 0; sb < sblimit; sb++)
+    for (ch = 0; ch < s->channels; ch++)
+      if (ba[ch][sb]) put(w, scfsi[ch][sb], 2);
+  for (sb = 0; sb < sblimit; sb++)
+    for (ch = 0; ch < s->channels; ch++)
+      if (ba[ch][sb])
+        for (i = 0; i < scales[scfsi[ch][sb]]; i++) put(w, 10 + random_below(40), 6);
+  for (i = 0; i < 12; i++) {
+    for (sb = 0; sb < sblimit; sb++) {
+      for (ch = 0; ch < s->channels; ch++) {
+        const struct al_table *q = rows[sb] + ba[ch][sb];
+        if (!ba[ch][sb]) continue;
+        if (q->d > 0) {
+          /* three samples grouped into one code */
+          put(w, random_below(q->d * q->d * q->d), q->bits);
+        } else {
+          /* all ones isn't a valid sample */
+          for (j = 0; j < 3; j++) put(w, random_below((1 << q->bits) - 1), q->bits);
+        }
+      }
+    }
+  }
+}
+
+/* Huffman codes of the Layer III tables, found by walking libmpg123's
+ * decoding trees */
+typedef struct {
+  unsigned long code[16][16];
+  int length[16][16];
+} huffcode;
+
+static huffcode codes[32];
+static huffcode quad_codes[2];
+
+static void walk(const short *table, int pos, unsigned long code, int length, huffcode *h) {
+  short y = table[pos];
+  if (y >= 0) {
+    h->code[y >> 4][y & 0xf] = code;
+    h->length[y >> 4][y & 0xf] = length;
+    return;
+  }
+  walk(table, pos + 1, code << 1, length + 1, h);
+  walk(table, pos + 1 - y, (code << 1) | 1, length + 1, h);
+}
+
+static void init_codes(void) {
+  int i;
+  for (i = 0; i < 32; i++) walk(ht[i].table, 0, 0, 0, &codes[i]);
+  for (i = 0; i < 2; i++) walk(htc[i].table, 0, 0, 0, &quad_codes[i]);
+}
+
+/* tables that have codes, and the largest value (before linbits) of each */
+static const int big_tables[] = { 1, 2, 3, 5, 6, 7, 8, 9, 10, 11, 12, 13, 15, 16, 17, 18, 19, 20, 21, 22, 23, 24, 25, 26, 27, 28, 29, 30, 31 };
+
+static int table_max(int t) {
+  return t == 1 ? 1 : t < 5 ? 2 : t < 7 ? 3 : t < 10 ? 5 : t < 13 ? 7 : 15;
+}
+
+static int value_bits(int t, int v) {
+  if (v == 0) return 0;
+  return 1 + (v >= 15 && ht[t].linbits ? (int) ht[t].linbits : 0);
+}
+
+static void put_value(bitwriter *w, int t, int v) {
+  if (v >= 15 && ht[t].linbits) put(w, v - 15, ht[t].linbits);
+  if (v) put(w, random_bits(1), 1);
+}
+
+/* Writes the spectrum of one granule of one channel into `main`, no more
+ * than `budget` bits, and fills in its side info fields. */
+typedef struct {
+  int part2_3_length;
+  int big_values;
+  int global_gain;
+  int table;
+  int count1table;
+} granule;
+
+static void layer3_granule(bitwriter *main, long budget, granule *g) {
+  int t = big_tables[random_below(sizeof(big_tables) / sizeof(big_tables[0]))];
+  int max = table_max(t), limit = max;
+  int pairs = 0, quads = 0;
+  size_t start = main->bits;
+
+  if (max == 15 && ht[t].linbits) limit = 15 + (1 << (ht[t].linbits > 6 ? 6 : ht[t].linbits)) - 1;
+  g->table = t;
+  g->count1table = random_bits(1);
+  g->global_gain = 130 + random_below(30);
+
+  while (pairs < 288) {
+    int x = random_small(limit), y = random_small(limit);
+    int cx = x > max ? max : x, cy = y > max ? max : y;
+    long cost = codes[t].length[cx][cy] + value_bits(t, x) + value_bits(t, y);
+    if (x > max || y > max) {
+      /* only tables with linbits have escapes; those clamp to 15 */
+      if (!ht[t].linbits) continue;
+    }
+    if ((long) (main->bits - start) + cost > budget) break;
+    put(main, codes[t].code[cx][cy], codes[t].length[cx][cy]);
+    put_value(main, t, x);
+    put_value(main, t, y);
+    pairs++;
+  }
+  g->big_values = pairs;
+
+  while (quads < (288 - pairs) / 2) {
+    int v[4], i, cost, idx = 0;
+    for (i = 0; i < 4; i++) v[i] = random_bits(2) == 0;
+    for (i = 0; i < 4; i++) idx = (idx << 1) | v[i];
+    cost = quad_codes[g->count1table].length[idx >> 4][idx & 0xf] + v[0] + v[1] + v[2] + v[3];
+    if ((long) (main->bits - start) + cost > budget) break;
+    put(main, quad_codes[g->count1table].code[idx >> 4][idx & 0xf], quad_codes[g->count1table].length[idx >> 4][idx & 0xf]);
+    for (i = 0; i < 4; i++) if (v[i]) put(main, random_bits(1), 1);
+    quads++;
+  }
+  g->part2_3_length = (int) (main->bits - start);
+}
+
+static void layer3_frame(bitwriter *w, const stream_spec *s, size_t end) {
+  int lsf = s->version != 1;
+  int granules = lsf ? 1 : 2;
+  int side = lsf ? (s->channels == 1 ? 9 : 17) : (s->channels == 1 ? 17 : 32);
+  long budget = (long) (end - w->bits) - side * 8;
+  granule g[2][2];
+  bitwriter main = { NULL, 0, 0 };
+  int gr, ch;
+
+  for (gr = 0; gr < granules; gr++)
+    for (ch = 0; ch < s->channels; ch++)
+      layer3_granule(&main, budget / (granules * s->channels), &g[gr][ch]);
+
+  put(w, 0, lsf ? 8 : 9);             /* main_data_begin: no bit reservoir */
+  put(w, 0, lsf ? s->channels : (s->channels == 1 ? 5 : 3));
+  if (!lsf) put(w, 0, 4 * s->channels); /* scfsi */
+  for (gr = 0; gr < granules; gr++) {
+    for (ch = 0; ch < s->channels; ch++) {
+      put(w, g[gr][ch].part2_3_length, 12);
+      put(w, g[gr][ch].big_values, 9);
+      put(w, g[gr][ch].global_gain, 8);
+      put(w, 0, lsf ? 9 : 4);         /* scalefac_compress: no scale factors */
+      put(w, 0, 1);                   /* long blocks */
+      put(w, g[gr][ch].table, 5);     /* the same table in all three regions */
+      put(w, g[gr][ch].table, 5);
+      put(w, g[gr][ch].table, 5);
+      put(w, 7, 4);
+      put(w, 7, 3);
+      if (!lsf) put(w, 0, 1);         /* preflag */
+      put(w, 0, 1);
+      put(w, g[gr][ch].count1table, 1);
+    }
+  }
+  {
+    size_t i;
+    for (i = 0; i < main.bits; i++) put(w, (main.data[i >> 3] >> (7 - (i & 7))) & 1, 1);
+  }
+  free(main.data);
+}
+
+/* Generates SECONDS of audio, returns the number of frames. */
+static long generate(const stream_spec *s, bitwriter *w) {
+  int lsf = s->version != 1;
+  long rate = spec_rate(s);
+  long frames = SECONDS * rate / spec_samples(s), i;
+
+  for (i = 0; i < frames; i++) {
+    int bitrate = s->bitrate ? s->bitrate : vbr_bitrate(s);
+    long kbps = bitrates[lsf][s->layer - 1][bitrate];
+    size_t bytes = s->layer == 1 ? kbps * 12000 / rate * 4
+                 : s->layer == 2 ? kbps * 144000 / rate
+                 : kbps * 144000 / (rate << lsf);
+    size_t end = w->bits + bytes * 8;
+
+    put_header(w, s, bitrate);
+    if (s->layer == 1) layer1_frame(w, s, end);
+    else if (s->layer == 2) layer2_frame(w, s, bitrate, end);
+    else layer3_frame(w, s, end);
+    pad(w, end);
+  }
+  return frames;
+}
+
+static double now(void) {
+#ifdef WIN32
+  LARGE_INTEGER count, frequency;
+  QueryPerformanceCounter(&count);
+  QueryPerformanceFrequency(&frequency);
+  return (double) count.QuadPart / frequency.QuadPart;
+#else
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return t.tv_sec + t.tv_nsec / 1e9;
+#endif
+}
+
+static unsigned long long cycles(void) {
+#ifdef HAVE_RDTSC
+  return __rdtsc();
+#else
+  return 0;
+#endif
+}
+
+static const char *encoding_name(int encoding) {
+  switch (encoding) {
+    case MPG123_ENC_SIGNED_16: return "s16";
+    case MPG123_ENC_UNSIGNED_16: return "u16";
+    case MPG123_ENC_SIGNED_24: return "s24";
+    case MPG123_ENC_UNSIGNED_24: return "u24";
+    case MPG123_ENC_SIGNED_32: return "s32";
+    case MPG123_ENC_UNSIGNED_32: return "u32";
+    case MPG123_ENC_SIGNED_8: return "s8";
+    case MPG123_ENC_UNSIGNED_8: return "u8";
+    case MPG123_ENC_ULAW_8: return "ulaw";
+    case MPG123_ENC_ALAW_8: return "alaw";
+    case MPG123_ENC_FLOAT_32: return "f32";
+    case MPG123_ENC_FLOAT_64: return "f64";
+    default: return "?";
+  }
+}
+
+/* Decodes the stream once, returns the samples per channel, or -1. */
+static long decode(mpg123_handle *mh, const bitwriter *w, unsigned char *out, size_t out_size) {
+  size_t done, total = 0;
+  long rate;
+  int channels, encoding, ret;
+
+  if (mpg123_open_feed(mh) != MPG123_OK) return -1;
+  ret = mpg123_decode(mh, w->data, w->bits / 8, out, out_size, &done);
+  total += done;
+  while (ret != MPG123_NEED_MORE && ret != MPG123_ERR) {
+    ret = mpg123_decode(mh, NULL, 0, out, out_size, &done);
+    total += done;
+  }
+  if (ret == MPG123_ERR) return -1;
+  mpg123_getformat(mh, &rate, &channels, &encoding);
+  mpg123_close(mh);
+  return (long) (total / (channels * mpg123_encsize(encoding)));
+}
+
+int main(int argc, char **argv) {
+  double min_seconds = argc > 1 ? atof(argv[1]) : 0.1;
+  const char **decoders, **decoder;
+  const int *encodings;
+  size_t num_encodings, e, i;
+  unsigned char *out = malloc(1 << 20);
+  bitwriter streams[sizeof(specs) / sizeof(specs[0])];
+  long frames[sizeof(specs) / sizeof(specs[0])];
+  int failed = 0;
+
+  mpg123_init();
+  init_codes();
+  for (i = 0; i < sizeof(specs) / sizeof(specs[0]); i++) {
+    memset(&streams[i], 0, sizeof(bitwriter));
+    frames[i] = generate(&specs[i], &streams[i]);
+  }
+
+  mpg123_encodings(&encodings, &num_encodings);
+  decoders = mpg123_decoders();
+#ifndef HAVE_RDTSC
+  printf("no cycle counter on this CPU, cycles/sample is 0\n");
+#endif
+  printf("%-14s %-5s %9s %9s %12s  %s\n", "decoder", "enc", "MB/s", "realtime", "cycles/smp", "stream");
+
+  for (decoder = decoders; *decoder; decoder++) {
+    for (e = 0; e < num_encodings; e++) {
+      for (i = 0; i < sizeof(specs) / sizeof(specs[0]); i++) {
+        const stream_spec *s = &specs[i];
+        long expected = frames[i] * spec_samples(s), samples = 0;
+        double begin, took;
+        unsigned long long c0, c1;
+        long passes = 0;
+        mpg123_handle *mh = mpg123_new(*decoder, NULL);
+
+        mpg123_param(mh, MPG123_ADD_FLAGS, MPG123_QUIET, 0);
+        mpg123_format_none(mh);
+        if (mpg123_format(mh, spec_rate(s), s->channels == 2 ? MPG123_STEREO : MPG123_MONO, encodings[e]) != MPG123_OK) {
+          mpg123_delete(mh);
+          continue;
+        }
+
+        begin = now();
+        c0 = cycles();
+        do {
+          long n = decode(mh, &streams[i], out, 1 << 20);
+          if (n != expected) {
+            printf("FAIL: %s decoded %ld of %ld samples with %s to %s\n", s->name, n, expected, *decoder, encoding_name(encodings[e]));
+            failed = 1;
+            break;
+          }
+          samples += n;
+          passes++;
+        } while ((took = now() - begin) < min_seconds);
+        c1 = cycles();
+        mpg123_delete(mh);
+        if (samples == 0) continue;
+
+        printf("%-14s %-5s %9.2f %9.1f %12.1f  %s\n", *decoder, encoding_name(encodings[e]),
+               passes * (streams[i].bits / 8) / took / 1e6, samples / (double) spec_rate(s) / took,
+               (double) (c1 - c0) / ((double) samples * s->channels), s->name);
+      }
+    }
+  }
+
+  for (i = 0; i < sizeof(specs) / sizeof(specs[0]); i++) free(streams[i].data);
+  free(out);
+  mpg123_exit();
+  printf(failed ? "FAIL\n" : "OK\n");
+  return failed;
+}
@@ -175,6 +175,7 @@ enum mpg123_param_flags
 	,MPG123_SKIP_ID3V2 = 0x2000 /**< 10 0000 0000 0000 Do not parse ID3v2 tags, just skip them. */
 	,MPG123_IGNORE_INFOFRAME = 0x4000 /**< 100 0000 0000 0000 Do not parse the LAME/Xing info frame, treat it as normal MPEG data. */
 	,MPG123_AUTO_RESAMPLE = 0x8000 /**< 1000 0000 0000 0000 Allow automatic internal resampling of any kind (default on if supported). Especially when going lowlevel with replacing output buffer, you might want to unset this flag. Setting MPG123_DOWNSAMPLE or MPG123_FORCE_RATE will override this. */
+	,MPG123_LAZY_ID3 = 0x10000 /**< 1 0000 0000 0000 0000 Only read the ID3v2 frames that get parsed (text, comments, RVA2) and skip over the others, like pictures (APIC) and embedded files (GEOB), instead of reading the whole tag into memory. The skipped frames are listed by mpg123_id3_frames() and can be read with mpg123_id3_frame(). */
 };
 
 /** choices for MPG123_RVA */
@@ -284,6 +285,7 @@ enum mpg123_errors
 	,MPG123_BAD_CUSTOM_IO /**< Custom I/O not prepared. */
 	,MPG123_LFS_OVERFLOW /**< Offset value overflow during translation of large file API calls -- your client program cannot handle that large file. */
 	,MPG123_INT_OVERFLOW /**< Some integer overflow. */
+	,MPG123_BAD_TOC /**< Seek index blob is corrupt or does not match the opened stream. */
 };
 
 /** Return a string describing that error errcode means. */
@@ -616,6 +618,21 @@ EXPORT int mpg123_index(mpg123_handle *mh, off_t **offsets, off_t *step, size_t
  *  \param fill    number of recorded index offsets; size of the array */ 
 EXPORT int mpg123_set_index(mpg123_handle *mh, off_t *offsets, off_t step, size_t fill);
 
+/** Serialise the frame index and the track length/gapless information of the
+ *  opened stream into a compact blob that can be cached next to the file.
+ *  Do this after mpg123_scan() (or a full decode) for an index covering the whole stream.
+ *  The blob carries a stamp of file size and modification time; it is only
+ *  accepted again by mpg123_toc_restore() for the unchanged file.
+ *  \param buf  storage for the blob, or NULL to query the needed size
+ *  \param size in: size of buf, out: size of the blob */
+EXPORT int mpg123_toc_store(mpg123_handle *mh, unsigned char *buf, size_t *size);
+
+/** Restore the frame index and track length/gapless information from a blob
+ *  produced by mpg123_toc_store(), making mpg123_scan() unnecessary for accurate seeking.
+ *  Call this right after opening the stream, before decoding.
+ *  Returns MPG123_ERR with MPG123_BAD_TOC as error code if the blob is corrupt or stale. */
+EXPORT int mpg123_toc_restore(mpg123_handle *mh, const unsigned char *buf, size_t size);
+
 /** Get information about current and remaining frames/seconds.
  *  WARNING: This function is there because of special usage by standalone mpg123 and may be removed in the final version of libmpg123!
  *  You provide an offset (in frames) from now and a number of output bytes 
@@ -966,6 +983,28 @@ EXPORT int mpg123_icy(mpg123_handle *mh, char **icy_meta); /* same for ICY meta
  *  \return pointer to newly allocated buffer with UTF-8 data (You free() it!) */
 EXPORT char* mpg123_icy2utf8(const char* icy_text);
 
+/** Position of an ID3v2 frame in the stream, as recorded with MPG123_LAZY_ID3. */
+typedef struct
+{
+	char id[5];           /**< The frame id as in the tag, like APIC (or PIC for ID3v2.2), terminated. */
+	unsigned long offset; /**< Stream position of the frame data, after the frame header. */
+	unsigned long size;   /**< Size of the frame data in the stream. */
+	int unsync;           /**< Whether the data is unsynchronised. */
+	int skipped;          /**< Whether the data was skipped over instead of parsed. */
+} mpg123_id3frame;
+
+/** Point frames to the list of all frames in the ID3v2 tag, which may change on any next read/decode function call.
+ *  This is only filled with MPG123_LAZY_ID3.
+ *  \return Return value is MPG123_OK or MPG123_ERR,  */
+EXPORT int mpg123_id3_frames(mpg123_handle *mh, mpg123_id3frame **frames, size_t *count);
+
+/** Read the data of frame number index in the list of mpg123_id3_frames(), with unsynchronisation undone.
+ *  The stream position is restored afterwards, so this can be done in between decoding.
+ *  The stream needs to be seekable (MPG123_NO_SEEK otherwise).
+ *  \param data set to storage that stays valid until the next call of this function or the stream is closed
+ *  \return Return value is MPG123_OK or MPG123_ERR,  */
+EXPORT int mpg123_id3_frame(mpg123_handle *mh, size_t index, unsigned char **data, size_t *size);
+
 
 /* @} */
 
@@ -9,6 +9,9 @@
 {
   'variables': {
     'target_arch%': 'ia32',
+    # the output modules whose libraries are installed, for the tests of
+    # those modules that need them
+    'mpg123_installed_backends%': '<!(node backends.js <(OS) none)',
   },
   'target_defaults': {
     'default_configuration': 'Debug',
@@ -87,6 +90,7 @@
         'src/libmpg123/layer1.c',
         'src/libmpg123/layer2.c',
         'src/libmpg123/layer3.c',
+        'src/libmpg123/layer3_simd.c',
         'src/libmpg123/feature.c',
       ],
       'include_dirs': [
@@ -107,12 +111,42 @@
         ]
       },
       'conditions': [
+        # no fused multiply-adds, so that the vectorised Layer III stages and
+        # the C code they replace round alike, and layer3_test can compare
+        # them bit for bit
+        ['OS!="win"', {
+          'cflags': [ '-ffp-contract=off' ],
+          'xcode_settings': { 'OTHER_CFLAGS': [ '-ffp-contract=off' ] },
+        }],
+        # upstream's decoder trips these, and is kept as it is
+        ['OS!="win"', {
+          'cflags': [
+            '-Wno-sign-compare',
+            '-Wno-empty-body',
+            '-Wno-shift-negative-value',
+            '-Wno-unused-value',
+            '-Wno-array-bounds',
+          ],
+          'xcode_settings': {
+            'WARNING_CFLAGS': [
+              '-Wno-sign-compare',
+              '-Wno-empty-body',
+              '-Wno-shift-negative-value',
+              '-Wno-unused-value',
+              '-Wno-array-bounds',
+            ],
+          },
+        }],
         ['mpg123_cpu=="arm_nofpu"', {
           'defines': [
             'OPT_ARM',
             'REAL_IS_FIXED',
             'NEWOLD_WRITE_SAMPLE',
           ],
+          # tests that poke at the library internals need to agree on these
+          'direct_dependent_settings': {
+            'defines': [ 'OPT_ARM', 'REAL_IS_FIXED' ],
+          },
           'sources': [
             'src/libmpg123/synth_arm.S',
           ],
@@ -123,6 +157,9 @@
             'REAL_IS_FLOAT',
             'NEWOLD_WRITE_SAMPLE',
           ],
+          'direct_dependent_settings': {
+            'defines': [ 'OPT_I386', 'REAL_IS_FLOAT' ],
+          },
           'sources': [
             'src/libmpg123/synth_s32.c',
             'src/libmpg123/synth_real.c',
@@ -134,6 +171,9 @@
             'OPT_X86_64',
             'REAL_IS_FLOAT',
           ],
+          'direct_dependent_settings': {
+            'defines': [ 'OPT_X86_64', 'REAL_IS_FLOAT' ],
+          },
           'sources': [
             'src/libmpg123/dct64_x86_64.S',
             'src/libmpg123/dct64_x86_64_float.S',
@@ -155,14 +195,25 @@
       'product_prefix': 'lib',
       'type': 'static_library',
       'variables': {
-        'conditions': [
-          # "mpg123_backend" is the audio backend to use
-          ['OS=="mac"', { 'mpg123_backend%': 'coreaudio' }],
-          ['OS=="win"', { 'mpg123_backend%': 'win32' }],
-          ['OS=="linux"', { 'mpg123_backend%': 'alsa' }],
-          ['OS=="freebsd"', { 'mpg123_backend%': 'alsa' }],
-          ['OS=="solaris"', { 'mpg123_backend%': 'sun' }],
-        ]
+        'variables': {
+          'variables': {
+            'conditions': [
+              # "mpg123_backend" is the audio backend to use by default
+              ['OS=="mac"', { 'mpg123_backend%': 'coreaudio' }],
+              ['OS=="win"', { 'mpg123_backend%': 'win32' }],
+              ['OS=="linux"', { 'mpg123_backend%': 'alsa' }],
+              ['OS=="freebsd"', { 'mpg123_backend%': 'alsa' }],
+              ['OS=="solaris"', { 'mpg123_backend%': 'sun' }],
+            ]
+          },
+          'mpg123_backend%': '<(mpg123_backend)',
+          # "mpg123_backends" are the ones that get built in besides it, which
+          # are all of those that can be built here unless told otherwise
+          'mpg123_backends%': '<!(node backends.js <(OS) <(mpg123_backend))',
+        },
+        'mpg123_backend%': '<(mpg123_backend)',
+        'mpg123_backends%': '<(mpg123_backends)',
+        'mpg123_all_backends': '<(mpg123_backend) <(mpg123_backends)',
       },
       'include_dirs': [
         'src',
@@ -188,14 +239,14 @@
         ]
       },
       'conditions': [
-        ['mpg123_backend=="alsa"', {
+        ['"alsa" in mpg123_all_backends.split()', {
           'link_settings': {
             'libraries': [
               '-lasound',
             ]
           }
         }],
-        ['mpg123_backend=="coreaudio"', {
+        ['"coreaudio" in mpg123_all_backends.split()', {
           'link_settings': {
             'libraries': [
               '-framework AudioToolbox',
@@ -204,7 +255,7 @@
             ],
           },
         }],
-        ['mpg123_backend=="openal"', {
+        ['"openal" in mpg123_all_backends.split() and OS=="mac"', {
           'defines': [
             'OPENAL_SUBDIR_OPENAL'
           ],
@@ -214,14 +265,25 @@
             ]
           }
         }],
-        ['mpg123_backend=="win32"', {
+        ['"openal" in mpg123_all_backends.split() and OS!="mac"', {
+          'defines': [
+            'OPENAL_SUBDIR_AL'
+          ],
+          'link_settings': {
+            'libraries': [
+              '-lopenal',
+              '-lpthread',
+            ]
+          }
+        }],
+        ['"win32" in mpg123_all_backends.split()', {
           'link_settings': {
             'libraries': [
               '-lwinmm.lib',
             ],
           }
         }],
-        ['mpg123_backend=="pulse"', {
+        ['"pulse" in mpg123_all_backends.split()', {
           'link_settings': {
             'libraries': [
               '-lpulse',
@@ -229,17 +291,140 @@
             ],
           }
         }],
-        ['mpg123_backend=="jack"', {
+        ['"sdl" in mpg123_all_backends.split()', {
+          'cflags': [
+            '<!@(pkg-config --cflags sdl2)',
+          ],
+          'xcode_settings': {
+            'OTHER_CFLAGS': [
+              '<!@(pkg-config --cflags sdl2)',
+            ],
+          },
+          'link_settings': {
+            'libraries': [
+              '<!@(pkg-config --libs sdl2)',
+            ],
+          }
+        }],
+        ['"jack" in mpg123_all_backends.split()', {
           'link_settings': {
             'libraries': [
               '-ljack',
             ],
           }
         }],
+        # the other backends, each under a name of its own (see src/output/backends/)
+        ['"alsa" in mpg123_backends.split() and mpg123_backend!="alsa"', {
+          'sources': [ 'src/output/backends/alsa.c' ],
+          'direct_dependent_settings': { 'defines': [ 'SPEAKER_BACKEND_ALSA' ] },
+        }],
+        ['"pulse" in mpg123_backends.split() and mpg123_backend!="pulse"', {
+          'sources': [ 'src/output/backends/pulse.c' ],
+          'direct_dependent_settings': { 'defines': [ 'SPEAKER_BACKEND_PULSE' ] },
+        }],
+        ['"jack" in mpg123_backends.split() and mpg123_backend!="jack"', {
+          'sources': [ 'src/output/backends/jack.c' ],
+          'direct_dependent_settings': { 'defines': [ 'SPEAKER_BACKEND_JACK' ] },
+        }],
+        ['"oss" in mpg123_backends.split() and mpg123_backend!="oss"', {
+          'sources': [ 'src/output/backends/oss.c' ],
+          'direct_dependent_settings': { 'defines': [ 'SPEAKER_BACKEND_OSS' ] },
+        }],
+        ['"sdl" in mpg123_backends.split() and mpg123_backend!="sdl"', {
+          'sources': [ 'src/output/backends/sdl.c' ],
+          'direct_dependent_settings': { 'defines': [ 'SPEAKER_BACKEND_SDL' ] },
+        }],
+        ['"openal" in mpg123_backends.split() and mpg123_backend!="openal"', {
+          'sources': [ 'src/output/backends/openal.c' ],
+          'direct_dependent_settings': { 'defines': [ 'SPEAKER_BACKEND_OPENAL' ] },
+        }],
+        ['"coreaudio" in mpg123_backends.split() and mpg123_backend!="coreaudio"', {
+          'sources': [ 'src/output/backends/coreaudio.c' ],
+          'direct_dependent_settings': { 'defines': [ 'SPEAKER_BACKEND_COREAUDIO' ] },
+        }],
+        ['"win32" in mpg123_backends.split() and mpg123_backend!="win32"', {
+          'sources': [ 'src/output/backends/win32.c' ],
+          'direct_dependent_settings': { 'defines': [ 'SPEAKER_BACKEND_WIN32' ] },
+        }],
+        ['"bench" in mpg123_backends.split() and mpg123_backend!="bench"', {
+          'sources': [ 'src/output/backends/bench.c' ],
+          'direct_dependent_settings': { 'defines': [ 'SPEAKER_BACKEND_BENCH' ] },
+        }],
+        ['"dummy" in mpg123_backends.split() and mpg123_backend!="dummy"', {
+          'sources': [ 'src/output/backends/dummy.c' ],
+          'direct_dependent_settings': { 'defines': [ 'SPEAKER_BACKEND_DUMMY' ] },
+        }],
       ],
       'sources': [ 'src/output/<(mpg123_backend).c' ],
     },
 
+    {
+      # the shared memory ring that carries audio over to "speakerd", which
+      # isn't available on Windows
+      'target_name': 'xfermem',
+      'product_prefix': 'lib',
+      'type': 'static_library',
+      'include_dirs': [
+        'src',
+        'src/libmpg123',
+        # platform and arch-specific headers
+        'config/<(OS)/<(target_arch)',
+      ],
+      'defines': [
+        'PIC',
+        'HAVE_CONFIG_H',
+      ],
+      'direct_dependent_settings': {
+        'include_dirs': [
+          'src',
+          'src/libmpg123',
+          # platform and arch-specific headers
+          'config/<(OS)/<(target_arch)',
+        ]
+      },
+      'conditions': [
+        ['OS=="linux"', {
+          'link_settings': {
+            'libraries': [
+              '-lrt',
+            ]
+          }
+        }],
+      ],
+      'sources': [ 'src/xfermem.c' ],
+    },
+
+    {
+      # HTTP and ICY streaming from the mpg123 program, for stream input.
+      # Windows would need win32_net.c instead
+      'target_name': 'http',
+      'product_prefix': 'lib',
+      'type': 'static_library',
+      'include_dirs': [
+        'src',
+        'src/libmpg123',
+        # platform and arch-specific headers
+        'config/<(OS)/<(target_arch)',
+      ],
+      'defines': [
+        'PIC',
+        'HAVE_CONFIG_H',
+      ],
+      'direct_dependent_settings': {
+        'include_dirs': [
+          'src',
+          'src/libmpg123',
+          # platform and arch-specific headers
+          'config/<(OS)/<(target_arch)',
+        ]
+      },
+      'sources': [
+        'src/httpget.c',
+        'src/httpparam.c',
+        'src/resolver.c',
+      ],
+    },
+
     {
       'target_name': 'test',
       'type': 'executable',
@@ -247,11 +432,134 @@
       'sources': [ 'test.c' ]
     },
 
+    {
+      'target_name': 'layer3_test',
+      'type': 'executable',
+      'dependencies': [ 'mpg123' ],
+      'defines': [ 'HAVE_CONFIG_H' ],
+      'conditions': [
+        ['OS!="win"', {
+          'cflags': [ '-ffp-contract=off' ],
+          'xcode_settings': { 'OTHER_CFLAGS': [ '-ffp-contract=off' ] },
+        }],
+      ],
+      'sources': [ 'test_layer3.c' ]
+    },
+    {
+      'target_name': 'toc_test',
+      'type': 'executable',
+      'dependencies': [ 'mpg123' ],
+      'sources': [ 'test_toc.c' ]
+    },
+    {
+      'target_name': 'id3_test',
+      'type': 'executable',
+      'dependencies': [ 'mpg123' ],
+      'sources': [ 'test_id3.c' ]
+    },
+    {
+      'target_name': 'decode_bench',
+      'type': 'executable',
+      'dependencies': [ 'mpg123' ],
+      'defines': [ 'HAVE_CONFIG_H' ],
+      'sources': [ 'bench_decode.c' ]
+    },
+
     {
       'target_name': 'output_test',
       'type': 'executable',
       'dependencies': [ 'output' ],
       'sources': [ 'test_output.c' ]
+    },
+
+    {
+      # the bench module's simulated device, whatever the backend is
+      'target_name': 'bench_test',
+      'type': 'executable',
+      'include_dirs': [
+        'src',
+        'src/output',
+        'src/libmpg123',
+        # platform and arch-specific headers
+        'config/<(OS)/<(target_arch)',
+      ],
+      'defines': [
+        'PIC',
+        'NOXFERMEM',
+        'REAL_IS_FLOAT',
+        'HAVE_CONFIG_H',
+        'BUILDING_OUTPUT_MODULES=1'
+      ],
+      'sources': [ 'test_bench.c' ]
     }
+  ],
+
+  'conditions': [
+    ['OS=="linux" or OS=="freebsd"', {
+      'targets': [
+        {
+          # the OSS module against a fake device, whatever the backend is
+          'target_name': 'oss_test',
+          'type': 'executable',
+          'include_dirs': [
+            'src',
+            'src/output',
+            'src/libmpg123',
+            # platform and arch-specific headers
+            'config/<(OS)/<(target_arch)',
+          ],
+          'defines': [
+            'PIC',
+            'NOXFERMEM',
+            'REAL_IS_FLOAT',
+            'HAVE_CONFIG_H',
+            'BUILDING_OUTPUT_MODULES=1'
+          ],
+          'link_settings': {
+            'libraries': [
+              '-lpthread',
+            ]
+          },
+          'sources': [ 'test_oss.c' ]
+        }
+      ]
+    }],
+    ['"sdl" in mpg123_installed_backends.split()', {
+      'targets': [
+        {
+          # the SDL module on SDL's dummy driver, whatever the backend is
+          'target_name': 'sdl_test',
+          'type': 'executable',
+          'include_dirs': [
+            'src',
+            'src/output',
+            'src/libmpg123',
+            # platform and arch-specific headers
+            'config/<(OS)/<(target_arch)',
+          ],
+          'defines': [
+            'PIC',
+            'NOXFERMEM',
+            'REAL_IS_FLOAT',
+            'HAVE_CONFIG_H',
+            'BUILDING_OUTPUT_MODULES=1'
+          ],
+          'cflags': [
+            '<!@(pkg-config --cflags sdl2)',
+          ],
+          'xcode_settings': {
+            'OTHER_CFLAGS': [
+              '<!@(pkg-config --cflags sdl2)',
+            ],
+          },
+          'link_settings': {
+            'libraries': [
+              '<!@(pkg-config --libs sdl2)',
+            ],
+          },
+          'sources': [ 'test_sdl.c' ]
+        }
+      ]
+    }]
   ]
 }
@@ -221,6 +221,7 @@ audio_output_t* alloc_audio_output()
 	ao->format = -1;
 	ao->flags = 0;
 	ao->auxflags = 0;
+	ao->latency = 0;
 
 	/*ao->module = NULL;*/
 
@@ -231,6 +232,9 @@ audio_output_t* alloc_audio_output()
 	ao->flush = NULL;
 	ao->close = NULL;
 	ao->deinit = NULL;
+	ao->delay = NULL;
+	ao->delay_at = NULL;
+	ao->enumerate = NULL;
 	
 	return ao;
 }
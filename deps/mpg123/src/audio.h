@@ -61,6 +61,18 @@ typedef struct audio_output_struct
 	int is_open;	/* something opened? */
 #define MPG123_OUT_QUIET 1
 	int auxflags; /* For now just one: quiet mode (for probing). */
+	long latency;	/* requested device buffering in microseconds, 0 for the default */
+	/* Optional: frames written but not played yet, or -1 if unknown. */
+	int (*delay)(struct audio_output_struct *);
+	/* Optional: like delay(), and stores in *when the CLOCK_MONOTONIC time in
+	   seconds at which the device was that far behind, as the device reported
+	   it rather than when it was asked. */
+	int (*delay_at)(struct audio_output_struct *, double *when);
+	/* Optional: calls store() with the name and a description of each device
+	   that open() can be pointed at, without opening any. Returns -1 if the
+	   devices could not be listed, or if store() failed (returned non-zero)
+	   for one of them. */
+	int (*enumerate)(struct audio_output_struct *, int (*store)(void *arg, const char *name, const char *description), void *arg);
 } audio_output_t;
 
 /* Lazy. */
@@ -277,7 +277,7 @@ void buffer_loop(audio_output_t *ao, sigset_t *oldsigset)
 			bytes = outburst;
 
 		debug("write");
-		outbytes = flush_output(ao, (unsigned char*) xf->data + xf->readindex, bytes);
+		outbytes = flush_output(ao, (unsigned char*) xfermem_data(xf) + xf->readindex, bytes);
 
 		if(outbytes < bytes)
 		{
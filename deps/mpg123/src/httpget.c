@@ -123,7 +123,8 @@ debunk_result:
 #if !defined (WANT_WIN32_SOCKETS)
 static int writestring (int fd, mpg123_string *string)
 {
-	size_t result, bytes;
+	ssize_t result;
+	size_t bytes;
 	char *ptr = string->p;
 	bytes = string->fill ? string->fill-1 : 0;
 
@@ -611,7 +612,7 @@ int http_open(char* url, struct httpdata *hd)
 			char *sptr;
 			if((sptr = strchr(response.p, ' ')))
 			{
-				if(response.fill > sptr-response.p+2)
+				if(response.fill > (size_t)(sptr-response.p)+2)
 				switch (sptr[1])
 				{
 					case '3':
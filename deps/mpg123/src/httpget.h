@@ -63,4 +63,8 @@ extern unsigned long proxyip;
 extern int http_open (char* url, struct httpdata *hd);
 extern char *httpauth;
 
+/* for builds without the mpg123 program: asks for ICY metadata, and gives up on
+   connecting after timeout seconds (0: the system's) */
+void httpparam_init(long timeout);
+
 #endif
@@ -0,0 +1,17 @@
+/*
+	httpparam: the program settings that httpget and resolver go by
+
+	The mpg123 program fills in "param" from its command line. Built without
+	the program, as the "http" library, they are all zero until
+	httpparam_init() sets the ones that HTTP streaming looks at.
+*/
+
+#include "mpg123app.h"
+
+struct parameter param;
+
+void httpparam_init(long timeout)
+{
+	param.talk_icy = 1;
+	param.timeout = timeout;
+}
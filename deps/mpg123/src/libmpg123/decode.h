@@ -195,6 +195,13 @@ void dct64_i486(int*, int* , real*); /* Yeah, of no use outside of synth_i486.c
 void dct36         (real *,real *,real *,real *,real *);
 void dct36_3dnow   (real *,real *,real *,real *,real *);
 void dct36_3dnowext(real *,real *,real *,real *,real *);
+/* The short block IMDCT and the alias reduction, generic variants, */
+void dct12         (real *,real *,real *,real *,real *);
+void antialias     (real *,int);
+/* ... and ones that work on a vector of sub-bands at once, pairs of them windowed with win and win1. */
+void dct36_simd    (real *,real *,real *,real *,real *,real *,size_t);
+void dct12_simd    (real *,real *,real *,real *,real *,real *,size_t);
+void antialias_simd(real *,int);
 
 /* Tools for NtoM resampling synth, defined in ntom.c . */
 int synth_ntom_set_step(mpg123_handle *fr); /* prepare ntom decoding */
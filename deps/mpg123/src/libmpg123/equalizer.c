@@ -9,9 +9,41 @@
 
 #include "mpg123lib_intern.h"
 
+/*
+	The vector versions only need the compiler's intrinsics, not a runtime CPU check:
+	they are picked when the build target guarantees the instruction set anyway (SSE on
+	x86-64, NEON on armv8 and armv7 with -mfpu=neon, AVX with -mavx).
+	The 32 bands are a whole number of vectors for all of them, and the multiply is
+	the same IEEE single precision one the plain C loop does, so results are identical.
+*/
+#ifdef REAL_IS_FLOAT
+#if defined(__AVX__)
+#define EQ_AVX
+#include <immintrin.h>
+#elif defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define EQ_SSE
+#include <xmmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define EQ_NEON
+#include <arm_neon.h>
+#endif
+#endif
+
 void do_equalizer(real *bandPtr,int channel, real equalizer[2][32]) 
 {
 	int i;
+	real *eq = equalizer[channel];
+#if defined(EQ_AVX)
+	for(i=0;i<32;i+=8)
+	_mm256_storeu_ps(bandPtr+i, _mm256_mul_ps(_mm256_loadu_ps(bandPtr+i), _mm256_loadu_ps(eq+i)));
+#elif defined(EQ_SSE)
+	for(i=0;i<32;i+=4)
+	_mm_storeu_ps(bandPtr+i, _mm_mul_ps(_mm_loadu_ps(bandPtr+i), _mm_loadu_ps(eq+i)));
+#elif defined(EQ_NEON)
+	for(i=0;i<32;i+=4)
+	vst1q_f32(bandPtr+i, vmulq_f32(vld1q_f32(bandPtr+i), vld1q_f32(eq+i)));
+#else
 	for(i=0;i<32;i++)
-	bandPtr[i] = REAL_MUL(bandPtr[i], equalizer[channel][i]);
+	bandPtr[i] = REAL_MUL(bandPtr[i], eq[i]);
+#endif
 }
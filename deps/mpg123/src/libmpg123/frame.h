@@ -289,6 +289,11 @@ struct mpg123_handle_struct
 	unsigned char id3buf[128];
 #ifndef NO_ID3V2
 	mpg123_id3v2 id3v2;
+	/* frames of the tag with MPG123_LAZY_ID3, and the data last read by mpg123_id3_frame() */
+	mpg123_id3frame *id3frames;
+	size_t id3frame_count;
+	size_t id3frame_alloc;
+	unsigned char *id3frame_data;
 #endif
 #ifndef NO_ICY
 	struct icy_meta icy;
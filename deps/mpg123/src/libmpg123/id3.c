@@ -37,6 +37,8 @@ static const text_converter text_converters[4] =
 
 static const unsigned int encoding_widths[4] = { 1, 2, 2, 1 };
 
+static unsigned char *read_lazy_tag(mpg123_handle *fr, unsigned char major, int exthead, int unsync, unsigned long length, unsigned long *taglen, int *ret);
+
 /* the code starts here... */
 
 static void null_id3_links(mpg123_handle *fr)
@@ -59,6 +61,10 @@ void init_id3(mpg123_handle *fr)
 	fr->id3v2.text     = NULL;
 	fr->id3v2.extras   = 0;
 	fr->id3v2.extra    = NULL;
+	fr->id3frames      = NULL;
+	fr->id3frame_count = 0;
+	fr->id3frame_alloc = 0;
+	fr->id3frame_data  = NULL;
 }
 
 /* Managing of the text, comment and extra lists. */
@@ -144,6 +150,8 @@ void exit_id3(mpg123_handle *fr)
 	free_comment(fr);
 	free_extra(fr);
 	free_text(fr);
+	free(fr->id3frames);
+	free(fr->id3frame_data);
 }
 
 void reset_id3(mpg123_handle *fr)
@@ -607,11 +615,26 @@ int parse_new_id3(mpg123_handle *fr, unsigned long first4bytes)
 	{
 		unsigned char* tagdata = NULL;
 		fr->id3v2.version = major;
+		if(fr->p.flags & MPG123_LAZY_ID3)
+		{
+			/* Only the frames to parse end up in tagdata, the extended header is gone already. */
+			tagdata = read_lazy_tag(fr, major, flags & EXTHEAD_FLAG, flags & UNSYNC_FLAG, length, &length, &ret2);
+			flags &= ~EXTHEAD_FLAG;
+			if(tagdata == NULL) ret = ret2;
+		}
+		else if((tagdata = (unsigned char*) malloc(length+1)) != NULL)
+		ret2 = fr->rd->read_frame_body(fr,tagdata,length);
+		else
+		{
+			if(NOQUIET) error1("ID3v2: Arrg! Unable to allocate %lu bytes for interpreting ID3v2 data - trying to skip instead.", length);
+			if((ret2 = fr->rd->skip_bytes(fr,length)) < 0) ret = ret2; /* will not store data in backbuff! */
+			else ret = 0;
+		}
 		/* try to interpret that beast */
-		if((tagdata = (unsigned char*) malloc(length+1)) != NULL)
+		if(tagdata != NULL)
 		{
 			debug("ID3v2: analysing frames...");
-			if((ret2 = fr->rd->read_frame_body(fr,tagdata,length)) > 0)
+			if(ret2 > 0)
 			{
 				unsigned long tagpos = 0;
 				debug1("ID3v2: have read at all %lu bytes for the tag now", (unsigned long)length+6);
@@ -811,16 +834,10 @@ int parse_new_id3(mpg123_handle *fr, unsigned long first4bytes)
 tagparse_cleanup:
 			free(tagdata);
 		}
-		else
-		{
-			if(NOQUIET) error1("ID3v2: Arrg! Unable to allocate %lu bytes for interpreting ID3v2 data - trying to skip instead.", length);
-			if((ret2 = fr->rd->skip_bytes(fr,length)) < 0) ret = ret2; /* will not store data in backbuff! */
-			else ret = 0;
-		}
 	}
 #endif /* NO_ID3V2 */
-	/* skip footer if present */
-	if((ret > 0) && (flags & FOOTER_FLAG) && ((ret2 = fr->rd->skip_bytes(fr,length)) < 0)) ret = ret2;
+	/* skip footer if present, a copy of the 10 byte header */
+	if((ret > 0) && (flags & FOOTER_FLAG) && ((ret2 = fr->rd->skip_bytes(fr,10)) < 0)) ret = ret2;
 
 	return ret;
 	#undef UNSYNC_FLAG
@@ -832,6 +849,164 @@ tagparse_cleanup:
 
 #ifndef NO_ID3V2 /* Disabling all the rest... */
 
+/* Append a frame to the list for mpg123_id3_frames(), which just stays shorter without memory. */
+static void record_frame(mpg123_handle *fr, const char *id, unsigned long size, int unsync, int skipped)
+{
+	mpg123_id3frame *frame;
+	if(fr->id3frame_count == fr->id3frame_alloc)
+	{
+		size_t alloc = fr->id3frame_alloc ? 2*fr->id3frame_alloc : 16;
+		mpg123_id3frame *frames = (mpg123_id3frame*) realloc(fr->id3frames, alloc*sizeof(mpg123_id3frame));
+		if(frames == NULL)
+		{
+			if(NOQUIET) error("ID3v2: unable to allocate memory for the frame list");
+			return;
+		}
+		fr->id3frames = frames;
+		fr->id3frame_alloc = alloc;
+	}
+	frame = &fr->id3frames[fr->id3frame_count++];
+	strcpy(frame->id, id);
+	frame->offset  = (unsigned long) fr->rd->tell(fr);
+	frame->size    = size;
+	frame->unsync  = unsync;
+	frame->skipped = skipped;
+}
+
+/* skip_bytes() with 0 for success, for the int return values below */
+static int skip_tag_bytes(mpg123_handle *fr, unsigned long len)
+{
+	off_t ret = fr->rd->skip_bytes(fr, (off_t)len);
+	return ret < 0 ? (int)ret : 0;
+}
+
+/*
+	Read the tag after its header for MPG123_LAZY_ID3, frame by frame.
+	Every frame gets recorded. The ones that parse_new_id3() would interpret are collected,
+	header and all, in the returned buffer of *taglen bytes, which ends in 10 zero bytes to
+	stop the parsing loop (and has one more for it to terminate).
+	All others are skipped, which means seeking over them in a seekable stream.
+	On reader errors, NULL is returned and *ret is the error. The whole tag will be read again
+	when feeding more data.
+*/
+static unsigned char *read_lazy_tag(mpg123_handle *fr, unsigned char major, int exthead, int unsync, unsigned long length, unsigned long *taglen, int *ret)
+{
+	unsigned char *tagdata;
+	unsigned long tagalloc = 1024;
+	unsigned long fill = 0;
+	unsigned long tagpos = 0; /* bytes of the tag read or skipped */
+	int head_part = major == 2 ? 3 : 4;
+	int head_size = major == 2 ? 6 : 10;
+	unsigned char head[10];
+
+	fr->id3frame_count = 0;
+	if((tagdata = (unsigned char*) malloc(tagalloc+11)) == NULL)
+	{
+		if(NOQUIET) error("ID3v2: unable to allocate memory for the tag - trying to skip instead.");
+		*ret = skip_tag_bytes(fr,length);
+		return NULL;
+	}
+	if(exthead && length >= 4)
+	{
+		unsigned long extsize = 0;
+		if((*ret = fr->rd->read_frame_body(fr, head, 4)) < 0) goto read_error;
+		tagpos = 4;
+		/* Same as without MPG123_LAZY_ID3, the frames start at the size value. */
+		if(!bytes_to_long(head, extsize) || extsize > length)
+		{
+			if(NOQUIET) error4("Bad (non-synchsafe) tag offset: 0x%02x%02x%02x%02x", head[0], head[1], head[2], head[3]);
+			*ret = skip_tag_bytes(fr,length-tagpos);
+			free(tagdata);
+			return NULL;
+		}
+		if(extsize > tagpos)
+		{
+			if((*ret = skip_tag_bytes(fr,extsize-tagpos)) < 0) goto read_error;
+			tagpos = extsize;
+		}
+	}
+	while(tagpos + head_size <= length)
+	{
+		char id[5];
+		unsigned long framesize;
+		unsigned long fflags = 0;
+		int i;
+		int parse;
+		if((*ret = fr->rd->read_frame_body(fr, head, head_size)) < 0) goto read_error;
+		tagpos += head_size;
+		/* The padding, or any other strangeness, ends the tag. */
+		for(i=0; i<head_part; ++i)
+		if(!((head[i] > 47 && head[i] < 58) || (head[i] > 64 && head[i] < 91))) break;
+		if(i < head_part) break;
+
+		memcpy(id, head, head_part);
+		id[head_part] = 0;
+		if(major == 2) framesize = (((unsigned long) head[3]) << 16) | (((unsigned long) head[4]) << 8) | ((unsigned long) head[5]);
+		else if(!bytes_to_long(head+4, framesize))
+		{
+			if(NOQUIET) error1("ID3v2: non-syncsafe size of %s frame, skipping the remainder of tag", id);
+			break;
+		}
+		if(framesize > length-tagpos)
+		{
+			if(NOQUIET) error("Whoa! ID3v2 frame claims to be larger than the whole rest of the tag.");
+			break;
+		}
+		if(major > 2) fflags = (((unsigned long) head[8]) << 8) | ((unsigned long) head[9]);
+
+		/* The same choice as in the parsing loop, on the promoted name for ID3v2.2. */
+		{
+			char name[5];
+			strcpy(name, id);
+			parse = head_part == 4 || promote_framename(fr, name) == 0;
+			if(parse)
+			{
+				parse = name[0] == 'T';
+				for(i = 0; i < (int)(sizeof(frame_type)/sizeof(frame_type[0])); ++i)
+				if(!strncmp(frame_type[i], name, 4)) parse = 1;
+			}
+		}
+		record_frame(fr, id, framesize, unsync || (fflags & 2) != 0, !parse);
+		if(parse)
+		{
+			if(fill+head_size+framesize > tagalloc)
+			{
+				unsigned char *more;
+				while(fill+head_size+framesize > tagalloc) tagalloc *= 2;
+				if((more = (unsigned char*) realloc(tagdata, tagalloc+11)) == NULL)
+				{
+					if(NOQUIET) error("ID3v2: unable to allocate memory for the tag - skipping the remainder.");
+					if((*ret = skip_tag_bytes(fr,length-tagpos)) < 0) goto read_error;
+					tagpos = length;
+					break;
+				}
+				tagdata = more;
+			}
+			memcpy(tagdata+fill, head, head_size);
+			if((*ret = fr->rd->read_frame_body(fr, tagdata+fill+head_size, framesize)) < 0) goto read_error;
+			fill += head_size+framesize;
+		}
+		else
+		{
+			debug2("ID3v2: skipping %s frame of %lu bytes", id, framesize);
+			if((*ret = skip_tag_bytes(fr, framesize)) < 0) goto read_error;
+		}
+		tagpos += framesize;
+	}
+	if(tagpos < length && (*ret = skip_tag_bytes(fr,length-tagpos)) < 0) goto read_error;
+
+	memset(tagdata+fill, 0, 10);
+	*taglen = fill+10;
+	*ret = 1;
+	return tagdata;
+
+read_error:
+	if(NOQUIET && *ret != MPG123_NEED_MORE) error("ID3v2: Duh, not able to read ID3v2 tag data.");
+	fr->id3frame_count = 0;
+	free(tagdata);
+	return NULL;
+}
+
 static void convert_latin1(mpg123_string *sb, const unsigned char* s, size_t l, const int noquiet)
 {
 	size_t length = l;
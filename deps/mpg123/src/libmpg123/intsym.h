@@ -3,6 +3,13 @@
 /* Mapping of internal mpg123 symbols to something that is less likely to conflict in case of static linking. */
 #define COS9 INT123_COS9
 #define tfcos36 INT123_tfcos36
+#define tfcos12 INT123_tfcos12
+#define COS6_1 INT123_COS6_1
+#define COS6_2 INT123_COS6_2
+#define cos9 INT123_cos9
+#define cos18 INT123_cos18
+#define aa_ca INT123_aa_ca
+#define aa_cs INT123_aa_cs
 #define pnts INT123_pnts
 #define safe_realloc INT123_safe_realloc
 #define compat_open INT123_compat_open
@@ -114,6 +121,11 @@
 #define dct36 INT123_dct36
 #define dct36_3dnow INT123_dct36_3dnow
 #define dct36_3dnowext INT123_dct36_3dnowext
+#define dct12 INT123_dct12
+#define antialias INT123_antialias
+#define dct36_simd INT123_dct36_simd
+#define dct12_simd INT123_dct12_simd
+#define antialias_simd INT123_antialias_simd
 #define synth_ntom_set_step INT123_synth_ntom_set_step
 #define ntom_val INT123_ntom_val
 #define ntom_frame_outsamples INT123_ntom_frame_outsamples
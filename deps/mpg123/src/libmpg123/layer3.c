@@ -30,16 +30,16 @@
 #else
 /* static one-time calculated tables... or so */
 static real ispow[8207];
-static real aa_ca[8],aa_cs[8];
+real aa_ca[8],aa_cs[8]; /* antialias_simd wants to use that */
 static real win[4][36];
 static real win1[4][36];
 real COS9[9]; /* dct36_3dnow wants to use that */
-static real COS6_1,COS6_2;
+real COS6_1,COS6_2; /* dct36_simd and dct12_simd want to use that */
 real tfcos36[9]; /* dct36_3dnow wants to use that */
-static real tfcos12[3];
+real tfcos12[3]; /* dct12_simd wants to use that */
 #define NEW_DCT9
 #ifdef NEW_DCT9
-static real cos9[3],cos18[3];
+real cos9[3],cos18[3]; /* dct36_simd wants to use that */
 static real tan1_1[16],tan2_1[16],tan1_2[16],tan2_2[16];
 static real pow1_1[2][16],pow2_1[2][16],pow1_2[2][16],pow2_2[2][16];
 #endif
@@ -1336,7 +1336,7 @@ maybe still wrong??? (copy 12 to 13?) */
 }
 
 
-static void III_antialias(real xr[SBLIMIT][SSLIMIT],struct gr_info_s *gr_info)
+static void III_antialias(real xr[SBLIMIT][SSLIMIT],struct gr_info_s *gr_info, mpg123_handle *fr)
 {
 	int sblim;
 
@@ -1348,12 +1348,21 @@ static void III_antialias(real xr[SBLIMIT][SSLIMIT],struct gr_info_s *gr_info)
 	}
 	else sblim = gr_info->maxb-1;
 
+	opt_antialias(fr)((real *) xr[1], sblim);
+}
+
+/*
+	The butterflies between the first sblim+1 sub-bands, xr1 pointing at the
+	start of the second one. Used to be part of III_antialias, it is out here
+	for the SIMD variant to be tested against it.
+*/
+void antialias(real *xr1, int sblim)
+{
 	/* 31 alias-reduction operations between each pair of sub-bands */
 	/* with 8 butterflies between each pair                         */
 
 	{
 		int sb;
-		real *xr1=(real *) xr[1];
 
 		for(sb=sblim; sb; sb--,xr1+=10)
 		{
@@ -1691,8 +1700,9 @@ void dct36(real *inbuf,real *o1,real *o2,real *wintab,real *tsbuf)
 }
 
 
-/* new DCT12 */
-static void dct12(real *in,real *rawout1,real *rawout2,register real *wi,register real *ts)
+/* new DCT12
+   used to be static, dct12_simd falls back to it and is tested against it */
+void dct12(real *in,real *rawout1,real *rawout2,register real *wi,register real *ts)
 {
 #define DCT12_PART1 \
 	in5 = in[5*3];  \
@@ -1856,6 +1866,17 @@ static void III_hybrid(real fsIn[SBLIMIT][SSLIMIT], real tsOut[SSLIMIT][SBLIMIT]
 	}
  
 	bt = gr_info->block_type;
+#ifdef OPT_LAYER3_SIMD
+	/* Same pairs of sub-bands as below, a whole vector of them at a time. */
+	if(sb < gr_info->maxb)
+	{
+		size_t count = (gr_info->maxb - sb + 1) & ~(size_t)1;
+		if(bt == 2) dct12_simd(fsIn[sb],rawout1,rawout2,win[2],win1[2],tspnt,count);
+		else        dct36_simd(fsIn[sb],rawout1,rawout2,win[bt],win1[bt],tspnt,count);
+
+		sb += count; tspnt += count; rawout1 += 18*count; rawout2 += 18*count;
+	}
+#else
 	if(bt == 2)
 	{
 		for(; sb<gr_info->maxb; sb+=2,tspnt+=2,rawout1+=36,rawout2+=36)
@@ -1872,6 +1893,7 @@ static void III_hybrid(real fsIn[SBLIMIT][SSLIMIT], real tsOut[SSLIMIT][SBLIMIT]
 			opt_dct36(fr)(fsIn[sb+1],rawout1+18,rawout2+18,win1[bt],tspnt+1);
 		}
 	}
+#endif
 
 	for(;sb<SBLIMIT;sb++,tspnt++)
 	{
@@ -2012,7 +2034,7 @@ int do_layer3(mpg123_handle *fr)
 		for(ch=0;ch<stereo1;ch++)
 		{
 			struct gr_info_s *gr_info = &(sideinfo.ch[ch].gr[gr]);
-			III_antialias(hybridIn[ch],gr_info);
+			III_antialias(hybridIn[ch],gr_info,fr);
 			III_hybrid(hybridIn[ch], hybridOut[ch], ch,gr_info, fr);
 		}
 
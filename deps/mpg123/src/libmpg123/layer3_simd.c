@@ -0,0 +1,398 @@
+/*
+	layer3_simd.c: Layer III alias reduction and IMDCT with SSE, AVX or NEON intrinsics
+
+	copyright 2026 by the mpg123 project - free software under the terms of the LGPL 2.1
+	see COPYING and AUTHORS files in distribution or http://mpg123.org
+
+	The IMDCT has a long chain of dependent operations per sub-band, which doesn't vectorise
+	well within a single transform. Instead, each vector lane runs the generic dct36()/dct12()
+	for a sub-band of its own, so that VLANES sub-bands are transformed at once. Every lane
+	does the very same single precision operations in the very same order as the C code, which
+	keeps the output bit-identical to the generic decoder (as long as the compiler isn't allowed
+	to contract the C code into fused multiply-adds).
+
+	The time-domain output of neighbouring sub-bands is adjacent in tsOut, so it is written
+	with plain vector stores. Inputs and overlap buffers are per sub-band and get transposed.
+*/
+
+#include "mpg123lib_intern.h"
+
+#ifdef OPT_LAYER3_SIMD
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#define VLANES 8
+typedef __m256 vreal;
+#define VLOAD(p)     _mm256_load_ps(p)
+#define VSTORE(p, v) _mm256_store_ps(p, v)
+#define VSTOREU(p, v) _mm256_storeu_ps(p, v)
+#define VSET1(x)     _mm256_set1_ps(x)
+#define VADD(a, b)   _mm256_add_ps(a, b)
+#define VSUB(a, b)   _mm256_sub_ps(a, b)
+#define VMUL(a, b)   _mm256_mul_ps(a, b)
+#elif defined(__SSE__) || defined(_M_X64)
+#include <xmmintrin.h>
+#define VLANES 4
+typedef __m128 vreal;
+#define VLOAD(p)     _mm_load_ps(p)
+#define VSTORE(p, v) _mm_store_ps(p, v)
+#define VSTOREU(p, v) _mm_storeu_ps(p, v)
+#define VSET1(x)     _mm_set1_ps(x)
+#define VADD(a, b)   _mm_add_ps(a, b)
+#define VSUB(a, b)   _mm_sub_ps(a, b)
+#define VMUL(a, b)   _mm_mul_ps(a, b)
+#else
+#include <arm_neon.h>
+#define VLANES 4
+typedef float32x4_t vreal;
+#define VLOAD(p)     vld1q_f32(p)
+#define VSTORE(p, v) vst1q_f32(p, v)
+#define VSTOREU(p, v) vst1q_f32(p, v)
+#define VSET1(x)     vdupq_n_f32(x)
+#define VADD(a, b)   vaddq_f32(a, b)
+#define VSUB(a, b)   vsubq_f32(a, b)
+#define VMUL(a, b)   vmulq_f32(a, b)
+#endif
+
+/* Lane-major scratch arrays: element [i][lane]. */
+#if defined(_MSC_VER)
+#define VALIGN __declspec(align(32))
+#else
+#define VALIGN __attribute__((aligned(32)))
+#endif
+
+/* Tables computed by init_layer3(). */
+extern real aa_ca[8], aa_cs[8];
+extern real COS6_1, COS6_2;
+extern real tfcos36[9], tfcos12[3];
+extern real cos9[3], cos18[3];
+
+/* Copies n values with the given stride of each sub-band into lane-major order. */
+static void gather(real dst[][VLANES], const real *src, size_t n, size_t stride, size_t sbstride)
+{
+	size_t i, l;
+	for(l=0; l<VLANES; ++l)
+	for(i=0; i<n; ++i)
+	dst[i][l] = src[l*sbstride + i*stride];
+}
+
+static void scatter(real *dst, real src[][VLANES], size_t n, size_t sbstride)
+{
+	size_t i, l;
+	for(l=0; l<VLANES; ++l)
+	for(i=0; i<n; ++i)
+	dst[l*sbstride + i] = src[i][l];
+}
+
+/* Window coefficients for a vector of sub-bands: even ones use win, odd ones win1. */
+static void windows(real dst[][VLANES], const real *win, const real *win1, size_t n)
+{
+	size_t i, l;
+	for(i=0; i<n; ++i)
+	for(l=0; l<VLANES; ++l)
+	dst[i][l] = (l & 1) ? win1[i] : win[i];
+}
+
+void dct36_simd(real *inbuf, real *o1, real *o2, real *win, real *win1, real *tsbuf, size_t count)
+{
+	VALIGN real ibuf[18][VLANES];
+	VALIGN real obuf[18][VLANES];
+	VALIGN real wbuf[36][VLANES];
+	size_t sb = 0;
+
+	windows(wbuf, win, win1, 36);
+
+	for(; sb+VLANES <= count; sb+=VLANES, inbuf+=18*VLANES, o1+=18*VLANES, o2+=18*VLANES, tsbuf+=VLANES)
+	{
+		vreal in[18], tmp[18];
+		int i;
+
+		gather(ibuf, inbuf, 18, 1, 18);
+		for(i=0; i<18; ++i) in[i] = VLOAD(ibuf[i]);
+
+		for(i=17; i>=1; --i)  in[i] = VADD(in[i], in[i-1]);
+		for(i=17; i>=3; i-=2) in[i] = VADD(in[i], in[i-2]);
+
+		{
+			vreal t3;
+			{
+				vreal t0, t1, t2;
+
+				t0 = VMUL(VSET1(COS6_2), VSUB(VADD(in[8], in[16]), in[4]));
+				t1 = VMUL(VSET1(COS6_2), in[12]);
+
+				t3 = in[0];
+				t2 = VSUB(VSUB(t3, t1), t1);
+				tmp[1] = tmp[7] = VSUB(t2, t0);
+				tmp[4]          = VADD(VADD(t2, t0), t0);
+				t3 = VADD(t3, t1);
+
+				t2 = VMUL(VSET1(COS6_1), VSUB(VADD(in[10], in[14]), in[2]));
+				tmp[1] = VSUB(tmp[1], t2);
+				tmp[7] = VADD(tmp[7], t2);
+			}
+			{
+				vreal t0, t1, t2;
+
+				t0 = VMUL(VSET1(cos9[0]), VADD(in[4], in[8] ));
+				t1 = VMUL(VSET1(cos9[1]), VSUB(in[8], in[16]));
+				t2 = VMUL(VSET1(cos9[2]), VADD(in[4], in[16]));
+
+				tmp[2] = tmp[6] = VSUB(VSUB(t3, t0), t2);
+				tmp[0] = tmp[8] = VADD(VADD(t3, t0), t1);
+				tmp[3] = tmp[5] = VADD(VSUB(t3, t1), t2);
+			}
+		}
+		{
+			vreal t0, t1, t2, t3;
+
+			t1 = VMUL(VSET1(cos18[0]), VADD(in[2], in[10]));
+			t2 = VMUL(VSET1(cos18[1]), VSUB(in[10], in[14]));
+			t3 = VMUL(VSET1(COS6_1),   in[6]);
+
+			t0 = VADD(VADD(t1, t2), t3);
+			tmp[0] = VADD(tmp[0], t0);
+			tmp[8] = VSUB(tmp[8], t0);
+
+			t2 = VSUB(t2, t3);
+			t1 = VSUB(t1, t3);
+
+			t3 = VMUL(VSET1(cos18[2]), VADD(in[2], in[14]));
+
+			t1 = VADD(t1, t3);
+			tmp[3] = VADD(tmp[3], t1);
+			tmp[5] = VSUB(tmp[5], t1);
+
+			t2 = VSUB(t2, t3);
+			tmp[2] = VADD(tmp[2], t2);
+			tmp[6] = VSUB(tmp[6], t2);
+		}
+		{
+			vreal t0, t1, t2, t3, t4, t5, t6, t7;
+
+			t1 = VMUL(VSET1(COS6_2), in[13]);
+			t2 = VMUL(VSET1(COS6_2), VSUB(VADD(in[9], in[17]), in[5]));
+
+			t3 = VADD(in[1], t1);
+			t4 = VSUB(VSUB(in[1], t1), t1);
+			t5 = VSUB(t4, t2);
+
+			t0 = VMUL(VSET1(cos9[0]), VADD(in[5], in[9]));
+			t1 = VMUL(VSET1(cos9[1]), VSUB(in[9], in[17]));
+
+			tmp[13] = VMUL(VADD(VADD(t4, t2), t2), VSET1(tfcos36[17-13]));
+			t2 = VMUL(VSET1(cos9[2]), VADD(in[5], in[17]));
+
+			t6 = VSUB(VSUB(t3, t0), t2);
+			t0 = VADD(t0, VADD(t3, t1));
+			t3 = VADD(t3, VSUB(t2, t1));
+
+			t2 = VMUL(VSET1(cos18[0]), VADD(in[3], in[11]));
+			t4 = VMUL(VSET1(cos18[1]), VSUB(in[11], in[15]));
+			t7 = VMUL(VSET1(COS6_1), in[7]);
+
+			t1 = VADD(VADD(t2, t4), t7);
+			tmp[17] = VMUL(VADD(t0, t1), VSET1(tfcos36[17-17]));
+			tmp[9]  = VMUL(VSUB(t0, t1), VSET1(tfcos36[17-9]));
+			t1 = VMUL(VSET1(cos18[2]), VADD(in[3], in[15]));
+			t2 = VADD(t2, VSUB(t1, t7));
+
+			tmp[14] = VMUL(VADD(t3, t2), VSET1(tfcos36[17-14]));
+			t0 = VMUL(VSET1(COS6_1), VSUB(VADD(in[11], in[15]), in[3]));
+			tmp[12] = VMUL(VSUB(t3, t2), VSET1(tfcos36[17-12]));
+
+			t4 = VSUB(t4, VADD(t1, t7));
+
+			tmp[16] = VMUL(VSUB(t5, t0), VSET1(tfcos36[17-16]));
+			tmp[10] = VMUL(VADD(t5, t0), VSET1(tfcos36[17-10]));
+			tmp[15] = VMUL(VADD(t6, t4), VSET1(tfcos36[17-15]));
+			tmp[11] = VMUL(VSUB(t6, t4), VSET1(tfcos36[17-11]));
+		}
+
+		gather(ibuf, o1, 18, 1, 18);
+		for(i=0; i<9; ++i)
+		{
+			vreal tmpval = VADD(tmp[i], tmp[17-i]);
+			VSTORE(obuf[9+i], VMUL(tmpval, VLOAD(wbuf[27+i])));
+			VSTORE(obuf[8-i], VMUL(tmpval, VLOAD(wbuf[26-i])));
+			tmpval = VSUB(tmp[i], tmp[17-i]);
+			VSTOREU(tsbuf+SBLIMIT*(8-i), VADD(VLOAD(ibuf[8-i]), VMUL(tmpval, VLOAD(wbuf[8-i]))));
+			VSTOREU(tsbuf+SBLIMIT*(9+i), VADD(VLOAD(ibuf[9+i]), VMUL(tmpval, VLOAD(wbuf[9+i]))));
+		}
+		scatter(o2, obuf, 18, 18);
+	}
+
+	/* The leftover pairs. */
+	for(; sb<count; ++sb, inbuf+=18, o1+=18, o2+=18, ++tsbuf)
+	dct36(inbuf, o1, o2, (sb & 1) ? win1 : win, tsbuf);
+}
+
+/* The three short transforms, as in dct12(). */
+#define DCT12_PART1(w) \
+	in5 = VADD(in[5][w], in[4][w]); \
+	in4 = VADD(in[4][w], in[3][w]); \
+	in3 = VADD(in[3][w], in[2][w]); \
+	in2 = VADD(in[2][w], in[1][w]); \
+	in1 = VADD(in[1][w], in[0][w]); \
+	in0 = in[0][w]; \
+	\
+	in5 = VADD(in5, in3); in3 = VADD(in3, in1); \
+	\
+	in2 = VMUL(in2, VSET1(COS6_1)); \
+	in3 = VMUL(in3, VSET1(COS6_1));
+
+#define DCT12_PART2 \
+	in0 = VADD(in0, VMUL(in4, VSET1(COS6_2))); \
+	\
+	in4 = VADD(in0, in2); \
+	in0 = VSUB(in0, in2); \
+	\
+	in1 = VADD(in1, VMUL(in5, VSET1(COS6_2))); \
+	\
+	in5 = VMUL(VADD(in1, in3), VSET1(tfcos12[0])); \
+	in1 = VMUL(VSUB(in1, in3), VSET1(tfcos12[2])); \
+	\
+	in3 = VADD(in4, in5); \
+	in4 = VSUB(in4, in5); \
+	\
+	in2 = VADD(in0, in1); \
+	in0 = VSUB(in0, in1);
+
+#define DCT12_MIDDLE \
+	tmp1 = VSUB(in0, in4); \
+	tmp2 = VMUL(VSUB(in1, in5), VSET1(tfcos12[1])); \
+	tmp0 = VADD(tmp1, tmp2); \
+	tmp1 = VSUB(tmp1, tmp2);
+
+#define WI(i) VLOAD(wbuf[i])
+
+void dct12_simd(real *inbuf, real *o1, real *o2, real *win, real *win1, real *tsbuf, size_t count)
+{
+	VALIGN real ibuf[18][VLANES];
+	VALIGN real obuf[18][VLANES];
+	VALIGN real wbuf[12][VLANES];
+	size_t sb = 0;
+
+	windows(wbuf, win, win1, 12);
+
+	for(; sb+VLANES <= count; sb+=VLANES, inbuf+=18*VLANES, o1+=18*VLANES, o2+=18*VLANES, tsbuf+=VLANES)
+	{
+		vreal in[6][3], ts[18], out2[18];
+		vreal in0, in1, in2, in3, in4, in5, tmp0, tmp1, tmp2;
+		int i;
+
+		gather(ibuf, inbuf, 18, 1, 18);
+		for(i=0; i<18; ++i) in[i/3][i%3] = VLOAD(ibuf[i]);
+		gather(ibuf, o1, 18, 1, 18);
+		for(i=0; i<6; ++i) ts[i] = VLOAD(ibuf[i]);
+
+		DCT12_PART1(0)
+		DCT12_MIDDLE
+		ts[17-1] = VADD(VLOAD(ibuf[17-1]), VMUL(tmp0, WI(11-1)));
+		ts[12+1] = VADD(VLOAD(ibuf[12+1]), VMUL(tmp0, WI(6+1)));
+		ts[6 +1] = VADD(VLOAD(ibuf[6 +1]), VMUL(tmp1, WI(1)));
+		ts[11-1] = VADD(VLOAD(ibuf[11-1]), VMUL(tmp1, WI(5-1)));
+		DCT12_PART2
+		ts[17-0] = VADD(VLOAD(ibuf[17-0]), VMUL(in2, WI(11-0)));
+		ts[12+0] = VADD(VLOAD(ibuf[12+0]), VMUL(in2, WI(6+0)));
+		ts[12+2] = VADD(VLOAD(ibuf[12+2]), VMUL(in3, WI(6+2)));
+		ts[17-2] = VADD(VLOAD(ibuf[17-2]), VMUL(in3, WI(11-2)));
+		ts[6 +0] = VADD(VLOAD(ibuf[6+0]),  VMUL(in0, WI(0)));
+		ts[11-0] = VADD(VLOAD(ibuf[11-0]), VMUL(in0, WI(5-0)));
+		ts[6 +2] = VADD(VLOAD(ibuf[6+2]),  VMUL(in4, WI(2)));
+		ts[11-2] = VADD(VLOAD(ibuf[11-2]), VMUL(in4, WI(5-2)));
+
+		DCT12_PART1(1)
+		DCT12_MIDDLE
+		out2[5-1] = VMUL(tmp0, WI(11-1));
+		out2[0+1] = VMUL(tmp0, WI(6+1));
+		ts[12+1] = VADD(ts[12+1], VMUL(tmp1, WI(1)));
+		ts[17-1] = VADD(ts[17-1], VMUL(tmp1, WI(5-1)));
+		DCT12_PART2
+		out2[5-0] = VMUL(in2, WI(11-0));
+		out2[0+0] = VMUL(in2, WI(6+0));
+		out2[0+2] = VMUL(in3, WI(6+2));
+		out2[5-2] = VMUL(in3, WI(11-2));
+		ts[12+0] = VADD(ts[12+0], VMUL(in0, WI(0)));
+		ts[17-0] = VADD(ts[17-0], VMUL(in0, WI(5-0)));
+		ts[12+2] = VADD(ts[12+2], VMUL(in4, WI(2)));
+		ts[17-2] = VADD(ts[17-2], VMUL(in4, WI(5-2)));
+
+		for(i=12; i<18; ++i) out2[i] = VSET1(0.0f);
+		DCT12_PART1(2)
+		DCT12_MIDDLE
+		out2[11-1] = VMUL(tmp0, WI(11-1));
+		out2[6 +1] = VMUL(tmp0, WI(6+1));
+		out2[0+1] = VADD(out2[0+1], VMUL(tmp1, WI(1)));
+		out2[5-1] = VADD(out2[5-1], VMUL(tmp1, WI(5-1)));
+		DCT12_PART2
+		out2[11-0] = VMUL(in2, WI(11-0));
+		out2[6 +0] = VMUL(in2, WI(6+0));
+		out2[6 +2] = VMUL(in3, WI(6+2));
+		out2[11-2] = VMUL(in3, WI(11-2));
+		out2[0+0] = VADD(out2[0+0], VMUL(in0, WI(0)));
+		out2[5-0] = VADD(out2[5-0], VMUL(in0, WI(5-0)));
+		out2[0+2] = VADD(out2[0+2], VMUL(in4, WI(2)));
+		out2[5-2] = VADD(out2[5-2], VMUL(in4, WI(5-2)));
+
+		for(i=0; i<18; ++i)
+		{
+			VSTOREU(tsbuf+SBLIMIT*i, ts[i]);
+			VSTORE(obuf[i], out2[i]);
+		}
+		scatter(o2, obuf, 18, 18);
+	}
+
+	for(; sb<count; ++sb, inbuf+=18, o1+=18, o2+=18, ++tsbuf)
+	dct12(inbuf, o1, o2, (sb & 1) ? win1 : win, tsbuf);
+}
+
+/*
+	The 8 butterflies between two sub-bands are independent of each other, and so are
+	the ones between different pairs of sub-bands, so these go 4 butterflies at a time.
+	The upper inputs run backwards from the boundary and need to be reversed.
+*/
+#if defined(__SSE__) || defined(_M_X64)
+#define REVERSE4(v) _mm_shuffle_ps(v, v, _MM_SHUFFLE(0,1,2,3))
+#define AA_LOAD  _mm_loadu_ps
+#define AA_STORE _mm_storeu_ps
+#define AA_SUB   _mm_sub_ps
+#define AA_ADD   _mm_add_ps
+#define AA_MUL   _mm_mul_ps
+typedef __m128 aareal;
+#else
+#define REVERSE4(v) vcombine_f32(vget_high_f32(vrev64q_f32(v)), vget_low_f32(vrev64q_f32(v)))
+#define AA_LOAD  vld1q_f32
+#define AA_STORE vst1q_f32
+#define AA_SUB   vsubq_f32
+#define AA_ADD   vaddq_f32
+#define AA_MUL   vmulq_f32
+typedef float32x4_t aareal;
+#endif
+
+void antialias_simd(real *xr1, int sblim)
+{
+	int sb, i;
+
+	for(sb=sblim; sb; sb--, xr1+=18)
+	{
+		for(i=0; i<8; i+=4)
+		{
+			/* lower inputs xr1[i..i+3], upper ones xr1[-1-i] downwards, loaded in memory order */
+			aareal bd = AA_LOAD(xr1+i);
+			aareal bu = REVERSE4(AA_LOAD(xr1-4-i));
+			aareal cs = AA_LOAD(aa_cs+i);
+			aareal ca = AA_LOAD(aa_ca+i);
+
+			AA_STORE(xr1-4-i, REVERSE4(AA_SUB(AA_MUL(bu, cs), AA_MUL(bd, ca))));
+			AA_STORE(xr1+i,            AA_ADD(AA_MUL(bd, cs), AA_MUL(bu, ca)));
+		}
+	}
+}
+
+#else
+
+/* ISO C forbids an empty translation unit. */
+extern int layer3_simd_unused;
+
+#endif
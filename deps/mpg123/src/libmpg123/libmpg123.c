@@ -12,6 +12,10 @@
 
 #include "gapless.h"
 
+#ifdef HAVE_SYS_STAT_H
+#include <sys/stat.h>
+#endif
+
 #define SEEKFRAME(mh) ((mh)->ignoreframe < 0 ? 0 : (mh)->ignoreframe)
 
 static int initialized = 0;
@@ -1387,6 +1391,94 @@ int attribute_align_arg mpg123_icy(mpg123_handle *mh, char **icy_meta)
 #endif
 }
 
+int attribute_align_arg mpg123_id3_frames(mpg123_handle *mh, mpg123_id3frame **frames, size_t *count)
+{
+	if(mh == NULL) return MPG123_ERR;
+	if(frames == NULL || count == NULL)
+	{
+		mh->err = MPG123_NULL_POINTER;
+		return MPG123_ERR;
+	}
+#ifndef NO_ID3V2
+	*frames = mh->id3frames;
+	*count  = mh->id3frame_count;
+#else
+	*frames = NULL;
+	*count  = 0;
+#endif
+	return MPG123_OK;
+}
+
+int attribute_align_arg mpg123_id3_frame(mpg123_handle *mh, size_t index, unsigned char **data, size_t *size)
+{
+#ifndef NO_ID3V2
+	mpg123_id3frame *frame;
+	unsigned char *buf;
+	off_t pos;
+	int ret;
+#endif
+	if(mh == NULL) return MPG123_ERR;
+	if(data == NULL || size == NULL)
+	{
+		mh->err = MPG123_NULL_POINTER;
+		return MPG123_ERR;
+	}
+#ifndef NO_ID3V2
+	if(index >= mh->id3frame_count)
+	{
+		mh->err = MPG123_BAD_VALUE;
+		return MPG123_ERR;
+	}
+	if(!(mh->rdat.flags & READER_SEEKABLE))
+	{
+		mh->err = MPG123_NO_SEEK;
+		return MPG123_ERR;
+	}
+	frame = &mh->id3frames[index];
+	if((buf = (unsigned char*) realloc(mh->id3frame_data, frame->size+1)) == NULL)
+	{
+		mh->err = MPG123_OUT_OF_MEM;
+		return MPG123_ERR;
+	}
+	mh->id3frame_data = buf;
+
+	/* Go there and back again, the decoder doesn't notice. */
+	pos = mh->rd->tell(mh);
+	if(pos < 0 || mh->rd->skip_bytes(mh, (off_t)frame->offset-pos) < 0)
+	{
+		mh->err = MPG123_LSEEK_FAILED;
+		return MPG123_ERR;
+	}
+	ret = mh->rd->read_frame_body(mh, buf, (int)frame->size);
+	if(mh->rd->skip_bytes(mh, pos-mh->rd->tell(mh)) < 0)
+	{
+		mh->err = MPG123_LSEEK_FAILED;
+		return MPG123_ERR;
+	}
+	if(ret < 0)
+	{
+		mh->err = MPG123_BAD_FILE;
+		return MPG123_ERR;
+	}
+
+	*size = frame->size;
+	if(frame->unsync && frame->size > 0)
+	{
+		/* de-unsync in place: FF00 -> FF */
+		size_t ipos, opos = 1;
+		for(ipos = 1; ipos < frame->size; ++ipos)
+		if(!(buf[ipos] == 0 && buf[ipos-1] == 0xff)) buf[opos++] = buf[ipos];
+
+		*size = opos;
+	}
+	*data = buf;
+	return MPG123_OK;
+#else
+	mh->err = MPG123_MISSING_FEATURE;
+	return MPG123_ERR;
+#endif
+}
+
 char* attribute_align_arg mpg123_icy2utf8(const char* icy_text)
 {
 #ifndef NO_ICY
@@ -1500,6 +1592,215 @@ int attribute_align_arg mpg123_set_index(mpg123_handle *mh, off_t *offsets, off_
 #endif
 }
 
+/*
+	Seek index (TOC) blobs: The frame index and track length/gapless info of a fully scanned
+	stream, serialised so that a later session can skip mpg123_scan() on reopening the same file.
+
+	Layout, all integers little endian:
+	  magic "M123TOC" + version byte
+	  u64 stamp (hash of file size and modification time)
+	  u32 native rate, u32 samples per frame
+	  i64 track frames, i64 track samples
+	  i64 gapless frames, i64 begin skip, i64 end skip
+	  i64 index step, u32 index fill
+	  index offsets as LEB128 varints, delta coded
+	  u32 checksum over everything before
+*/
+#define TOC_MAGIC "M123TOC"
+#define TOC_VERSION 1
+#define TOC_HEADSIZE 76
+
+static unsigned char *toc_put(unsigned char *p, unsigned long long val, int bytes)
+{
+	int i;
+	for(i=0; i<bytes; ++i){ *p++ = (unsigned char)(val & 0xff); val >>= 8; }
+	return p;
+}
+
+static unsigned long long toc_get(const unsigned char *p, int bytes)
+{
+	unsigned long long val = 0;
+	int i;
+	for(i=bytes-1; i>=0; --i) val = (val << 8) | p[i];
+	return val;
+}
+
+static size_t toc_varint_size(unsigned long long val)
+{
+	size_t n = 1;
+	while(val >= 0x80){ val >>= 7; ++n; }
+	return n;
+}
+
+/* FNV-1a, 32 and 64 bit. Cheap and good enough to catch a stale or mangled blob. */
+static unsigned long toc_hash32(const unsigned char *p, size_t len)
+{
+	unsigned long h = 2166136261UL;
+	while(len--){ h ^= *p++; h = (h * 16777619UL) & 0xffffffffUL; }
+	return h;
+}
+
+static unsigned long long toc_stamp(mpg123_handle *mh)
+{
+	unsigned char raw[16];
+	unsigned long long h = 14695981039346656037ULL;
+	long long mtime = 0;
+	size_t i;
+#ifdef HAVE_SYS_STAT_H
+	/* Only for plain file descriptors; custom I/O and the feeder have no file to ask. */
+	if(!(mh->rdat.flags & (READER_HANDLEIO|READER_BUFFERED)))
+	{
+		struct stat st;
+		if(fstat(mh->rdat.filept, &st) == 0) mtime = (long long)st.st_mtime;
+	}
+#endif
+	toc_put(raw, (unsigned long long)mh->rdat.filelen, 8);
+	toc_put(raw+8, (unsigned long long)mtime, 8);
+	for(i=0; i<sizeof(raw); ++i){ h ^= raw[i]; h *= 1099511628211ULL; }
+	return h;
+}
+
+int attribute_align_arg mpg123_toc_store(mpg123_handle *mh, unsigned char *buf, size_t *size)
+{
+	size_t need, i;
+	unsigned char *p;
+	off_t prev = 0;
+	off_t gapless_frames = -1, bskip = 0, eskip = 0;
+	int b;
+
+	if(mh == NULL) return MPG123_ERR;
+	if(size == NULL){ mh->err = MPG123_NULL_POINTER; return MPG123_ERR; }
+#ifndef FRAME_INDEX
+	mh->err = MPG123_NO_INDEX;
+	return MPG123_ERR;
+#else
+	if(!(mh->rdat.flags & READER_SEEKABLE)){ mh->err = MPG123_NO_SEEK; return MPG123_ERR; }
+	b = init_track(mh);
+	if(b < 0) return b;
+
+	need = TOC_HEADSIZE + 4;
+	for(i=0; i<mh->index.fill; ++i)
+	{
+		need += toc_varint_size((unsigned long long)(mh->index.data[i] - prev));
+		prev = mh->index.data[i];
+	}
+	if(buf == NULL){ *size = need; return MPG123_OK; }
+	if(*size < need){ *size = need; mh->err = MPG123_NO_SPACE; return MPG123_ERR; }
+
+#ifdef GAPLESS
+	if(mh->gapless_frames > 0)
+	{
+		gapless_frames = mh->gapless_frames;
+		bskip = mh->begin_s - GAPLESS_DELAY;
+		eskip = gapless_frames*spf(mh) - mh->end_s + GAPLESS_DELAY;
+	}
+#endif
+	memcpy(buf, TOC_MAGIC, 7);
+	buf[7] = TOC_VERSION;
+	p = toc_put(buf+8, toc_stamp(mh), 8);
+	p = toc_put(p, (unsigned long long)frame_freq(mh), 4);
+	p = toc_put(p, (unsigned long long)spf(mh), 4);
+	p = toc_put(p, (unsigned long long)mh->track_frames, 8);
+	p = toc_put(p, (unsigned long long)mh->track_samples, 8);
+	p = toc_put(p, (unsigned long long)gapless_frames, 8);
+	p = toc_put(p, (unsigned long long)bskip, 8);
+	p = toc_put(p, (unsigned long long)eskip, 8);
+	p = toc_put(p, (unsigned long long)mh->index.step, 8);
+	p = toc_put(p, (unsigned long long)mh->index.fill, 4);
+	prev = 0;
+	for(i=0; i<mh->index.fill; ++i)
+	{
+		unsigned long long delta = (unsigned long long)(mh->index.data[i] - prev);
+		prev = mh->index.data[i];
+		while(delta >= 0x80){ *p++ = (unsigned char)(delta | 0x80); delta >>= 7; }
+		*p++ = (unsigned char)delta;
+	}
+	p = toc_put(p, toc_hash32(buf, (size_t)(p-buf)), 4);
+	*size = (size_t)(p-buf);
+	return MPG123_OK;
+#endif
+}
+
+int attribute_align_arg mpg123_toc_restore(mpg123_handle *mh, const unsigned char *buf, size_t size)
+{
+	const unsigned char *p, *end;
+	off_t *offsets;
+	off_t step, pos = 0, track_frames, track_samples;
+	size_t fill, i;
+	int b;
+
+	if(mh == NULL) return MPG123_ERR;
+	if(buf == NULL){ mh->err = MPG123_NULL_POINTER; return MPG123_ERR; }
+#ifndef FRAME_INDEX
+	mh->err = MPG123_NO_INDEX;
+	return MPG123_ERR;
+#else
+	if(size < TOC_HEADSIZE + 4 || memcmp(buf, TOC_MAGIC, 7) || buf[7] != TOC_VERSION
+	|| toc_get(buf+size-4, 4) != toc_hash32(buf, size-4))
+	{
+		mh->err = MPG123_BAD_TOC;
+		return MPG123_ERR;
+	}
+	/* We need the first frame to compare the stream properties. */
+	b = init_track(mh);
+	if(b < 0) return b;
+	if( toc_get(buf+8, 8) != toc_stamp(mh)
+	 || (long)toc_get(buf+16, 4) != frame_freq(mh)
+	 || (int)toc_get(buf+20, 4) != spf(mh) )
+	{
+		debug("seek index blob does not match this stream");
+		mh->err = MPG123_BAD_TOC;
+		return MPG123_ERR;
+	}
+	track_frames  = (off_t)(long long)toc_get(buf+24, 8);
+	track_samples = (off_t)(long long)toc_get(buf+32, 8);
+	step = (off_t)(long long)toc_get(buf+64, 8);
+	fill = (size_t)toc_get(buf+72, 4);
+	if(step < 1 || fill > size){ mh->err = MPG123_BAD_TOC; return MPG123_ERR; }
+
+	offsets = fill ? malloc(fill*sizeof(off_t)) : NULL;
+	if(fill && offsets == NULL){ mh->err = MPG123_OUT_OF_MEM; return MPG123_ERR; }
+	p = buf + TOC_HEADSIZE;
+	end = buf + size - 4;
+	for(i=0; i<fill; ++i)
+	{
+		unsigned long long delta = 0;
+		int shift = 0;
+		do
+		{
+			if(p == end || shift > 56)
+			{
+				free(offsets);
+				mh->err = MPG123_BAD_TOC;
+				return MPG123_ERR;
+			}
+			delta |= (unsigned long long)(*p & 0x7f) << shift;
+			shift += 7;
+		} while(*p++ & 0x80);
+		pos += (off_t)delta;
+		offsets[i] = pos;
+	}
+	if(p != end || fi_set(&mh->index, offsets, step, fill) == -1)
+	{
+		free(offsets);
+		mh->err = p != end ? MPG123_BAD_TOC : MPG123_OUT_OF_MEM;
+		return MPG123_ERR;
+	}
+	free(offsets);
+
+	mh->track_frames  = track_frames;
+	mh->track_samples = track_samples;
+#ifdef GAPLESS
+	/* Same as what mpg123_scan() would have ended up with. */
+	frame_gapless_init( mh, (off_t)(long long)toc_get(buf+40, 8)
+	,	(off_t)(long long)toc_get(buf+48, 8), (off_t)(long long)toc_get(buf+56, 8) );
+	frame_gapless_realinit(mh);
+	frame_set_frameseek(mh, mh->num);
+#endif
+	return MPG123_OK;
+#endif
+}
+
 int attribute_align_arg mpg123_close(mpg123_handle *mh)
 {
 	if(mh == NULL) return MPG123_ERR;
@@ -1574,6 +1875,7 @@ static const char *mpg123_error[] =
 	,"Custom I/O obviously not prepared."
 	,"Overflow in LFS (large file support) conversion."
 	,"Overflow in integer conversion."
+	,"Seek index blob is corrupt or does not match the opened stream."
 };
 
 const char* attribute_align_arg mpg123_plain_strerror(int errcode)
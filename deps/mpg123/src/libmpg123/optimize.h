@@ -215,5 +215,20 @@ void check_decoders(void);
 #		define opt_dct36(fr) dct36
 #	endif
 
+/*
+	The Layer III alias reduction and IMDCTs in C with SSE, AVX or NEON intrinsics.
+	They work on several sub-bands at once, using the same single precision operations
+	in the same order as the generic code for each of them, so output is bit-identical.
+	There is no runtime check, they are used when the compiler targets the instruction
+	set anyway, as with any x86-64 build.
+*/
+#if (defined REAL_IS_FLOAT) && !(defined OPT_MULTI) \
+	&& ((defined __SSE__) || (defined _M_X64) || (defined __ARM_NEON) || (defined __ARM_NEON__))
+#	define OPT_LAYER3_SIMD
+#	define opt_antialias(fr) antialias_simd
+#else
+#	define opt_antialias(fr) antialias
+#endif
+
 #endif /* MPG123_H_OPTIMIZE */
 
@@ -11,6 +11,7 @@
 #include "audio.h"
 #include "module.h"
 #include <errno.h>
+#include <time.h>
 
 /* make ALSA 0.9.x compatible to the 1.0.x API */
 #define ALSA_PCM_NEW_HW_PARAMS_API
@@ -139,6 +140,12 @@ static int initialize_device(audio_output_t *ao)
 		if(!AOQUIET) error("initialize_device(): cannot set transfer alignment");
 		return -1;
 	}
+#endif
+#if SND_LIB_VERSION >= ((1<<16)|28)
+	/* timestamp the status with the clock that delay_at() reports, where
+	   that can be had */
+	snd_pcm_sw_params_set_tstamp_mode(pcm, sw, SND_PCM_TSTAMP_ENABLE);
+	snd_pcm_sw_params_set_tstamp_type(pcm, sw, SND_PCM_TSTAMP_TYPE_MONOTONIC);
 #endif
 	if (snd_pcm_sw_params(pcm, sw) < 0) {
 		if(!AOQUIET) error("initialize_device(): cannot set sw params");
@@ -250,6 +257,40 @@ debug("alsa prepare");
 debug("alsa flush done");
 }
 
+static int delay_alsa(audio_output_t *ao)
+{
+	snd_pcm_t *pcm=(snd_pcm_t*)ao->userptr;
+	snd_pcm_sframes_t delay;
+
+	if (snd_pcm_delay(pcm, &delay) < 0) return -1;
+	return delay > 0 ? (int)delay : 0;
+}
+
+static int delay_at_alsa(audio_output_t *ao, double *when)
+{
+	snd_pcm_t *pcm=(snd_pcm_t*)ao->userptr;
+	snd_pcm_status_t *status;
+	snd_htimestamp_t stamp;
+	struct timespec now;
+	snd_pcm_sframes_t delay;
+	double at, t;
+
+	snd_pcm_status_alloca(&status);
+	if (snd_pcm_status(pcm, status) < 0) return -1;
+	delay = snd_pcm_status_get_delay(status);
+	snd_pcm_status_get_htstamp(status, &stamp);
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	/* The timestamp of the last hardware pointer update, which the delay is
+	   as of. Devices that aren't running, or that timestamp with another
+	   clock (old alsa-lib, or the default gettimeofday() one), don't give one
+	   that is within a moment of now. */
+	at = stamp.tv_sec + stamp.tv_nsec / 1e9;
+	t = now.tv_sec + now.tv_nsec / 1e9;
+	*when = snd_pcm_status_get_state(status) == SND_PCM_STATE_RUNNING && at <= t && t - at < 1.0 ? at : t;
+	return delay > 0 ? (int)delay : 0;
+}
+
 static int close_alsa(audio_output_t *ao)
 {
 	snd_pcm_t *pcm=(snd_pcm_t*)ao->userptr;
@@ -265,6 +306,34 @@ static int close_alsa(audio_output_t *ao)
 }
 
 
+static int enumerate_alsa(audio_output_t *ao, int (*store)(void *, const char *, const char *), void *arg)
+{
+	void **hints, **hint;
+	int r = 0;
+
+	if(snd_device_name_hint(-1, "pcm", &hints) < 0) return -1;
+	for(hint = hints; *hint != NULL && r == 0; ++hint)
+	{
+		char *name = snd_device_name_get_hint(*hint, "NAME");
+		char *desc = snd_device_name_get_hint(*hint, "DESC");
+		char *ioid = snd_device_name_get_hint(*hint, "IOID");
+		char *c;
+
+		/* No IOID means that the PCM does both directions. */
+		if(name != NULL && strcmp(name, "null") && (ioid == NULL || !strcmp(ioid, "Output")))
+		{
+			/* Descriptions come in lines. */
+			if(desc != NULL) for(c = desc; *c; ++c) if(*c == '\n') *c = ' ';
+			r = store(arg, name, desc != NULL ? desc : "");
+		}
+		free(name);
+		free(desc);
+		free(ioid);
+	}
+	snd_device_name_free_hint(hints);
+	return r;
+}
+
 static int init_alsa(audio_output_t* ao)
 {
 	if (ao==NULL) return -1;
@@ -275,6 +344,9 @@ static int init_alsa(audio_output_t* ao)
 	ao->write = write_alsa;
 	ao->get_formats = get_formats_alsa;
 	ao->close = close_alsa;
+	ao->delay = delay_alsa;
+	ao->delay_at = delay_at_alsa;
+	ao->enumerate = enumerate_alsa;
 
 	/* Success */
 	return 0;
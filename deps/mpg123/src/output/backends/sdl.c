@@ -0,0 +1,2 @@
+#define mpg123_output_module_info mpg123_output_module_info_sdl
+#include "../sdl.c"
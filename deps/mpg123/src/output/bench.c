@@ -0,0 +1,351 @@
+/*
+	bench: benchmark audio output
+
+	free software under the terms of the LGPL 2.1, like the rest of mpg123
+	see COPYING and AUTHORS files in distribution or http://mpg123.org
+
+	Accepts any encoding and throws the audio away, like the dummy module, but
+	can stand in for a sound card that plays in real time: it then holds
+	writes back to the rate of a simulated device clock. It can also inject
+	scheduling hiccups, and it keeps a histogram of how long write() calls
+	took. All of it is set up through the device name, as comma separated
+	options:
+
+		realtime         consume audio at the sample rate, rather than at once
+		buffer=<ms>      the simulated device buffer (100)
+		period=<ms>      the device consumes audio in periods this long (10)
+		jitter=<ms>      delays writes by a random 0 up to this long (0)
+		underrun=<p>     probability per write of stalling for longer than
+		                 the buffer lasts, so that the device runs dry (0)
+		seed=<n>         seeds the random numbers, for repeatable runs (1)
+		report           prints the statistics to stderr on close
+
+	E.g. "realtime,buffer=50,jitter=2".
+*/
+
+#include "mpg123app.h"
+#ifdef WIN32
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+#include "debug.h"
+
+/* Write times go into power of two buckets of microseconds: the first holds
+   writes under 1 us, the next 1-2 us, and so on. */
+#define BENCH_BUCKETS 32
+
+typedef struct
+{
+	/* options */
+	int realtime;
+	long buffer, period;	/* in frames */
+	double jitter;			/* in seconds */
+	double underrun;
+	unsigned long random;
+	int report;
+
+	int framesize;
+	long rate;
+	/* the simulated device: from `start` on it has consumed a period at a
+	   time, starting `base` frames into what was written */
+	double start;
+	long long base, written;
+	long underruns;
+
+	/* statistics */
+	long writes;
+	long long bytes;
+	double busy;
+	long histogram[BENCH_BUCKETS];
+} mpg123_bench_t;
+
+
+static double now_bench(void)
+{
+#ifdef WIN32
+	LARGE_INTEGER count, frequency;
+	QueryPerformanceCounter(&count);
+	QueryPerformanceFrequency(&frequency);
+	return (double)count.QuadPart / frequency.QuadPart;
+#else
+	struct timespec t;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return t.tv_sec + t.tv_nsec / 1e9;
+#endif
+}
+
+static void sleep_bench(double seconds)
+{
+	if(seconds <= 0) return;
+#ifdef WIN32
+	Sleep((DWORD)(seconds * 1000));
+#else
+	{
+		struct timespec t;
+		t.tv_sec = (time_t)seconds;
+		t.tv_nsec = (long)((seconds - t.tv_sec) * 1e9);
+		nanosleep(&t, NULL);
+	}
+#endif
+}
+
+/* xorshift, so that runs with the same seed are the same everywhere */
+static double random_bench(mpg123_bench_t *bn)
+{
+	bn->random ^= (bn->random << 13) & 0xffffffffUL;
+	bn->random ^= bn->random >> 17;
+	bn->random ^= (bn->random << 5) & 0xffffffffUL;
+	return (double)(bn->random & 0xffffffUL) / 0x1000000UL;
+}
+
+static int framesize_bench(audio_output_t *ao)
+{
+	int bytes;
+
+	if(ao->format & MPG123_ENC_FLOAT_64) bytes = 8;
+	else if(ao->format & (MPG123_ENC_32|MPG123_ENC_FLOAT_32)) bytes = 4;
+	else if(ao->format & MPG123_ENC_24) bytes = 3;
+	else if(ao->format & MPG123_ENC_16) bytes = 2;
+	else bytes = 1;
+	return bytes * ao->channels;
+}
+
+static int parse_bench(audio_output_t *ao, mpg123_bench_t *bn)
+{
+	double buffer = 100, period = 10;
+	const char *p = ao->device;
+
+	bn->realtime = 0;
+	bn->jitter = 0;
+	bn->underrun = 0;
+	bn->random = 1;
+	bn->report = 0;
+
+	while(p != NULL && *p != '\0')
+	{
+		size_t len = strcspn(p, ",");
+		const char *value = memchr(p, '=', len);
+		size_t key = value ? (size_t)(value - p) : len;
+		double number = value ? atof(value + 1) : 0;
+
+		if(key == 8 && !strncmp(p, "realtime", key)) bn->realtime = 1;
+		else if(key == 6 && !strncmp(p, "report", key)) bn->report = 1;
+		else if(value && key == 6 && !strncmp(p, "buffer", key)) buffer = number;
+		else if(value && key == 6 && !strncmp(p, "period", key)) period = number;
+		else if(value && key == 6 && !strncmp(p, "jitter", key)) bn->jitter = number / 1000;
+		else if(value && key == 8 && !strncmp(p, "underrun", key)) bn->underrun = number;
+		else if(value && key == 4 && !strncmp(p, "seed", key)) bn->random = (unsigned long)number;
+		else warning2("ignoring unknown bench output option: %.*s", (int)len, p);
+		p += len;
+		if(*p == ',') ++p;
+	}
+
+	if(period <= 0 || buffer < period || bn->jitter < 0 || bn->underrun < 0 || bn->underrun > 1)
+	{
+		error("bench output: need 0 < period <= buffer, jitter >= 0 and 0 <= underrun <= 1");
+		return -1;
+	}
+	if(bn->random == 0) bn->random = 1;
+	bn->rate = ao->rate;
+	bn->period = (long)(period * ao->rate / 1000);
+	bn->buffer = (long)(buffer * ao->rate / 1000);
+	if(bn->period < 1) bn->period = 1;
+	if(bn->buffer < bn->period) bn->buffer = bn->period;
+	return 0;
+}
+
+/* Frames the simulated device has consumed by `t`, a period at a time. */
+static long long consumed_bench(mpg123_bench_t *bn, double t)
+{
+	if(bn->start < 0) return bn->written;
+	return bn->base + (long long)((t - bn->start) * bn->rate / bn->period) * bn->period;
+}
+
+/* Catches the device clock up with `t`. Once it consumed more than was
+   written, the device ran dry: that counts as an underrun, and it starts over
+   with the next write. */
+static void update_bench(mpg123_bench_t *bn, double t)
+{
+	if(bn->start >= 0 && consumed_bench(bn, t) > bn->written)
+	{
+		++bn->underruns;
+		bn->start = -1;
+	}
+}
+
+static int open_bench(audio_output_t *ao)
+{
+	mpg123_bench_t *bn = (mpg123_bench_t*)ao->userptr;
+
+	/* Called with no format to probe the device. */
+	if(ao->rate <= 0 || ao->channels <= 0 || ao->format < 0) return 0;
+
+	memset(bn, 0, sizeof(mpg123_bench_t));
+	if(parse_bench(ao, bn) != 0) return -1;
+	bn->framesize = framesize_bench(ao);
+	bn->start = -1;
+	return 0;
+}
+
+static int get_formats_bench(audio_output_t *ao)
+{
+	return MPG123_ENC_ANY;
+}
+
+static int write_bench(audio_output_t *ao, unsigned char *buf, int len)
+{
+	mpg123_bench_t *bn = (mpg123_bench_t*)ao->userptr;
+	double begin = now_bench();
+	double t, took;
+	int bucket;
+
+	if(bn->jitter > 0) sleep_bench(random_bench(bn) * bn->jitter);
+	if(bn->underrun > 0 && random_bench(bn) < bn->underrun)
+	{
+		/* a stall that outlasts the buffer */
+		sleep_bench((double)(bn->buffer + bn->period) / bn->rate);
+	}
+
+	if(bn->realtime)
+	{
+		long long frames = len / bn->framesize;
+
+		t = now_bench();
+		update_bench(bn, t);
+		if(bn->start < 0)
+		{
+			/* the device starts, or starts over, on the next period */
+			bn->start = t;
+			bn->base = bn->written;
+		}
+		/* Wait for room in the buffer, until the period that makes it. Like a
+		   blocking write to a real device, one that is larger than the buffer
+		   returns once its tail fits. */
+		while(bn->written + frames - consumed_bench(bn, t) > bn->buffer)
+		{
+			long long over = bn->written + frames - consumed_bench(bn, t) - bn->buffer;
+			long long periods = (over + bn->period - 1) / bn->period;
+			long long target = consumed_bench(bn, t) + periods * bn->period - bn->base;
+			sleep_bench(bn->start + (double)target / bn->rate - t);
+			t = now_bench();
+		}
+		bn->written += frames;
+	}
+
+	took = now_bench() - begin;
+	bn->busy += took;
+	bn->writes++;
+	bn->bytes += len;
+	for(bucket = 0; bucket < BENCH_BUCKETS - 1 && took * 1e6 >= (double)(1L << bucket); ++bucket);
+	bn->histogram[bucket]++;
+
+	return len;
+}
+
+static int delay_bench(audio_output_t *ao)
+{
+	mpg123_bench_t *bn = (mpg123_bench_t*)ao->userptr;
+
+	double t = now_bench();
+
+	if(!bn->realtime) return 0;
+	update_bench(bn, t);
+	return (int)(bn->written - consumed_bench(bn, t));
+}
+
+static void flush_bench(audio_output_t *ao)
+{
+	mpg123_bench_t *bn = (mpg123_bench_t*)ao->userptr;
+
+	/* drop what the device hasn't played yet */
+	bn->start = -1;
+}
+
+static void report_bench(mpg123_bench_t *bn)
+{
+	int i, last;
+
+	fprintf(stderr, "bench: %ld writes, %lld bytes, %.3f s in write(), %ld underruns\n",
+		bn->writes, bn->bytes, bn->busy, bn->underruns);
+	for(last = BENCH_BUCKETS - 1; last > 0 && bn->histogram[last] == 0; --last);
+	for(i = 0; i <= last; ++i)
+	{
+		if(i == 0) fprintf(stderr, "bench:        < 1 us: %ld\n", bn->histogram[i]);
+		else fprintf(stderr, "bench: %10ld+ us: %ld\n", 1L << (i - 1), bn->histogram[i]);
+	}
+}
+
+static int close_bench(audio_output_t *ao)
+{
+	mpg123_bench_t *bn = (mpg123_bench_t*)ao->userptr;
+
+	if(bn->framesize == 0) return 0;
+
+	/* play out the buffer */
+	if(bn->realtime && bn->start >= 0)
+	{
+		double t = now_bench();
+		update_bench(bn, t);
+		if(bn->start >= 0)
+		{
+			long long left = bn->written - bn->base;
+			long long periods = (left + bn->period - 1) / bn->period;
+			sleep_bench(bn->start + (double)(periods * bn->period) / bn->rate - t);
+		}
+	}
+	if(bn->report) report_bench(bn);
+	bn->framesize = 0;
+	return 0;
+}
+
+static int deinit_bench(audio_output_t *ao)
+{
+	if(ao->userptr)
+	{
+		free(ao->userptr);
+		ao->userptr = NULL;
+	}
+	return 0;
+}
+
+
+static int init_bench(audio_output_t* ao)
+{
+	if (ao==NULL) return -1;
+
+	/* Set callbacks */
+	ao->open = open_bench;
+	ao->flush = flush_bench;
+	ao->write = write_bench;
+	ao->get_formats = get_formats_bench;
+	ao->close = close_bench;
+	ao->deinit = deinit_bench;
+	ao->delay = delay_bench;
+
+	/* Allocate memory for data structure */
+	ao->userptr = malloc(sizeof(mpg123_bench_t));
+	if(ao->userptr == NULL)
+	{
+		error("failed to malloc memory for 'mpg123_bench_t'");
+		return -1;
+	}
+	memset(ao->userptr, 0, sizeof(mpg123_bench_t));
+
+	/* Success */
+	return 0;
+}
+
+
+/* 
+	Module information data structure
+*/
+mpg123_module_t mpg123_output_module_info = {
+	/* api_version */	MPG123_MODULE_API_VERSION,
+	/* name */			"bench",
+	/* description */	"Benchmark audio output - discards audio, optionally in real time.",
+	/* revision */		"$Rev:$",
+	/* handle */		NULL,
+	
+	/* init_output */	init_bench,
+};
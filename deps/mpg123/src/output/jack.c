@@ -420,6 +420,46 @@ static void flush_jack(audio_output_t *ao)
 	}
 }
 
+/* Each client with playback ports becomes one device: its first two ports,
+   which is what connect_jack_ports() takes. */
+static int enumerate_jack(audio_output_t *ao, int (*store)(void *, const char *, const char *), void *arg)
+{
+	jack_client_t *client;
+	jack_status_t jstat = 0;
+	const char **ports;
+	char client_name[255];
+	size_t i = 0;
+	int r = 0;
+
+	snprintf(client_name, 255, "mpg123-%d-list", getpid());
+	if((client = jack_client_open(client_name, JackNoStartServer, &jstat)) == NULL) return -1;
+	ports = jack_get_ports(client, NULL, JACK_DEFAULT_AUDIO_TYPE, JackPortIsInput);
+	while(ports != NULL && ports[i] != NULL && r == 0)
+	{
+		const char *colon = strchr(ports[i], ':');
+		size_t prefix = colon ? (size_t) (colon - ports[i]) : strlen(ports[i]);
+		char device[512];
+
+		if(ports[i+1] != NULL && !strncmp(ports[i], ports[i+1], prefix) && ports[i+1][prefix] == ':')
+		{
+			snprintf(device, sizeof(device), "%s,%s", ports[i], ports[i+1]);
+			snprintf(client_name, sizeof(client_name), "%.*s", (int) prefix, ports[i]);
+			r = store(arg, device, client_name);
+		}
+		else
+		{
+			snprintf(client_name, sizeof(client_name), "%.*s", (int) prefix, ports[i]);
+			r = store(arg, ports[i], client_name);
+		}
+		/* on to the next client; a port without one is a device of its own */
+		++i;
+		while(colon != NULL && ports[i] != NULL && !strncmp(ports[i], client_name, prefix) && ports[i][prefix] == ':') ++i;
+	}
+	if(ports != NULL) jack_free(ports);
+	jack_client_close(client);
+	return r;
+}
+
 static int init_jack(audio_output_t* ao)
 {
 	if (ao==NULL) return -1;
@@ -430,6 +470,7 @@ static int init_jack(audio_output_t* ao)
 	ao->write = write_jack;
 	ao->get_formats = get_formats_jack;
 	ao->close = close_jack;
+	ao->enumerate = enumerate_jack;
 
 	/* Success */
 	return 0;
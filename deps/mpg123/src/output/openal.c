@@ -22,9 +22,18 @@
 #include <errno.h>
 #include <unistd.h>
 
+#ifndef _WIN32
+#define OPENAL_EVENTS
+#include <pthread.h>
+#include <sys/time.h>
+#endif
+
 #include "debug.h"
 
+/* The buffers that are allocated at open() and cycled through the source. */
+#ifndef NUM_BUFFERS
 #define NUM_BUFFERS 16
+#endif
 
 #ifndef AL_FORMAT_MONO_FLOAT32
 #define AL_FORMAT_MONO_FLOAT32 0x10010
@@ -33,24 +42,171 @@
 #define AL_FORMAT_STEREO_FLOAT32 0x10011
 #endif
 
+/*
+	AL_SOFT_events from OpenAL Soft's alext.h, which not every OpenAL ships.
+	It calls back from the mixer when a buffer has been played, so that writes
+	don't have to poll for it.
+*/
+#ifndef AL_SOFT_events
+#ifndef AL_APIENTRY
+#define AL_APIENTRY
+#endif
+#define AL_EVENT_TYPE_BUFFER_COMPLETED_SOFT 0x19A4
+#define AL_EVENT_TYPE_SOURCE_STATE_CHANGED_SOFT 0x19A5
+typedef void (AL_APIENTRY*ALEVENTPROCSOFT)(ALenum eventType, ALuint object, ALuint param, ALsizei length, const ALchar *message, void *userParam);
+typedef void (AL_APIENTRY*LPALEVENTCONTROLSOFT)(ALsizei count, const ALenum *types, ALboolean enable);
+typedef void (AL_APIENTRY*LPALEVENTCALLBACKSOFT)(ALEVENTPROCSOFT callback, void *userParam);
+#endif
+
+/* Bounds of a single wait for the source to make progress, in microseconds. */
+#define MIN_WAIT 1000
+#define MAX_WAIT 100000
+
 typedef struct
 {
 	ALCdevice *device;
 	ALCcontext *context;
-	ALuint source, buffer;
+	ALuint source;
 	ALenum format;
 	ALsizei rate;
+	int framesize;
+	/* The ring of buffers: queued ones start at head, in the order they play. */
+	ALuint buffers[NUM_BUFFERS];
+	ALint frames[NUM_BUFFERS];
+	int head, queued;
+#ifdef OPENAL_EVENTS
+	LPALEVENTCONTROLSOFT event_control;
+	LPALEVENTCALLBACKSOFT event_callback;
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	int signalled;
+#endif
 } mpg123_openal_t;
 
 
+#ifdef OPENAL_EVENTS
+static const ALenum event_types[] =
+{
+	AL_EVENT_TYPE_BUFFER_COMPLETED_SOFT,
+	AL_EVENT_TYPE_SOURCE_STATE_CHANGED_SOFT
+};
+
+/* Runs on OpenAL's event thread. */
+static void AL_APIENTRY event_openal(ALenum type, ALuint object, ALuint param, ALsizei length, const ALchar *message, void *userptr)
+{
+	mpg123_openal_t* al = (mpg123_openal_t*)userptr;
+
+	pthread_mutex_lock(&al->lock);
+	al->signalled = 1;
+	pthread_cond_signal(&al->cond);
+	pthread_mutex_unlock(&al->lock);
+}
+#endif
+
+/* Takes the buffers that have been played off the source, back into the ring. */
+static void reclaim_openal(mpg123_openal_t* al)
+{
+	ALint n;
+	ALuint buffer;
+
+	alGetSourcei(al->source, AL_BUFFERS_PROCESSED, &n);
+	while(n-- > 0 && al->queued > 0)
+	{
+		alSourceUnqueueBuffers(al->source, 1, &buffer);
+		al->head = (al->head + 1) % NUM_BUFFERS;
+		--al->queued;
+	}
+}
+
+static int playing_openal(mpg123_openal_t* al)
+{
+	ALint state;
+
+	alGetSourcei(al->source, AL_SOURCE_STATE, &state);
+	return state == AL_PLAYING;
+}
+
+/* Starts the source, or restarts it after it ran dry. */
+static void play_openal(mpg123_openal_t* al)
+{
+	if(al->queued > 0 && !playing_openal(al)) alSourcePlay(al->source);
+}
+
+/* Frames queued on the source that haven't been played yet, once the played
+   buffers have been reclaimed. Also stores what is left of the buffer that is
+   playing right now. */
+static long pending_openal(mpg123_openal_t* al, long *current)
+{
+	ALint offset = 0;
+	long frames = 0;
+	int i;
+
+	if(al->queued == 0)
+	{
+		*current = 0;
+		return 0;
+	}
+	/* The offset counts from the first queued buffer, which is the head. */
+	if(playing_openal(al)) alGetSourcei(al->source, AL_SAMPLE_OFFSET, &offset);
+	for(i = 0; i < al->queued; ++i) frames += al->frames[(al->head + i) % NUM_BUFFERS];
+	*current = al->frames[al->head] - offset;
+	if(*current < 0) *current = 0;
+	return frames - offset;
+}
+
+/*
+	Waits for the source to make progress: until the buffer that is playing
+	should be done, and with AL_SOFT_events, until OpenAL says something has
+	been played, if that is sooner.
+*/
+static void wait_openal(mpg123_openal_t* al)
+{
+	long current, us;
+
+	pending_openal(al, &current);
+	us = (long)((double)current * 1000000 / al->rate);
+	if(us < MIN_WAIT) us = MIN_WAIT;
+	if(us > MAX_WAIT) us = MAX_WAIT;
+
+#ifdef OPENAL_EVENTS
+	if(al->event_callback)
+	{
+		struct timeval now;
+		struct timespec deadline;
+
+		gettimeofday(&now, NULL);
+		us += now.tv_usec;
+		deadline.tv_sec = now.tv_sec + us / 1000000;
+		deadline.tv_nsec = (us % 1000000) * 1000;
+
+		pthread_mutex_lock(&al->lock);
+		while(!al->signalled)
+		{
+			if(pthread_cond_timedwait(&al->cond, &al->lock, &deadline) == ETIMEDOUT) break;
+		}
+		al->signalled = 0;
+		pthread_mutex_unlock(&al->lock);
+		return;
+	}
+#endif
+	usleep(us);
+}
+
 static int open_openal(audio_output_t *ao)
 {
 	mpg123_openal_t* al = (mpg123_openal_t*)ao->userptr;
 
 	al->device = alcOpenDevice(NULL);
+	if(al->device == NULL)
+	{
+		error("failed to open the OpenAL device");
+		return -1;
+	}
 	al->context = alcCreateContext(al->device, NULL);
 	alcMakeContextCurrent(al->context);
 	alGenSources(1, &al->source);
+	alGenBuffers(NUM_BUFFERS, al->buffers);
+	al->head = al->queued = 0;
 
 	al->rate = ao->rate;
 	if(ao->format == MPG123_ENC_SIGNED_16 && ao->channels == 2) al->format = AL_FORMAT_STEREO16;
@@ -59,7 +215,36 @@ static int open_openal(audio_output_t *ao)
 	else if(ao->format == MPG123_ENC_UNSIGNED_8 && ao->channels == 1) al->format = AL_FORMAT_MONO8;
 	else if(ao->format == MPG123_ENC_FLOAT_32 && ao->channels == 2) al->format = AL_FORMAT_STEREO_FLOAT32;
 	else if(ao->format == MPG123_ENC_FLOAT_32 && ao->channels == 1) al->format = AL_FORMAT_MONO_FLOAT32;
-	
+
+	if(ao->format == MPG123_ENC_FLOAT_32) al->framesize = 4;
+	else if(ao->format == MPG123_ENC_SIGNED_16) al->framesize = 2;
+	else al->framesize = 1;
+	al->framesize *= ao->channels > 0 ? ao->channels : 1;
+
+	if(alGetError() != AL_NO_ERROR)
+	{
+		error("failed to set up the OpenAL source");
+		return -1;
+	}
+
+#ifdef OPENAL_EVENTS
+	al->event_control = NULL;
+	al->event_callback = NULL;
+	if(alIsExtensionPresent("AL_SOFT_events") == AL_TRUE)
+	{
+		al->event_control = (LPALEVENTCONTROLSOFT)alGetProcAddress("alEventControlSOFT");
+		al->event_callback = (LPALEVENTCALLBACKSOFT)alGetProcAddress("alEventCallbackSOFT");
+		if(al->event_control && al->event_callback)
+		{
+			al->signalled = 0;
+			al->event_control(sizeof(event_types) / sizeof(event_types[0]), event_types, AL_TRUE);
+			al->event_callback(event_openal, al);
+		}
+		else al->event_callback = NULL;
+	}
+	debug1("buffer completion events: %s", al->event_callback ? "yes" : "no");
+#endif
+
 	return 0;
 }
 
@@ -70,56 +255,91 @@ static int get_formats_openal(audio_output_t *ao)
 
 static int write_openal(audio_output_t *ao, unsigned char *buf, int len)
 {
-	ALint state, n;
 	mpg123_openal_t* al = (mpg123_openal_t*)ao->userptr;
+	long latency = (long)((double)ao->latency * al->rate / 1000000);
+	long current;
+	int slot;
 
-	alGetSourcei(al->source, AL_BUFFERS_QUEUED, &n);
-	if(n < NUM_BUFFERS)
+	/* Wait for a free buffer, and with a latency asked for, for the queue to
+	   drop below it. */
+	reclaim_openal(al);
+	while(al->queued == NUM_BUFFERS || (latency > 0 && al->queued > 1 && pending_openal(al, &current) >= latency))
 	{
-		alGenBuffers(1, &al->buffer);
+		play_openal(al);
+		wait_openal(al);
+		reclaim_openal(al);
 	}
-	else
+
+	slot = (al->head + al->queued) % NUM_BUFFERS;
+	alBufferData(al->buffers[slot], al->format, buf, len, al->rate);
+	alSourceQueueBuffers(al->source, 1, &al->buffers[slot]);
+	if(alGetError() != AL_NO_ERROR)
 	{
-		alGetSourcei(al->source, AL_SOURCE_STATE, &state);
-		if(state != AL_PLAYING)
-		{
-			alSourcePlay(al->source);
-		}
-		while(alGetSourcei(al->source, AL_BUFFERS_PROCESSED, &n), n == 0)
-		{	
-			usleep(10000);
-		}
-		alSourceUnqueueBuffers(al->source, 1, &al->buffer);
+		error("failed to queue an OpenAL buffer");
+		return -1;
 	}
-	
-	alBufferData(al->buffer, al->format, buf, len, al->rate);
-	alSourceQueueBuffers(al->source, 1, &al->buffer);
-	
+	al->frames[slot] = len / al->framesize;
+	++al->queued;
+
+	/* Start with the first buffer, or pick up again after an underrun or a
+	   flush: callers that pace themselves by the delay keep only a period or
+	   two queued, and wait for it to drop. */
+	play_openal(al);
+
 	return len;
 }
 
+/*
+	Frames queued on the source that haven't been played yet. This runs on
+	whatever thread asks while write_openal() may be changing the ring on
+	another, so it leaves the played buffers on the source for write_openal()
+	to reclaim, and skips them itself: while playing, the offset counts from
+	the first of them; once stopped, they are the ones processed.
+*/
+static int delay_openal(audio_output_t *ao)
+{
+	mpg123_openal_t* al = (mpg123_openal_t*)ao->userptr;
+	int head = al->head, queued = al->queued;
+	ALint processed = 0, offset = 0;
+	long frames = 0;
+	int i;
+
+	if(playing_openal(al)) alGetSourcei(al->source, AL_SAMPLE_OFFSET, &offset);
+	else alGetSourcei(al->source, AL_BUFFERS_PROCESSED, &processed);
+	for(i = processed; i < queued; ++i) frames += al->frames[(head + i) % NUM_BUFFERS];
+	frames -= offset;
+	return frames > 0 ? (int)frames : 0;
+}
+
 static int close_openal(audio_output_t *ao)
 {
-	ALint state, n;
 	mpg123_openal_t* al = (mpg123_openal_t*)ao->userptr;
 
-	if (al)
+	if (al && al->device)
 	{
-		/* wait until all buffers are consumed */
-		while(alGetSourcei(al->source, AL_SOURCE_STATE, &state), state == AL_PLAYING)
+		/* wait until all buffers are consumed, which includes starting
+		   to play if there never was enough for that */
+		play_openal(al);
+		while(playing_openal(al))
 		{
-			usleep(10000);
+			wait_openal(al);
+			reclaim_openal(al);
 		}
-		/* free all processed buffers */
-		while(alGetSourcei(al->source, AL_BUFFERS_PROCESSED, &n), n > 0)
+		alSourceStop(al->source);
+		reclaim_openal(al);
+#ifdef OPENAL_EVENTS
+		if(al->event_callback)
 		{
-			alSourceUnqueueBuffers(al->source, 1, &al->buffer);
-			alDeleteBuffers(1, &al->buffer);
+			al->event_control(sizeof(event_types) / sizeof(event_types[0]), event_types, AL_FALSE);
+			al->event_callback(NULL, NULL);
 		}
+#endif
 		alDeleteSources(1, &al->source);
+		alDeleteBuffers(NUM_BUFFERS, al->buffers);
 		alcMakeContextCurrent(NULL);
 		alcDestroyContext(al->context);
 		alcCloseDevice(al->device);
+		al->device = NULL;
 	}
 	
 	return 0;
@@ -127,18 +347,13 @@ static int close_openal(audio_output_t *ao)
 
 static void flush_openal(audio_output_t *ao)
 {
-	ALint n;
 	mpg123_openal_t* al = (mpg123_openal_t*)ao->userptr;
 
 	if (al)
 	{
-		/* stop playing and flush all buffers */
+		/* stop playing, which marks all buffers as played */
 		alSourceStop(al->source);
-		while(alGetSourcei(al->source, AL_BUFFERS_PROCESSED, &n), n > 0)
-		{
-			alSourceUnqueueBuffers(al->source, 1, &al->buffer);
-			alDeleteBuffers(1, &al->buffer);
-		}
+		reclaim_openal(al);
 	}
 }
 
@@ -147,6 +362,11 @@ static int deinit_openal(audio_output_t* ao)
 	/* Free up memory */
 	if(ao->userptr)
 	{
+#ifdef OPENAL_EVENTS
+		mpg123_openal_t* al = (mpg123_openal_t*)ao->userptr;
+		pthread_cond_destroy(&al->cond);
+		pthread_mutex_destroy(&al->lock);
+#endif
 		free( ao->userptr );
 		ao->userptr = NULL;
 	}
@@ -166,6 +386,7 @@ static int init_openal(audio_output_t* ao)
 	ao->get_formats = get_formats_openal;
 	ao->close = close_openal;
 	ao->deinit = deinit_openal;
+	ao->delay = delay_openal;
 
 	/* Allocate memory for data structure */
 	ao->userptr = malloc( sizeof( mpg123_openal_t ) );
@@ -175,6 +396,13 @@ static int init_openal(audio_output_t* ao)
 		return -1;
 	}
 	memset( ao->userptr, 0, sizeof(mpg123_openal_t) );
+#ifdef OPENAL_EVENTS
+	{
+		mpg123_openal_t* al = (mpg123_openal_t*)ao->userptr;
+		pthread_mutex_init(&al->lock, NULL);
+		pthread_cond_init(&al->cond, NULL);
+	}
+#endif
 
 	/* Success */
 	return 0;
@@ -193,5 +421,3 @@ mpg123_module_t mpg123_output_module_info = {
 	
 	/* init_output */	init_openal,
 };
-
-
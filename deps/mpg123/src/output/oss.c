@@ -8,6 +8,8 @@
 
 #include <sys/ioctl.h>
 #include <fcntl.h>
+#include <poll.h>
+#include <errno.h>
 
 #include "mpg123app.h"
 
@@ -41,11 +43,55 @@
 
 #include "debug.h"
 
-struct oss_stuff
+/* How long a write waits for the device to take more audio before it gives up
+   on it, in milliseconds. */
+#define OSS_WRITE_TIMEOUT 2000
+
+/* Bytes per frame, going by the sample size bits of the encoding. */
+static int frame_size_oss(audio_output_t *ao)
 {
-	int fragment; /* size of one fragment */
-	int nfrag;    /* number of fragments  */
-};
+	int bytes;
+
+	if(ao->format & MPG123_ENC_FLOAT_64)
+		bytes = 8;
+	else if(ao->format & (MPG123_ENC_32|MPG123_ENC_FLOAT_32))
+		bytes = 4;
+	else if(ao->format & MPG123_ENC_24)
+		bytes = 3;
+	else if(ao->format & MPG123_ENC_16)
+		bytes = 2;
+	else
+		bytes = 1;
+	return bytes * (ao->channels > 0 ? ao->channels : 1);
+}
+
+/*
+ * Size the fragments after the requested latency: about four of them cover
+ * it, so that the device is woken up often enough to keep the buffer full
+ * without holding more than asked for.
+ */
+static int set_fragment_oss(audio_output_t *ao)
+{
+	long bytes;
+	int shift = 4;
+	int count, frag;
+
+	if(ao->latency <= 0 || ao->rate <= 0) return 0;
+
+	bytes = (long)((double)ao->latency * ao->rate / 1000000.0) * frame_size_oss(ao);
+	while(shift < 16 && (1L << (shift+1)) <= bytes/4) ++shift;
+	count = (int)((bytes + (1L << shift) - 1) >> shift);
+	if(count < 2) count = 2;
+	if(count > 0x7fff) count = 0x7fff;
+
+	frag = (count << 16) | shift;
+	if(ioctl(ao->fn, SNDCTL_DSP_SETFRAGMENT, &frag) < 0)
+	{
+		/* Not fatal, the device just keeps its default buffering. */
+		if(!AOQUIET) warning("Can't set the fragment size.");
+	}
+	return 0;
+}
 
 static int rate_best_match_oss(audio_output_t *ao)
 {
@@ -127,6 +173,8 @@ static int reset_parameters_oss(audio_output_t *ao)
 	int ret;
 	ret = ioctl(ao->fn, SNDCTL_DSP_RESET, NULL);
 	if(ret < 0 && !AOQUIET) error("Can't reset audio!");
+	/* The fragment layout has to be settled before the format commits it. */
+	set_fragment_oss(ao);
 	ret = set_format_oss(ao);
 	if (ret == -1) goto err;
 	ret = set_channels_oss(ao);
@@ -161,13 +209,14 @@ static int open_oss(audio_output_t *ao)
 		usingdefdev = 1;
 	}
 	
-	ao->fn = open(ao->device,O_WRONLY);  
+	/* Non-blocking, so that writes can wait for the device with a timeout. */
+	ao->fn = open(ao->device,O_WRONLY|O_NONBLOCK);
 	
 	if(ao->fn < 0)
 	{
 		if(usingdefdev) {
 			ao->device = "/dev/sound/dsp";
-			ao->fn = open(ao->device,O_WRONLY);
+			ao->fn = open(ao->device,O_WRONLY|O_NONBLOCK);
 			if(ao->fn < 0) {
 				if(!AOQUIET) error("Can't open default sound device!");
 				return -1;
@@ -268,13 +317,65 @@ static int get_formats_oss(audio_output_t *ao)
 	return fmt;
 }
 
+/* Waits until the device takes more audio. */
+static int wait_oss(audio_output_t *ao)
+{
+	struct pollfd pfd;
+	int ret;
+
+	pfd.fd = ao->fn;
+	pfd.events = POLLOUT;
+	do
+	{
+		pfd.revents = 0;
+		ret = poll(&pfd, 1, OSS_WRITE_TIMEOUT);
+	} while(ret < 0 && errno == EINTR);
+
+	if(ret == 0)
+	{
+		if(!AOQUIET) error("Timed out waiting for the audio device.");
+		return -1;
+	}
+	if(ret < 0 || (pfd.revents & (POLLERR|POLLHUP|POLLNVAL))) return -1;
+	return 0;
+}
+
 static int write_oss(audio_output_t *ao,unsigned char *buf,int len)
 {
-	return write(ao->fn,buf,len);
+	int written = 0;
+
+	while(written < len)
+	{
+		ssize_t ret = write(ao->fn, buf+written, len-written);
+		if(ret >= 0)
+		{
+			written += ret;
+			continue;
+		}
+		if(errno == EINTR) continue;
+		if((errno != EAGAIN && errno != EWOULDBLOCK) || wait_oss(ao) < 0)
+			return written > 0 ? written : -1;
+	}
+	return written;
+}
+
+static int delay_oss(audio_output_t *ao)
+{
+#ifdef SNDCTL_DSP_GETODELAY
+	int bytes;
+
+	if(ioctl(ao->fn, SNDCTL_DSP_GETODELAY, &bytes) < 0) return -1;
+	return bytes / frame_size_oss(ao);
+#else
+	return -1;
+#endif
 }
 
 static int close_oss(audio_output_t *ao)
 {
+	/* Play out what the device still holds before letting go of it. */
+	fcntl(ao->fn, F_SETFL, fcntl(ao->fn, F_GETFL) & ~O_NONBLOCK);
+	ioctl(ao->fn, SNDCTL_DSP_SYNC, NULL);
 	close(ao->fn);
 	return 0;
 }
@@ -296,6 +397,7 @@ static int init_oss(audio_output_t* ao)
 	ao->write = write_oss;
 	ao->get_formats = get_formats_oss;
 	ao->close = close_oss;
+	ao->delay = delay_oss;
 	
 	/* Success */
 	return 0;
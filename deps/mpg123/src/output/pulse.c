@@ -12,6 +12,9 @@
 
 #include <pulse/simple.h>
 #include <pulse/error.h>
+#include <pulse/mainloop.h>
+#include <pulse/context.h>
+#include <pulse/introspect.h>
 
 #include "config.h"
 #include "mpg123app.h"
@@ -24,6 +27,7 @@ static int open_pulse(audio_output_t *ao)
 	int err;
 	pa_simple* pas = NULL;
 	pa_sample_spec ss;
+	pa_buffer_attr attr;
 	/* Check if already open ? */
 	if (ao->userptr) {
 		error("Pulse audio output is already open.");
@@ -67,6 +71,16 @@ static int open_pulse(audio_output_t *ao)
 	}
 
 
+	/* Start playing on the first write: the default prebuffer holds back
+	   about 2 s, which a short clip, or output that keeps only a period or
+	   two queued, never fills. The queue is as long as the latency asked
+	   for, if any. */
+	attr.maxlength = (uint32_t)-1;
+	attr.tlength = ao->latency > 0 ? (uint32_t)pa_usec_to_bytes(ao->latency, &ss) : (uint32_t)-1;
+	attr.prebuf = 0;
+	attr.minreq = (uint32_t)-1;
+	attr.fragsize = (uint32_t)-1;
+
 	/* Perform the open */
 	pas = pa_simple_new(
 			NULL,				/* Use the default server */
@@ -76,7 +90,7 @@ static int open_pulse(audio_output_t *ao)
 			"MPEG Audio",		/* Description of our stream */
 			&ss,				/* Our sample format */
 			NULL,				/* Use default channel map */
-			NULL,				/* Use default buffering attributes */
+			&attr,				/* Our buffering attributes */
 			&err				/* Error result code */
 	);
 
@@ -109,6 +123,15 @@ static int write_pulse(audio_output_t *ao, unsigned char *buf, int len)
 	return len; /* If successful, everything has been written. */
 }
 
+static int delay_pulse(audio_output_t *ao)
+{
+	int err;
+	pa_usec_t latency = pa_simple_get_latency((pa_simple*)ao->userptr, &err);
+
+	if(latency == (pa_usec_t)-1) return -1;
+	return (int)(latency * ao->rate / 1000000);
+}
+
 static int close_pulse(audio_output_t *ao)
 {
 	pa_simple *pas = (pa_simple*)ao->userptr;
@@ -133,6 +156,65 @@ static void flush_pulse(audio_output_t *ao)
 }
 
 
+struct pulse_sinks
+{
+	int (*store)(void *, const char *, const char *);
+	void *arg;
+	int done; /* 1 at the end of the list, -1 on failure */
+	int failed; /* store() failed, the rest of the list gets ignored */
+};
+
+static void sink_info_pulse(pa_context *c, const pa_sink_info *info, int eol, void *userdata)
+{
+	struct pulse_sinks *sinks = userdata;
+
+	if(eol) sinks->done = eol > 0 ? 1 : -1;
+	else if(!sinks->failed && sinks->store(sinks->arg, info->name, info->description ? info->description : "") != 0)
+		sinks->failed = 1;
+}
+
+/* The simple API can't list sinks, so this talks to the server directly. */
+static int enumerate_pulse(audio_output_t *ao, int (*store)(void *, const char *, const char *), void *arg)
+{
+	struct pulse_sinks sinks;
+	pa_mainloop *ml;
+	pa_context *ctx;
+	pa_operation *op = NULL;
+
+	sinks.store = store;
+	sinks.arg = arg;
+	sinks.done = 0;
+	sinks.failed = 0;
+	if((ml = pa_mainloop_new()) == NULL) return -1;
+	ctx = pa_context_new(pa_mainloop_get_api(ml), "mpg123");
+	if(ctx != NULL && pa_context_connect(ctx, NULL, PA_CONTEXT_NOAUTOSPAWN, NULL) >= 0)
+	{
+		while(sinks.done == 0)
+		{
+			pa_context_state_t state = pa_context_get_state(ctx);
+			if(!PA_CONTEXT_IS_GOOD(state))
+			{
+				sinks.done = -1;
+				break;
+			}
+			if(state == PA_CONTEXT_READY && op == NULL
+			   && (op = pa_context_get_sink_info_list(ctx, sink_info_pulse, &sinks)) == NULL)
+			{
+				sinks.done = -1;
+				break;
+			}
+			if(sinks.done == 0 && pa_mainloop_iterate(ml, 1, NULL) < 0) sinks.done = -1;
+		}
+		pa_context_disconnect(ctx);
+	}
+	else sinks.done = -1;
+
+	if(op != NULL) pa_operation_unref(op);
+	if(ctx != NULL) pa_context_unref(ctx);
+	pa_mainloop_free(ml);
+	return sinks.done > 0 && !sinks.failed ? 0 : -1;
+}
+
 static int init_pulse(audio_output_t* ao)
 {
 	if (ao==NULL) return -1;
@@ -143,6 +225,8 @@ static int init_pulse(audio_output_t* ao)
 	ao->write = write_pulse;
 	ao->get_formats = get_formats_pulse;
 	ao->close = close_pulse;
+	ao->delay = delay_pulse;
+	ao->enumerate = enumerate_pulse;
 
 	/* Success */
 	return 0;
@@ -6,142 +6,189 @@
 	initially written by Nicholas J. Humfrey
 */
 
-#include <math.h>
-
 #include <SDL.h>
 
 #include "audio.h"
 #include "mpg123app.h"
-#ifdef WIN32
-#include <windows.h>
-#endif
-
-/* Including the sfifo code locally, to avoid module linkage issues. */
-#define SFIFO_STATIC
-#include "sfifo.c"
 
 #include "debug.h"
 
+#if !SDL_VERSION_ATLEAST(2,0,4)
+#error "the sdl output needs SDL 2.0.4 or later, for SDL_QueueAudio()"
+#endif
 
-#define SAMPLE_SIZE			(2)
-#define FRAMES_PER_BUFFER	(256)
-#define FIFO_DURATION		(0.5f)
+/* How much audio is queued up ahead of the device without a latency asked
+   for, in seconds. */
+#define QUEUE_DURATION		(0.5)
+/* The most SDL gets to pull from the queue at a time, in sample frames. */
+#define MAX_SAMPLES			(1024)
 
 
+typedef struct
+{
+	SDL_AudioDeviceID device;
+	int framesize;
+	Uint32 limit;	/* bytes that may be queued before writes wait */
+	Uint32 samples;	/* the device buffer, in sample frames */
+	int paused;
+} mpg123_sdl_t;
 
 
-/* The audio function callback takes the following parameters:
-       stream:  A pointer to the audio buffer to be filled
-       len:     The length (in bytes) of the audio buffer
-*/
-static void audio_callback_sdl(void *udata, Uint8 *stream, int len)
+static SDL_AudioFormat format_sdl(int format)
 {
-	audio_output_t *ao = (audio_output_t*)udata;
-	sfifo_t *fifo = (sfifo_t*)ao->userptr;
-	int bytes_read;
-
-	/* Only play if we have data left */
-	if ( sfifo_used( fifo ) < len ) {
-		warning("Didn't have any audio data for SDL (buffer underflow)");
-		SDL_PauseAudio(1);
-		return;
+	switch(format)
+	{
+		case MPG123_ENC_SIGNED_16:   return AUDIO_S16SYS;
+		case MPG123_ENC_UNSIGNED_16: return AUDIO_U16SYS;
+		case MPG123_ENC_SIGNED_8:    return AUDIO_S8;
+		case MPG123_ENC_UNSIGNED_8:  return AUDIO_U8;
+		case MPG123_ENC_SIGNED_32:   return AUDIO_S32SYS;
+		case MPG123_ENC_FLOAT_32:    return AUDIO_F32SYS;
 	}
+	return 0;
+}
 
-	/* Read audio from FIFO to SDL's buffer */
-	bytes_read = sfifo_read( fifo, stream, len );
-	
-	if (len!=bytes_read)
-		warning2("Error reading from the FIFO (wanted=%u, bytes_read=%u).\n", len, bytes_read);
+/* Sleeps for the time it takes to play `bytes` of the queue, within 1-100 ms. */
+static void wait_sdl(audio_output_t *ao, Uint32 bytes)
+{
+	mpg123_sdl_t *sdl = (mpg123_sdl_t*)ao->userptr;
+	Uint32 ms = (Uint32)((double)bytes / sdl->framesize * 1000 / ao->rate);
+
+	if(ms < 1) ms = 1;
+	if(ms > 100) ms = 100;
+	SDL_Delay(ms);
+}
 
-} 
+static void play_sdl(mpg123_sdl_t *sdl)
+{
+	if(sdl->paused)
+	{
+		SDL_PauseAudioDevice(sdl->device, 0);
+		sdl->paused = 0;
+	}
+}
 
 static int open_sdl(audio_output_t *ao)
 {
-	sfifo_t *fifo = (sfifo_t*)ao->userptr;
-	
-	/* Open an audio I/O stream. */
-	if (ao->rate > 0 && ao->channels >0 ) {
-		size_t ringbuffer_len;
-		SDL_AudioSpec wanted;
-	
-		/* L16 uncompressed audio data, using 16-bit signed representation in twos 
-		   complement notation - system endian-ness. */
-		wanted.format = AUDIO_S16SYS;
-		wanted.samples = 1024;  /* Good low-latency value for callback */ 
-		wanted.callback = audio_callback_sdl; 
-		wanted.userdata = ao; 
-		wanted.channels = ao->channels; 
-		wanted.freq = ao->rate; 
-	
-		/* Open the audio device, forcing the desired format */
-		if ( SDL_OpenAudio(&wanted, NULL) ) {
-			error1("Couldn't open SDL audio: %s\n", SDL_GetError());
-			return -1;
-		}
-		
-		/* Initialise FIFO */
-		ringbuffer_len = ao->rate * FIFO_DURATION * SAMPLE_SIZE *ao->channels;
-		debug2( "Allocating %d byte ring-buffer (%f seconds)", (int)ringbuffer_len, (float)FIFO_DURATION);
-		if (sfifo_init( fifo, ringbuffer_len )) error1( "Failed to initialise FIFO of size %d bytes", (int)ringbuffer_len );
+	mpg123_sdl_t *sdl = (mpg123_sdl_t*)ao->userptr;
+	SDL_AudioSpec wanted, obtained;
+	long frames;
+
+	/* Called with no format to probe the device. */
+	if(ao->rate <= 0 || ao->channels <= 0 || ao->format < 0) return 0;
+
+	SDL_zero(wanted);
+	wanted.format = format_sdl(ao->format);
+	wanted.channels = ao->channels;
+	wanted.freq = ao->rate;
+	if(wanted.format == 0)
+	{
+		error1("SDL can't play encoding 0x%x", ao->format);
+		return -1;
 	}
-	
-	return(0);
+
+	/* The device buffer gets a quarter of the latency asked for, as a power
+	   of two, so that SDL pulls from the queue often enough to keep it
+	   short. */
+	frames = ao->latency > 0 ? (long)((double)ao->latency * ao->rate / 1000000) : (long)(QUEUE_DURATION * ao->rate);
+	for(wanted.samples = MAX_SAMPLES; wanted.samples > 64 && wanted.samples * 4 > frames; wanted.samples >>= 1);
+
+	/* No callback: audio gets pushed with SDL_QueueAudio(). Anything the
+	   device doesn't support natively is converted by SDL. */
+	sdl->device = SDL_OpenAudioDevice(ao->device, 0, &wanted, &obtained, 0);
+	if(sdl->device == 0)
+	{
+		error1("Couldn't open SDL audio: %s", SDL_GetError());
+		return -1;
+	}
+
+	sdl->framesize = SDL_AUDIO_BITSIZE(wanted.format) / 8 * ao->channels;
+	sdl->samples = obtained.samples;
+	sdl->limit = (Uint32)frames * sdl->framesize;
+	if(sdl->limit < sdl->samples * sdl->framesize) sdl->limit = sdl->samples * sdl->framesize;
+	sdl->paused = 1;
+	debug3("SDL device buffer of %u frames, %u bytes queued at most, %s driver",
+		(unsigned)obtained.samples, (unsigned)sdl->limit, SDL_GetCurrentAudioDriver());
+
+	return 0;
 }
 
 
 static int get_formats_sdl(audio_output_t *ao)
 {
-	/* Only implemented Signed 16-bit audio for now */
-	return MPG123_ENC_SIGNED_16;
+	return MPG123_ENC_SIGNED_16|MPG123_ENC_UNSIGNED_16|MPG123_ENC_SIGNED_8|MPG123_ENC_UNSIGNED_8
+		|MPG123_ENC_SIGNED_32|MPG123_ENC_FLOAT_32;
 }
 
 
 static int write_sdl(audio_output_t *ao, unsigned char *buf, int len)
 {
-	sfifo_t *fifo = (sfifo_t*)ao->userptr;
-
-	/* Sleep for half the length of the FIFO */
-	while (sfifo_space( fifo ) < len )
-#ifdef WIN32
-		Sleep( (FIFO_DURATION/2) * 1000);
-#else
-		usleep( (FIFO_DURATION/2) * 1000000 );
-#endif
-	
-	/* Bung decoded audio into the FIFO 
-		 SDL Audio locking probably isn't actually needed
-		 as SFIFO claims to be thread safe...
-	*/
-	SDL_LockAudio();
-	sfifo_write( fifo, buf, len);
-	SDL_UnlockAudio();
-	
-	
-	/* Unpause once the buffer is 50% full */
-	if (sfifo_used(fifo) > (sfifo_size(fifo)*0.5) ) SDL_PauseAudio(0);
+	mpg123_sdl_t *sdl = (mpg123_sdl_t*)ao->userptr;
+	Uint32 queued;
+
+	/* Wait for the device to make room. */
+	while((queued = SDL_GetQueuedAudioSize(sdl->device)) > 0 && queued + len > sdl->limit)
+	{
+		play_sdl(sdl);
+		wait_sdl(ao, queued + len - sdl->limit);
+		if(SDL_GetAudioDeviceStatus(sdl->device) == SDL_AUDIO_STOPPED)
+		{
+			error("SDL audio device went away");
+			return -1;
+		}
+	}
+
+	if(SDL_QueueAudio(sdl->device, buf, len) != 0)
+	{
+		error1("Couldn't queue SDL audio: %s", SDL_GetError());
+		return -1;
+	}
+
+	/* Start with the first write, and again after a flush: a short clip may
+	   never fill much of the queue, and callers that pace themselves by the
+	   delay keep it at a period or two, waiting for it to drop. */
+	play_sdl(sdl);
 
 	return len;
 }
 
+static int delay_sdl(audio_output_t *ao)
+{
+	mpg123_sdl_t *sdl = (mpg123_sdl_t*)ao->userptr;
+
+	return sdl->device ? (int)(SDL_GetQueuedAudioSize(sdl->device) / sdl->framesize) : -1;
+}
+
 static int close_sdl(audio_output_t *ao)
 {
-	sfifo_t *fifo = (sfifo_t*)ao->userptr;
+	mpg123_sdl_t *sdl = (mpg123_sdl_t*)ao->userptr;
+	Uint32 queued;
 
-	SDL_CloseAudio();
-	
-	/* Free up the memory used by the FIFO */
-	sfifo_close( fifo );
+	if(sdl->device == 0) return 0;
+
+	/* Play out the queue, and what SDL already took from it. */
+	if(SDL_GetQueuedAudioSize(sdl->device) > 0) play_sdl(sdl);
+	while(!sdl->paused && (queued = SDL_GetQueuedAudioSize(sdl->device)) > 0)
+	{
+		if(SDL_GetAudioDeviceStatus(sdl->device) == SDL_AUDIO_STOPPED) break;
+		wait_sdl(ao, queued);
+	}
+	if(!sdl->paused) wait_sdl(ao, sdl->samples * sdl->framesize);
+
+	SDL_CloseAudioDevice(sdl->device);
+	sdl->device = 0;
 	
 	return 0;
 }
 
 static void flush_sdl(audio_output_t *ao)
 {
-	sfifo_t *fifo = (sfifo_t*)ao->userptr;
+	mpg123_sdl_t *sdl = (mpg123_sdl_t*)ao->userptr;
 
-	SDL_PauseAudio(1);
-	
-	sfifo_flush( fifo );	
+	if(sdl->device == 0) return;
+	SDL_PauseAudioDevice(sdl->device, 1);
+	sdl->paused = 1;
+	SDL_ClearQueuedAudio(sdl->device);
 }
 
 
@@ -153,8 +200,8 @@ static int deinit_sdl(audio_output_t* ao)
 		ao->userptr = NULL;
 	}
 
-	/* Shut down SDL */
-	SDL_Quit();
+	/* Shut down SDL's audio */
+	SDL_QuitSubSystem(SDL_INIT_AUDIO);
 
 	/* Success */
 	return 0;
@@ -172,18 +219,20 @@ static int init_sdl(audio_output_t* ao)
 	ao->get_formats = get_formats_sdl;
 	ao->close = close_sdl;
 	ao->deinit = deinit_sdl;
+	ao->delay = delay_sdl;
 	
 	/* Allocate memory */
-	ao->userptr = malloc( sizeof(sfifo_t) );
+	ao->userptr = malloc( sizeof(mpg123_sdl_t) );
 	if (ao->userptr==NULL) {
-		error( "Failed to allocated memory for FIFO structure" );
+		error( "Failed to allocate memory for 'mpg123_sdl_t'" );
 		return -1;
 	}
-	memset( ao->userptr, 0, sizeof(sfifo_t) );
+	memset( ao->userptr, 0, sizeof(mpg123_sdl_t) );
 
-	/* Initialise SDL */
-	if (SDL_Init( SDL_INIT_AUDIO ) ) {
-		error1("Failed to initialise SDL: %s\n", SDL_GetError());
+	/* Initialise SDL's audio, which leaves the rest of SDL to the
+	   application */
+	if (SDL_InitSubSystem( SDL_INIT_AUDIO ) ) {
+		error1("Failed to initialise SDL: %s", SDL_GetError());
 		return -1;
 	}
 
@@ -198,7 +247,7 @@ static int init_sdl(audio_output_t* ao)
 mpg123_module_t mpg123_output_module_info = {
 	/* api_version */	MPG123_MODULE_API_VERSION,
 	/* name */			"sdl",
-	/* description */	"Output audio using SDL (Simple DirectMedia Layer).",
+	/* description */	"Output audio using SDL 2 (Simple DirectMedia Layer).",
 	/* revision */		"$Rev:$",
 	/* handle */		NULL,
 	
@@ -18,6 +18,7 @@
 #include <sys/uio.h>
 #include <sys/mman.h>
 #include <sys/socket.h>
+#include <sys/stat.h>
 #include <fcntl.h>
 
 #ifndef HAVE_MMAP
@@ -80,13 +81,83 @@ void xfermem_init (txfermem **xf, size_t bufsize, size_t msize, size_t skipbuf)
 	}
 	(*xf)->freeindex = (*xf)->readindex = 0;
 	(*xf)->wakeme[0] = (*xf)->wakeme[1] = FALSE;
-	(*xf)->data = ((byte *) *xf) + sizeof(txfermem) + msize;
-	(*xf)->metadata = ((byte *) *xf) + sizeof(txfermem);
+	(*xf)->dataoffset = sizeof(txfermem) + msize;
+	(*xf)->metaoffset = sizeof(txfermem);
 	(*xf)->size = bufsize;
 	(*xf)->metasize = msize + skipbuf;
 	(*xf)->justwait = 0;
 }
 
+#ifdef HAVE_MMAP
+int xfermem_init_shared (txfermem **xf, size_t bufsize, int *memfd)
+{
+	static unsigned int counter = 0;
+	size_t regsize = bufsize + sizeof(txfermem);
+	char name[64];
+	int fd;
+
+	/* A named object only for as long as it takes to open it. */
+	snprintf(name, sizeof(name), "/xfermem-%ld-%u", (long) getpid(), counter++);
+	if ((fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600)) == -1)
+		return -1;
+	shm_unlink(name);
+	fcntl(fd, F_SETFD, FD_CLOEXEC);
+
+	if (ftruncate(fd, regsize) == -1) {
+		close(fd);
+		return -1;
+	}
+	if ((*xf = (txfermem *) mmap(0, regsize, PROT_READ | PROT_WRITE,
+			MAP_SHARED, fd, 0)) == (txfermem *) -1) {
+		close(fd);
+		return -1;
+	}
+	if (socketpair(AF_UNIX, SOCK_STREAM, 0, (*xf)->fd) < 0) {
+		munmap((void *) *xf, regsize);
+		close(fd);
+		return -1;
+	}
+	fcntl((*xf)->fd[XF_WRITER], F_SETFD, FD_CLOEXEC);
+	fcntl((*xf)->fd[XF_READER], F_SETFD, FD_CLOEXEC);
+
+	(*xf)->freeindex = (*xf)->readindex = 0;
+	(*xf)->wakeme[0] = (*xf)->wakeme[1] = FALSE;
+	(*xf)->dataoffset = sizeof(txfermem);
+	(*xf)->metaoffset = sizeof(txfermem);
+	(*xf)->size = bufsize;
+	(*xf)->metasize = 0;
+	(*xf)->justwait = 0;
+	*memfd = fd;
+	return 0;
+}
+
+int xfermem_attach (txfermem **xf, int memfd)
+{
+	struct stat st;
+
+	if (fstat(memfd, &st) == -1 || (size_t) st.st_size < sizeof(txfermem))
+		return -1;
+	if ((*xf = (txfermem *) mmap(0, st.st_size, PROT_READ | PROT_WRITE,
+			MAP_SHARED, memfd, 0)) == (txfermem *) -1)
+		return -1;
+	if ((size_t) st.st_size != (*xf)->size + (*xf)->metasize + sizeof(txfermem)) {
+		munmap((void *) *xf, st.st_size);
+		return -1;
+	}
+	return 0;
+}
+#else
+int xfermem_init_shared (txfermem **xf, size_t bufsize, int *memfd)
+{
+	return -1;
+}
+
+int xfermem_attach (txfermem **xf, int memfd)
+{
+	return -1;
+}
+#endif
+
 void xfermem_done (txfermem *xf)
 {
 	if(!xf)
@@ -120,9 +191,8 @@ size_t xfermem_get_freespace (txfermem *xf)
 	if(!xf)
 		return 0;
 
-	if ((freeindex = xf->freeindex) < 0
-			|| (readindex = xf->readindex) < 0)
-		return (0);
+	freeindex = xf->freeindex;
+	readindex = xf->readindex;
 	if (readindex > freeindex)
 		return ((readindex - freeindex) - 1);
 	else
@@ -136,9 +206,8 @@ size_t xfermem_get_usedspace (txfermem *xf)
 	if(!xf)
 		return 0;
 
-	if ((freeindex = xf->freeindex) < 0
-			|| (readindex = xf->readindex) < 0)
-		return (0);
+	freeindex = xf->freeindex;
+	readindex = xf->readindex;
 	if (freeindex >= readindex)
 		return (freeindex - readindex);
 	else
@@ -252,16 +321,18 @@ int xfermem_write(txfermem *xf, byte *buffer, size_t bytes)
 	/* Now we have enough space. copy the memory, possibly with the wrap. */
 	if(xf->size - xf->freeindex >= bytes)
 	{	/* one block of free memory */
-		memcpy(xf->data+xf->freeindex, buffer, bytes);
+		memcpy(xfermem_data(xf)+xf->freeindex, buffer, bytes);
 	}
 	else
 	{ /* two blocks */
 		size_t endblock = xf->size - xf->freeindex;
-		memcpy(xf->data+xf->freeindex, buffer, endblock);
-		memcpy(xf->data, buffer + endblock, bytes-endblock);
+		memcpy(xfermem_data(xf)+xf->freeindex, buffer, endblock);
+		memcpy(xfermem_data(xf), buffer + endblock, bytes-endblock);
 	}
 	/* Advance the free space pointer, including the wrap. */
+	xfermem_barrier();
 	xf->freeindex = (xf->freeindex + bytes) % xf->size;
+	xfermem_barrier();
 	/* Wake up the buffer process if necessary. */
 	debug("write waking");
 	if(xf->wakeme[XF_READER])
@@ -295,6 +366,14 @@ size_t xfermem_get_usedspace (txfermem *xf)
 {
   return 0;
 }
+int xfermem_init_shared (txfermem **xf, size_t bufsize, int *memfd)
+{
+  return -1;
+}
+int xfermem_attach (txfermem **xf, int memfd)
+{
+  return -1;
+}
 int xfermem_write(txfermem *xf, byte *buffer, size_t bytes)
 {
 	return FALSE;
@@ -30,8 +30,8 @@ typedef struct {
 	size_t readindex;	/* [R] next index to read */
 	int fd[2];
 	int wakeme[2];
-	byte *data;
-	byte *metadata;
+	size_t dataoffset;	/* the buffers, relative to the start of this struct */
+	size_t metaoffset;
 	size_t size;
 	size_t metasize;
 	long rate;
@@ -43,9 +43,36 @@ typedef struct {
  *   [W] -- May be written to by the writing process only!
  *   [R] -- May be written to by the reading process only!
  *   All other entries are initialized once.
+ *
+ *   The struct lives at the start of the shared memory itself, which
+ *   is why it only holds offsets: a reader that was exec()ed after the
+ *   fork maps the memory at some other address.
  */
+#define xfermem_data(xf)     ((byte *) (xf) + (xf)->dataoffset)
+#define xfermem_metadata(xf) ((byte *) (xf) + (xf)->metaoffset)
+
+/* The indices are handed between two processes, make sure that the data they
+   cover is visible before they are. */
+#if defined(__GNUC__)
+#define xfermem_barrier() __sync_synchronize()
+#else
+#define xfermem_barrier()
+#endif
 
 void xfermem_init (txfermem **xf, size_t bufsize, size_t msize, size_t skipbuf);
+/*
+ * Like xfermem_init(), but the memory is backed by a file descriptor that
+ * can be handed to a process that doesn't share the mapping through fork(),
+ * and failure is returned (-1) rather than exiting. The socket descriptors
+ * and *memfd are close-on-exec.
+ */
+int xfermem_init_shared (txfermem **xf, size_t bufsize, int *memfd);
+/*
+ * Maps memory set up by xfermem_init_shared() from its descriptor, in the
+ * reader process. The descriptors in fd[] are the writer's, the reader has
+ * to use its own copy of fd[XF_READER] instead.
+ */
+int xfermem_attach (txfermem **xf, int memfd);
 void xfermem_init_writer (txfermem *xf);
 void xfermem_init_reader (txfermem *xf);
 
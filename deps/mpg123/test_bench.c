@@ -0,0 +1,114 @@
+/*
+  Checks the bench output module: that it takes every encoding, that its
+  simulated device holds writes back to real time, and that it counts the
+  underruns it was told to inject.
+*/
+#include <stdio.h>
+#include <string.h>
+
+#include "src/output/bench.c"
+
+#define RATE 44100
+#define CHUNK 4096      /* bytes, 1024 frames of 16 bit stereo */
+
+static int open_bench_test(audio_output_t *ao, int format, char *device) {
+  memset(ao, 0, sizeof(audio_output_t));
+  ao->channels = 2;
+  ao->rate = RATE;
+  ao->format = format;
+  ao->device = device;
+  if (mpg123_output_module_info.init_output(ao) != 0) return -1;
+  return ao->open(ao);
+}
+
+/* writes `chunks` chunks, and returns how long that took in seconds */
+static double write_bench_test(audio_output_t *ao, int chunks) {
+  unsigned char buf[CHUNK];
+  double begin = now_bench();
+  int i;
+
+  memset(buf, 0, sizeof(buf));
+  for (i = 0; i < chunks; i++) {
+    if (ao->write(ao, buf, CHUNK) != CHUNK) return -1;
+  }
+  return now_bench() - begin;
+}
+
+int main () {
+  static const int encodings[] = {
+    MPG123_ENC_SIGNED_16, MPG123_ENC_UNSIGNED_16, MPG123_ENC_UNSIGNED_8,
+    MPG123_ENC_SIGNED_8, MPG123_ENC_ULAW_8, MPG123_ENC_ALAW_8,
+    MPG123_ENC_SIGNED_32, MPG123_ENC_UNSIGNED_32, MPG123_ENC_SIGNED_24,
+    MPG123_ENC_UNSIGNED_24, MPG123_ENC_FLOAT_32, MPG123_ENC_FLOAT_64
+  };
+  static const int sizes[] = { 4, 4, 2, 2, 2, 2, 8, 8, 6, 6, 8, 16 };
+  audio_output_t ao;
+  mpg123_bench_t *bn;
+  double took;
+  long total;
+  int i, failed = 0;
+
+  /* every encoding, with the right frame size */
+  for (i = 0; i < (int) (sizeof(encodings) / sizeof(encodings[0])); i++) {
+    if (open_bench_test(&ao, encodings[i], NULL) != 0 ||
+        (ao.get_formats(&ao) & encodings[i]) != encodings[i] ||
+        ((mpg123_bench_t*) ao.userptr)->framesize != sizes[i]) {
+      printf("encoding 0x%x not supported\n", encodings[i]);
+      failed = 1;
+    }
+    ao.close(&ao);
+    ao.deinit(&ao);
+  }
+
+  /* nonsensical options don't open */
+  if (open_bench_test(&ao, MPG123_ENC_SIGNED_16, "realtime,buffer=5,period=10") == 0) {
+    printf("bad options were accepted\n");
+    failed = 1;
+  }
+  ao.deinit(&ao);
+
+  /* without "realtime", as fast as it gets, with every write in the histogram */
+  open_bench_test(&ao, MPG123_ENC_SIGNED_16, NULL);
+  took = write_bench_test(&ao, 1000);
+  bn = (mpg123_bench_t*) ao.userptr;
+  for (total = 0, i = 0; i < BENCH_BUCKETS; i++) total += bn->histogram[i];
+  if (took < 0 || took > 0.1 || bn->writes != 1000 || total != 1000 || bn->bytes != 1000L * CHUNK) {
+    printf("%ld writes (%ld in the histogram) took %.3f s\n", bn->writes, total, took);
+    failed = 1;
+  }
+  ao.close(&ao);
+  ao.deinit(&ao);
+
+  /* half a second's worth against a 50 ms buffer: the writes return once
+     all but the buffer has been played, and close() plays out the rest */
+  open_bench_test(&ao, MPG123_ENC_SIGNED_16, "realtime,buffer=50,period=10");
+  took = write_bench_test(&ao, 22);
+  bn = (mpg123_bench_t*) ao.userptr;
+  if (took < 0.45 || took > 0.55 || ao.delay(&ao) > RATE / 20 || bn->underruns != 0) {
+    printf("writing 22528 frames took %.3f s, %d left, %ld underruns\n", took, ao.delay(&ao), bn->underruns);
+    failed = 1;
+  }
+  took = now_bench();
+  ao.close(&ao);
+  took = now_bench() - took;
+  if (took < 0.02 || took > 0.1) {
+    printf("close() took %.3f s\n", took);
+    failed = 1;
+  }
+  ao.deinit(&ao);
+
+  /* every write stalls for longer than the buffer lasts */
+  open_bench_test(&ao, MPG123_ENC_SIGNED_16, "realtime,buffer=20,period=5,underrun=1");
+  write_bench_test(&ao, 5);
+  ao.delay(&ao);
+  bn = (mpg123_bench_t*) ao.userptr;
+  if (bn->underruns < 4) {
+    printf("%ld underruns for 5 stalled writes\n", bn->underruns);
+    failed = 1;
+  }
+  ao.close(&ao);
+  ao.deinit(&ao);
+
+  printf("%s\n", failed ? "FAIL" : "OK");
+  return failed;
+}
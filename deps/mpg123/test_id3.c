@@ -0,0 +1,194 @@
+/*
+  Checks MPG123_LAZY_ID3 on a file with a big picture in its ID3v2 tag: the
+  title still gets parsed, from a file and when fed, the picture is listed and
+  can be read back, and the MPEG frames after the tag decode as before.
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "mpg123.h"
+
+#define PICTURE_SIZE 300000
+#define MPEG_FRAMES 20
+#define FRAME_SIZE 136
+
+static const char title[] = "Lazy title";
+
+static void put_size(unsigned char *p, unsigned long size, int synchsafe) {
+  int shift = synchsafe ? 7 : 8;
+  int i;
+  for (i = 3; i >= 0; i--) {
+    p[i] = (unsigned char) (size & (synchsafe ? 0x7f : 0xff));
+    size >>= shift;
+  }
+}
+
+/* An ID3v2.3 tag with TIT2 and APIC frames and some padding, followed by
+ * silent Layer I frames. */
+static unsigned char *make_file(size_t *size, unsigned char **picture, unsigned long *picture_offset) {
+  size_t title_size = 1 + strlen(title);
+  size_t tag_size = 10 + title_size + 10 + PICTURE_SIZE + 64;
+  unsigned char *data = calloc(1, 10 + tag_size + MPEG_FRAMES * FRAME_SIZE);
+  unsigned char *p = data;
+  size_t i;
+
+  memcpy(p, "ID3\3\0\0", 6);
+  put_size(p + 6, tag_size, 1);
+  p += 10;
+
+  memcpy(p, "TIT2", 4);
+  put_size(p + 4, title_size, 0);
+  p += 10;
+  p[0] = 0; /* latin1 */
+  memcpy(p + 1, title, strlen(title));
+  p += title_size;
+
+  memcpy(p, "APIC", 4);
+  put_size(p + 4, PICTURE_SIZE, 0);
+  p += 10;
+  *picture = p;
+  *picture_offset = (unsigned long) (p - data);
+  for (i = 0; i < PICTURE_SIZE; i++) p[i] = (unsigned char) (i * 7);
+  p += PICTURE_SIZE + 64;
+
+  for (i = 0; i < MPEG_FRAMES; i++, p += FRAME_SIZE) {
+    p[0] = 0xff;
+    p[1] = 0xff;
+    p[2] = 0x40;
+  }
+  *size = p - data;
+  return data;
+}
+
+static int check_title(mpg123_handle *mh, const char *what) {
+  mpg123_id3v1 *v1;
+  mpg123_id3v2 *v2;
+  if (mpg123_id3(mh, &v1, &v2) != MPG123_OK || !v2 || !v2->title || strcmp(v2->title->p, title)) {
+    printf("%s: the title didn't get parsed\n", what);
+    return 1;
+  }
+  return 0;
+}
+
+/* Decodes all frames, returning how many there were. */
+static int decode_all(mpg123_handle *mh) {
+  unsigned char *audio;
+  size_t bytes;
+  off_t num;
+  int frames = 0;
+  int ret;
+  while ((ret = mpg123_decode_frame(mh, &num, &audio, &bytes)) == MPG123_OK || ret == MPG123_NEW_FORMAT) {
+    if (ret == MPG123_OK) frames++;
+  }
+  return frames;
+}
+
+static int check_file(const char *path, const unsigned char *picture, unsigned long picture_offset, int lazy) {
+  const char *what = lazy ? "lazy" : "eager";
+  mpg123_handle *mh = mpg123_new(NULL, NULL);
+  mpg123_id3frame *frames;
+  size_t count;
+  unsigned char *data;
+  size_t size;
+  int failed = 0;
+
+  mpg123_param(mh, MPG123_ADD_FLAGS, MPG123_QUIET | (lazy ? MPG123_LAZY_ID3 : 0), 0);
+  if (mpg123_open(mh, path) != MPG123_OK) {
+    printf("%s: can't open %s\n", what, path);
+    mpg123_delete(mh);
+    return 1;
+  }
+  if (decode_all(mh) != MPEG_FRAMES) {
+    printf("%s: not all MPEG frames decoded\n", what);
+    failed = 1;
+  }
+  failed |= check_title(mh, what);
+
+  mpg123_id3_frames(mh, &frames, &count);
+  if (!lazy) {
+    if (count != 0) {
+      printf("eager: frames got listed\n");
+      failed = 1;
+    }
+  } else if (count != 2 || strcmp(frames[0].id, "TIT2") || frames[0].skipped
+             || strcmp(frames[1].id, "APIC") || !frames[1].skipped
+             || frames[1].offset != picture_offset || frames[1].size != PICTURE_SIZE) {
+    printf("lazy: the frame list is wrong\n");
+    failed = 1;
+  } else if (mpg123_id3_frame(mh, 1, &data, &size) != MPG123_OK
+             || size != PICTURE_SIZE || memcmp(data, picture, PICTURE_SIZE)) {
+    printf("lazy: the picture doesn't read back\n");
+    failed = 1;
+  } else if (mpg123_id3_frame(mh, 2, &data, &size) != MPG123_ERR) {
+    printf("lazy: a frame past the list reads\n");
+    failed = 1;
+  }
+
+  mpg123_close(mh);
+  mpg123_delete(mh);
+  return failed;
+}
+
+/* Feeds in small chunks, so that the tag is read over and again until it's
+ * all there. */
+static int check_feed(const unsigned char *file, size_t file_size) {
+  mpg123_handle *mh = mpg123_new(NULL, NULL);
+  mpg123_id3frame *frames;
+  unsigned char *data;
+  size_t count;
+  size_t size;
+  size_t fed;
+  int frames_decoded = 0;
+  int failed = 0;
+
+  mpg123_param(mh, MPG123_ADD_FLAGS, MPG123_QUIET | MPG123_LAZY_ID3, 0);
+  mpg123_open_feed(mh);
+  for (fed = 0; fed < file_size; fed += 4096) {
+    size_t chunk = file_size - fed < 4096 ? file_size - fed : 4096;
+    mpg123_feed(mh, file + fed, chunk);
+    frames_decoded += decode_all(mh);
+  }
+  if (frames_decoded != MPEG_FRAMES) {
+    printf("feed: %d MPEG frames decoded out of %d\n", frames_decoded, MPEG_FRAMES);
+    failed = 1;
+  }
+  failed |= check_title(mh, "feed");
+  mpg123_id3_frames(mh, &frames, &count);
+  if (count != 2 || !frames[1].skipped) {
+    printf("feed: the frame list is wrong\n");
+    failed = 1;
+  } else if (mpg123_id3_frame(mh, 1, &data, &size) != MPG123_ERR || mpg123_errcode(mh) != MPG123_NO_SEEK) {
+    printf("feed: a frame reads back without seeking\n");
+    failed = 1;
+  }
+
+  mpg123_delete(mh);
+  return failed;
+}
+
+int main () {
+  char path[] = "id3_test.mp1";
+  unsigned char *picture;
+  unsigned long picture_offset;
+  size_t size;
+  unsigned char *file = make_file(&size, &picture, &picture_offset);
+  FILE *f = fopen(path, "wb");
+  int failed = 0;
+
+  if (!f || fwrite(file, 1, size, f) != size) {
+    printf("can't write %s\n", path);
+    return 1;
+  }
+  fclose(f);
+
+  mpg123_init();
+  failed |= check_file(path, picture, picture_offset, 0);
+  failed |= check_file(path, picture, picture_offset, 1);
+  failed |= check_feed(file, size);
+  mpg123_exit();
+
+  remove(path);
+  free(file);
+  printf("%s\n", failed ? "FAIL" : "OK");
+  return failed;
+}
@@ -0,0 +1,97 @@
+/*
+  Checks that the vectorised Layer III stages produce bit-identical output to
+  the generic C code they replace, on random input.
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "mpg123lib_intern.h"
+
+#define TRIALS 200
+
+static real random_real(void) {
+  return (real) ((rand() / (double) RAND_MAX) * 2.0 - 1.0);
+}
+
+static void fill(real *buf, size_t n) {
+  size_t i;
+  for (i = 0; i < n; i++) buf[i] = random_real();
+}
+
+#ifdef OPT_LAYER3_SIMD
+/* Both IMDCTs, the generic one sub-band at a time like III_hybrid() does. */
+static int check_hybrid(int short_blocks, size_t count) {
+  real in[2][SBLIMIT * SSLIMIT];
+  real o1[SBLIMIT * SSLIMIT];
+  real o2[2][SBLIMIT * SSLIMIT];
+  real ts[2][SSLIMIT * SBLIMIT];
+  real win[36], win1[36];
+  size_t sb;
+
+  fill(in[0], SBLIMIT * SSLIMIT);
+  memcpy(in[1], in[0], sizeof(in[0]));
+  fill(o1, SBLIMIT * SSLIMIT);
+  fill(win, 36);
+  fill(win1, 36);
+  memset(o2, 0, sizeof(o2));
+  memset(ts, 0, sizeof(ts));
+
+  for (sb = 0; sb < count; sb++) {
+    real *w = (sb & 1) ? win1 : win;
+    if (short_blocks) {
+      dct12(in[0] + sb * 18, o1 + sb * 18, o2[0] + sb * 18, w, ts[0] + sb);
+    } else {
+      dct36(in[0] + sb * 18, o1 + sb * 18, o2[0] + sb * 18, w, ts[0] + sb);
+    }
+  }
+  if (short_blocks) {
+    dct12_simd(in[1], o1, o2[1], win, win1, ts[1], count);
+  } else {
+    dct36_simd(in[1], o1, o2[1], win, win1, ts[1], count);
+  }
+
+  if (memcmp(o2[0], o2[1], sizeof(o2[0])) || memcmp(ts[0], ts[1], sizeof(ts[0]))) {
+    printf("%s with %d sub-bands differs from the generic code\n", short_blocks ? "dct12_simd" : "dct36_simd", (int) count);
+    return 1;
+  }
+  return 0;
+}
+
+static int check_antialias(int sblim) {
+  real xr[2][SBLIMIT * SSLIMIT];
+
+  fill(xr[0], SBLIMIT * SSLIMIT);
+  memcpy(xr[1], xr[0], sizeof(xr[0]));
+  antialias(xr[0] + SSLIMIT, sblim);
+  antialias_simd(xr[1] + SSLIMIT, sblim);
+
+  if (memcmp(xr[0], xr[1], sizeof(xr[0]))) {
+    printf("antialias_simd with %d sub-band pairs differs from the generic code\n", sblim);
+    return 1;
+  }
+  return 0;
+}
+#endif
+
+int main () {
+  int failed = 0;
+#ifdef OPT_LAYER3_SIMD
+  int trial;
+
+  /* fills in the tables */
+  mpg123_init();
+  srand(1);
+
+  for (trial = 0; trial < TRIALS; trial++) {
+    size_t count = 2 * (1 + trial % 16);
+    failed |= check_hybrid(0, count);
+    failed |= check_hybrid(1, count);
+    failed |= check_antialias(1 + trial % 31);
+  }
+  printf("%s\n", failed ? "FAIL" : "OK");
+  mpg123_exit();
+#else
+  printf("no vectorised Layer III code in this build, nothing to check\n");
+#endif
+  return failed;
+}
@@ -0,0 +1,163 @@
+/*
+  Checks the OSS output module against a fake device: a FIFO stands in for
+  /dev/dsp, and oss_test_ioctl() answers the ioctls, reporting what is left in
+  the FIFO as the output delay.
+*/
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+/* the module under test, with its ioctls redirected */
+#define ioctl oss_test_ioctl
+int oss_test_ioctl(int fd, unsigned long request, ...);
+#include "src/output/oss.c"
+#undef ioctl
+
+#define LATENCY 20000 /* us */
+#define CHUNK 4096
+#define CHUNKS 64     /* several times what the FIFO holds */
+
+static int fifo = -1;
+static int fragment = 0;
+static int synced = 0;
+
+int oss_test_ioctl(int fd, unsigned long request, ...) {
+  va_list ap;
+  int *arg;
+
+  va_start(ap, request);
+  arg = va_arg(ap, int *);
+  va_end(ap);
+
+  if (request == SNDCTL_DSP_SETFRAGMENT) {
+    fragment = *arg;
+    return 0;
+  }
+  if (request == SNDCTL_DSP_GETODELAY) return ioctl(fifo, FIONREAD, arg);
+  if (request == SNDCTL_DSP_SYNC) {
+    synced = 1;
+    return 0;
+  }
+  if (request == SNDCTL_DSP_RESET || request == SNDCTL_DSP_SETFMT ||
+      request == SNDCTL_DSP_STEREO || request == SNDCTL_DSP_SPEED) {
+    return 0;
+  }
+  errno = ENOTTY;
+  return -1;
+}
+
+static unsigned char pattern(size_t i) {
+  return (unsigned char) (i * 7 + (i >> 8));
+}
+
+static size_t received = 0;
+static int corrupt = 0;
+
+/* drains the FIFO slowly, so that the writer has to wait for it */
+static void *reader(void *arg) {
+  unsigned char buf[1024];
+  ssize_t n, i;
+
+  while ((n = read(fifo, buf, sizeof(buf))) > 0) {
+    for (i = 0; i < n; i++) {
+      if (buf[i] != pattern(received + i)) corrupt = 1;
+    }
+    received += n;
+    usleep(200);
+  }
+  return NULL;
+}
+
+static int fill_and_write(audio_output_t *ao, size_t *sent) {
+  unsigned char buf[CHUNK];
+  size_t i;
+
+  for (i = 0; i < CHUNK; i++) buf[i] = pattern(*sent + i);
+  *sent += CHUNK;
+  return ao->write(ao, buf, CHUNK);
+}
+
+int main () {
+  char path[64];
+  audio_output_t ao;
+  pthread_t thread;
+  size_t sent = 0;
+  long bytes, size;
+  int i, written, delay, failed = 0;
+
+  snprintf(path, sizeof(path), "/tmp/mpg123-oss-test-%ld", (long) getpid());
+  if (mkfifo(path, 0600) != 0) {
+    perror("mkfifo");
+    return 1;
+  }
+  /* a writer can only open a FIFO without blocking once it has a reader */
+  fifo = open(path, O_RDONLY | O_NONBLOCK);
+  fcntl(fifo, F_SETFL, fcntl(fifo, F_GETFL) & ~O_NONBLOCK);
+
+  memset(&ao, 0, sizeof(audio_output_t));
+  ao.channels = 2;
+  ao.rate = 44100;
+  ao.format = MPG123_ENC_SIGNED_16;
+  ao.gain = -1;
+  ao.latency = LATENCY;
+  ao.device = path;
+  if (mpg123_output_module_info.init_output(&ao) != 0 || ao.open(&ao) < 0) {
+    printf("failed to open the fake device\n");
+    unlink(path);
+    return 1;
+  }
+  unlink(path);
+
+  if (!(fcntl(ao.fn, F_GETFL) & O_NONBLOCK)) {
+    printf("device is not opened non-blocking\n");
+    failed = 1;
+  }
+
+  /* the fragments add up to somewhere between the latency and twice that */
+  bytes = (long) LATENCY * ao.rate / 1000000 * 4;
+  size = (long) (fragment >> 16) << (fragment & 0xffff);
+  if ((fragment >> 16) < 2 || size < bytes || size >= 2 * bytes) {
+    printf("fragments of %d x %d bytes for %ld bytes of latency\n", fragment >> 16, 1 << (fragment & 0xffff), bytes);
+    failed = 1;
+  }
+
+  /* nothing reads yet, so all of it is still queued */
+  written = fill_and_write(&ao, &sent);
+  if (written != CHUNK) {
+    printf("write returned %d\n", written);
+    failed = 1;
+  } else if ((delay = ao.delay(&ao)) != CHUNK / 4) {
+    printf("delay of %d frames after writing %d\n", delay, CHUNK / 4);
+    failed = 1;
+  }
+
+  pthread_create(&thread, NULL, reader, NULL);
+  for (i = 0; i < CHUNKS; i++) {
+    written = fill_and_write(&ao, &sent);
+    if (written != CHUNK) {
+      printf("write returned %d\n", written);
+      failed = 1;
+      break;
+    }
+  }
+  ao.close(&ao);
+  pthread_join(thread, NULL);
+
+  if (!synced) {
+    printf("close didn't drain the device\n");
+    failed = 1;
+  }
+  if (received != sent || corrupt) {
+    printf("device got %ld of %ld bytes%s\n", (long) received, (long) sent, corrupt ? ", corrupted" : "");
+    failed = 1;
+  }
+
+  printf("%s\n", failed ? "FAIL" : "OK");
+  return failed;
+}
@@ -0,0 +1,94 @@
+/*
+  Checks the SDL output module without a sound card: SDL's dummy driver
+  consumes the queue at the rate of the audio, like a real device would.
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* the module under test */
+#include "src/output/sdl.c"
+
+#define LATENCY 20000 /* us */
+#define CHUNK 1024
+#define CHUNKS 200    /* over a second of audio */
+
+int main () {
+  unsigned char buf[CHUNK];
+  audio_output_t ao;
+  const char *driver;
+  long limit;
+  int i, written, delay, most = 0, failed = 0;
+
+  setenv("SDL_AUDIODRIVER", "dummy", 1);
+
+  memset(&ao, 0, sizeof(audio_output_t));
+  ao.channels = 2;
+  ao.rate = 44100;
+  ao.format = MPG123_ENC_SIGNED_16;
+  ao.gain = -1;
+  ao.latency = LATENCY;
+  if (mpg123_output_module_info.init_output(&ao) != 0 || ao.open(&ao) < 0) {
+    printf("failed to open the dummy device\n");
+    return 1;
+  }
+
+  driver = SDL_GetCurrentAudioDriver();
+  if (driver == NULL || strcmp(driver, "dummy") != 0) {
+    printf("opened the %s driver\n", driver ? driver : "(no)");
+    failed = 1;
+  }
+
+  /* the device starts with the first write, however little it is */
+  memset(buf, 0, sizeof(buf));
+  written = ao.write(&ao, buf, CHUNK);
+  if (written != CHUNK) {
+    printf("write returned %d\n", written);
+    failed = 1;
+  } else if ((delay = ao.delay(&ao)) > CHUNK / 4) {
+    printf("delay of %d frames after writing %d\n", delay, CHUNK / 4);
+    failed = 1;
+  } else if (SDL_GetAudioDeviceStatus(((mpg123_sdl_t *) ao.userptr)->device) != SDL_AUDIO_PLAYING) {
+    printf("not playing after the first write\n");
+    failed = 1;
+  }
+
+  /* once it plays, writes wait for room instead of queueing up more than the
+     latency asked for, or the device buffer if that is longer */
+  limit = (long) ((mpg123_sdl_t *) ao.userptr)->limit / 4;
+  if (limit < (long) LATENCY * ao.rate / 1000000) {
+    printf("%ld frames may be queued for a latency of %d us\n", limit, LATENCY);
+    failed = 1;
+  }
+  for (i = 0; i < CHUNKS && !failed; i++) {
+    written = ao.write(&ao, buf, CHUNK);
+    if (written != CHUNK) {
+      printf("write returned %d\n", written);
+      failed = 1;
+    }
+    delay = ao.delay(&ao);
+    if (delay > most) most = delay;
+  }
+  if (most > limit + CHUNK / 4) {
+    printf("%d frames queued with room for %ld\n", most, limit);
+    failed = 1;
+  }
+
+  ao.flush(&ao);
+  if ((delay = ao.delay(&ao)) != 0) {
+    printf("delay of %d frames after a flush\n", delay);
+    failed = 1;
+  }
+
+  /* close plays out what is queued */
+  ao.write(&ao, buf, CHUNK);
+  ao.close(&ao);
+  if ((delay = ao.delay(&ao)) != -1) {
+    printf("delay of %d frames after closing\n", delay);
+    failed = 1;
+  }
+  ao.deinit(&ao);
+
+  printf("%s\n", failed ? "FAIL" : "OK");
+  return failed;
+}
@@ -0,0 +1,147 @@
+/*
+  Checks mpg123_toc_store()/mpg123_toc_restore(): a blob stored after a scan
+  gives a fresh handle the scanned length, which the first frame alone
+  doesn't tell for a file of mixed frame sizes, and seeks that land on the same
+  frames and stream positions as on the scanned handle. A blob for another
+  file, or a corrupt one, is refused.
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "mpg123.h"
+
+#define MPEG_FRAMES 3000
+#define SAMPLES_PER_FRAME 384
+
+/* Silent Layer I frames at 64, 128 and 192 kbit/s by turns, so that a frame's
+ * position can't be worked out from its number. */
+static int write_file(const char *path, int frames) {
+  static const int bitrates[] = { 2, 4, 6 };
+  static const int sizes[] = { 68, 136, 208 };
+  unsigned char frame[208];
+  FILE *f = fopen(path, "wb");
+  int i;
+
+  if (!f) return -1;
+  for (i = 0; i < frames; i++) {
+    int k = i % 3;
+    memset(frame, 0, sizeof(frame));
+    frame[0] = 0xff;
+    frame[1] = 0xff;
+    frame[2] = (unsigned char) (bitrates[k] << 4);
+    if (fwrite(frame, 1, sizes[k], f) != (size_t) sizes[k]) {
+      fclose(f);
+      return -1;
+    }
+  }
+  return fclose(f);
+}
+
+static mpg123_handle *open_file(const char *path) {
+  mpg123_handle *mh = mpg123_new(NULL, NULL);
+  mpg123_param(mh, MPG123_ADD_FLAGS, MPG123_QUIET, 0);
+  if (mpg123_open(mh, path) != MPG123_OK) {
+    printf("can't open %s\n", path);
+    mpg123_delete(mh);
+    return NULL;
+  }
+  return mh;
+}
+
+/* Seeks both handles to `sample` and compares where they ended up. */
+static int check_seek(mpg123_handle *scanned, mpg123_handle *restored, off_t sample) {
+  off_t a = mpg123_seek(scanned, sample, SEEK_SET);
+  off_t b = mpg123_seek(restored, sample, SEEK_SET);
+  if (a != sample || b != sample) {
+    printf("seek to %ld: got %ld and %ld\n", (long) sample, (long) a, (long) b);
+    return 1;
+  }
+  if (mpg123_tellframe(scanned) != mpg123_tellframe(restored)
+      || mpg123_tell_stream(scanned) != mpg123_tell_stream(restored)) {
+    printf("seek to %ld: frame %ld at %ld rather than frame %ld at %ld\n", (long) sample,
+           (long) mpg123_tellframe(restored), (long) mpg123_tell_stream(restored),
+           (long) mpg123_tellframe(scanned), (long) mpg123_tell_stream(scanned));
+    return 1;
+  }
+  return 0;
+}
+
+int main () {
+  const char path[] = "toc_test.mp1";
+  const char other[] = "toc_test_other.mp1";
+  mpg123_handle *scanned, *restored;
+  unsigned char *blob;
+  size_t size;
+  off_t estimate, length;
+  int failed = 0;
+  int i;
+
+  if (write_file(path, MPEG_FRAMES) != 0 || write_file(other, MPEG_FRAMES / 2) != 0) {
+    printf("can't write the test files\n");
+    return 1;
+  }
+  mpg123_init();
+
+  scanned = open_file(path);
+  if (!scanned) return 1;
+  estimate = mpg123_length(scanned);
+  if (mpg123_scan(scanned) != MPG123_OK || mpg123_toc_store(scanned, NULL, &size) != MPG123_OK) {
+    printf("can't size the blob: %s\n", mpg123_strerror(scanned));
+    return 1;
+  }
+  blob = malloc(size);
+  if (mpg123_toc_store(scanned, blob, &size) != MPG123_OK) {
+    printf("can't store the blob: %s\n", mpg123_strerror(scanned));
+    return 1;
+  }
+  /* without the scan, the length is guessed from the first frame */
+  length = mpg123_length(scanned);
+  if (length == estimate) {
+    printf("the scan didn't change the length of %ld samples\n", (long) length);
+    failed = 1;
+  }
+
+  restored = open_file(path);
+  if (!restored) return 1;
+  if (mpg123_toc_restore(restored, blob, size) != MPG123_OK) {
+    printf("the blob didn't restore: %s\n", mpg123_strerror(restored));
+    failed = 1;
+  } else if (mpg123_length(restored) != length) {
+    printf("the restored length is %ld samples\n", (long) mpg123_length(restored));
+    failed = 1;
+  } else {
+    /* back and forth across the file, into the middle of frames */
+    for (i = 0; i < 20 && !failed; i++) {
+      off_t sample = (off_t) ((i * 7919L) % MPEG_FRAMES) * SAMPLES_PER_FRAME + i * 13;
+      failed |= check_seek(scanned, restored, sample);
+    }
+  }
+  mpg123_delete(restored);
+
+  /* stale: the same blob for a different file */
+  restored = open_file(other);
+  if (!restored) return 1;
+  if (mpg123_toc_restore(restored, blob, size) != MPG123_ERR || mpg123_errcode(restored) != MPG123_BAD_TOC) {
+    printf("a blob for another file was taken\n");
+    failed = 1;
+  }
+  mpg123_delete(restored);
+
+  /* corrupt: one bit flipped in the index */
+  restored = open_file(path);
+  if (!restored) return 1;
+  blob[size - 8] ^= 1;
+  if (mpg123_toc_restore(restored, blob, size) != MPG123_ERR || mpg123_errcode(restored) != MPG123_BAD_TOC) {
+    printf("a corrupt blob was taken\n");
+    failed = 1;
+  }
+  mpg123_delete(restored);
+
+  mpg123_delete(scanned);
+  mpg123_exit();
+  free(blob);
+  remove(path);
+  remove(other);
+  printf("%s\n", failed ? "FAIL" : "OK");
+  return failed;
+}
@@ -7,6 +7,146 @@ declare namespace Speaker {
         readonly sampleRate?: number;
         readonly lowWaterMark?: number;
         readonly highWaterMark?: number;
+        readonly crossfade?: number;
+        readonly volume?: number;
+        readonly equalizer?: EqualizerBand[];
+        readonly outOfProcess?: boolean;
+        readonly latency?: number;
+        readonly backend?: string;
+        readonly targetLatency?: number;
+        readonly clipBudget?: number;
+    }
+
+    interface EqualizerBand {
+        readonly type: 'peaking' | 'lowshelf' | 'highshelf' | 'lowpass' | 'highpass';
+        readonly frequency: number;
+        readonly gain?: number;
+        readonly q?: number;
+    }
+
+    /**
+     * The writing end of the rings created by `createRing()`.
+     */
+    class RingWriter {
+        constructor(buffer: SharedArrayBuffer);
+
+        readonly buffer: SharedArrayBuffer;
+        readonly frameSize: number;
+        readonly available: number;
+        readonly underruns: number;
+        readonly closed: boolean;
+
+        write(chunk: NodeJS.ArrayBufferView): number;
+        waitForSpace(bytes: number, timeout?: number): boolean;
+    }
+
+    interface Backend {
+        readonly name: string;
+        readonly description: string;
+        readonly formats: number;
+        readonly default: boolean;
+    }
+
+    interface Capability {
+        readonly sampleRate: number;
+        readonly channels: number;
+        readonly formats: number;
+    }
+
+    interface Timing {
+        readonly start: number;
+        readonly error: number;
+        readonly silence: number;
+        readonly trimmed: number;
+    }
+
+    interface Drift {
+        readonly ppm: number;
+        readonly latency: number;
+    }
+
+    interface JitterStats {
+        readonly received: number;
+        readonly played: number;
+        readonly concealed: number;
+        readonly late: number;
+        readonly dropped: number;
+        readonly underruns: number;
+        readonly jitter: number;
+        readonly buffered: number;
+        readonly target: number;
+        readonly depth: number;
+    }
+
+    interface JitterOptions {
+        packetFrames?: number;
+        minDepth?: number;
+        maxDepth?: number;
+    }
+
+    interface ClipFormat {
+        readonly channels?: number;
+        readonly bitDepth?: number;
+        readonly sampleRate?: number;
+        readonly float?: boolean;
+        readonly signed?: boolean;
+    }
+
+    interface ClipOptions {
+        volume?: number;
+    }
+
+    interface ClipStats {
+        readonly clips: number;
+        readonly bytes: number;
+        readonly budget: number;
+        readonly hits: number;
+        readonly misses: number;
+        readonly evicted: number;
+        readonly dropped: number;
+        readonly voices: number;
+    }
+
+    interface StreamOptions {
+        prefetch?: number;
+    }
+
+    interface Station {
+        readonly name: string | null;
+        readonly url: string | null;
+        readonly contentType: string | null;
+        readonly metaint: number;
+    }
+
+    interface Metadata {
+        readonly title: string | null;
+        readonly url: string | null;
+        readonly raw: string;
+    }
+
+    interface Device {
+        readonly backend: string;
+        readonly name: string | null;
+        readonly description: string;
+        readonly capabilities: Capability[] | null;
+    }
+
+    interface Histogram {
+        readonly count: number;
+        readonly mean: number;
+        readonly max: number;
+        readonly p50: number;
+        readonly p90: number;
+        readonly p99: number;
+        readonly p999: number;
+    }
+
+    interface Metrics {
+        readonly queueWait: Histogram;
+        readonly writeTime: Histogram;
+        readonly writeBytes: Histogram;
+        readonly callbackDelay: Histogram;
+        readonly shortWrites: number;
     }
 
     interface Format {
@@ -28,6 +168,18 @@ declare namespace Speaker {
 declare class Speaker extends Writable {
     constructor(opts?: Speaker.Options);
 
+    /**
+     * The linear gain applied to the audio, `1` by default. Changes take effect
+     * mid-stream.
+     */
+    public volume: number;
+
+    /**
+     * The parametric equalizer bands, applied in order before the volume.
+     * Changes take effect mid-stream.
+     */
+    public equalizer: Speaker.EqualizerBand[];
+
     /**
      * Closes the audio backend. Normally this function will be called automatically
      * after the audio backend has finished playing the audio buffer through the
@@ -37,6 +189,123 @@ declare class Speaker extends Writable {
      */
     public close(flush: boolean): string;
 
+    /**
+     * The milliseconds of audio that the device has taken but not played yet,
+     * or `null` if the backend can't tell.
+     */
+    public delay(): number | null;
+
+    /**
+     * Histograms of this speaker's native write path, or `null` if it was
+     * never opened.
+     */
+    public metrics(): Speaker.Metrics | null;
+
+    /**
+     * Histograms of the native write path of all speakers together.
+     */
+    public static metrics(): Speaker.Metrics;
+
+    /**
+     * The resampling correction and the latency it steers by, with the
+     * `targetLatency` option, or `null`.
+     */
+    public drift(): Speaker.Drift | null;
+
+    /**
+     * Writes a chunk that is to start playing at `time`, in milliseconds on
+     * the `Speaker.now()` clock, padding it with silence or trimming its start.
+     *
+     * @param chunk PCM audio in this Speaker's format
+     * @param time when to start playing it
+     * @param callback called with how the timing went
+     */
+    public writeAt(chunk: NodeJS.ArrayBufferView, time: number, callback?: (err: Error | null, timing: Speaker.Timing | null) => void): boolean;
+
+    /**
+     * The clock `writeAt()` times are on, in milliseconds.
+     */
+    public static now(): number;
+
+    /**
+     * Queues an MPEG audio file to be decoded and played natively, gaplessly
+     * following any other queued files.
+     *
+     * @param path path of the file to play
+     */
+    public enqueue(path: string): this;
+
+    /**
+     * Opens the output device and plays from a ring in shared memory on a
+     * native thread, which a `Speaker.RingWriter` in any thread writes into.
+     *
+     * @param frames how many frames the ring holds, a quarter of a second's worth by default
+     */
+    public createRing(frames?: number): SharedArrayBuffer;
+
+    /**
+     * Opens the output device and plays packets pushed with `pushPacket()`
+     * from a native jitter buffer, in sequence order, concealing lost ones.
+     *
+     * @param opts packet size and buffer depth bounds, in packets
+     */
+    public startJitterBuffer(opts?: Speaker.JitterOptions): this;
+
+    /**
+     * Inserts a packet into the jitter buffer. Returns `false` if it came too
+     * late, or twice.
+     *
+     * @param sequence the packet's 16-bit sequence number
+     * @param packet "packetFrames" frames of PCM audio in this Speaker's format
+     */
+    public pushPacket(sequence: number, packet: NodeJS.ArrayBufferView): boolean;
+
+    /**
+     * Statistics of the jitter buffer, or `null` if there was none.
+     */
+    public jitterStats(): Speaker.JitterStats | null;
+
+    /**
+     * Opens the output device and plays an MPEG audio stream over HTTP, such
+     * as internet radio, on native threads. Emits "connect" and "metadata".
+     *
+     * @param url an http:// URL
+     * @param opts how many bytes to buffer before playing
+     */
+    public playStream(url: string, opts?: Speaker.StreamOptions): this;
+
+    /**
+     * Decodes an MPEG audio file, or converts PCM audio, into this Speaker's
+     * format and caches it natively for `playClip()`. Resolves with its
+     * duration in milliseconds.
+     *
+     * @param id what to call the clip
+     * @param source path of an MPEG audio file, or PCM audio at this Speaker's sample rate
+     * @param format the PCM audio's format, this Speaker's by default
+     */
+    public loadClip(id: string, source: string | NodeJS.ArrayBufferView, format?: Speaker.ClipFormat): Promise<number>;
+
+    /**
+     * Plays a cached clip, mixed on a native output thread. Returns `false`
+     * if it isn't cached, or too many are playing.
+     *
+     * @param id the clip's id
+     * @param opts the gain of this playback
+     */
+    public playClip(id: string, opts?: Speaker.ClipOptions): boolean;
+
+    /**
+     * Drops a clip from the cache. Returns `false` if it wasn't cached.
+     *
+     * @param id the clip's id
+     */
+    public unloadClip(id: string): boolean;
+
+    /**
+     * Statistics of the clip cache, or `null` if there is none.
+     */
+    public clipStats(): Speaker.ClipStats | null;
+
     /**
      * Returns the `MPG123_ENC_*` constant that corresponds to the given "format"
      * object, or `null` if the format is invalid.
@@ -48,12 +317,59 @@ declare class Speaker extends Writable {
 
     /**
      * Returns whether or not "format" is playable via the "output module"
-     * that was selected during compilation.
+     * that was selected during compilation, or the built in one named `backend`.
      *
      * @param format MPG123_ENC_* format constant
+     * @param backend backend name, the default one if not given
      * @return whether or not is playable
      */
-    public isSupported(format: number): boolean;
+    public isSupported(format: number | Speaker.Format, backend?: string): boolean;
+
+    /**
+     * Returns the output modules built into the addon, the default one first.
+     * Opens their default devices to find out the formats they play.
+     */
+    public backends(): Speaker.Backend[];
+
+    /**
+     * Opens `device` of the default backend, or of the one named `backend`,
+     * and resolves with the formats it plays at each rate and channel count.
+     * The answers are cached, so each device only gets opened once.
+     *
+     * @param device device name, `null` for the default one
+     * @param backend backend name, the default one if not given
+     */
+    public probe(device: string | null, backend?: string): Promise<Speaker.Capability[]>;
+
+    /**
+     * Lists the devices of every built in backend, or of the one named
+     * `backend`, probing them all in parallel.
+     *
+     * @param backend backend name, all of them if not given
+     */
+    public devices(backend?: string): Promise<Speaker.Device[]>;
+
+    /**
+     * Opens a device for speakers with the given options from the threadpool
+     * and keeps it running with silence until such a speaker opens and takes
+     * it. Resolves with the number of devices prepared for these options.
+     *
+     * @param opts the options a `Speaker` would be created with
+     */
+    public static prepare(opts?: Speaker.Options): Promise<number>;
+
+    /**
+     * The number of devices `prepare()` has ready for speakers with the given
+     * options.
+     *
+     * @param opts the options a `Speaker` would be created with
+     */
+    public static prepared(opts?: Speaker.Options): number;
+
+    /**
+     * Closes the devices `prepare()` has ready or is still opening.
+     */
+    public static closePrepared(): void;
 }
 
 export = Speaker
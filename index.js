@@ -5,13 +5,39 @@
  */
 
 const os = require('os')
+const path = require('path')
 const debug = require('debug')('speaker')
-const binding = require('bindings')('binding')
+const bindings = require('bindings')
+const binding = bindings('binding')
+const ring = require('./ring')
+const { spawn } = require('child_process')
 const { Writable } = require('stream')
 
 // determine the native host endianness, the only supported playback endianness
 const endianness = os.endianness()
 
+// equalizer band types, and the "q" they get when none is given
+const bandTypes = {
+  peaking: [binding.DSP_EQ_PEAKING, 1],
+  lowshelf: [binding.DSP_EQ_LOWSHELF, Math.SQRT1_2],
+  highshelf: [binding.DSP_EQ_HIGHSHELF, Math.SQRT1_2],
+  lowpass: [binding.DSP_EQ_LOWPASS, Math.SQRT1_2],
+  highpass: [binding.DSP_EQ_HIGHPASS, Math.SQRT1_2]
+}
+
+// how often the events of a stream played with `playStream()` are picked up;
+// JS can't be woken by the native threads that queue them
+const RADIO_POLL_MS = 100
+
+// bytes of decoded audio that `loadClip()` keeps cached by default
+const CLIP_BUDGET = 16 * 1024 * 1024
+
+// devices opened ahead of time by `Speaker.prepare()`, by `preparedKey()`, and
+// how many times `closePrepared()` was called, for the ones that were still
+// being opened then
+const preparedDevices = new Map()
+let preparedGeneration = 0
+
 /**
  * The `Speaker` class accepts raw PCM data written to it, and then sends that data
  * to the default output device of the OS.
@@ -41,6 +67,81 @@ class Speaker extends Writable {
     // flipped after close() is called, no write() calls allowed after
     this._closed = false
 
+    // files passed to `enqueue()` that the native playlist hasn't seen yet,
+    // and the ones it has, in the order they are going to start playing
+    this._queued = []
+    this._tracks = []
+
+    // Promise for the native playlist playback, while it is running
+    this._playback = null
+
+    // Promise for the `write()` chunk that is on its way to the device, which
+    // the native playlist has to wait for
+    this._writing = null
+
+    // chunks passed to `writeAt()`, and when they are to be heard
+    this._scheduled = new WeakMap()
+
+    // play through a "speakerd" helper process rather than opening the device
+    // in this one, and the ChildProcess instance while it is running
+    this.outOfProcess = Boolean(opts.outOfProcess)
+    this._remote = null
+
+    // name of the built in output module to play through, `null` for the one
+    // that was the default at compile time
+    this.backend = opts.backend == null ? null : String(opts.backend)
+
+    // how much audio the device should buffer, in milliseconds. `0` leaves it
+    // up to the backend, which doesn't all honour it
+    this.latency = opts.latency == null ? 0 : Number(opts.latency)
+    if (!(this.latency >= 0)) {
+      throw new TypeError('"latency" must be a non-negative number of milliseconds')
+    }
+
+    // the latency, in milliseconds, to hold by resampling streams that come
+    // in at a clock of their own. `0` plays them as they come
+    this.targetLatency = opts.targetLatency == null ? 0 : Number(opts.targetLatency)
+    if (!(this.targetLatency >= 0)) {
+      throw new TypeError('"targetLatency" must be a non-negative number of milliseconds')
+    }
+
+    // the SharedArrayBuffer handed out by `createRing()`, while the native
+    // output thread is playing from it
+    this._ring = null
+
+    // the Promise of the native stop that `end()` started for a ring, jitter
+    // buffer, stream or clip cache, which close() has to wait for
+    this._stopping = null
+
+    // set while the native jitter buffer plays the packets pushed into it,
+    // and the handle its statistics stay readable through after close()
+    this._jitter = false
+    this._jitterHandle = null
+
+    // the timer that polls for the events of a stream played with
+    // `playStream()`, while there is one
+    this._radio = null
+
+    // set once `loadClip()` has set up the native clip cache, and while its
+    // output thread is mixing the clips passed to `playClip()`
+    this.clipBudget = opts.clipBudget == null ? CLIP_BUDGET : Number(opts.clipBudget)
+    if (!(this.clipBudget >= 1 && this.clipBudget <= Number.MAX_SAFE_INTEGER) || this.clipBudget !== Math.floor(this.clipBudget)) {
+      throw new TypeError('"clipBudget" must be a positive integer number of bytes')
+    }
+    this._clipCache = false
+    this._clips = false
+
+    // clips that are being decoded or converted, close() waits for them
+    this._clipLoads = new Set()
+
+    // linear gain applied to everything that gets played
+    this._volume = 1
+    if (opts.volume != null) this.volume = opts.volume
+
+    // parametric equalizer bands, applied before the volume
+    this._equalizer = []
+    if (opts.equalizer != null) this.equalizer = opts.equalizer
+
     // set PCM format
     this._format(opts)
 
@@ -52,17 +153,12 @@ class Speaker extends Writable {
   }
 
   /**
-   * Calls the audio backend's `open()` function, and then emits an "open" event.
+   * Sets the PCM format options that weren't given to their defaults.
    *
    * @api private
    */
 
-  _open () {
-    debug('open()')
-    if (this.audio_handle) {
-      throw new Error('_open() called more than once!')
-    }
-    // set default options, if not set
+  _defaults () {
     if (this.channels == null) {
       debug('setting default %o: %o', 'channels', 2)
       this.channels = 2
@@ -84,27 +180,197 @@ class Speaker extends Writable {
       debug('setting default %o: %o', 'device', null)
       this.device = null
     }
+  }
+
+  /**
+   * Calls the audio backend's `open()` function, and then emits an "open" event.
+   *
+   * @api private
+   */
+
+  _open () {
+    debug('open()')
+    if (this.audio_handle) {
+      throw new Error('_open() called more than once!')
+    }
+    this._defaults()
 
     const format = Speaker.getFormat(this)
     if (format == null) {
       throw new Error('invalid PCM format specified')
     }
 
-    if (!Speaker.isSupported(format)) {
-      throw new Error(`specified PCM format is not supported by "${binding.name}" backend`)
+    // "file:" devices render to a file in any format, without the backend
+    const file = isFile(this.device)
+    const remote = this.outOfProcess && !file
+    // a device opened ahead of time by `Speaker.prepare()` is taken as it is
+    const handle = file || remote ? null : takePrepared(preparedKey(this, format))
+    if (handle) {
+      debug('using a prepared device')
+    } else if (remote && !Speaker.isSupported(format, this.backend)) {
+      throw new Error(`specified PCM format is not supported by "${this.backend || binding.name}" backend`)
+    } else if (!file && !remote) {
+      // what the device plays is only known if it has been probed, which
+      // isn't done here since it opens the device; otherwise, and if it can't
+      // be opened at all, `binding.open()` says so
+      const formats = binding.formats(this.backend, this.device, this.sampleRate, this.channels)
+      if (formats >= 0 && (formats & format) !== format) {
+        throw new Error(`specified PCM format is not supported by "${this.backend || binding.name}" backend`)
+      }
     }
 
     // calculate the "block align"
     this.blockAlign = this.bitDepth / 8 * this.channels
 
-    // initialize the audio handle
-    // TODO: open async?
-    this.audio_handle = binding.open(this.channels, this.sampleRate, format, this.device)
+    // initialize the audio handle, unless one was prepared. Opening the device
+    // here blocks the JS thread for as long as the backend takes to start
+    this.audio_handle = handle || binding.open(this.channels, this.sampleRate, format, this.device, remote, this.latency, this.backend, this.targetLatency)
+    // kept past close() for `metrics()`
+    this._metricsHandle = this.audio_handle
+    if (remote) {
+      this._spawn(this.audio_handle)
+    }
+    if (this._volume !== 1) {
+      binding.setVolume(this.audio_handle, this._volume)
+    }
+    if (this._equalizer.length > 0) {
+      binding.setEqualizer(this.audio_handle, flattenBands(this._equalizer))
+    }
 
     this.emit('open')
     return this.audio_handle
   }
 
+  /**
+   * Starts the "speakerd" helper process that opens the output device and
+   * plays what gets written into the shared memory ring of the given handle.
+   *
+   * @param {Object} handle - handle opened with the "outOfProcess" flag
+   * @api private
+   */
+
+  _spawn (handle) {
+    const file = path.join(path.dirname(bindings({ bindings: 'binding', path: true })), 'speakerd')
+    const args = []
+    if (this.backend != null) args.push('-b', this.backend)
+    if (this.latency > 0) args.push('-l', String(Math.round(this.latency * 1000)))
+    if (this.device != null) args.push(String(this.device))
+    const fds = binding.remoteFds(handle)
+    debug('spawning %o %o', file, args)
+    const child = spawn(file, args, { stdio: ['ignore', 'ignore', 'inherit', fds[0], fds[1]] })
+    binding.remoteStarted(handle)
+    this._remote = child
+
+    // the helper only ever goes away on its own when something went wrong,
+    // pending and further writes fail once it is gone
+    child.on('error', (err) => {
+      if (this._remote !== child) return
+      this._remote = null
+      this.emit('error', err)
+    })
+    child.on('exit', (code, signal) => {
+      if (this._remote !== child) return
+      this._remote = null
+      this.emit('error', new Error(`speakerd exited with ${signal || `code ${code}`}`))
+    })
+  }
+
+  /**
+   * How far behind the writes the speakers are: the milliseconds of audio that
+   * the device has taken but not played yet. `null` if the backend can't tell,
+   * or the device isn't open.
+   *
+   * @return {Number|null}
+   * @api public
+   */
+
+  delay () {
+    if (!this.audio_handle) return null
+    const frames = binding.delay(this.audio_handle)
+    return frames < 0 ? null : frames * 1000 / this.sampleRate
+  }
+
+  /**
+   * Histograms of this speaker's native write path, as `{ queueWait,
+   * writeTime, writeBytes, callbackDelay, shortWrites }`, or `null` if it was
+   * never opened. See `Speaker.metrics()`.
+   *
+   * @return {Object|null}
+   * @api public
+   */
+
+  metrics () {
+    return this._metricsHandle ? binding.metrics(this._metricsHandle) : null
+  }
+
+  /**
+   * The linear gain applied to the audio, `1` by default. Changes take effect
+   * mid-stream, with the next chunk that gets played, and are ramped over a few
+   * milliseconds so that they don't click.
+   *
+   * @api public
+   */
+
+  get volume () {
+    return this._volume
+  }
+
+  set volume (volume) {
+    volume = Number(volume)
+    if (!(volume >= 0) || volume === Infinity) {
+      throw new TypeError(`volume must be a non-negative number, got ${volume}`)
+    }
+    debug('setting %o: %o', 'volume', volume)
+    this._volume = volume
+    if (this.audio_handle) {
+      binding.setVolume(this.audio_handle, volume)
+    }
+  }
+
+  /**
+   * The parametric equalizer, an Array of up to 8 bands that are applied in
+   * order. Every band is an object with a "type" (one of "peaking", "lowshelf",
+   * "highshelf", "lowpass" or "highpass"), a "frequency" in Hz, a "gain" in dB
+   * for the peaking and shelving types, and an optional "q". Like the volume,
+   * it can be changed mid-stream.
+   *
+   * @api public
+   */
+
+  get equalizer () {
+    return this._equalizer.map((band) => Object.assign({}, band))
+  }
+
+  set equalizer (bands) {
+    if (!Array.isArray(bands)) {
+      throw new TypeError('equalizer must be an Array of bands')
+    }
+    if (bands.length > 8) {
+      throw new RangeError(`equalizer supports up to 8 bands, got ${bands.length}`)
+    }
+    bands = bands.map((band) => {
+      const type = bandTypes[band.type]
+      if (!type) {
+        throw new TypeError(`unknown equalizer band type "${band.type}"`)
+      }
+      const normalized = {
+        type: band.type,
+        frequency: Number(band.frequency),
+        gain: Number(band.gain || 0),
+        q: Number(band.q == null ? type[1] : band.q)
+      }
+      if (!(normalized.frequency > 0) || !(normalized.q > 0) || !isFinite(normalized.gain)) {
+        throw new RangeError(`invalid equalizer band: ${JSON.stringify(band)}`)
+      }
+      return normalized
+    })
+    debug('setting %o: %o', 'equalizer', bands)
+    if (this.audio_handle) {
+      binding.setEqualizer(this.audio_handle, flattenBands(bands))
+    }
+    this._equalizer = bands
+  }
+
   /**
    * Set given PCM formatting options. Called during instantiation on the passed in
    * options object, on the stream given to the "pipe" event, and a final time if
@@ -144,6 +410,10 @@ class Speaker extends Writable {
       debug('setting %o: %o', 'device', opts.device)
       this.device = opts.device
     }
+    if (opts.crossfade != null) {
+      debug('setting %o: %o', 'crossfade', opts.crossfade)
+      this.crossfade = opts.crossfade
+    }
     if (opts.endianness == null || endianness === opts.endianness) {
       // no "endianness" specified or explicit native endianness
       this.endianness = endianness
@@ -169,6 +439,24 @@ class Speaker extends Writable {
       // close() has already been called. this should not be called
       return done(new Error('write() call after close() call'))
     }
+    if (this._ring) {
+      return done(new Error('write() call on a Speaker that plays from a ring'))
+    }
+    if (this._jitter) {
+      return done(new Error('write() call on a Speaker that plays from a jitter buffer'))
+    }
+    if (this._radio) {
+      return done(new Error('write() call on a Speaker that plays a stream'))
+    }
+    if (this._clips) {
+      return done(new Error('write() call on a Speaker that plays clips'))
+    }
+    if (this._playback) {
+      // the native playlist owns the device until the queue runs dry
+      debug('waiting for queued files to finish playing')
+      this._playback.then(() => this._write(chunk, encoding, done))
+      return
+    }
     let b
     let left = chunk
     let handle = this.audio_handle
@@ -182,6 +470,34 @@ class Speaker extends Writable {
     }
     const chunkSize = this.blockAlign * this.samplesPerFrame
 
+    let settle
+    const writing = this._writing = new Promise((resolve) => { settle = resolve })
+    const release = () => {
+      if (this._writing === writing) this._writing = null
+      settle()
+    }
+    const callback = done
+    done = (err) => {
+      release()
+      callback(err)
+    }
+
+    const scheduled = this._scheduled.get(chunk)
+    if (scheduled) {
+      // in one piece, so that nothing can get in between the silence and it
+      debug('writing %o bytes at %o', chunk.length, scheduled.time)
+      binding.write(handle, chunk, scheduled.time).then((r) => {
+        const { start, error, silence, trimmed } = r
+        scheduled.timing = { start, error, silence, trimmed }
+        if (r.written !== chunk.length) done(new Error(`write() failed: ${r.written}`))
+        else done()
+      }, (e) => {
+        release()
+        this.emit('error', e)
+      })
+      return
+    }
+
     const write = () => {
       if (this._closed) {
         debug('aborting remainder of write() call (%o bytes), since speaker is `_closed`', left.length)
@@ -200,6 +516,7 @@ class Speaker extends Writable {
     }
 
     const onerror = (e) => {
+      release()
       this.emit('error', e)
     }
 
@@ -219,6 +536,462 @@ class Speaker extends Writable {
     write()
   }
 
+  /**
+   * With the "targetLatency" option: the resampling correction in parts per
+   * million, positive while the stream gets played faster than it comes in,
+   * and the smoothed latency in milliseconds that it steers by (`-1` while
+   * the backend hasn't said). `null` without the option, or before the device
+   * is opened.
+   *
+   * @return {Object|null} `{ ppm, latency }`
+   * @api public
+   */
+
+  drift () {
+    if (!this.audio_handle) return null
+    return binding.drift(this.audio_handle)
+  }
+
+  /**
+   * Writes a chunk that is to start playing at `time`, in milliseconds on the
+   * `Speaker.now()` clock. The chunk waits its turn behind earlier writes like
+   * any other, then silence is written before it or frames are dropped from
+   * its start so that the device gets to its first frame at `time`, going by
+   * how far behind the device says it is. The callback gets a `{ start,
+   * error, silence, trimmed }` object: when the chunk is expected to be heard,
+   * how far that is from `time` in milliseconds, and the frames of silence
+   * written before it or dropped from it.
+   *
+   * @param {Buffer} chunk - PCM audio in this Speaker's format
+   * @param {Number} time - when to start playing it, see `Speaker.now()`
+   * @param {Function} [callback] - called with `(err, timing)`
+   * @return {Boolean} false if the caller should wait for "drain"
+   * @api public
+   */
+
+  writeAt (chunk, time, callback) {
+    if (!Number.isFinite(time)) {
+      throw new TypeError('"time" must be a number of milliseconds')
+    }
+    // a view of its own, so that the same buffer can be scheduled twice
+    const view = Buffer.from(chunk.buffer, chunk.byteOffset, chunk.length)
+    const entry = { time, timing: null }
+    this._scheduled.set(view, entry)
+    return this.write(view, (err) => {
+      if (callback) callback(err || null, entry.timing)
+    })
+  }
+
+  /**
+   * Queues an MPEG audio file (e.g. an MP3) to be decoded and played on the
+   * native side, through the same open output device as everything else that
+   * gets played by this Speaker. Consecutive files play back gaplessly, or
+   * crossfaded when the "crossfade" option is set. A "track" event is emitted
+   * when a file starts playing, and "queueend" once the queue ran dry.
+   *
+   * @param {String} path - path of the file to play
+   * @return {Speaker} this Speaker instance
+   * @api public
+   */
+
+  enqueue (path) {
+    debug('enqueue(%o)', path)
+    if (this._closed) {
+      throw new Error('enqueue() call after close() call')
+    }
+    if (this._ring || this._jitter || this._radio || this._clips) {
+      throw new Error('enqueue() call on a Speaker that plays from a ring, jitter buffer, stream or clip cache')
+    }
+    if (!this.audio_handle) {
+      this._open()
+    }
+    this._queued.push(String(path))
+    if (!this._playback) {
+      this._playback = this._play()
+    }
+    return this
+  }
+
+  /**
+   * Opens the output device for good and plays from a ring in shared memory
+   * on a native thread, instead of from `write()` calls. The returned
+   * SharedArrayBuffer can be passed on to a worker thread, which writes PCM
+   * audio in this Speaker's format into it through a `Speaker.RingWriter`,
+   * without any copies between threads. Volume and equalizer changes still
+   * apply. `end()` plays what is left in the ring before closing, `close()`
+   * stops right away.
+   *
+   * @param {Number} frames - how many frames the ring holds, a quarter of a second's worth by default
+   * @return {SharedArrayBuffer}
+   * @api public
+   */
+
+  createRing (frames) {
+    debug('createRing(%o)', frames)
+    if (this._closed) {
+      throw new Error('createRing() call after close() call')
+    }
+    if (this._ring || this._jitter || this._radio || this._clips || this._playback || this.writableLength > 0) {
+      throw new Error('createRing() call on a Speaker that is already playing')
+    }
+    if (!this.audio_handle) {
+      this._open()
+    }
+    if (frames == null) frames = Math.round(this.sampleRate / 4)
+    frames = Number(frames)
+    if (!(frames >= 1) || frames !== Math.floor(frames)) {
+      throw new TypeError(`frames must be a positive integer, got ${frames}`)
+    }
+    const buffer = ring.allocate(frames, this.blockAlign)
+    binding.startRing(this.audio_handle, new Uint8Array(buffer))
+    this._ring = buffer
+    return buffer
+  }
+
+  /**
+   * Opens the output device for good and plays packets of real-time audio
+   * (VoIP, RTP, ...) pushed with `pushPacket()` from a native jitter buffer,
+   * on a thread of its own, instead of from `write()` calls. Packets are put
+   * back in order by their sequence numbers, missing ones are concealed, and
+   * the depth of the buffer follows the jitter of their arrival times.
+   * Volume and equalizer changes still apply. `end()` plays what is buffered
+   * before closing, `close()` stops right away.
+   *
+   * @param {Object} [opts]
+   * @param {Number} [opts.packetFrames] - frames per packet, 20 ms worth by default
+   * @param {Number} [opts.minDepth] - the fewest packets to buffer before playing, 1 by default
+   * @param {Number} [opts.maxDepth] - the most packets to buffer, 10 by default
+   * @return {Speaker} this Speaker instance
+   * @api public
+   */
+
+  startJitterBuffer (opts) {
+    debug('startJitterBuffer(%o)', opts)
+    if (this._closed) {
+      throw new Error('startJitterBuffer() call after close() call')
+    }
+    if (this._ring || this._jitter || this._radio || this._clips || this._playback || this.writableLength > 0) {
+      throw new Error('startJitterBuffer() call on a Speaker that is already playing')
+    }
+    if (!opts) opts = {}
+    const packetFrames = opts.packetFrames == null ? Math.round(this.sampleRate / 50) : Number(opts.packetFrames)
+    const minDepth = opts.minDepth == null ? 1 : Number(opts.minDepth)
+    const maxDepth = opts.maxDepth == null ? Math.max(10, minDepth) : Number(opts.maxDepth)
+    for (const [name, value] of [['packetFrames', packetFrames], ['minDepth', minDepth], ['maxDepth', maxDepth]]) {
+      if (!(value >= 1) || value !== Math.floor(value)) {
+        throw new TypeError(`${name} must be a positive integer, got ${value}`)
+      }
+    }
+    if (maxDepth < minDepth) {
+      throw new RangeError('maxDepth must not be less than minDepth')
+    }
+    if (!this.audio_handle) {
+      this._open()
+    }
+    binding.startJitter(this.audio_handle, packetFrames, minDepth, maxDepth)
+    this._jitter = true
+    this._jitterHandle = this.audio_handle
+    this.packetFrames = packetFrames
+    return this
+  }
+
+  /**
+   * Inserts a packet into the jitter buffer, in whatever order packets
+   * arrive. `sequence` counts packets, and wraps around at 16 bits like RTP
+   * sequence numbers do. Returns `false` if the packet came too late to be
+   * played, or was a duplicate, or `end()` has been called.
+   *
+   * @param {Number} sequence - the packet's sequence number
+   * @param {Buffer} packet - "packetFrames" frames of PCM audio in this Speaker's format
+   * @return {Boolean}
+   * @api public
+   */
+
+  pushPacket (sequence, packet) {
+    if (!this._jitter) {
+      throw new Error('pushPacket() call on a Speaker without a jitter buffer')
+    }
+    if (packet.length !== this.packetFrames * this.blockAlign) {
+      throw new RangeError(`packets must be ${this.packetFrames * this.blockAlign} bytes, got ${packet.length}`)
+    }
+    // the buffer is playing out what it has
+    if (this._writableState.ending) return false
+    return binding.pushPacket(this.audio_handle, sequence & 0xffff, packet)
+  }
+
+  /**
+   * Statistics of the jitter buffer: packets `received`, `played`,
+   * `concealed`, `late` and `dropped`, `underruns`, the interarrival
+   * `jitter` in milliseconds, the packets `buffered`, and the `target` depth
+   * in packets and as a `depth` in milliseconds. `null` if there was no
+   * jitter buffer; readable after close().
+   *
+   * @return {Object|null}
+   * @api public
+   */
+
+  jitterStats () {
+    return this._jitterHandle ? binding.jitterStats(this._jitterHandle) : null
+  }
+
+  /**
+   * Opens the output device and plays an internet radio stream, an MPEG audio
+   * stream over HTTP, on native threads of their own. They connect, prefetch
+   * and decode; only the stream's events come over to JS. A "connect" event
+   * reports the station, and a "metadata" event each ICY (SHOUTcast)
+   * metadata block that the server sends along. Once the server ends the
+   * stream, so does the speaker. `end()` and `close()` stop it right away.
+   *
+   * @param {String} url - an http:// URL
+   * @param {Object} [opts]
+   * @param {Number} [opts.prefetch] - bytes to buffer before playing, 64 KiB by default
+   * @return {Speaker} this Speaker instance
+   * @api public
+   */
+
+  playStream (url, opts) {
+    debug('playStream(%o, %o)', url, opts)
+    if (this._closed) {
+      throw new Error('playStream() call after close() call')
+    }
+    if (this._ring || this._jitter || this._radio || this._clips || this._playback || this.writableLength > 0) {
+      throw new Error('playStream() call on a Speaker that is already playing')
+    }
+    if (typeof url !== 'string' || !/^http:\/\//i.test(url)) {
+      throw new TypeError(`only http:// URLs can be streamed, got ${url}`)
+    }
+    const prefetch = opts && opts.prefetch != null ? Number(opts.prefetch) : 64 * 1024
+    if (!(prefetch >= 1) || prefetch !== Math.floor(prefetch)) {
+      throw new TypeError(`prefetch must be a positive integer, got ${prefetch}`)
+    }
+    if (!this.audio_handle) {
+      this._open()
+    }
+    binding.startRadio(this.audio_handle, url, prefetch)
+    this._radio = setInterval(() => this._pollStream(), RADIO_POLL_MS)
+    return this
+  }
+
+  /**
+   * Emits the events that the native threads of `playStream()` queued up.
+   *
+   * @api private
+   */
+
+  _pollStream () {
+    for (const ev of binding.radioEvents(this.audio_handle)) {
+      debug('stream event %o', ev)
+      if (ev.type === 'connect') {
+        this.emit('connect', { name: ev.name, url: ev.url, contentType: ev.contentType, metaint: ev.interval })
+      } else if (ev.type === 'metadata') {
+        this.emit('metadata', parseIcy(ev.meta))
+      } else if (ev.type === 'error') {
+        this.emit('error', new Error(ev.error))
+        this.end()
+      } else {
+        this.end()
+      }
+    }
+  }
+
+  /**
+   * Stops picking up the events of `playStream()`.
+   *
+   * @api private
+   */
+
+  _stopPolling () {
+    if (this._radio) {
+      clearInterval(this._radio)
+      this._radio = null
+    }
+  }
+
+  /**
+   * Decodes an MPEG audio file, or converts PCM audio, into this Speaker's
+   * format once and keeps it in a native cache as `id`, for `playClip()` to
+   * play from. Opens the output device. Loading an `id` again replaces the
+   * clip. The cache holds up to "clipBudget" bytes; the least recently used
+   * clips that aren't playing make way for new ones.
+   *
+   * @param {String} id - what to call the clip
+   * @param {String|Buffer} source - path of an MPEG audio file, or PCM audio at this Speaker's sample rate
+   * @param {Object} [format] - "channels", "bitDepth", "float" and "signed" of the PCM audio, this Speaker's by default
+   * @return {Promise} resolves with the clip's duration in milliseconds
+   * @api public
+   */
+
+  loadClip (id, source, format) {
+    debug('loadClip(%o)', id)
+    if (this._closed) {
+      throw new Error('loadClip() call after close() call')
+    }
+    if (!this.audio_handle) {
+      this._open()
+    }
+    let encoding = 0
+    let channels = 0
+    if (typeof source !== 'string') {
+      if (!ArrayBuffer.isView(source)) {
+        throw new TypeError('source must be a path or a Buffer of PCM audio')
+      }
+      const f = Object.assign({ channels: this.channels }, format)
+      if (f.sampleRate != null && Number(f.sampleRate) !== this.sampleRate) {
+        throw new RangeError(`PCM audio must be at ${this.sampleRate} Hz, got ${f.sampleRate}`)
+      }
+      if (f.bitDepth == null) {
+        f.bitDepth = this.bitDepth
+        f.float = this.float
+        f.signed = this.signed
+      } else if (f.signed == null) {
+        f.signed = Number(f.bitDepth) !== 8
+      }
+      encoding = Speaker.getFormat(f)
+      channels = Number(f.channels)
+      if (encoding == null || !(channels >= 1) || channels !== Math.floor(channels)) {
+        throw new TypeError('invalid PCM format specified')
+      }
+      const blockAlign = f.bitDepth / 8 * channels
+      if (source.byteLength % blockAlign !== 0) {
+        throw new RangeError(`PCM audio must be a whole number of ${blockAlign} byte frames, got ${source.byteLength} bytes`)
+      }
+      source = new Uint8Array(source.buffer, source.byteOffset, source.byteLength)
+    }
+    const load = binding.loadClip(this.audio_handle, String(id), source, this.clipBudget, encoding, channels)
+    this._clipCache = true
+    const settled = load.then(() => this._clipLoads.delete(settled), () => this._clipLoads.delete(settled))
+    this._clipLoads.add(settled)
+    return load.then((frames) => frames * 1000 / this.sampleRate)
+  }
+
+  /**
+   * Plays a clip loaded with `loadClip()` straight from the cache, mixed with
+   * any others that are playing, on a native output thread that keeps the
+   * device going from the first call on. The clip starts within about
+   * 10 ms of the call. Like with `createRing()`, the device then belongs to
+   * the clips. Volume and equalizer changes still apply. Returns `false` if
+   * the clip isn't cached, e.g. because it got evicted, if too many are
+   * playing already, or after `end()`; throws if the device stopped taking
+   * audio. `end()` lets the clips that are playing finish before closing,
+   * `close()` stops right away.
+   *
+   * @param {String} id - the clip's id
+   * @param {Object} [opts]
+   * @param {Number} [opts.volume] - linear gain of this playback, 1 by default
+   * @return {Boolean}
+   * @api public
+   */
+
+  playClip (id, opts) {
+    if (this._closed) {
+      throw new Error('playClip() call after close() call')
+    }
+    if (!this._clips && (this._ring || this._jitter || this._radio || this._playback || this.writableLength > 0)) {
+      throw new Error('playClip() call on a Speaker that is already playing')
+    }
+    const volume = opts && opts.volume != null ? Number(opts.volume) : 1
+    if (!(volume >= 0)) {
+      throw new TypeError(`volume must be a non-negative number, got ${volume}`)
+    }
+    // the clips that are playing are being played out
+    if (!this._clipCache || this.writableEnded) return false
+    const played = binding.playClip(this.audio_handle, String(id), volume)
+    this._clips = true
+    return played
+  }
+
+  /**
+   * Drops a clip from the cache, stopping it if it is playing. Returns
+   * `false` if it wasn't cached.
+   *
+   * @param {String} id - the clip's id
+   * @return {Boolean}
+   * @api public
+   */
+
+  unloadClip (id) {
+    if (!this._clipCache || !this.audio_handle) return false
+    return binding.unloadClip(this.audio_handle, String(id))
+  }
+
+  /**
+   * Statistics of the clip cache: the `clips` and `bytes` it holds, its
+   * `budget`, the plays that found their clip cached (`hits`) or not
+   * (`misses`), the clips `evicted`, the plays `dropped` because too many
+   * clips were playing, and the `voices` playing right now. `null` without a
+   * cache, or after close().
+   *
+   * @return {Object|null}
+   * @api public
+   */
+
+  clipStats () {
+    if (!this._clipCache || !this.audio_handle) return null
+    return binding.clipStats(this.audio_handle)
+  }
+
+  /**
+   * Drives the native playlist, one "samplesPerFrame" sized step at a time,
+   * until all the queued files have been played.
+   *
+   * @return {Promise}
+   * @api private
+   */
+
+  _play () {
+    // a write() chunk may still be on its way to the device, which only one
+    // thread can write to at a time
+    const writing = this._writing
+    return new Promise((resolve) => {
+      const step = () => {
+        if (this._closed) {
+          debug('aborting playback of queued files, since speaker is `_closed`')
+          return finish()
+        }
+        const paths = this._queued.splice(0)
+        this._tracks.push(...paths)
+        const crossfade = Math.round((this.crossfade || 0) * this.sampleRate / 1000)
+        binding.play(this.audio_handle, this.samplesPerFrame, crossfade, paths).then(onplay, onerror)
+      }
+
+      const onplay = (r) => {
+        debug('played %o bytes of queued files', r.written)
+        for (const reason of r.events) {
+          const path = this._tracks.shift()
+          if (reason === null) {
+            debug('track %o started', path)
+            this.emit('track', path)
+          } else {
+            this.emit('error', new Error(`failed to play "${path}": ${reason}`))
+          }
+        }
+        if (r.done && this._queued.length === 0) {
+          finish()
+          this.emit('queueend')
+        } else {
+          step()
+        }
+      }
+
+      const onerror = (e) => {
+        finish()
+        this.emit('error', e)
+      }
+
+      const finish = () => {
+        this._playback = null
+        resolve()
+      }
+
+      if (writing) {
+        debug('waiting for the pending write() before playing queued files')
+        writing.then(step)
+      } else {
+        step()
+      }
+    })
+  }
+
   /**
    * Called when this stream is pipe()d to from another readable stream.
    * If the "sampleRate", "channels", "bitDepth", and "signed" properties are
@@ -246,6 +1019,42 @@ class Speaker extends Writable {
     source.removeListener('format', this._format)
   }
 
+  /**
+   * `_final()` callback for the Writable base class. Holds back the "finish"
+   * event until any files queued with `enqueue()` have been played.
+   *
+   * @param {Function} done
+   * @api private
+   */
+
+  _final (done) {
+    debug('_final()')
+    let stop = null
+    if (this._ring) {
+      debug('waiting for the ring to play out')
+      stop = binding.stopRing(this.audio_handle, true)
+    } else if (this._jitter) {
+      debug('waiting for the jitter buffer to play out')
+      stop = binding.stopJitter(this.audio_handle, true)
+    } else if (this._radio) {
+      debug('stopping the stream')
+      this._stopPolling()
+      stop = binding.stopRadio(this.audio_handle)
+    } else if (this._clips) {
+      debug('waiting for the clips to play out')
+      stop = binding.stopClips(this.audio_handle, true)
+    }
+    if (stop) {
+      this._stopping = stop.then(() => {}, () => {})
+      stop.then(() => done(), done)
+    } else if (this._playback) {
+      debug('waiting for queued files to finish playing')
+      this._playback.then(() => done())
+    } else {
+      done()
+    }
+  }
+
   /**
    * Emits a "flush" event and then calls the `.close()` function on
    * this Speaker instance.
@@ -273,16 +1082,48 @@ class Speaker extends Writable {
     if (this._closed) return debug('already closed...')
 
     if (this.audio_handle) {
-      if (flush !== false) {
-        // TODO: async most likely…
-        debug('invoking flush() native binding')
-        binding.flush(this.audio_handle)
-      }
+      const handle = this.audio_handle
+      const release = () => {
+        if (flush !== false) {
+          // TODO: async most likely…
+          debug('invoking flush() native binding')
+          binding.flush(handle)
+        }
 
-      // TODO: async maybe?
-      debug('invoking close() native binding')
-      binding.close(this.audio_handle)
+        // TODO: async maybe?
+        debug('invoking close() native binding')
+        const remote = this._remote
+        this._remote = null
+        binding.close(handle)
+
+        // the helper has played out the ring by now, unless it is stuck
+        if (remote && remote.exitCode === null && remote.signalCode === null) {
+          debug('killing speakerd')
+          remote.kill()
+        }
+      }
       this.audio_handle = null
+      this._ring = null
+      this._jitter = false
+      this._clips = false
+      const streaming = this._radio != null
+      this._stopPolling()
+
+      // the native playlist may still be using the device, clips may be on
+      // their way into the cache, and the output thread of a ring, jitter
+      // buffer, stream or clip cache may still be stopping on the threadpool;
+      // wait for them before pulling the rug
+      const busy = [...this._clipLoads]
+      if (this._playback) busy.push(this._playback)
+      if (this._stopping) busy.push(this._stopping)
+      // a stream may still be connecting, which binding.close() would wait
+      // for on the JS thread
+      if (streaming) busy.push(binding.stopRadio(handle).then(() => {}, () => {}))
+      if (busy.length > 0) {
+        Promise.all(busy).then(release)
+      } else {
+        release()
+      }
     } else {
       debug('not invoking flush() or close() bindings since no `audio_handle`')
     }
@@ -292,6 +1133,93 @@ class Speaker extends Writable {
   }
 }
 
+/**
+ * Parses an ICY metadata block, like `StreamTitle='...';StreamUrl='...';`, into
+ * its `title` and `url`, keeping the block itself as `raw`. Titles may
+ * contain quotes, so a value runs up to the `';` that ends it.
+ *
+ * @param {String} raw - the metadata block
+ * @return {Object}
+ * @api private
+ */
+
+function parseIcy (raw) {
+  const fields = {}
+  const re = /(\w+)='(.*?)';(?=\w+='|$)/g
+  let m
+  while ((m = re.exec(raw)) !== null) {
+    fields[m[1]] = m[2]
+  }
+  return {
+    title: fields.StreamTitle != null ? fields.StreamTitle : null,
+    url: fields.StreamUrl != null ? fields.StreamUrl : null,
+    raw
+  }
+}
+
+/**
+ * Returns the flat `type, frequency, gain, q` Array of equalizer bands that the
+ * native binding takes.
+ *
+ * @param {Array} bands - normalized equalizer bands
+ * @return {Array}
+ * @api private
+ */
+
+function flattenBands (bands) {
+  const flat = []
+  for (const band of bands) {
+    flat.push(bandTypes[band.type][0], band.frequency, band.gain, band.q)
+  }
+  return flat
+}
+
+/**
+ * Whether `device` names a file to render to rather than a device.
+ *
+ * @api private
+ */
+
+function isFile (device) {
+  return typeof device === 'string' && /^file(\+direct)?:/.test(device)
+}
+
+/**
+ * The key of the devices prepared for the given format and output options.
+ *
+ * @api private
+ */
+
+function preparedKey (speaker, format) {
+  return JSON.stringify([speaker.backend, speaker.device, speaker.channels, speaker.sampleRate, format, speaker.latency, speaker.targetLatency])
+}
+
+/**
+ * Takes a prepared device out of the pool and stops the silence on it, or
+ * returns `null` if there is none for `key` that still plays. Those that
+ * don't are closed.
+ *
+ * @api private
+ */
+
+function takePrepared (key) {
+  const handles = preparedDevices.get(key)
+  while (handles && handles.length > 0) {
+    const handle = handles.shift()
+    if (handles.length === 0) preparedDevices.delete(key)
+    try {
+      binding.claim(handle)
+      return handle
+    } catch (err) {
+      // e.g. the device went away while it idled; the next one is tried,
+      // and then opening it afresh
+      debug('failed to claim a prepared device: %s', err.message)
+      binding.close(handle)
+    }
+  }
+  return null
+}
+
 /**
  * Export information about the `mpg123_module_t` being used.
  */
@@ -335,20 +1263,213 @@ Speaker.getFormat = function getFormat (format) {
   }
 }
 
+/**
+ * Returns the output modules built into the addon, the default one first, as
+ * `{ name, description, formats, default }` objects where `formats` is the
+ * MPG123_ENC_* bitmask that the backend's default device plays in stereo at
+ * 44100 Hz, or 0 until `probe()` has opened it. Nothing gets opened here.
+ *
+ * @return {Array}
+ * @api public
+ */
+
+Speaker.backends = function backends () {
+  const list = binding.backends()
+  for (const backend of list) {
+    backend.formats = Math.max(binding.formats(backend.name, null, 44100, 2), 0)
+  }
+  return list
+}
+
+/**
+ * Opens `device` of the default backend, or of the one named `backend`, and
+ * asks it what it plays, from the libuv threadpool. Resolves with one
+ * `{ sampleRate, channels, formats }` object per rate that mpg123 decodes to,
+ * in mono and in stereo, where `formats` is an MPG123_ENC_* bitmask. The
+ * answers are cached, so each device only gets opened once.
+ *
+ * @param {String} device - device name, `null` for the default one
+ * @param {String} backend - backend name, defaults to the default one
+ * @return {Promise}
+ * @api public
+ */
+
+Speaker.probe = function probe (device, backend) {
+  try {
+    return binding.probe(backend, device)
+  } catch (err) {
+    return Promise.reject(err)
+  }
+}
+
+/**
+ * Lists the devices of every built in backend, or only of the one named
+ * `backend`, and probes them all in parallel from the libuv threadpool.
+ * Resolves with `{ backend, name, description, capabilities }` objects, where
+ * `name` is what the `device` option takes (`null` for backends that can only
+ * play on their default device) and `capabilities` is what `probe()` resolves
+ * with, or `null` if the device couldn't be opened. Backends whose devices
+ * can't be listed, like a sound server that isn't running, are left out.
+ *
+ * @param {String} backend - backend name, all of them if not given
+ * @return {Promise}
+ * @api public
+ */
+
+Speaker.devices = function devices (backend) {
+  let names
+  try {
+    names = backend == null ? binding.backends().map((b) => b.name) : [backend]
+    return Promise.all(names.map((name) => binding.devices(name).catch((err) => {
+      if (backend != null) throw err
+      return []
+    }).then((list) => Promise.all(list.map((device) => {
+      return Speaker.probe(device.name, name).catch(() => null).then((capabilities) => {
+        return { backend: name, name: device.name, description: device.description, capabilities }
+      })
+    }))))).then((lists) => [].concat(...lists))
+  } catch (err) {
+    return Promise.reject(err)
+  }
+}
+
 /**
  * Returns `true` if the given "format" is playable via the "output module"
- * that was selected during compilation, or `false` if not playable.
+ * that was selected during compilation, or the built in one called `backend`,
+ * or `false` if not playable, at 44100 Hz in stereo on the default device.
+ * That is only known once `probe()` has opened the device, which isn't done
+ * here; until then this returns `true` and leaves it to the speaker that
+ * opens the device to find out.
  *
  * @param {Number} format - MPG123_ENC_* format constant
+ * @param {String} backend - backend name, defaults to the default one
  * @return {Boolean} true if the format is playable, false otherwise
  * @api public
  */
 
-Speaker.isSupported = function isSupported (format) {
+Speaker.isSupported = function isSupported (format, backend) {
   if (typeof format !== 'number') format = Speaker.getFormat(format)
-  return (binding.formats & format) === format
+  let formats
+  try {
+    formats = binding.formats(backend, null, 44100, 2)
+  } catch (err) {
+    if (err.code === 'ERR_BACKEND') return false
+    throw err
+  }
+  return formats < 0 || (formats & format) === format
+}
+
+/**
+ * Opens a device for speakers with the given options from the libuv
+ * threadpool, and keeps it running with silence until a speaker with the same
+ * format, device, backend and latency options opens, which then takes it
+ * rather than opening one on the JS thread. Resolves with the number of
+ * devices that are prepared for these options. Not for "file:" devices or
+ * `outOfProcess` speakers.
+ *
+ * @param {Object} opts - the options a `Speaker` would be created with
+ * @return {Promise}
+ * @api public
+ */
+
+Speaker.prepare = function prepare (opts) {
+  try {
+    const speaker = new Speaker(opts)
+    speaker._defaults()
+    const format = Speaker.getFormat(speaker)
+    if (format == null) {
+      throw new Error('invalid PCM format specified')
+    }
+    if (isFile(speaker.device) || speaker.outOfProcess) {
+      throw new TypeError('only devices played in this process can be prepared')
+    }
+
+    const key = preparedKey(speaker, format)
+    const generation = preparedGeneration
+    return binding.prepare(speaker.channels, speaker.sampleRate, format, speaker.device, speaker.latency, speaker.backend, speaker.targetLatency).then((handle) => {
+      if (generation !== preparedGeneration) {
+        binding.close(handle)
+        throw new Error('closePrepared() was called while the device was being prepared')
+      }
+      const handles = preparedDevices.get(key) || []
+      handles.push(handle)
+      preparedDevices.set(key, handles)
+      return handles.length
+    })
+  } catch (err) {
+    return Promise.reject(err)
+  }
+}
+
+/**
+ * Returns the number of devices that `prepare()` has ready for speakers with
+ * the given options.
+ *
+ * @param {Object} opts - the options a `Speaker` would be created with
+ * @return {Number}
+ * @api public
+ */
+
+Speaker.prepared = function prepared (opts) {
+  const speaker = new Speaker(opts)
+  speaker._defaults()
+  const handles = preparedDevices.get(preparedKey(speaker, Speaker.getFormat(speaker)))
+  return handles ? handles.length : 0
+}
+
+/**
+ * Closes all the devices that `prepare()` has ready, and the ones that it is
+ * still opening once they are open.
+ *
+ * @api public
+ */
+
+Speaker.closePrepared = function closePrepared () {
+  preparedGeneration++
+  for (const handles of preparedDevices.values()) {
+    for (const handle of handles) binding.close(handle)
+  }
+  preparedDevices.clear()
+}
+
+/**
+ * Histograms of the native write path of all speakers together, recorded
+ * without locks as the writes happen. `queueWait` is the microseconds that
+ * writes waited for a threadpool thread, `writeTime` the microseconds spent in
+ * the backend's write, `writeBytes` the bytes per write and `callbackDelay` the
+ * microseconds from the backend's write returning to the write being resolved
+ * on the JS thread. Each is a `{ count, mean, max, p50, p90, p99, p999 }`
+ * object; percentiles are within 12.5%. `shortWrites` counts the writes that
+ * the backend took only part of.
+ *
+ * @return {Object}
+ * @api public
+ */
+
+Speaker.metrics = function metrics () {
+  return binding.metrics()
+}
+
+/**
+ * The clock that `writeAt()` times are on: milliseconds since some arbitrary
+ * point, from the same monotonic clock as `process.hrtime()`.
+ *
+ * @return {Number}
+ * @api public
+ */
+
+Speaker.now = function now () {
+  const [s, ns] = process.hrtime()
+  return s * 1e3 + ns / 1e6
 }
 
+/**
+ * The writing end of the rings created by `createRing()`, also available
+ * without the native binding as `require('speaker/ring')`.
+ */
+
+Speaker.RingWriter = ring.RingWriter
+
 /**
  * Module exports.
  */
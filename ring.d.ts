@@ -0,0 +1,5 @@
+import Speaker = require('./');
+
+declare const RingWriter: typeof Speaker.RingWriter;
+
+export = RingWriter;
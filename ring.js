@@ -0,0 +1,140 @@
+'use strict'
+
+/**
+ * The writing end of the SharedArrayBuffer ring that `speaker.createRing()`
+ * hands out. This file doesn't load the native binding, so it is cheap to
+ * `require('speaker/ring')` in worker threads.
+ *
+ * The buffer starts with a header of 32-bit words that the native output thread
+ * and the writers access with atomics, followed by the audio data. The indices
+ * are byte offsets into the data; one frame is always left empty, so that equal
+ * indices mean an empty ring. Keep in sync with src/ring.h.
+ */
+
+const HEADER = 64
+
+const WRITE = 0
+const READ = 1
+const STATE = 2
+const UNDERRUNS = 3
+const FRAME = 4
+
+const RUNNING = 0
+
+/**
+ * Writes PCM audio, in the format of the Speaker that created the ring, into
+ * a ring. There should only be one writer per ring at a time, but it may live
+ * in any thread.
+ *
+ * @param {SharedArrayBuffer} buffer - as returned by `speaker.createRing()`
+ * @api public
+ */
+
+class RingWriter {
+  constructor (buffer) {
+    if (!(buffer instanceof SharedArrayBuffer) || buffer.byteLength <= HEADER) {
+      throw new TypeError('RingWriter needs the SharedArrayBuffer returned by createRing()')
+    }
+    this.buffer = buffer
+    this._header = new Int32Array(buffer, 0, HEADER / 4)
+    this._data = new Uint8Array(buffer, HEADER)
+    this.frameSize = this._header[FRAME]
+  }
+
+  /**
+   * The number of bytes that can be written right now, in whole frames.
+   *
+   * @api public
+   */
+
+  get available () {
+    const size = this._data.length
+    const w = Atomics.load(this._header, WRITE)
+    const r = Atomics.load(this._header, READ)
+    const free = (r > w ? r - w : size - w + r) - this.frameSize
+    return free - free % this.frameSize
+  }
+
+  /**
+   * The number of times the output thread found the ring empty while playing.
+   *
+   * @api public
+   */
+
+  get underruns () {
+    return Atomics.load(this._header, UNDERRUNS)
+  }
+
+  /**
+   * `true` once the Speaker stopped playing from the ring.
+   *
+   * @api public
+   */
+
+  get closed () {
+    return Atomics.load(this._header, STATE) !== RUNNING
+  }
+
+  /**
+   * Copies as many whole frames of `chunk` as fit into the ring, without
+   * blocking.
+   *
+   * @param {Buffer|TypedArray|DataView} chunk - PCM audio
+   * @return {Number} the number of bytes written
+   * @api public
+   */
+
+  write (chunk) {
+    const src = new Uint8Array(chunk.buffer, chunk.byteOffset, chunk.byteLength)
+    const size = this._data.length
+    const w = Atomics.load(this._header, WRITE)
+    const n = Math.min(this.available, src.length - src.length % this.frameSize)
+    const first = Math.min(n, size - w)
+    this._data.set(src.subarray(0, first), w)
+    if (n > first) this._data.set(src.subarray(first, n), 0)
+    Atomics.store(this._header, WRITE, (w + n) % size)
+    return n
+  }
+
+  /**
+   * Waits until `bytes` can be written, or the ring is closed. This blocks the
+   * calling thread, so it is only allowed in worker threads.
+   *
+   * @param {Number} bytes
+   * @param {Number} timeout - in milliseconds, defaults to `Infinity`
+   * @return {Boolean} `false` if it timed out or the ring is closed
+   * @api public
+   */
+
+  waitForSpace (bytes, timeout = Infinity) {
+    const deadline = Date.now() + timeout
+    while (this.available < bytes) {
+      if (this.closed || Date.now() >= deadline) return false
+      // the output thread doesn't notify, so just sleep for a millisecond
+      const r = Atomics.load(this._header, READ)
+      Atomics.wait(this._header, READ, r, 1)
+    }
+    return !this.closed
+  }
+}
+
+/**
+ * Creates the SharedArrayBuffer of a ring for `frames` frames of `frameSize`
+ * bytes.
+ *
+ * @api private
+ */
+
+function allocate (frames, frameSize) {
+  const buffer = new SharedArrayBuffer(HEADER + (frames + 1) * frameSize)
+  new Int32Array(buffer, 0, HEADER / 4)[FRAME] = frameSize
+  return buffer
+}
+
+/**
+ * Module exports.
+ */
+
+exports = module.exports = RingWriter
+exports.RingWriter = RingWriter
+exports.allocate = allocate
@@ -0,0 +1,72 @@
+#ifndef SPEAKER_ATOMIC_H
+#define SPEAKER_ATOMIC_H
+
+#include <stdint.h>
+
+/* Just enough atomics to hand values from the JS thread to the audio threads
+ * without taking a lock. */
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+
+static __inline uint32_t atomic_load_u32(volatile uint32_t *p) {
+  return (uint32_t) _InterlockedCompareExchange((volatile long *) p, 0, 0);
+}
+
+static __inline void atomic_store_u32(volatile uint32_t *p, uint32_t v) {
+  _InterlockedExchange((volatile long *) p, (long) v);
+}
+
+static __inline void atomic_add_u32(volatile uint32_t *p, uint32_t v) {
+  _InterlockedExchangeAdd((volatile long *) p, (long) v);
+}
+
+static __inline void atomic_add_u64(volatile uint64_t *p, uint64_t v) {
+  _InterlockedExchangeAdd64((volatile __int64 *) p, (__int64) v);
+}
+
+/* raises `*p` to `v` if it is lower */
+static __inline void atomic_max_u64(volatile uint64_t *p, uint64_t v) {
+  __int64 old = *(volatile __int64 *) p;
+  while ((uint64_t) old < v) {
+    __int64 seen = _InterlockedCompareExchange64((volatile __int64 *) p, (__int64) v, old);
+    if (seen == old) break;
+    old = seen;
+  }
+}
+
+/* interlocked operations are full barriers */
+static __inline void atomic_fence(void) {
+  volatile long barrier = 0;
+  _InterlockedExchange(&barrier, 0);
+}
+#else
+static inline uint32_t atomic_load_u32(volatile uint32_t *p) {
+  return __atomic_load_n(p, __ATOMIC_ACQUIRE);
+}
+
+static inline void atomic_store_u32(volatile uint32_t *p, uint32_t v) {
+  __atomic_store_n(p, v, __ATOMIC_RELEASE);
+}
+
+static inline void atomic_add_u32(volatile uint32_t *p, uint32_t v) {
+  __atomic_fetch_add(p, v, __ATOMIC_RELAXED);
+}
+
+static inline void atomic_add_u64(volatile uint64_t *p, uint64_t v) {
+  __atomic_fetch_add(p, v, __ATOMIC_RELAXED);
+}
+
+/* raises `*p` to `v` if it is lower */
+static inline void atomic_max_u64(volatile uint64_t *p, uint64_t v) {
+  uint64_t old = __atomic_load_n(p, __ATOMIC_RELAXED);
+  while (old < v && !__atomic_compare_exchange_n(p, &old, v, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+  }
+}
+
+static inline void atomic_fence(void) {
+  __atomic_thread_fence(__ATOMIC_SEQ_CST);
+}
+#endif
+
+#endif
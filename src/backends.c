@@ -0,0 +1,84 @@
+#include <string.h>
+
+#include "backends.h"
+
+/* the SPEAKER_BACKEND_* defines come from the output target */
+#ifdef SPEAKER_BACKEND_ALSA
+extern mpg123_module_t mpg123_output_module_info_alsa;
+#endif
+#ifdef SPEAKER_BACKEND_PULSE
+extern mpg123_module_t mpg123_output_module_info_pulse;
+#endif
+#ifdef SPEAKER_BACKEND_JACK
+extern mpg123_module_t mpg123_output_module_info_jack;
+#endif
+#ifdef SPEAKER_BACKEND_OSS
+extern mpg123_module_t mpg123_output_module_info_oss;
+#endif
+#ifdef SPEAKER_BACKEND_SDL
+extern mpg123_module_t mpg123_output_module_info_sdl;
+#endif
+#ifdef SPEAKER_BACKEND_OPENAL
+extern mpg123_module_t mpg123_output_module_info_openal;
+#endif
+#ifdef SPEAKER_BACKEND_COREAUDIO
+extern mpg123_module_t mpg123_output_module_info_coreaudio;
+#endif
+#ifdef SPEAKER_BACKEND_WIN32
+extern mpg123_module_t mpg123_output_module_info_win32;
+#endif
+#ifdef SPEAKER_BACKEND_BENCH
+extern mpg123_module_t mpg123_output_module_info_bench;
+#endif
+#ifdef SPEAKER_BACKEND_DUMMY
+extern mpg123_module_t mpg123_output_module_info_dummy;
+#endif
+
+static mpg123_module_t *modules[] = {
+  &mpg123_output_module_info,
+#ifdef SPEAKER_BACKEND_ALSA
+  &mpg123_output_module_info_alsa,
+#endif
+#ifdef SPEAKER_BACKEND_PULSE
+  &mpg123_output_module_info_pulse,
+#endif
+#ifdef SPEAKER_BACKEND_JACK
+  &mpg123_output_module_info_jack,
+#endif
+#ifdef SPEAKER_BACKEND_OSS
+  &mpg123_output_module_info_oss,
+#endif
+#ifdef SPEAKER_BACKEND_SDL
+  &mpg123_output_module_info_sdl,
+#endif
+#ifdef SPEAKER_BACKEND_OPENAL
+  &mpg123_output_module_info_openal,
+#endif
+#ifdef SPEAKER_BACKEND_COREAUDIO
+  &mpg123_output_module_info_coreaudio,
+#endif
+#ifdef SPEAKER_BACKEND_WIN32
+  &mpg123_output_module_info_win32,
+#endif
+#ifdef SPEAKER_BACKEND_BENCH
+  &mpg123_output_module_info_bench,
+#endif
+#ifdef SPEAKER_BACKEND_DUMMY
+  &mpg123_output_module_info_dummy,
+#endif
+  NULL
+};
+
+mpg123_module_t *backend_find(const char *name) {
+  size_t i;
+
+  if (name == NULL) return modules[0];
+  for (i = 0; modules[i]; i++) {
+    if (strcmp(modules[i]->name, name) == 0) return modules[i];
+  }
+  return NULL;
+}
+
+mpg123_module_t *backend_at(size_t i) {
+  return i < sizeof(modules) / sizeof(modules[0]) ? modules[i] : NULL;
+}
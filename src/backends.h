@@ -0,0 +1,19 @@
+#ifndef SPEAKER_BACKENDS_H
+#define SPEAKER_BACKENDS_H
+
+#include <stddef.h>
+
+#include "output.h"
+
+/* The output modules built into the addon: the default one, which mpg123.gyp
+ * builds as `mpg123_output_module_info`, first, followed by any others that
+ * were found at build time (see deps/mpg123/backends.js). */
+
+/* Returns the module called `name`, the default one for NULL, or NULL if
+ * there is no such module. */
+mpg123_module_t *backend_find(const char *name);
+
+/* Returns the `i`th module, or NULL past the last one. */
+mpg123_module_t *backend_at(size_t i);
+
+#endif
@@ -1,105 +1,1322 @@
 #include <assert.h>
+#include <errno.h>
+#include <math.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
 #define NAPI_VERSION 1
 #include <node_api.h>
+#include <uv.h>
 
 #include "output.h"
-
-extern mpg123_module_t mpg123_output_module_info;
+#include "atomic.h"
+#include "backends.h"
+#include "clips.h"
+#include "drift.h"
+#include "dsp.h"
+#include "filesink.h"
+#include "idle.h"
+#include "jitter.h"
+#include "metrics.h"
+#include "playlist.h"
+#include "probe.h"
+#include "radio.h"
+#include "remote.h"
+#include "ring.h"
 
 typedef struct {
   char *device;
   audio_output_t ao;
+  playlist *playlist;
+
+  /* volume and EQ, applied to a copy of the written data unless they are
+   * neutral */
+  dsp_gain gain;
+  dsp_eq eq;
+  unsigned char *scratch;
+  size_t scratch_size;
+
+  /* set when the latency is to be held at a target by resampling */
+  bool drifting;
+  drift drift;
+
+  /* set when `ao` writes to a helper process rather than to the device */
+  bool remote;
+  int remote_fds[2];
+
+  /* the SharedArrayBuffer being played from, if any, and a reference that
+   * keeps it alive for the output thread */
+  ring ring;
+  napi_ref ring_ref;
+
+  /* packets pushed from JS, played out in order on a native thread */
+  jitter jitter;
+
+  /* an internet radio stream, fetched and played on native threads */
+  radio radio;
+
+  /* short sounds kept in the output format, mixed on a native thread */
+  clips clips;
+
+  /* silence written while the device waits to be claimed, for handles from
+   * `prepare()` */
+  idle idle;
+
+  /* the write path's histograms, also recorded into `metrics_process` */
+  metrics metrics;
 } Speaker;
 
 typedef struct {
+  Speaker *speaker;
   audio_output_t *ao;
 
   size_t length;
   size_t written;
   unsigned char* buffer;
 
-  napi_deferred deferred;
-} WriteData;
+  /* what kept the chunk from being written at all, or NULL */
+  const char *error;
+
+  /* uv_hrtime() when the write was queued and when ao->write() returned */
+  uint64_t queued;
+  uint64_t done;
+
+  /* for scheduled writes: when the first frame is to be heard, in ms on the
+   * uv_hrtime() clock, when it is expected to be, and the frames of silence
+   * that were written before it or dropped from its start to get there */
+  bool scheduled;
+  double at;
+  double start;
+  size_t silence;
+  size_t trimmed;
+
+  napi_deferred deferred;
+} WriteData;
+
+typedef struct {
+  Speaker *speaker;
+  bool drain;
+
+  napi_deferred deferred;
+  napi_async_work work;
+} RingData;
+
+typedef struct {
+  Speaker *speaker;
+  bool drain;
+
+  napi_deferred deferred;
+  napi_async_work work;
+} JitterData;
+
+typedef struct {
+  Speaker *speaker;
+
+  napi_deferred deferred;
+  napi_async_work work;
+} RadioData;
+
+typedef struct {
+  Speaker *speaker;
+  bool drain;
+
+  napi_deferred deferred;
+  napi_async_work work;
+} ClipsData;
+
+typedef struct {
+  Speaker *speaker;
+  char *id;
+
+  /* a file to decode, or PCM audio to convert */
+  char *path;
+  unsigned char *pcm;
+  size_t frames;
+  int32_t encoding;
+  int32_t channels;
+
+  const char *error;
+  char message[256];
+
+  napi_deferred deferred;
+  napi_async_work work;
+} LoadClipData;
+
+typedef struct {
+  Speaker *speaker;
+  mpg123_module_t *module;
+
+  const char *error;
+
+  napi_deferred deferred;
+  napi_async_work work;
+} PrepareData;
+
+typedef struct {
+  Speaker *speaker;
+
+  size_t frames;
+  size_t crossfade;
+  char **paths;
+  uint32_t path_count;
+  playlist_result result;
+
+  napi_deferred deferred;
+  napi_async_work work;
+} PlayData;
+
+typedef struct {
+  mpg123_module_t *module;
+
+  int result;
+  char **names;             /* NULL for the default device */
+  char **descriptions;
+  size_t count;
+  size_t size;
+
+  napi_deferred deferred;
+  napi_async_work work;
+} DevicesData;
+
+typedef struct {
+  mpg123_module_t *module;
+  char *device;
+
+  int result;
+  probe_entry *entries;
+  size_t count;
+
+  napi_deferred deferred;
+  napi_async_work work;
+} ProbeData;
+
+bool is_string(napi_env env, napi_value value) {
+  napi_valuetype valuetype;
+  assert(napi_typeof(env, value, &valuetype) == napi_ok);
+  return valuetype == napi_string;
+}
+
+/* Returns the output module named by `value`, the default one for anything
+ * but a string, or throws and returns NULL if there is no such module. */
+mpg123_module_t *get_module(napi_env env, napi_value value) {
+  char backend_name[64];
+  if (!is_string(env, value)) return backend_find(NULL);
+
+  assert(napi_get_value_string_utf8(env, value, backend_name, sizeof(backend_name), NULL) == napi_ok);
+  mpg123_module_t *module = backend_find(backend_name);
+  if (!module) {
+    char message[128];
+    snprintf(message, sizeof(message), "No \"%s\" backend is built in", backend_name);
+    napi_throw_error(env, "ERR_BACKEND", message);
+  }
+  return module;
+}
+
+/* Returns a copy of the string `value` for the caller to free(), or NULL if
+ * it isn't a string. */
+char *get_string(napi_env env, napi_value value) {
+  size_t size;
+  if (!is_string(env, value)) return NULL;
+
+  assert(napi_get_value_string_utf8(env, value, NULL, 0, &size) == napi_ok);
+  char *string = malloc(++size);
+  assert(napi_get_value_string_utf8(env, value, string, size, NULL) == napi_ok);
+  return string;
+}
+
+void finalize(napi_env env, void* data, void* hint) {
+  // FIXME: Maybe close here?
+  free(data);
+}
+
+/* Frees what speaker_new() set up, for a Speaker that never got handed out. */
+static void speaker_delete(Speaker *speaker) {
+  dsp_eq_free(&speaker->eq);
+  if (speaker->drifting) drift_free(&speaker->drift);
+  free(speaker->device);
+  free(speaker);
+}
+
+/* Sets up a Speaker for the format given by `channels`, `rate` and `format`,
+ * with `latency` and `target` in ms or NULL for none, without opening
+ * anything. Throws and returns NULL if out of memory. */
+static Speaker *speaker_new(napi_env env, napi_value channels, napi_value rate, napi_value format,
+                            napi_value device, napi_value latency, napi_value target) {
+  Speaker *speaker = malloc(sizeof(Speaker));
+  memset(speaker, 0, sizeof(Speaker));
+  audio_output_t *ao = &speaker->ao;
+
+  assert(napi_get_value_int32(env, channels, &ao->channels) == napi_ok);
+  int32_t _rate;
+  assert(napi_get_value_int32(env, rate, &_rate) == napi_ok);
+  ao->rate = _rate;
+  assert(napi_get_value_int32(env, format, &ao->format) == napi_ok); /* MPG123_ENC_* format */
+
+  speaker->device = get_string(env, device);
+  ao->device = speaker->device;
+
+  if (latency) {
+    double ms;
+    assert(napi_get_value_double(env, latency, &ms) == napi_ok); /* ms of device buffering, 0 for the default */
+    ao->latency = (long) (ms * 1000);
+  }
+
+  dsp_gain_init(&speaker->gain, ao->rate);
+  if (dsp_eq_init(&speaker->eq, ao->rate, ao->channels) != 0) {
+    napi_throw_error(env, "ERR_OPEN", "Out of memory");
+    speaker_delete(speaker);
+    return NULL;
+  }
+
+  if (target) {
+    double ms;
+    assert(napi_get_value_double(env, target, &ms) == napi_ok); /* ms of latency to hold, 0 for none */
+    if (ms > 0) {
+      if (drift_init(&speaker->drift, ao->rate, ao->channels, ms) != 0) {
+        napi_throw_error(env, "ERR_OPEN", "Out of memory");
+        speaker_delete(speaker);
+        return NULL;
+      }
+      speaker->drifting = true;
+    }
+  }
+  return speaker;
+}
+
+/* Opens the device through `module`. Returns NULL on success, or what went
+ * wrong, having undone init_output(). */
+static const char *open_device(mpg123_module_t *module, audio_output_t *ao) {
+  /* init_output() */
+  if (module->init_output(ao) != 0) return "Failed to initialize output device";
+
+  /* open(), which returns a file descriptor for some modules */
+  if (ao->open(ao) < 0) {
+    if (ao->deinit) ao->deinit(ao);
+    return "Failed to open output device";
+  }
+  return NULL;
+}
+
+napi_value speaker_open(napi_env env, napi_callback_info info) {
+  size_t argc = 8;
+  napi_value args[8];
+  assert(napi_get_cb_info(env, info, &argc, args, NULL, NULL) == napi_ok);
+
+  /* the output module, the default one unless named */
+  mpg123_module_t *module = get_module(env, args[6]);
+  if (!module) return NULL;
+
+  Speaker *speaker = speaker_new(env, args[0], args[1], args[2], args[3],
+                                 argc > 5 ? args[5] : NULL, argc > 7 ? args[7] : NULL);
+  if (!speaker) return NULL;
+  audio_output_t *ao = &speaker->ao;
+
+  bool out_of_process = false;
+  if (argc > 4) {
+    assert(napi_get_value_bool(env, args[4], &out_of_process) == napi_ok);
+  }
+
+  int direct;
+  const char *file = filesink_path(ao->device, &direct);
+
+  if (file) {
+    /* "file:" devices render to a file, whatever the backend is */
+    if (filesink_open(ao, file, direct) != 0) {
+      char message[512];
+      const char *reason = errno != EINVAL ? strerror(errno)
+                         : filesink_is_wav(file) ? "the PCM format doesn't fit a WAV file"
+                         : "the PCM format can't be written to a file";
+      snprintf(message, sizeof(message), "Failed to open \"%s\" for writing: %s", file, reason);
+      napi_throw_error(env, "ERR_OPEN", message);
+      speaker_delete(speaker);
+      return NULL;
+    }
+  } else if (out_of_process) {
+    /* the device gets opened by the helper process, once it has been started
+     * with the descriptors from `remoteFds()` */
+    if (remote_open(ao, &speaker->remote_fds[0], &speaker->remote_fds[1]) != 0) {
+      napi_throw_error(env, "ERR_OPEN", "Failed to set up out-of-process output");
+      speaker_delete(speaker);
+      return NULL;
+    }
+    speaker->remote = true;
+  } else {
+    const char *error = open_device(module, ao);
+    if (error) {
+      napi_throw_error(env, "ERR_OPEN", error);
+      speaker_delete(speaker);
+      return NULL;
+    }
+  }
+
+  napi_value handle;
+  assert(napi_create_object(env, &handle) == napi_ok);
+  assert(napi_wrap(env, handle, speaker, finalize, NULL, NULL) == napi_ok);
+
+  return handle;
+}
+
+void prepare_execute(napi_env env, void* _data) {
+  PrepareData *data = _data;
+  audio_output_t *ao = &data->speaker->ao;
+
+  data->error = open_device(data->module, ao);
+  if (data->error) return;
+
+  /* keep the device going until a Speaker takes it */
+  if (idle_start(&data->speaker->idle, ao) != 0) {
+    ao->close(ao);
+    if (ao->deinit) ao->deinit(ao);
+    data->error = "Failed to start the output thread";
+  }
+}
+
+void prepare_complete(napi_env env, napi_status status, void* _data) {
+  PrepareData *data = _data;
+
+  if (data->error) {
+    napi_value message, error;
+    assert(napi_create_string_utf8(env, data->error, NAPI_AUTO_LENGTH, &message) == napi_ok);
+    assert(napi_create_error(env, NULL, message, &error) == napi_ok);
+    assert(napi_reject_deferred(env, data->deferred, error) == napi_ok);
+    speaker_delete(data->speaker);
+  } else {
+    napi_value handle;
+    assert(napi_create_object(env, &handle) == napi_ok);
+    assert(napi_wrap(env, handle, data->speaker, finalize, NULL, NULL) == napi_ok);
+    assert(napi_resolve_deferred(env, data->deferred, handle) == napi_ok);
+  }
+
+  assert(napi_delete_async_work(env, data->work) == napi_ok);
+  free(data);
+}
+
+/* Opens a device like `open()` does, but on the threadpool, and keeps it
+ * running with silence until `claim()` is called with the handle that the
+ * returned Promise resolves with. Not for "file:" devices or out-of-process
+ * output. */
+napi_value speaker_prepare(napi_env env, napi_callback_info info) {
+  size_t argc = 7;
+  napi_value args[7];
+  assert(napi_get_cb_info(env, info, &argc, args, NULL, NULL) == napi_ok);
+
+  mpg123_module_t *module = get_module(env, args[5]);
+  if (!module) return NULL;
+
+  Speaker *speaker = speaker_new(env, args[0], args[1], args[2], args[3], args[4], args[6]);
+  if (!speaker) return NULL;
+
+  PrepareData *data = malloc(sizeof(PrepareData));
+  data->speaker = speaker;
+  data->module = module;
+  data->error = NULL;
+
+  napi_value promise;
+  assert(napi_create_promise(env, &data->deferred, &promise) == napi_ok);
+
+  napi_value work_name;
+  assert(napi_create_string_utf8(env, "speaker:prepare", NAPI_AUTO_LENGTH, &work_name) == napi_ok);
+  assert(napi_create_async_work(env, NULL, work_name, prepare_execute, prepare_complete, (void*) data, &data->work) == napi_ok);
+  assert(napi_queue_async_work(env, data->work) == napi_ok);
+
+  return promise;
+}
+
+/* Stops the silence on a device from `prepare()`, for it to be written to. */
+napi_value speaker_claim(napi_env env, napi_callback_info info) {
+  size_t argc = 1;
+  napi_value args[1];
+  assert(napi_get_cb_info(env, info, &argc, args, NULL, NULL) == napi_ok);
+
+  Speaker *speaker;
+  assert(napi_unwrap(env, args[0], (void**) &speaker) == napi_ok);
+
+  if (idle_stop(&speaker->idle) != 0) {
+    napi_throw_error(env, "ERR_OPEN", "The prepared output device stopped taking audio");
+  }
+  return NULL;
+}
+
+/* Records `value` into the histogram of the speaker and the process-wide one. */
+#define RECORD(speaker, histogram, value) do {\
+  uint64_t _value = (value);\
+  metrics_record(&(speaker)->metrics.histogram, _value);\
+  metrics_record(&metrics_process.histogram, _value);\
+} while (0)
+
+/* Writes `frames` frames of silence, returns how many were written. */
+static size_t write_silence(audio_output_t *ao, size_t frames) {
+  static const float zeros[1024];
+  unsigned char block[sizeof(zeros) * 2];
+  size_t frame_size = dsp_sample_size(ao->format) * ao->channels;
+  size_t per_block = sizeof(zeros) / sizeof(zeros[0]) / ao->channels;
+  size_t done = 0;
+
+  dsp_from_float(block, zeros, per_block * ao->channels, ao->format);
+  while (done < frames) {
+    size_t n = frames - done < per_block ? frames - done : per_block;
+    int written = ao->write(ao, block, (int) (n * frame_size));
+    if (written <= 0) break;
+    done += written / frame_size;
+  }
+  return done;
+}
+
+/* Lines a scheduled write up with its start time: writes silence first if the
+ * device would get to it early, or drops frames from its start if late, going
+ * by how far behind the device is. Backends that can't tell are taken to play
+ * what they are given right away. */
+static void schedule(WriteData *data) {
+  audio_output_t *ao = data->ao;
+  size_t frame_size = dsp_sample_size(ao->format) * ao->channels;
+  size_t frames = data->length / frame_size;
+  double when = 0;
+  int delay = -1;
+
+  if (ao->delay_at) {
+    delay = ao->delay_at(ao, &when);
+    when *= 1e3;
+  }
+  if (delay < 0) {
+    delay = ao->delay ? ao->delay(ao) : 0;
+    when = uv_hrtime() / 1e6;
+    if (delay < 0) delay = 0;
+  }
+
+  /* when the first frame written now would be heard */
+  double heard = when + delay * 1e3 / ao->rate;
+  double offset = floor((data->at - heard) * ao->rate / 1e3 + 0.5);
+
+  if (offset > 0) {
+    data->silence = write_silence(ao, (size_t) offset);
+  } else if (offset < 0) {
+    data->trimmed = -offset < frames ? (size_t) -offset : frames;
+    data->buffer += data->trimmed * frame_size;
+    data->length -= data->trimmed * frame_size;
+  }
+  data->start = heard + (double) data->silence * 1e3 / ao->rate;
+}
+
+void write_execute(napi_env env, void* _data) {
+  WriteData* data = _data;
+  Speaker *speaker = data->speaker;
+  audio_output_t *ao = data->ao;
+  int gain = !dsp_gain_is_unity(&speaker->gain);
+  int eq = !dsp_eq_is_flat(&speaker->eq);
+  uint64_t start = uv_hrtime();
+
+  RECORD(speaker, queue_wait, (start - data->queued) / 1000);
+
+  if (data->scheduled) schedule(data);
+  unsigned char *buffer = data->buffer;
+
+  if (gain || eq) {
+    /* the chunk belongs to JS land, so it can't be scaled in place. writes are
+     * never in flight at the same time, so one scratch buffer will do */
+    size_t frame_size = dsp_sample_size(ao->format) * ao->channels;
+    if (speaker->scratch_size < data->length) {
+      unsigned char *scratch = realloc(speaker->scratch, data->length);
+      if (!scratch) {
+        data->error = "Out of memory";
+        return;
+      }
+      speaker->scratch = scratch;
+      speaker->scratch_size = data->length;
+    }
+    memcpy(speaker->scratch, data->buffer, data->length);
+    if (eq) dsp_eq_apply(&speaker->eq, speaker->scratch, data->length / frame_size, ao->format);
+    if (gain) dsp_gain_apply(&speaker->gain, speaker->scratch, data->length / frame_size, ao->channels, ao->format);
+    buffer = speaker->scratch;
+  }
+
+  size_t length = data->length;
+  if (speaker->drifting && length > 0) {
+    size_t frame_size = dsp_sample_size(ao->format) * ao->channels;
+    long queued = ao->delay ? ao->delay(ao) : -1;
+    length = drift_process(&speaker->drift, buffer, length / frame_size, ao->format, queued, &buffer) * frame_size;
+  }
+
+  data->written = length ? ao->write(ao, buffer, length) : 0;
+  data->done = uv_hrtime();
+
+  /* the resampled length is what the backend saw, the caller wants to hear
+   * about its own */
+  if (length != data->length && (int) data->written >= 0) {
+    data->written = data->written == length ? data->length : data->written * data->length / length;
+  }
+
+  RECORD(speaker, write_time, (data->done - start) / 1000);
+  RECORD(speaker, write_bytes, data->length);
+  if ((int) data->written < (int) data->length) {
+    atomic_add_u32(&speaker->metrics.short_writes, 1);
+    atomic_add_u32(&metrics_process.short_writes, 1);
+  }
+
+  /* dropped frames count as written, they were dealt with */
+  if ((int) data->written >= 0) {
+    size_t trimmed = data->trimmed * dsp_sample_size(ao->format) * ao->channels;
+    data->written += trimmed;
+    data->length += trimmed;
+  }
+}
+
+void write_complete(napi_env env, napi_status status, void* _data) {
+  WriteData* data = _data;
+
+  /* the speaker outlives its writes, the handle keeps it alive */
+  if (data->done) RECORD(data->speaker, callback_delay, (uv_hrtime() - data->done) / 1000);
+
+  if (data->error) {
+    napi_value code, message, error;
+    assert(napi_create_string_utf8(env, "ERR_WRITE", NAPI_AUTO_LENGTH, &code) == napi_ok);
+    assert(napi_create_string_utf8(env, data->error, NAPI_AUTO_LENGTH, &message) == napi_ok);
+    assert(napi_create_error(env, code, message, &error) == napi_ok);
+    assert(napi_reject_deferred(env, data->deferred, error) == napi_ok);
+    free(_data);
+    return;
+  }
+
+  napi_value written;
+  assert(napi_create_uint32(env, data->written, &written) == napi_ok);
+
+  if (data->scheduled) {
+    /* the frame that was to be heard at `at` now is at `start`, give or take
+     * a frame of rounding, unless all of it was too late to play */
+    audio_output_t *ao = data->ao;
+    size_t frame_size = dsp_sample_size(ao->format) * ao->channels;
+    double error = data->start - (data->at + (double) data->trimmed * 1e3 / ao->rate);
+    bool late = data->trimmed * frame_size == data->length && data->length > 0;
+    napi_value result, value;
+
+    assert(napi_create_object(env, &result) == napi_ok);
+    assert(napi_set_named_property(env, result, "written", written) == napi_ok);
+    assert(napi_create_double(env, data->start, &value) == napi_ok);
+    assert(napi_set_named_property(env, result, "start", value) == napi_ok);
+    assert(napi_create_double(env, late ? 0 : error, &value) == napi_ok);
+    assert(napi_set_named_property(env, result, "error", value) == napi_ok);
+    assert(napi_create_uint32(env, data->silence, &value) == napi_ok);
+    assert(napi_set_named_property(env, result, "silence", value) == napi_ok);
+    assert(napi_create_uint32(env, data->trimmed, &value) == napi_ok);
+    assert(napi_set_named_property(env, result, "trimmed", value) == napi_ok);
+    written = result;
+  }
+  assert(napi_resolve_deferred(env, data->deferred, written) == napi_ok);
+
+  free(_data);
+}
+
+napi_value speaker_write(napi_env env, napi_callback_info info) {
+  size_t argc = 3;
+  napi_value args[3];
+  assert(napi_get_cb_info(env, info, &argc, args, NULL, NULL) == napi_ok);
+
+  Speaker *speaker;
+  assert(napi_unwrap(env, args[0], (void**) &speaker) == napi_ok);
+
+  WriteData* data = calloc(1, sizeof(WriteData));
+  data->speaker = speaker;
+  data->ao = &speaker->ao;
+  data->queued = uv_hrtime();
+  assert(napi_get_typedarray_info(env, args[1], NULL, &data->length, (void **) &data->buffer, NULL, NULL) == napi_ok);
+
+  /* an optional time to start playing at, in ms on the uv_hrtime() clock */
+  napi_valuetype valuetype = napi_undefined;
+  if (argc > 2) assert(napi_typeof(env, args[2], &valuetype) == napi_ok);
+  if (valuetype == napi_number) {
+    data->scheduled = true;
+    assert(napi_get_value_double(env, args[2], &data->at) == napi_ok);
+  }
+
+  napi_value promise;
+  assert(napi_create_promise(env, &data->deferred, &promise) == napi_ok);
+
+  napi_value work_name;
+  assert(napi_create_string_utf8(env, "speaker:write", NAPI_AUTO_LENGTH, &work_name) == napi_ok);
+
+  napi_async_work work;
+  assert(napi_create_async_work(env, NULL, work_name, write_execute, write_complete, (void*) data, &work) == napi_ok);
+
+  assert(napi_queue_async_work(env, work) == napi_ok);
+
+  return promise;
+}
+
+void play_execute(napi_env env, void* _data) {
+  PlayData* data = _data;
+  Speaker *speaker = data->speaker;
+  uint32_t i;
+
+  if (!speaker->playlist) {
+    speaker->playlist = playlist_new(speaker->ao.rate, speaker->ao.channels, speaker->ao.format, data->frames);
+  }
+  if (!speaker->playlist) {
+    data->result.error = "Out of memory";
+    return;
+  }
+  speaker->playlist->gain = &speaker->gain;
+  speaker->playlist->eq = &speaker->eq;
+
+  for (i = 0; i < data->path_count; i++) {
+    playlist_add(speaker->playlist, data->paths[i]);
+  }
+  playlist_set_crossfade(speaker->playlist, data->crossfade);
+  playlist_play(speaker->playlist, &speaker->ao, data->frames, &data->result);
+}
+
+void play_complete(napi_env env, napi_status status, void* _data) {
+  PlayData* data = _data;
+  playlist_result *result = &data->result;
+  uint32_t i;
+
+  if (result->error) {
+    napi_value code, message, error;
+    assert(napi_create_string_utf8(env, "ERR_PLAY", NAPI_AUTO_LENGTH, &code) == napi_ok);
+    assert(napi_create_string_utf8(env, result->error, NAPI_AUTO_LENGTH, &message) == napi_ok);
+    assert(napi_create_error(env, code, message, &error) == napi_ok);
+    assert(napi_reject_deferred(env, data->deferred, error) == napi_ok);
+  } else {
+    napi_value ret;
+    assert(napi_create_object(env, &ret) == napi_ok);
+
+    napi_value written;
+    assert(napi_create_uint32(env, result->written, &written) == napi_ok);
+    assert(napi_set_named_property(env, ret, "written", written) == napi_ok);
+
+    napi_value done;
+    assert(napi_get_boolean(env, result->done, &done) == napi_ok);
+    assert(napi_set_named_property(env, ret, "done", done) == napi_ok);
+
+    /* one entry per track that started (`null`) or was skipped (the reason) */
+    napi_value events;
+    assert(napi_create_array_with_length(env, result->event_count, &events) == napi_ok);
+    for (i = 0; i < (uint32_t) result->event_count; i++) {
+      napi_value event;
+      if (result->events[i] == PLAYLIST_SKIPPED) {
+        assert(napi_create_string_utf8(env, result->reasons[i], NAPI_AUTO_LENGTH, &event) == napi_ok);
+      } else {
+        assert(napi_get_null(env, &event) == napi_ok);
+      }
+      assert(napi_set_element(env, events, i, event) == napi_ok);
+    }
+    assert(napi_set_named_property(env, ret, "events", events) == napi_ok);
+
+    assert(napi_resolve_deferred(env, data->deferred, ret) == napi_ok);
+  }
+
+  for (i = 0; i < data->path_count; i++) free(data->paths[i]);
+  free(data->paths);
+  assert(napi_delete_async_work(env, data->work) == napi_ok);
+  free(data);
+}
+
+napi_value speaker_play(napi_env env, napi_callback_info info) {
+  size_t argc = 4;
+  napi_value args[4];
+  assert(napi_get_cb_info(env, info, &argc, args, NULL, NULL) == napi_ok);
+
+  PlayData* data = calloc(1, sizeof(PlayData));
+  assert(napi_unwrap(env, args[0], (void**) &data->speaker) == napi_ok);
+
+  uint32_t frames, crossfade;
+  assert(napi_get_value_uint32(env, args[1], &frames) == napi_ok); /* frames per step */
+  assert(napi_get_value_uint32(env, args[2], &crossfade) == napi_ok); /* crossfade frames */
+  data->frames = frames;
+  data->crossfade = crossfade;
+
+  /* files queued since the last call, handed over to the playing job */
+  assert(napi_get_array_length(env, args[3], &data->path_count) == napi_ok);
+  data->paths = calloc(data->path_count + 1, sizeof(char *));
+  for (uint32_t i = 0; i < data->path_count; i++) {
+    napi_value path;
+    size_t path_size;
+    assert(napi_get_element(env, args[3], i, &path) == napi_ok);
+    assert(napi_get_value_string_utf8(env, path, NULL, 0, &path_size) == napi_ok);
+    data->paths[i] = malloc(++path_size);
+    assert(napi_get_value_string_utf8(env, path, data->paths[i], path_size, NULL) == napi_ok);
+  }
+
+  napi_value promise;
+  assert(napi_create_promise(env, &data->deferred, &promise) == napi_ok);
+
+  napi_value work_name;
+  assert(napi_create_string_utf8(env, "speaker:play", NAPI_AUTO_LENGTH, &work_name) == napi_ok);
+
+  assert(napi_create_async_work(env, NULL, work_name, play_execute, play_complete, (void*) data, &data->work) == napi_ok);
+
+  assert(napi_queue_async_work(env, data->work) == napi_ok);
+
+  return promise;
+}
+
+napi_value speaker_set_volume(napi_env env, napi_callback_info info) {
+  size_t argc = 2;
+  napi_value args[2];
+  assert(napi_get_cb_info(env, info, &argc, args, NULL, NULL) == napi_ok);
+
+  Speaker *speaker;
+  assert(napi_unwrap(env, args[0], (void**) &speaker) == napi_ok);
+
+  double volume;
+  assert(napi_get_value_double(env, args[1], &volume) == napi_ok);
+
+  /* picked up by the next write, which ramps over to it */
+  dsp_gain_set(&speaker->gain, (float) volume);
+  return NULL;
+}
+
+napi_value speaker_set_equalizer(napi_env env, napi_callback_info info) {
+  size_t argc = 2;
+  napi_value args[2];
+  assert(napi_get_cb_info(env, info, &argc, args, NULL, NULL) == napi_ok);
+
+  Speaker *speaker;
+  assert(napi_unwrap(env, args[0], (void**) &speaker) == napi_ok);
+
+  /* flat array of `type, frequency, gain, q` for every band */
+  uint32_t length;
+  assert(napi_get_array_length(env, args[1], &length) == napi_ok);
+  if (length % 4 != 0 || length / 4 > DSP_EQ_BANDS) {
+    napi_throw_range_error(env, "ERR_EQUALIZER", "Invalid number of equalizer bands");
+    return NULL;
+  }
+
+  dsp_eq_band bands[DSP_EQ_BANDS];
+  double values[4];
+  for (uint32_t i = 0; i < length; i++) {
+    napi_value value;
+    assert(napi_get_element(env, args[1], i, &value) == napi_ok);
+    assert(napi_get_value_double(env, value, &values[i % 4]) == napi_ok);
+    if (i % 4 == 3) {
+      dsp_eq_band *band = &bands[i / 4];
+      band->type = (int) values[0];
+      band->frequency = values[1];
+      band->gain = values[2];
+      band->q = values[3];
+    }
+  }
+
+  /* picked up by the next write, filter state carries over */
+  if (dsp_eq_set(&speaker->eq, bands, length / 4) != 0) {
+    napi_throw_range_error(env, "ERR_EQUALIZER", "Invalid equalizer band");
+  }
+  return NULL;
+}
+
+napi_value speaker_remote_fds(napi_env env, napi_callback_info info) {
+  size_t argc = 1;
+  napi_value args[1];
+  assert(napi_get_cb_info(env, info, &argc, args, NULL, NULL) == napi_ok);
+
+  Speaker *speaker;
+  assert(napi_unwrap(env, args[0], (void**) &speaker) == napi_ok);
+
+  if (!speaker->remote) {
+    napi_throw_error(env, "ERR_REMOTE", "Speaker is not playing out-of-process");
+    return NULL;
+  }
+
+  /* descriptors 3 and 4 of the helper process: the ring and the control socket */
+  napi_value fds;
+  assert(napi_create_array_with_length(env, 2, &fds) == napi_ok);
+  for (uint32_t i = 0; i < 2; i++) {
+    napi_value fd;
+    assert(napi_create_int32(env, speaker->remote_fds[i], &fd) == napi_ok);
+    assert(napi_set_element(env, fds, i, fd) == napi_ok);
+  }
+  return fds;
+}
+
+napi_value speaker_remote_started(napi_env env, napi_callback_info info) {
+  size_t argc = 1;
+  napi_value args[1];
+  assert(napi_get_cb_info(env, info, &argc, args, NULL, NULL) == napi_ok);
+
+  Speaker *speaker;
+  assert(napi_unwrap(env, args[0], (void**) &speaker) == napi_ok);
+
+  /* the helper has its own copies of the descriptors now, dropping ours means
+   * that we notice when it goes away */
+  if (speaker->remote) remote_started(&speaker->ao);
+  return NULL;
+}
+
+napi_value speaker_start_ring(napi_env env, napi_callback_info info) {
+  size_t argc = 2;
+  napi_value args[2];
+  assert(napi_get_cb_info(env, info, &argc, args, NULL, NULL) == napi_ok);
+
+  Speaker *speaker;
+  assert(napi_unwrap(env, args[0], (void**) &speaker) == napi_ok);
+
+  napi_typedarray_type type;
+  size_t length;
+  unsigned char *mem;
+  assert(napi_get_typedarray_info(env, args[1], &type, &length, (void **) &mem, NULL, NULL) == napi_ok);
+
+  if (speaker->ring.running || type != napi_uint8_array) {
+    napi_throw_error(env, "ERR_RING", "Invalid ring buffer");
+    return NULL;
+  }
+
+  speaker->ring.gain = &speaker->gain;
+  speaker->ring.eq = &speaker->eq;
+  speaker->ring.drift = speaker->drifting ? &speaker->drift : NULL;
+  if (ring_start(&speaker->ring, &speaker->ao, mem, length) != 0) {
+    napi_throw_error(env, "ERR_RING", "Invalid ring buffer");
+    return NULL;
+  }
+  assert(napi_create_reference(env, args[1], 1, &speaker->ring_ref) == napi_ok);
+  return NULL;
+}
+
+void stop_ring_execute(napi_env env, void* _data) {
+  RingData* data = _data;
+  ring_stop(&data->speaker->ring, data->drain);
+}
+
+void stop_ring_complete(napi_env env, napi_status status, void* _data) {
+  RingData* data = _data;
+  Speaker *speaker = data->speaker;
+
+  if (speaker->ring_ref) {
+    assert(napi_delete_reference(env, speaker->ring_ref) == napi_ok);
+    speaker->ring_ref = NULL;
+  }
+
+  if (speaker->ring.error) {
+    napi_value code, message, error;
+    assert(napi_create_string_utf8(env, "ERR_RING", NAPI_AUTO_LENGTH, &code) == napi_ok);
+    assert(napi_create_string_utf8(env, "Failed to write to output device", NAPI_AUTO_LENGTH, &message) == napi_ok);
+    assert(napi_create_error(env, code, message, &error) == napi_ok);
+    assert(napi_reject_deferred(env, data->deferred, error) == napi_ok);
+  } else {
+    napi_value undefined;
+    assert(napi_get_undefined(env, &undefined) == napi_ok);
+    assert(napi_resolve_deferred(env, data->deferred, undefined) == napi_ok);
+  }
+
+  assert(napi_delete_async_work(env, data->work) == napi_ok);
+  free(data);
+}
+
+napi_value speaker_stop_ring(napi_env env, napi_callback_info info) {
+  size_t argc = 2;
+  napi_value args[2];
+  assert(napi_get_cb_info(env, info, &argc, args, NULL, NULL) == napi_ok);
+
+  RingData* data = calloc(1, sizeof(RingData));
+  assert(napi_unwrap(env, args[0], (void**) &data->speaker) == napi_ok);
+  assert(napi_get_value_bool(env, args[1], &data->drain) == napi_ok); /* play what's left first */
+
+  napi_value promise;
+  assert(napi_create_promise(env, &data->deferred, &promise) == napi_ok);
+
+  napi_value work_name;
+  assert(napi_create_string_utf8(env, "speaker:stopRing", NAPI_AUTO_LENGTH, &work_name) == napi_ok);
+
+  /* joining the output thread may take as long as the ring holds */
+  assert(napi_create_async_work(env, NULL, work_name, stop_ring_execute, stop_ring_complete, (void*) data, &data->work) == napi_ok);
+
+  assert(napi_queue_async_work(env, data->work) == napi_ok);
+
+  return promise;
+}
+
+napi_value speaker_start_jitter(napi_env env, napi_callback_info info) {
+  size_t argc = 4;
+  napi_value args[4];
+  assert(napi_get_cb_info(env, info, &argc, args, NULL, NULL) == napi_ok);
+
+  Speaker *speaker;
+  assert(napi_unwrap(env, args[0], (void**) &speaker) == napi_ok);
+
+  /* frames per packet, and the least and most packets to buffer */
+  uint32_t packet_frames;
+  int32_t min_depth, max_depth;
+  assert(napi_get_value_uint32(env, args[1], &packet_frames) == napi_ok);
+  assert(napi_get_value_int32(env, args[2], &min_depth) == napi_ok);
+  assert(napi_get_value_int32(env, args[3], &max_depth) == napi_ok);
+
+  if (speaker->jitter.running || speaker->ring.running) {
+    napi_throw_error(env, "ERR_JITTER", "Speaker is already playing from a ring or jitter buffer");
+    return NULL;
+  }
+
+  speaker->jitter.gain = &speaker->gain;
+  speaker->jitter.eq = &speaker->eq;
+  if (jitter_start(&speaker->jitter, &speaker->ao, packet_frames, min_depth, max_depth) != 0) {
+    napi_throw_error(env, "ERR_JITTER", "Failed to start the jitter buffer");
+  }
+  return NULL;
+}
+
+napi_value speaker_push_packet(napi_env env, napi_callback_info info) {
+  size_t argc = 3;
+  napi_value args[3];
+  assert(napi_get_cb_info(env, info, &argc, args, NULL, NULL) == napi_ok);
+
+  Speaker *speaker;
+  assert(napi_unwrap(env, args[0], (void**) &speaker) == napi_ok);
+
+  uint32_t seq;
+  assert(napi_get_value_uint32(env, args[1], &seq) == napi_ok);
+
+  size_t length;
+  unsigned char *packet;
+  assert(napi_get_typedarray_info(env, args[2], NULL, &length, (void **) &packet, NULL, NULL) == napi_ok);
+
+  if (!speaker->jitter.running || length != speaker->jitter.packet_size) {
+    napi_throw_range_error(env, "ERR_JITTER", "Invalid packet");
+    return NULL;
+  }
+
+  /* false if it came too late, or twice */
+  napi_value taken;
+  assert(napi_get_boolean(env, jitter_push(&speaker->jitter, (uint16_t) seq, packet) == 0, &taken) == napi_ok);
+  return taken;
+}
+
+napi_value speaker_jitter_stats(napi_env env, napi_callback_info info) {
+  size_t argc = 1;
+  napi_value args[1];
+  assert(napi_get_cb_info(env, info, &argc, args, NULL, NULL) == napi_ok);
+
+  Speaker *speaker;
+  assert(napi_unwrap(env, args[0], (void**) &speaker) == napi_ok);
+
+  jitter_stats stats;
+  jitter_get_stats(&speaker->jitter, &stats);
+  double period = speaker->ao.rate ? (double) speaker->jitter.packet_frames / speaker->ao.rate : 0;
+
+  napi_value result, value;
+  assert(napi_create_object(env, &result) == napi_ok);
+#define SET(name, number) do {\
+  assert(napi_create_double(env, (double) (number), &value) == napi_ok);\
+  assert(napi_set_named_property(env, result, name, value) == napi_ok);\
+} while (0)
+  SET("received", stats.received);
+  SET("played", stats.played);
+  SET("concealed", stats.concealed);
+  SET("late", stats.late);
+  SET("dropped", stats.dropped);
+  SET("underruns", stats.underruns);
+  SET("jitter", stats.jitter * 1000);
+  SET("buffered", stats.buffered);
+  SET("target", stats.target);
+  SET("depth", stats.target * period * 1000);
+#undef SET
+  return result;
+}
+
+void stop_jitter_execute(napi_env env, void* _data) {
+  JitterData* data = _data;
+  jitter_stop(&data->speaker->jitter, data->drain);
+}
+
+void stop_jitter_complete(napi_env env, napi_status status, void* _data) {
+  JitterData* data = _data;
+
+  if (data->speaker->jitter.error) {
+    napi_value code, message, error;
+    assert(napi_create_string_utf8(env, "ERR_JITTER", NAPI_AUTO_LENGTH, &code) == napi_ok);
+    assert(napi_create_string_utf8(env, "Failed to write to output device", NAPI_AUTO_LENGTH, &message) == napi_ok);
+    assert(napi_create_error(env, code, message, &error) == napi_ok);
+    assert(napi_reject_deferred(env, data->deferred, error) == napi_ok);
+  } else {
+    napi_value undefined;
+    assert(napi_get_undefined(env, &undefined) == napi_ok);
+    assert(napi_resolve_deferred(env, data->deferred, undefined) == napi_ok);
+  }
+
+  assert(napi_delete_async_work(env, data->work) == napi_ok);
+  free(data);
+}
+
+napi_value speaker_stop_jitter(napi_env env, napi_callback_info info) {
+  size_t argc = 2;
+  napi_value args[2];
+  assert(napi_get_cb_info(env, info, &argc, args, NULL, NULL) == napi_ok);
+
+  JitterData* data = calloc(1, sizeof(JitterData));
+  assert(napi_unwrap(env, args[0], (void**) &data->speaker) == napi_ok);
+  assert(napi_get_value_bool(env, args[1], &data->drain) == napi_ok); /* play what's buffered first */
+
+  napi_value promise;
+  assert(napi_create_promise(env, &data->deferred, &promise) == napi_ok);
+
+  napi_value work_name;
+  assert(napi_create_string_utf8(env, "speaker:stopJitter", NAPI_AUTO_LENGTH, &work_name) == napi_ok);
+
+  assert(napi_create_async_work(env, NULL, work_name, stop_jitter_execute, stop_jitter_complete, (void*) data, &data->work) == napi_ok);
+
+  assert(napi_queue_async_work(env, data->work) == napi_ok);
+
+  return promise;
+}
+
+napi_value speaker_start_radio(napi_env env, napi_callback_info info) {
+  size_t argc = 3;
+  napi_value args[3];
+  assert(napi_get_cb_info(env, info, &argc, args, NULL, NULL) == napi_ok);
+
+  Speaker *speaker;
+  assert(napi_unwrap(env, args[0], (void**) &speaker) == napi_ok);
+
+  char *url = get_string(env, args[1]);
+  uint32_t prefetch;
+  assert(napi_get_value_uint32(env, args[2], &prefetch) == napi_ok); /* bytes to buffer before playing */
+
+  if (speaker->radio.running || speaker->jitter.running || speaker->ring.running) {
+    napi_throw_error(env, "ERR_RADIO", "Speaker is already playing from a stream, ring or jitter buffer");
+  } else {
+    speaker->radio.gain = &speaker->gain;
+    speaker->radio.eq = &speaker->eq;
+    if (!url || radio_start(&speaker->radio, &speaker->ao, url, prefetch) != 0) {
+      napi_throw_error(env, "ERR_RADIO", "Failed to start the stream");
+    }
+  }
+  free(url);
+  return NULL;
+}
+
+/* a string property, or null */
+static void set_string(napi_env env, napi_value object, const char *name, const char *string) {
+  napi_value value;
+  if (string) {
+    assert(napi_create_string_utf8(env, string, NAPI_AUTO_LENGTH, &value) == napi_ok);
+  } else {
+    assert(napi_get_null(env, &value) == napi_ok);
+  }
+  assert(napi_set_named_property(env, object, name, value) == napi_ok);
+}
+
+napi_value speaker_radio_events(napi_env env, napi_callback_info info) {
+  size_t argc = 1;
+  napi_value args[1];
+  assert(napi_get_cb_info(env, info, &argc, args, NULL, NULL) == napi_ok);
+
+  Speaker *speaker;
+  assert(napi_unwrap(env, args[0], (void**) &speaker) == napi_ok);
+
+  napi_value events;
+  uint32_t count = 0;
+  radio_event ev;
+  assert(napi_create_array(env, &events) == napi_ok);
 
-bool is_string(napi_env env, napi_value value) {
-  napi_valuetype valuetype;
-  assert(napi_typeof(env, value, &valuetype) == napi_ok);
-  return valuetype == napi_string;
+  while (radio_poll(&speaker->radio, &ev) == 0) {
+    static const char *types[] = { NULL, "connect", "metadata", "end", "error" };
+    napi_value event, interval;
+    assert(napi_create_object(env, &event) == napi_ok);
+    set_string(env, event, "type", types[ev.type]);
+    switch (ev.type) {
+      case RADIO_CONNECT:
+        set_string(env, event, "name", ev.name);
+        set_string(env, event, "url", ev.url);
+        set_string(env, event, "contentType", ev.content_type);
+        assert(napi_create_double(env, (double) ev.interval, &interval) == napi_ok);
+        assert(napi_set_named_property(env, event, "interval", interval) == napi_ok);
+        break;
+      case RADIO_METADATA:
+        set_string(env, event, "meta", ev.meta);
+        break;
+      case RADIO_ERROR:
+        set_string(env, event, "error", ev.error);
+        break;
+    }
+    radio_event_free(&ev);
+    assert(napi_set_element(env, events, count++, event) == napi_ok);
+  }
+  return events;
 }
 
-void finalize(napi_env env, void* data, void* hint) {
-  // FIXME: Maybe close here?
+void stop_radio_execute(napi_env env, void* _data) {
+  RadioData* data = _data;
+  radio_stop(&data->speaker->radio);
+}
+
+void stop_radio_complete(napi_env env, napi_status status, void* _data) {
+  RadioData* data = _data;
+
+  napi_value undefined;
+  assert(napi_get_undefined(env, &undefined) == napi_ok);
+  assert(napi_resolve_deferred(env, data->deferred, undefined) == napi_ok);
+
+  assert(napi_delete_async_work(env, data->work) == napi_ok);
   free(data);
 }
 
-napi_value speaker_open(napi_env env, napi_callback_info info) {
-  size_t argc = 4;
-  napi_value args[4];
+napi_value speaker_stop_radio(napi_env env, napi_callback_info info) {
+  size_t argc = 1;
+  napi_value args[1];
   assert(napi_get_cb_info(env, info, &argc, args, NULL, NULL) == napi_ok);
 
-  Speaker *speaker = malloc(sizeof(Speaker));
-  memset(speaker, 0, sizeof(Speaker));
-  audio_output_t *ao = &speaker->ao;
+  RadioData* data = calloc(1, sizeof(RadioData));
+  assert(napi_unwrap(env, args[0], (void**) &data->speaker) == napi_ok);
 
-  assert(napi_get_value_int32(env, args[0], &ao->channels) == napi_ok); /* channels */
-  int32_t _rate;
-  assert(napi_get_value_int32(env, args[1], &_rate) == napi_ok); /* sample rate */
-  ao->rate = _rate;
-  assert(napi_get_value_int32(env, args[2], &ao->format) == napi_ok); /* MPG123_ENC_* format */
+  napi_value promise;
+  assert(napi_create_promise(env, &data->deferred, &promise) == napi_ok);
+
+  napi_value work_name;
+  assert(napi_create_string_utf8(env, "speaker:stopRadio", NAPI_AUTO_LENGTH, &work_name) == napi_ok);
+
+  /* the player thread may be in the middle of a device write */
+  assert(napi_create_async_work(env, NULL, work_name, stop_radio_execute, stop_radio_complete, (void*) data, &data->work) == napi_ok);
+
+  assert(napi_queue_async_work(env, data->work) == napi_ok);
+
+  return promise;
+}
+
+void load_clip_execute(napi_env env, void* _data) {
+  LoadClipData* data = _data;
+  audio_output_t *ao = &data->speaker->ao;
+  unsigned char *pcm = NULL;
 
-  if (is_string(env, args[3])) {
-    size_t device_string_size;
-    assert(napi_get_value_string_utf8(env, args[3], NULL, 0, &device_string_size) == napi_ok);
-    speaker->device = malloc(++device_string_size);
-    assert(napi_get_value_string_utf8(env, args[3], speaker->device, device_string_size, NULL) == napi_ok);
-    assert(speaker->device[device_string_size - 1] == 0);
-    ao->device = speaker->device;
+  if (data->path) {
+    int err = clips_decode(ao, data->path, &pcm, &data->frames);
+    if (err != MPG123_OK) {
+      snprintf(data->message, sizeof(data->message), "Failed to decode \"%s\": %s", data->path, mpg123_plain_strerror(err));
+      data->error = data->message;
+      return;
+    }
+  } else if (clips_convert(ao, data->pcm, data->frames, data->encoding, data->channels, &pcm) != 0) {
+    data->error = "Out of memory";
+    return;
   }
 
-  /* init_output() */
-  int r = mpg123_output_module_info.init_output(ao);
+  if (data->frames == 0) {
+    data->error = "There is no audio in the clip";
+  } else if (clips_put(&data->speaker->clips, data->id, pcm, data->frames) != 0) {
+    data->error = "The clip doesn't fit in the clip budget";
+  }
+  free(pcm);
+}
 
-  if (r != 0) {
-    napi_throw_error(env, "ERR_OPEN", "Failed to initialize output device");
-    return NULL;
+void load_clip_complete(napi_env env, napi_status status, void* _data) {
+  LoadClipData* data = _data;
+
+  if (data->error) {
+    napi_value code, message, error;
+    assert(napi_create_string_utf8(env, "ERR_CLIP", NAPI_AUTO_LENGTH, &code) == napi_ok);
+    assert(napi_create_string_utf8(env, data->error, NAPI_AUTO_LENGTH, &message) == napi_ok);
+    assert(napi_create_error(env, code, message, &error) == napi_ok);
+    assert(napi_reject_deferred(env, data->deferred, error) == napi_ok);
+  } else {
+    napi_value frames;
+    assert(napi_create_double(env, (double) data->frames, &frames) == napi_ok);
+    assert(napi_resolve_deferred(env, data->deferred, frames) == napi_ok);
   }
 
-  /* open() */
-  r = ao->open(ao);
+  assert(napi_delete_async_work(env, data->work) == napi_ok);
+  free(data->id);
+  free(data->path);
+  free(data->pcm);
+  free(data);
+}
 
-  if (r != 0) {
-    napi_throw_error(env, "ERR_OPEN", "Failed to open output device");
+napi_value speaker_load_clip(napi_env env, napi_callback_info info) {
+  size_t argc = 6;
+  napi_value args[6];
+  assert(napi_get_cb_info(env, info, &argc, args, NULL, NULL) == napi_ok);
+
+  Speaker *speaker;
+  assert(napi_unwrap(env, args[0], (void**) &speaker) == napi_ok);
+
+  /* the arena is set aside by the first load; a double, as budgets of 4 GiB
+   * and more don't fit in a uint32 */
+  double budget;
+  assert(napi_get_value_double(env, args[3], &budget) == napi_ok);
+  if (!speaker->clips.ready && (budget < 1 || budget > (double) SIZE_MAX || clips_init(&speaker->clips, &speaker->ao, (size_t) budget) != 0)) {
+    napi_throw_error(env, "ERR_CLIP", "Failed to set up the clip cache");
     return NULL;
   }
 
-  napi_value handle;
-  assert(napi_create_object(env, &handle) == napi_ok);
-  assert(napi_wrap(env, handle, speaker, finalize, NULL, NULL) == napi_ok);
+  LoadClipData* data = calloc(1, sizeof(LoadClipData));
+  data->speaker = speaker;
+  data->id = get_string(env, args[1]);
+  data->path = get_string(env, args[2]);
+  if (!data->path) {
+    /* PCM audio in the given encoding and channel count, at the device's rate;
+     * copied, as the buffer belongs to JS land */
+    size_t length;
+    unsigned char *pcm;
+    assert(napi_get_value_int32(env, args[4], &data->encoding) == napi_ok);
+    assert(napi_get_value_int32(env, args[5], &data->channels) == napi_ok);
+    if (dsp_sample_size(data->encoding) == 0 || data->channels < 1) {
+      free(data->id);
+      free(data);
+      napi_throw_range_error(env, "ERR_CLIP", "Invalid PCM format");
+      return NULL;
+    }
+    assert(napi_get_typedarray_info(env, args[2], NULL, &length, (void **) &pcm, NULL, NULL) == napi_ok);
+    data->frames = length / (dsp_sample_size(data->encoding) * data->channels);
+    data->pcm = malloc(length ? length : 1);
+    memcpy(data->pcm, pcm, length);
+  }
 
-  return handle;
-}
+  napi_value promise;
+  assert(napi_create_promise(env, &data->deferred, &promise) == napi_ok);
 
-void write_execute(napi_env env, void* _data) {
-  WriteData* data = _data;
+  napi_value work_name;
+  assert(napi_create_string_utf8(env, "speaker:loadClip", NAPI_AUTO_LENGTH, &work_name) == napi_ok);
+
+  /* decoding takes a while, and so may making room in the arena */
+  assert(napi_create_async_work(env, NULL, work_name, load_clip_execute, load_clip_complete, (void*) data, &data->work) == napi_ok);
 
-  data->written = data->ao->write(data->ao, data->buffer, data->length);
+  assert(napi_queue_async_work(env, data->work) == napi_ok);
+
+  return promise;
 }
 
-void write_complete(napi_env env, napi_status status, void* _data) {
-  WriteData* data = _data;
+napi_value speaker_play_clip(napi_env env, napi_callback_info info) {
+  size_t argc = 3;
+  napi_value args[3];
+  assert(napi_get_cb_info(env, info, &argc, args, NULL, NULL) == napi_ok);
 
-  napi_value written;
-  assert(napi_create_uint32(env, data->written, &written) == napi_ok);
-  assert(napi_resolve_deferred(env, data->deferred, written) == napi_ok);
+  Speaker *speaker;
+  assert(napi_unwrap(env, args[0], (void**) &speaker) == napi_ok);
 
-  free(_data);
+  char *id = get_string(env, args[1]);
+  double gain;
+  assert(napi_get_value_double(env, args[2], &gain) == napi_ok);
+
+  if (!speaker->clips.ready) {
+    /* nothing was ever loaded */
+    free(id);
+    napi_value played;
+    assert(napi_get_boolean(env, false, &played) == napi_ok);
+    return played;
+  }
+  if (!speaker->clips.running) {
+    if (speaker->radio.running || speaker->jitter.running || speaker->ring.running) {
+      free(id);
+      napi_throw_error(env, "ERR_CLIP", "Speaker is already playing from a stream, ring or jitter buffer");
+      return NULL;
+    }
+    speaker->clips.gain = &speaker->gain;
+    speaker->clips.eq = &speaker->eq;
+    if (clips_start(&speaker->clips) != 0) {
+      free(id);
+      napi_throw_error(env, "ERR_CLIP", "Failed to start playing clips");
+      return NULL;
+    }
+  }
+
+  /* false if it isn't cached (any more), or too many are playing, or the
+   * clips are playing out; an error if the device failed */
+  int result = id ? clips_play(&speaker->clips, id, (float) gain) : -1;
+  free(id);
+  if (result == -2 && speaker->clips.error) {
+    napi_throw_error(env, "ERR_CLIP", "Failed to write to output device");
+    return NULL;
+  }
+  napi_value played;
+  assert(napi_get_boolean(env, result == 0, &played) == napi_ok);
+  return played;
 }
 
-napi_value speaker_write(napi_env env, napi_callback_info info) {
+napi_value speaker_unload_clip(napi_env env, napi_callback_info info) {
   size_t argc = 2;
   napi_value args[2];
   assert(napi_get_cb_info(env, info, &argc, args, NULL, NULL) == napi_ok);
@@ -107,25 +1324,179 @@ napi_value speaker_write(napi_env env, napi_callback_info info) {
   Speaker *speaker;
   assert(napi_unwrap(env, args[0], (void**) &speaker) == napi_ok);
 
-  WriteData* data = malloc(sizeof(WriteData));
-  data->ao = &speaker->ao;
-  data->written = 0;
-  assert(napi_get_typedarray_info(env, args[1], NULL, &data->length, (void **) &data->buffer, NULL, NULL) == napi_ok);
+  char *id = get_string(env, args[1]);
+  napi_value removed;
+  assert(napi_get_boolean(env, id && speaker->clips.ready && clips_remove(&speaker->clips, id) == 0, &removed) == napi_ok);
+  free(id);
+  return removed;
+}
+
+napi_value speaker_clip_stats(napi_env env, napi_callback_info info) {
+  size_t argc = 1;
+  napi_value args[1];
+  assert(napi_get_cb_info(env, info, &argc, args, NULL, NULL) == napi_ok);
+
+  Speaker *speaker;
+  assert(napi_unwrap(env, args[0], (void**) &speaker) == napi_ok);
+
+  clips_stats stats;
+  clips_get_stats(&speaker->clips, &stats);
+
+  napi_value result, value;
+  assert(napi_create_object(env, &result) == napi_ok);
+#define SET(name, number) do {\
+  assert(napi_create_double(env, (double) (number), &value) == napi_ok);\
+  assert(napi_set_named_property(env, result, name, value) == napi_ok);\
+} while (0)
+  SET("clips", stats.clips);
+  SET("bytes", stats.bytes);
+  SET("budget", stats.budget);
+  SET("hits", stats.hits);
+  SET("misses", stats.misses);
+  SET("evicted", stats.evictions);
+  SET("dropped", stats.dropped);
+  SET("voices", stats.voices);
+#undef SET
+  return result;
+}
+
+void stop_clips_execute(napi_env env, void* _data) {
+  ClipsData* data = _data;
+  clips_stop(&data->speaker->clips, data->drain);
+}
+
+void stop_clips_complete(napi_env env, napi_status status, void* _data) {
+  ClipsData* data = _data;
+
+  if (data->speaker->clips.error) {
+    napi_value code, message, error;
+    assert(napi_create_string_utf8(env, "ERR_CLIP", NAPI_AUTO_LENGTH, &code) == napi_ok);
+    assert(napi_create_string_utf8(env, "Failed to write to output device", NAPI_AUTO_LENGTH, &message) == napi_ok);
+    assert(napi_create_error(env, code, message, &error) == napi_ok);
+    assert(napi_reject_deferred(env, data->deferred, error) == napi_ok);
+  } else {
+    napi_value undefined;
+    assert(napi_get_undefined(env, &undefined) == napi_ok);
+    assert(napi_resolve_deferred(env, data->deferred, undefined) == napi_ok);
+  }
+
+  assert(napi_delete_async_work(env, data->work) == napi_ok);
+  free(data);
+}
+
+napi_value speaker_stop_clips(napi_env env, napi_callback_info info) {
+  size_t argc = 2;
+  napi_value args[2];
+  assert(napi_get_cb_info(env, info, &argc, args, NULL, NULL) == napi_ok);
+
+  ClipsData* data = calloc(1, sizeof(ClipsData));
+  assert(napi_unwrap(env, args[0], (void**) &data->speaker) == napi_ok);
+  assert(napi_get_value_bool(env, args[1], &data->drain) == napi_ok); /* let the clips that are playing finish */
 
   napi_value promise;
   assert(napi_create_promise(env, &data->deferred, &promise) == napi_ok);
 
   napi_value work_name;
-  assert(napi_create_string_utf8(env, "speaker:write", NAPI_AUTO_LENGTH, &work_name) == napi_ok);
+  assert(napi_create_string_utf8(env, "speaker:stopClips", NAPI_AUTO_LENGTH, &work_name) == napi_ok);
 
-  napi_async_work work;
-  assert(napi_create_async_work(env, NULL, work_name, write_execute, write_complete, (void*) data, &work) == napi_ok);
+  assert(napi_create_async_work(env, NULL, work_name, stop_clips_execute, stop_clips_complete, (void*) data, &data->work) == napi_ok);
 
-  assert(napi_queue_async_work(env, work) == napi_ok);
+  assert(napi_queue_async_work(env, data->work) == napi_ok);
 
   return promise;
 }
 
+napi_value histogram_object(napi_env env, const metrics_histogram *h) {
+  napi_value object, value;
+  assert(napi_create_object(env, &object) == napi_ok);
+
+  uint64_t count = h->count;
+  assert(napi_create_double(env, (double) count, &value) == napi_ok);
+  assert(napi_set_named_property(env, object, "count", value) == napi_ok);
+  assert(napi_create_double(env, count ? (double) h->sum / count : 0, &value) == napi_ok);
+  assert(napi_set_named_property(env, object, "mean", value) == napi_ok);
+  assert(napi_create_double(env, (double) h->max, &value) == napi_ok);
+  assert(napi_set_named_property(env, object, "max", value) == napi_ok);
+
+#define PERCENTILE(NAME, QUANTILE) \
+  assert(napi_create_double(env, (double) metrics_percentile(h, QUANTILE), &value) == napi_ok);\
+  assert(napi_set_named_property(env, object, NAME, value) == napi_ok);
+
+  PERCENTILE("p50", 0.5);
+  PERCENTILE("p90", 0.9);
+  PERCENTILE("p99", 0.99);
+  PERCENTILE("p999", 0.999);
+
+#undef PERCENTILE
+
+  return object;
+}
+
+napi_value speaker_metrics(napi_env env, napi_callback_info info) {
+  size_t argc = 1;
+  napi_value args[1];
+  assert(napi_get_cb_info(env, info, &argc, args, NULL, NULL) == napi_ok);
+
+  /* the speaker's histograms, or the whole process' without a handle */
+  metrics *m = &metrics_process;
+  napi_valuetype valuetype;
+  assert(napi_typeof(env, args[0], &valuetype) == napi_ok);
+  if (valuetype == napi_object) {
+    Speaker *speaker;
+    assert(napi_unwrap(env, args[0], (void**) &speaker) == napi_ok);
+    m = &speaker->metrics;
+  }
+
+  napi_value result, short_writes;
+  assert(napi_create_object(env, &result) == napi_ok);
+  assert(napi_set_named_property(env, result, "queueWait", histogram_object(env, &m->queue_wait)) == napi_ok);
+  assert(napi_set_named_property(env, result, "writeTime", histogram_object(env, &m->write_time)) == napi_ok);
+  assert(napi_set_named_property(env, result, "writeBytes", histogram_object(env, &m->write_bytes)) == napi_ok);
+  assert(napi_set_named_property(env, result, "callbackDelay", histogram_object(env, &m->callback_delay)) == napi_ok);
+  assert(napi_create_uint32(env, m->short_writes, &short_writes) == napi_ok);
+  assert(napi_set_named_property(env, result, "shortWrites", short_writes) == napi_ok);
+  return result;
+}
+
+napi_value speaker_delay(napi_env env, napi_callback_info info) {
+  size_t argc = 1;
+  napi_value args[1];
+  assert(napi_get_cb_info(env, info, &argc, args, NULL, NULL) == napi_ok);
+
+  Speaker *speaker;
+  assert(napi_unwrap(env, args[0], (void**) &speaker) == napi_ok);
+  audio_output_t *ao = &speaker->ao;
+
+  /* frames the device has yet to play, -1 if the backend can't tell */
+  napi_value delay;
+  assert(napi_create_int32(env, ao->delay ? ao->delay(ao) : -1, &delay) == napi_ok);
+  return delay;
+}
+
+napi_value speaker_drift(napi_env env, napi_callback_info info) {
+  size_t argc = 1;
+  napi_value args[1];
+  assert(napi_get_cb_info(env, info, &argc, args, NULL, NULL) == napi_ok);
+
+  Speaker *speaker;
+  assert(napi_unwrap(env, args[0], (void**) &speaker) == napi_ok);
+
+  napi_value result;
+  if (!speaker->drifting) {
+    assert(napi_get_null(env, &result) == napi_ok);
+    return result;
+  }
+
+  /* the correction in ppm, and the latency it is steering by in ms */
+  napi_value ppm, latency;
+  assert(napi_create_object(env, &result) == napi_ok);
+  assert(napi_create_double(env, drift_ppm(&speaker->drift), &ppm) == napi_ok);
+  assert(napi_set_named_property(env, result, "ppm", ppm) == napi_ok);
+  assert(napi_create_double(env, drift_latency(&speaker->drift), &latency) == napi_ok);
+  assert(napi_set_named_property(env, result, "latency", latency) == napi_ok);
+  return result;
+}
+
 napi_value speaker_flush(napi_env env, napi_callback_info info) {
   size_t argc = 1;
   napi_value args[1];
@@ -149,6 +1520,17 @@ napi_value speaker_close(napi_env env, napi_callback_info info) {
   assert(napi_unwrap(env, args[0], (void**) &speaker) == napi_ok);
   audio_output_t *ao = &speaker->ao;
 
+  /* the output threads have to let go of the device first */
+  ring_free(&speaker->ring);
+  jitter_free(&speaker->jitter);
+  radio_free(&speaker->radio);
+  clips_free(&speaker->clips);
+  idle_stop(&speaker->idle);
+  if (speaker->ring_ref) {
+    assert(napi_delete_reference(env, speaker->ring_ref) == napi_ok);
+    speaker->ring_ref = NULL;
+  }
+
   int r = ao->close(ao);
 
   if (r != 0) {
@@ -166,51 +1548,243 @@ napi_value speaker_close(napi_env env, napi_callback_info info) {
   }
 
 cleanup:
+  playlist_free(speaker->playlist);
+  speaker->playlist = NULL;
+  free(speaker->scratch);
+  speaker->scratch = NULL;
+  dsp_eq_free(&speaker->eq);
+  if (speaker->drifting) drift_free(&speaker->drift);
+  speaker->drifting = false;
   free(speaker->device);
   return NULL;
 }
 
-int get_formats() {
-  audio_output_t ao;
-  memset(&ao, 0, sizeof(audio_output_t));
-  mpg123_output_module_info.init_output(&ao);
-  ao.channels = 2;
-  ao.rate = 44100;
-  ao.format = MPG123_ENC_SIGNED_16;
-  ao.open(&ao);
-
-  int formats = ao.get_formats(&ao);
+napi_value speaker_formats(napi_env env, napi_callback_info info) {
+  size_t argc = 4;
+  napi_value args[4];
+  assert(napi_get_cb_info(env, info, &argc, args, NULL, NULL) == napi_ok);
 
-  ao.close(&ao);
+  mpg123_module_t *module = get_module(env, args[0]);
+  if (!module) return NULL;
+  char *device = get_string(env, args[1]);
+  int32_t rate, channels;
+  assert(napi_get_value_int32(env, args[2], &rate) == napi_ok);
+  assert(napi_get_value_int32(env, args[3], &channels) == napi_ok);
 
+  /* only what `probe()` found out, -1 if the device hasn't been probed */
+  napi_value formats;
+  assert(napi_create_int32(env, probe_formats(module, device, rate, channels), &formats) == napi_ok);
+  free(device);
   return formats;
 }
 
+void probe_execute(napi_env env, void* _data) {
+  ProbeData* data = _data;
+  data->result = probe_device(data->module, data->device, &data->entries, &data->count);
+}
+
+void probe_complete(napi_env env, napi_status status, void* _data) {
+  ProbeData* data = _data;
+
+  if (data->result != 0) {
+    char buf[512];
+    napi_value code, message, error;
+    snprintf(buf, sizeof(buf), "Failed to open %s%s%s of the \"%s\" backend",
+             data->device ? "\"" : "the default device", data->device ? data->device : "",
+             data->device ? "\"" : "", data->module->name);
+    assert(napi_create_string_utf8(env, "ERR_PROBE", NAPI_AUTO_LENGTH, &code) == napi_ok);
+    assert(napi_create_string_utf8(env, buf, NAPI_AUTO_LENGTH, &message) == napi_ok);
+    assert(napi_create_error(env, code, message, &error) == napi_ok);
+    assert(napi_reject_deferred(env, data->deferred, error) == napi_ok);
+  } else {
+    napi_value list;
+    assert(napi_create_array_with_length(env, data->count, &list) == napi_ok);
+    for (uint32_t i = 0; i < data->count; i++) {
+      napi_value entry, rate, channels, formats;
+      assert(napi_create_object(env, &entry) == napi_ok);
+      assert(napi_create_int32(env, data->entries[i].rate, &rate) == napi_ok);
+      assert(napi_set_named_property(env, entry, "sampleRate", rate) == napi_ok);
+      assert(napi_create_int32(env, data->entries[i].channels, &channels) == napi_ok);
+      assert(napi_set_named_property(env, entry, "channels", channels) == napi_ok);
+      assert(napi_create_int32(env, data->entries[i].formats, &formats) == napi_ok);
+      assert(napi_set_named_property(env, entry, "formats", formats) == napi_ok);
+      assert(napi_set_element(env, list, i, entry) == napi_ok);
+    }
+    assert(napi_resolve_deferred(env, data->deferred, list) == napi_ok);
+  }
+
+  free(data->entries);
+  free(data->device);
+  assert(napi_delete_async_work(env, data->work) == napi_ok);
+  free(data);
+}
+
+napi_value speaker_probe(napi_env env, napi_callback_info info) {
+  size_t argc = 2;
+  napi_value args[2];
+  assert(napi_get_cb_info(env, info, &argc, args, NULL, NULL) == napi_ok);
+
+  mpg123_module_t *module = get_module(env, args[0]);
+  if (!module) return NULL;
+
+  ProbeData* data = calloc(1, sizeof(ProbeData));
+  data->module = module;
+  data->device = get_string(env, args[1]);
+
+  napi_value promise;
+  assert(napi_create_promise(env, &data->deferred, &promise) == napi_ok);
+
+  napi_value work_name;
+  assert(napi_create_string_utf8(env, "speaker:probe", NAPI_AUTO_LENGTH, &work_name) == napi_ok);
+
+  /* opening a device can take a while, or hang on a busy one */
+  assert(napi_create_async_work(env, NULL, work_name, probe_execute, probe_complete, (void*) data, &data->work) == napi_ok);
+
+  assert(napi_queue_async_work(env, data->work) == napi_ok);
+
+  return promise;
+}
+
+int devices_store(void *arg, const char *name, const char *description) {
+  DevicesData* data = arg;
+
+  if (data->count == data->size) {
+    size_t size = data->size ? data->size * 2 : 16;
+    char **names = realloc(data->names, size * sizeof(char *));
+    if (!names) return -1;
+    data->names = names;
+    char **descriptions = realloc(data->descriptions, size * sizeof(char *));
+    if (!descriptions) return -1;
+    data->descriptions = descriptions;
+    data->size = size;
+  }
+  char *copy = name ? strdup(name) : NULL;
+  char *description_copy = strdup(description);
+  if ((name && !copy) || !description_copy) {
+    free(copy);
+    free(description_copy);
+    return -1;
+  }
+  data->names[data->count] = copy;
+  data->descriptions[data->count] = description_copy;
+  data->count++;
+  return 0;
+}
+
+void devices_execute(napi_env env, void* _data) {
+  DevicesData* data = _data;
+  data->result = probe_enumerate(data->module, devices_store, data);
+}
+
+void devices_complete(napi_env env, napi_status status, void* _data) {
+  DevicesData* data = _data;
+  uint32_t i;
+
+  if (data->result != 0) {
+    char buf[256];
+    napi_value code, message, error;
+    snprintf(buf, sizeof(buf), "Failed to list the devices of the \"%s\" backend", data->module->name);
+    assert(napi_create_string_utf8(env, "ERR_DEVICES", NAPI_AUTO_LENGTH, &code) == napi_ok);
+    assert(napi_create_string_utf8(env, buf, NAPI_AUTO_LENGTH, &message) == napi_ok);
+    assert(napi_create_error(env, code, message, &error) == napi_ok);
+    assert(napi_reject_deferred(env, data->deferred, error) == napi_ok);
+  } else {
+    napi_value list;
+    assert(napi_create_array_with_length(env, data->count, &list) == napi_ok);
+    for (i = 0; i < data->count; i++) {
+      napi_value device, name, description;
+      assert(napi_create_object(env, &device) == napi_ok);
+      if (data->names[i]) {
+        assert(napi_create_string_utf8(env, data->names[i], NAPI_AUTO_LENGTH, &name) == napi_ok);
+      } else {
+        assert(napi_get_null(env, &name) == napi_ok);
+      }
+      assert(napi_set_named_property(env, device, "name", name) == napi_ok);
+      assert(napi_create_string_utf8(env, data->descriptions[i] ? data->descriptions[i] : "", NAPI_AUTO_LENGTH, &description) == napi_ok);
+      assert(napi_set_named_property(env, device, "description", description) == napi_ok);
+      assert(napi_set_element(env, list, i, device) == napi_ok);
+    }
+    assert(napi_resolve_deferred(env, data->deferred, list) == napi_ok);
+  }
+
+  for (i = 0; i < data->count; i++) {
+    free(data->names[i]);
+    free(data->descriptions[i]);
+  }
+  free(data->names);
+  free(data->descriptions);
+  assert(napi_delete_async_work(env, data->work) == napi_ok);
+  free(data);
+}
+
+napi_value speaker_devices(napi_env env, napi_callback_info info) {
+  size_t argc = 1;
+  napi_value args[1];
+  assert(napi_get_cb_info(env, info, &argc, args, NULL, NULL) == napi_ok);
+
+  mpg123_module_t *module = get_module(env, args[0]);
+  if (!module) return NULL;
+
+  DevicesData* data = calloc(1, sizeof(DevicesData));
+  data->module = module;
+
+  napi_value promise;
+  assert(napi_create_promise(env, &data->deferred, &promise) == napi_ok);
+
+  napi_value work_name;
+  assert(napi_create_string_utf8(env, "speaker:devices", NAPI_AUTO_LENGTH, &work_name) == napi_ok);
+
+  /* sound servers get asked over a socket */
+  assert(napi_create_async_work(env, NULL, work_name, devices_execute, devices_complete, (void*) data, &data->work) == napi_ok);
+
+  assert(napi_queue_async_work(env, data->work) == napi_ok);
+
+  return promise;
+}
+
+napi_value speaker_backends(napi_env env, napi_callback_info info) {
+  napi_value list;
+  assert(napi_create_array(env, &list) == napi_ok);
+
+  mpg123_module_t *module;
+  for (uint32_t i = 0; (module = backend_at(i)) != NULL; i++) {
+    napi_value backend, name, description, is_default;
+    assert(napi_create_object(env, &backend) == napi_ok);
+    assert(napi_create_string_latin1(env, module->name, NAPI_AUTO_LENGTH, &name) == napi_ok);
+    assert(napi_set_named_property(env, backend, "name", name) == napi_ok);
+    assert(napi_create_string_latin1(env, module->description, NAPI_AUTO_LENGTH, &description) == napi_ok);
+    assert(napi_set_named_property(env, backend, "description", description) == napi_ok);
+    assert(napi_get_boolean(env, i == 0, &is_default) == napi_ok);
+    assert(napi_set_named_property(env, backend, "default", is_default) == napi_ok);
+    assert(napi_set_element(env, list, i, backend) == napi_ok);
+  }
+  return list;
+}
+
 
 static napi_value Init(napi_env env, napi_value exports) {
+  mpg123_init();
+  mpg123_module_t *module = backend_find(NULL);
+
   napi_value result;
   assert(napi_create_object(env, &result) == napi_ok);
 
   napi_value api_version;
-  assert(napi_create_int32(env, mpg123_output_module_info.api_version, &api_version) == napi_ok);
+  assert(napi_create_int32(env, module->api_version, &api_version) == napi_ok);
   assert(napi_set_named_property(env, result, "api_version", api_version) == napi_ok);
 
   napi_value name;
-  assert(napi_create_string_latin1(env, mpg123_output_module_info.name, NAPI_AUTO_LENGTH, &name) == napi_ok);
+  assert(napi_create_string_latin1(env, module->name, NAPI_AUTO_LENGTH, &name) == napi_ok);
   assert(napi_set_named_property(env, result, "name", name) == napi_ok);
 
   napi_value description;
-  assert(napi_create_string_latin1(env, mpg123_output_module_info.description, NAPI_AUTO_LENGTH, &description) == napi_ok);
+  assert(napi_create_string_latin1(env, module->description, NAPI_AUTO_LENGTH, &description) == napi_ok);
   assert(napi_set_named_property(env, result, "description", description) == napi_ok);
 
   napi_value revision;
-  assert(napi_create_string_latin1(env, mpg123_output_module_info.revision, NAPI_AUTO_LENGTH, &revision) == napi_ok);
+  assert(napi_create_string_latin1(env, module->revision, NAPI_AUTO_LENGTH, &revision) == napi_ok);
   assert(napi_set_named_property(env, result, "revision", revision) == napi_ok);
 
-  napi_value formats;
-  assert(napi_create_int32(env, get_formats(), &formats) == napi_ok);
-  assert(napi_set_named_property(env, result, "formats", formats) == napi_ok);
-
 #define CONST_INT(NAME) \
   napi_value NAME ## _value;\
   assert(napi_create_uint32(env, NAME, & NAME ## _value) == napi_ok);\
@@ -227,16 +1801,134 @@ static napi_value Init(napi_env env, napi_value exports) {
   CONST_INT(MPG123_ENC_SIGNED_32);
   CONST_INT(MPG123_ENC_UNSIGNED_32);
 
+  CONST_INT(DSP_EQ_PEAKING);
+  CONST_INT(DSP_EQ_LOWSHELF);
+  CONST_INT(DSP_EQ_HIGHSHELF);
+  CONST_INT(DSP_EQ_LOWPASS);
+  CONST_INT(DSP_EQ_HIGHPASS);
+
 #undef CONST_INT
 
+  napi_value backends_fn;
+  assert(napi_create_function(env, "backends", NAPI_AUTO_LENGTH, speaker_backends, NULL, &backends_fn) == napi_ok);
+  assert(napi_set_named_property(env, result, "backends", backends_fn) == napi_ok);
+
+  napi_value formats_fn;
+  assert(napi_create_function(env, "formats", NAPI_AUTO_LENGTH, speaker_formats, NULL, &formats_fn) == napi_ok);
+  assert(napi_set_named_property(env, result, "formats", formats_fn) == napi_ok);
+
+  napi_value probe_fn;
+  assert(napi_create_function(env, "probe", NAPI_AUTO_LENGTH, speaker_probe, NULL, &probe_fn) == napi_ok);
+  assert(napi_set_named_property(env, result, "probe", probe_fn) == napi_ok);
+
+  napi_value devices_fn;
+  assert(napi_create_function(env, "devices", NAPI_AUTO_LENGTH, speaker_devices, NULL, &devices_fn) == napi_ok);
+  assert(napi_set_named_property(env, result, "devices", devices_fn) == napi_ok);
+
   napi_value open_fn;
   assert(napi_create_function(env, "open", NAPI_AUTO_LENGTH, speaker_open, NULL, &open_fn) == napi_ok);
   assert(napi_set_named_property(env, result, "open", open_fn) == napi_ok);
 
+  napi_value prepare_fn;
+  assert(napi_create_function(env, "prepare", NAPI_AUTO_LENGTH, speaker_prepare, NULL, &prepare_fn) == napi_ok);
+  assert(napi_set_named_property(env, result, "prepare", prepare_fn) == napi_ok);
+
+  napi_value claim_fn;
+  assert(napi_create_function(env, "claim", NAPI_AUTO_LENGTH, speaker_claim, NULL, &claim_fn) == napi_ok);
+  assert(napi_set_named_property(env, result, "claim", claim_fn) == napi_ok);
+
   napi_value write_fn;
   assert(napi_create_function(env, "write", NAPI_AUTO_LENGTH, speaker_write, NULL, &write_fn) == napi_ok);
   assert(napi_set_named_property(env, result, "write", write_fn) == napi_ok);
 
+  napi_value play_fn;
+  assert(napi_create_function(env, "play", NAPI_AUTO_LENGTH, speaker_play, NULL, &play_fn) == napi_ok);
+  assert(napi_set_named_property(env, result, "play", play_fn) == napi_ok);
+
+  napi_value set_volume_fn;
+  assert(napi_create_function(env, "setVolume", NAPI_AUTO_LENGTH, speaker_set_volume, NULL, &set_volume_fn) == napi_ok);
+  assert(napi_set_named_property(env, result, "setVolume", set_volume_fn) == napi_ok);
+
+  napi_value set_equalizer_fn;
+  assert(napi_create_function(env, "setEqualizer", NAPI_AUTO_LENGTH, speaker_set_equalizer, NULL, &set_equalizer_fn) == napi_ok);
+  assert(napi_set_named_property(env, result, "setEqualizer", set_equalizer_fn) == napi_ok);
+
+  napi_value start_ring_fn;
+  assert(napi_create_function(env, "startRing", NAPI_AUTO_LENGTH, speaker_start_ring, NULL, &start_ring_fn) == napi_ok);
+  assert(napi_set_named_property(env, result, "startRing", start_ring_fn) == napi_ok);
+
+  napi_value stop_ring_fn;
+  assert(napi_create_function(env, "stopRing", NAPI_AUTO_LENGTH, speaker_stop_ring, NULL, &stop_ring_fn) == napi_ok);
+  assert(napi_set_named_property(env, result, "stopRing", stop_ring_fn) == napi_ok);
+
+  napi_value remote_fds_fn;
+  assert(napi_create_function(env, "remoteFds", NAPI_AUTO_LENGTH, speaker_remote_fds, NULL, &remote_fds_fn) == napi_ok);
+  assert(napi_set_named_property(env, result, "remoteFds", remote_fds_fn) == napi_ok);
+
+  napi_value remote_started_fn;
+  assert(napi_create_function(env, "remoteStarted", NAPI_AUTO_LENGTH, speaker_remote_started, NULL, &remote_started_fn) == napi_ok);
+  assert(napi_set_named_property(env, result, "remoteStarted", remote_started_fn) == napi_ok);
+
+  napi_value metrics_fn;
+  assert(napi_create_function(env, "metrics", NAPI_AUTO_LENGTH, speaker_metrics, NULL, &metrics_fn) == napi_ok);
+  assert(napi_set_named_property(env, result, "metrics", metrics_fn) == napi_ok);
+
+  napi_value delay_fn;
+  assert(napi_create_function(env, "delay", NAPI_AUTO_LENGTH, speaker_delay, NULL, &delay_fn) == napi_ok);
+  assert(napi_set_named_property(env, result, "delay", delay_fn) == napi_ok);
+
+  napi_value start_jitter_fn;
+  assert(napi_create_function(env, "startJitter", NAPI_AUTO_LENGTH, speaker_start_jitter, NULL, &start_jitter_fn) == napi_ok);
+  assert(napi_set_named_property(env, result, "startJitter", start_jitter_fn) == napi_ok);
+
+  napi_value push_packet_fn;
+  assert(napi_create_function(env, "pushPacket", NAPI_AUTO_LENGTH, speaker_push_packet, NULL, &push_packet_fn) == napi_ok);
+  assert(napi_set_named_property(env, result, "pushPacket", push_packet_fn) == napi_ok);
+
+  napi_value jitter_stats_fn;
+  assert(napi_create_function(env, "jitterStats", NAPI_AUTO_LENGTH, speaker_jitter_stats, NULL, &jitter_stats_fn) == napi_ok);
+  assert(napi_set_named_property(env, result, "jitterStats", jitter_stats_fn) == napi_ok);
+
+  napi_value stop_jitter_fn;
+  assert(napi_create_function(env, "stopJitter", NAPI_AUTO_LENGTH, speaker_stop_jitter, NULL, &stop_jitter_fn) == napi_ok);
+  assert(napi_set_named_property(env, result, "stopJitter", stop_jitter_fn) == napi_ok);
+
+  napi_value start_radio_fn;
+  assert(napi_create_function(env, "startRadio", NAPI_AUTO_LENGTH, speaker_start_radio, NULL, &start_radio_fn) == napi_ok);
+  assert(napi_set_named_property(env, result, "startRadio", start_radio_fn) == napi_ok);
+
+  napi_value radio_events_fn;
+  assert(napi_create_function(env, "radioEvents", NAPI_AUTO_LENGTH, speaker_radio_events, NULL, &radio_events_fn) == napi_ok);
+  assert(napi_set_named_property(env, result, "radioEvents", radio_events_fn) == napi_ok);
+
+  napi_value stop_radio_fn;
+  assert(napi_create_function(env, "stopRadio", NAPI_AUTO_LENGTH, speaker_stop_radio, NULL, &stop_radio_fn) == napi_ok);
+  assert(napi_set_named_property(env, result, "stopRadio", stop_radio_fn) == napi_ok);
+
+  napi_value load_clip_fn;
+  assert(napi_create_function(env, "loadClip", NAPI_AUTO_LENGTH, speaker_load_clip, NULL, &load_clip_fn) == napi_ok);
+  assert(napi_set_named_property(env, result, "loadClip", load_clip_fn) == napi_ok);
+
+  napi_value play_clip_fn;
+  assert(napi_create_function(env, "playClip", NAPI_AUTO_LENGTH, speaker_play_clip, NULL, &play_clip_fn) == napi_ok);
+  assert(napi_set_named_property(env, result, "playClip", play_clip_fn) == napi_ok);
+
+  napi_value unload_clip_fn;
+  assert(napi_create_function(env, "unloadClip", NAPI_AUTO_LENGTH, speaker_unload_clip, NULL, &unload_clip_fn) == napi_ok);
+  assert(napi_set_named_property(env, result, "unloadClip", unload_clip_fn) == napi_ok);
+
+  napi_value clip_stats_fn;
+  assert(napi_create_function(env, "clipStats", NAPI_AUTO_LENGTH, speaker_clip_stats, NULL, &clip_stats_fn) == napi_ok);
+  assert(napi_set_named_property(env, result, "clipStats", clip_stats_fn) == napi_ok);
+
+  napi_value stop_clips_fn;
+  assert(napi_create_function(env, "stopClips", NAPI_AUTO_LENGTH, speaker_stop_clips, NULL, &stop_clips_fn) == napi_ok);
+  assert(napi_set_named_property(env, result, "stopClips", stop_clips_fn) == napi_ok);
+
+  napi_value drift_fn;
+  assert(napi_create_function(env, "drift", NAPI_AUTO_LENGTH, speaker_drift, NULL, &drift_fn) == napi_ok);
+  assert(napi_set_named_property(env, result, "drift", drift_fn) == napi_ok);
+
   napi_value flush_fn;
   assert(napi_create_function(env, "flush", NAPI_AUTO_LENGTH, speaker_flush, NULL, &flush_fn) == napi_ok);
   assert(napi_set_named_property(env, result, "flush", flush_fn) == napi_ok);
@@ -0,0 +1,571 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "clips.h"
+#include "decode.h"
+
+/* frames decoded at a time while loading */
+#define CLIPS_DECODE_FRAMES 1152
+
+/* The next period of a voice, as taken by the thread to mix without the
+ * lock. */
+typedef struct {
+  const unsigned char *pcm;
+  size_t frames;
+  float gain;
+} clip_part;
+
+/* Converts `frames` frames of `channels` channels of `encoding` into `ao`'s
+ * format at `out`, with `tmp` room for the floats of one frame of each. */
+static void convert(audio_output_t *ao, const unsigned char *in, size_t frames, int encoding, int channels, unsigned char *out, float *tmp) {
+  size_t in_frame = dsp_sample_size(encoding) * channels;
+  size_t out_frame = dsp_sample_size(ao->format) * ao->channels;
+  float *from = tmp;
+  float *to = tmp + channels;
+  size_t i;
+  int ch;
+
+  if (channels == ao->channels) {
+    /* nothing to lay out, a frame at a time still keeps `tmp` small */
+    for (i = 0; i < frames; i++) {
+      dsp_to_float(from, in + i * in_frame, channels, encoding);
+      dsp_from_float(out + i * out_frame, from, channels, ao->format);
+    }
+    return;
+  }
+  for (i = 0; i < frames; i++) {
+    dsp_to_float(from, in + i * in_frame, channels, encoding);
+    if (ao->channels == 1) {
+      float sum = 0;
+      for (ch = 0; ch < channels; ch++) sum += from[ch];
+      to[0] = sum / channels;
+    } else {
+      for (ch = 0; ch < ao->channels; ch++) {
+        if (channels == 1) {
+          to[ch] = ch < 2 ? from[0] : 0.0f;
+        } else {
+          to[ch] = ch < channels ? from[ch] : 0.0f;
+        }
+      }
+    }
+    dsp_from_float(out + i * out_frame, to, ao->channels, ao->format);
+  }
+}
+
+int clips_decode(audio_output_t *ao, const char *path, unsigned char **pcm, size_t *frames) {
+  int err = MPG123_OK;
+  int channels = decode_channels(ao->channels);
+  int encoding;
+  size_t frame = dsp_sample_size(ao->format) * ao->channels;
+  size_t size = 0;
+  size_t fill = 0;
+  unsigned char *raw = NULL;
+  unsigned char *out = NULL;
+  float *tmp = NULL;
+  mpg123_handle *mh = mpg123_new(NULL, &err);
+
+  *pcm = NULL;
+  *frames = 0;
+  if (!mh) return err;
+
+  mpg123_param(mh, MPG123_ADD_FLAGS, MPG123_QUIET | MPG123_LAZY_ID3, 0);
+  mpg123_format_none(mh);
+
+  if (decode_format(mh, ao->rate, ao->channels, &encoding) != MPG123_OK) goto fail;
+  if (mpg123_open(mh, path) != MPG123_OK) goto fail;
+
+  raw = malloc(CLIPS_DECODE_FRAMES * channels * dsp_sample_size(encoding));
+  tmp = malloc((channels + ao->channels) * sizeof(float));
+  if (!raw || !tmp) {
+    err = MPG123_OUT_OF_MEM;
+    goto done;
+  }
+
+  for (;;) {
+    size_t raw_frame = channels * dsp_sample_size(encoding);
+    size_t bytes = 0;
+    size_t n;
+    int r = mpg123_read(mh, raw, CLIPS_DECODE_FRAMES * raw_frame, &bytes);
+
+    n = bytes / raw_frame;
+    if (fill + n > size) {
+      size_t grown = size ? size * 2 : (size_t) ao->rate;
+      unsigned char *more;
+      while (grown < fill + n) grown *= 2;
+      more = realloc(out, grown * frame);
+      if (!more) {
+        err = MPG123_OUT_OF_MEM;
+        goto done;
+      }
+      out = more;
+      size = grown;
+    }
+    convert(ao, raw, n, encoding, channels, out + fill * frame, tmp);
+    fill += n;
+
+    if (r == MPG123_DONE) break;
+    if (r != MPG123_OK && r != MPG123_NEW_FORMAT) {
+      err = r;
+      goto done;
+    }
+  }
+  *pcm = out;
+  *frames = fill;
+  out = NULL;
+  goto done;
+
+fail:
+  err = mpg123_errcode(mh);
+  if (err == MPG123_OK) err = MPG123_ERR;
+done:
+  free(out);
+  free(raw);
+  free(tmp);
+  mpg123_close(mh);
+  mpg123_delete(mh);
+  return err;
+}
+
+int clips_convert(audio_output_t *ao, const unsigned char *in, size_t frames, int encoding, int channels, unsigned char **pcm) {
+  float *tmp = malloc((channels + ao->channels) * sizeof(float));
+
+  *pcm = malloc(frames * dsp_sample_size(ao->format) * ao->channels);
+  if (!tmp || !*pcm) {
+    free(tmp);
+    free(*pcm);
+    *pcm = NULL;
+    return -1;
+  }
+  convert(ao, in, frames, encoding, channels, *pcm, tmp);
+  free(tmp);
+  return 0;
+}
+
+int clips_init(clips *c, audio_output_t *ao, size_t budget) {
+  size_t samples;
+  int i;
+
+  c->ao = ao;
+  c->frame = dsp_sample_size(ao->format) * ao->channels;
+  c->budget = budget;
+  c->used = 0;
+  c->slots = NULL;
+  c->count = 0;
+  c->tick = 0;
+  c->copying = c->mixing = c->moving = 0;
+  c->period = (size_t) (ao->rate * CLIPS_PERIOD_MS / 1000);
+  if (c->period == 0) c->period = 1;
+  samples = c->period * ao->channels;
+
+  if (c->frame == 0 || budget == 0) return -1;
+  c->arena = malloc(budget);
+  c->mix = malloc(samples * sizeof(float));
+  c->scratch = malloc(samples * sizeof(float));
+  c->out = malloc(samples * dsp_sample_size(ao->format));
+  if (!c->arena || !c->mix || !c->scratch || !c->out) goto fail;
+
+  if (uv_mutex_init(&c->lock) != 0) goto fail;
+  if (uv_cond_init(&c->cond) != 0) {
+    uv_mutex_destroy(&c->lock);
+    goto fail;
+  }
+  for (i = 0; i < CLIPS_VOICES; i++) c->voices[i].slot = -1;
+  memset(&c->stats, 0, sizeof(c->stats));
+  c->stats.budget = budget;
+  c->ready = 1;
+  return 0;
+
+fail:
+  free(c->arena);
+  free(c->mix);
+  free(c->scratch);
+  free(c->out);
+  c->arena = c->out = NULL;
+  c->mix = c->scratch = NULL;
+  return -1;
+}
+
+/* The slot of the clip, or -1. Called with the lock held. */
+static int find(clips *c, const char *id) {
+  size_t i;
+  for (i = 0; i < c->count; i++) {
+    if (c->slots[i].id && !strcmp(c->slots[i].id, id)) return (int) i;
+  }
+  return -1;
+}
+
+/* Frees the slot, stopping the voices that play it. Its bytes in the arena
+ * are left for compact() to reclaim. Called with the lock held. */
+static void drop(clips *c, int slot) {
+  clip *k = &c->slots[slot];
+  int i;
+
+  for (i = 0; i < CLIPS_VOICES; i++) {
+    if (c->voices[i].slot == slot) {
+      c->voices[i].slot = -1;
+      c->stats.voices--;
+    }
+  }
+  c->stats.clips--;
+  c->stats.bytes -= k->frames * c->frame;
+  free(k->id);
+  k->id = NULL;
+  k->playing = 0;
+}
+
+/* Moves the clips down to the start of the arena, in the order they are in,
+ * so that the free space is all at the end. Called with the lock held, which
+ * it lets go of while moving each clip; no clip gets copied in or mixed
+ * meanwhile, and no slot taken, so only drops can happen. */
+static void compact(clips *c) {
+  size_t end = 0;
+
+  while (c->moving || c->copying || c->mixing) uv_cond_wait(&c->cond, &c->lock);
+  c->moving = 1;
+  for (;;) {
+    clip *next = NULL;
+    size_t i, bytes;
+    for (i = 0; i < c->count; i++) {
+      clip *k = &c->slots[i];
+      if (k->id && k->offset >= end && (!next || k->offset < next->offset)) next = k;
+    }
+    if (!next) break;
+    bytes = next->frames * c->frame;
+    if (next->offset != end) {
+      size_t from = next->offset;
+      uv_mutex_unlock(&c->lock);
+      memmove(c->arena + end, c->arena + from, bytes);
+      uv_mutex_lock(&c->lock);
+      /* dropped while it moved: the next one goes in its place */
+      if (!next->id) continue;
+    }
+    next->offset = end;
+    end += bytes;
+  }
+  c->used = end;
+  c->moving = 0;
+  uv_cond_broadcast(&c->cond);
+}
+
+/* Makes `bytes` free at the end of the arena, evicting the least recently
+ * used clips that aren't playing if need be. Returns -1, having evicted
+ * nothing, if that wouldn't be enough. Called with the lock held, which it
+ * may let go of. */
+static int make_room(clips *c, size_t bytes) {
+  for (;;) {
+    size_t evictable = 0;
+    size_t i;
+
+    /* a move is about to change `used` */
+    while (c->moving) uv_cond_wait(&c->cond, &c->lock);
+    if (c->budget - c->used >= bytes) return 0;
+
+    /* `bytes` counts what is still being copied in too, which can't go */
+    for (i = 0; i < c->count; i++) {
+      if (c->slots[i].id && !c->slots[i].playing) evictable += c->slots[i].frames * c->frame;
+    }
+    if (c->budget - c->stats.bytes + evictable < bytes) return -1;
+
+    while (c->budget - c->stats.bytes < bytes) {
+      int oldest = -1;
+      for (i = 0; i < c->count; i++) {
+        clip *k = &c->slots[i];
+        if (k->id && !k->playing && (oldest < 0 || k->used < c->slots[oldest].used)) oldest = (int) i;
+      }
+      drop(c, oldest);
+      c->stats.evictions++;
+    }
+    /* other clips may have gone in at the end while this one waited for the
+     * move, so it is checked again */
+    compact(c);
+  }
+}
+
+int clips_put(clips *c, const char *id, const unsigned char *pcm, size_t frames) {
+  size_t bytes = frames * c->frame;
+  size_t offset;
+  char *name;
+  clip *k;
+  int slot;
+
+  if (frames == 0 || bytes > c->budget) return -1;
+  name = malloc(strlen(id) + 1);
+  if (!name) return -1;
+  strcpy(name, id);
+
+  uv_mutex_lock(&c->lock);
+  slot = find(c, id);
+  if (slot >= 0) drop(c, slot);
+  if (make_room(c, bytes) != 0) {
+    uv_mutex_unlock(&c->lock);
+    free(name);
+    return -1;
+  }
+
+  /* set the bytes aside, nothing moves them before `copying` is back down */
+  offset = c->used;
+  c->used += bytes;
+  c->stats.bytes += bytes;
+  c->copying++;
+  uv_mutex_unlock(&c->lock);
+
+  memcpy(c->arena + offset, pcm, bytes);
+
+  uv_mutex_lock(&c->lock);
+  c->copying--;
+  uv_cond_broadcast(&c->cond);
+
+  /* a load of the same id may have gone in meanwhile */
+  slot = find(c, id);
+  if (slot >= 0) drop(c, slot);
+  for (slot = 0; slot < (int) c->count && c->slots[slot].id; slot++);
+  if (slot == (int) c->count) {
+    clip *more = realloc(c->slots, (c->count + 16) * sizeof(clip));
+    if (!more) {
+      /* the bytes are left for compact() to reclaim */
+      c->stats.bytes -= bytes;
+      uv_mutex_unlock(&c->lock);
+      free(name);
+      return -1;
+    }
+    memset(more + c->count, 0, 16 * sizeof(clip));
+    c->slots = more;
+    c->count += 16;
+  }
+
+  k = &c->slots[slot];
+  k->id = name;
+  k->offset = offset;
+  k->frames = frames;
+  k->used = ++c->tick;
+  k->playing = 0;
+  c->stats.clips++;
+  uv_mutex_unlock(&c->lock);
+  return 0;
+}
+
+int clips_remove(clips *c, const char *id) {
+  int slot;
+
+  uv_mutex_lock(&c->lock);
+  slot = find(c, id);
+  if (slot >= 0) drop(c, slot);
+  uv_mutex_unlock(&c->lock);
+  return slot >= 0 ? 0 : -1;
+}
+
+int clips_play(clips *c, const char *id, float gain) {
+  int slot, i;
+
+  uv_mutex_lock(&c->lock);
+  if (c->state != CLIPS_RUNNING) {
+    uv_mutex_unlock(&c->lock);
+    return -2;
+  }
+  slot = find(c, id);
+  if (slot < 0) {
+    c->stats.misses++;
+    uv_mutex_unlock(&c->lock);
+    return -1;
+  }
+  c->stats.hits++;
+  c->slots[slot].used = ++c->tick;
+  for (i = 0; i < CLIPS_VOICES && c->voices[i].slot >= 0; i++);
+  if (i == CLIPS_VOICES) {
+    c->stats.dropped++;
+    uv_mutex_unlock(&c->lock);
+    return -1;
+  }
+  c->voices[i].slot = slot;
+  c->voices[i].pos = 0;
+  c->voices[i].gain = gain;
+  c->slots[slot].playing++;
+  c->stats.voices++;
+  uv_mutex_unlock(&c->lock);
+  return 0;
+}
+
+/* Takes the next period of every voice into `parts`, freeing the voices
+ * that are done. Returns how many voices there were. Called with the lock
+ * held; the bytes stay put until `mixing` is back down, even those of clips
+ * that get dropped meanwhile, as only a move reuses them. */
+static int take(clips *c, clip_part *parts) {
+  int voices = 0;
+  int i;
+
+  for (i = 0; i < CLIPS_VOICES; i++) {
+    clip_voice *v = &c->voices[i];
+    clip *k;
+    size_t n;
+
+    if (v->slot < 0) continue;
+    k = &c->slots[v->slot];
+    n = k->frames - v->pos;
+    if (n > c->period) n = c->period;
+    parts[voices].pcm = c->arena + k->offset + v->pos * c->frame;
+    parts[voices].frames = n;
+    parts[voices].gain = v->gain;
+    v->pos += n;
+    if (v->pos == k->frames) {
+      k->playing--;
+      v->slot = -1;
+      c->stats.voices--;
+    }
+    voices++;
+  }
+  return voices;
+}
+
+/* Mixes the parts into `mix`. */
+static void mix(clips *c, const clip_part *parts, int voices) {
+  audio_output_t *ao = c->ao;
+  int i;
+
+  memset(c->mix, 0, c->period * ao->channels * sizeof(float));
+  for (i = 0; i < voices; i++) {
+    size_t s;
+    dsp_to_float(c->scratch, parts[i].pcm, parts[i].frames * ao->channels, ao->format);
+    for (s = 0; s < parts[i].frames * ao->channels; s++) c->mix[s] += c->scratch[s] * parts[i].gain;
+  }
+}
+
+static void clips_thread(void *arg) {
+  clips *c = arg;
+  audio_output_t *ao = c->ao;
+  double lead = (double) c->period / ao->rate;
+
+  clip_part parts[CLIPS_VOICES];
+
+  uv_mutex_lock(&c->lock);
+  for (;;) {
+    double wait;
+    int voices, failed;
+
+    if (c->state == CLIPS_STOPPED) break;
+
+    /* about one period in the device at a time, so that a clip that gets
+     * played doesn't queue up behind much silence; the backend isn't asked
+     * with the lock held, so plays and loads don't wait for it */
+    uv_mutex_unlock(&c->lock);
+    wait = pace_ahead(&c->pace) - lead;
+    uv_mutex_lock(&c->lock);
+    if (c->state == CLIPS_STOPPED) break;
+    if (wait > 0) {
+      uv_cond_timedwait(&c->cond, &c->lock, (uint64_t) (wait * 1e9));
+      continue;
+    }
+    if (c->moving) {
+      uv_cond_wait(&c->cond, &c->lock);
+      continue;
+    }
+
+    voices = take(c, parts);
+    if (voices == 0 && c->state == CLIPS_ENDING) break;
+    c->mixing = 1;
+    uv_mutex_unlock(&c->lock);
+
+    mix(c, parts, voices);
+
+    uv_mutex_lock(&c->lock);
+    c->mixing = 0;
+    uv_cond_broadcast(&c->cond);
+    uv_mutex_unlock(&c->lock);
+
+    if (c->eq && !dsp_eq_is_flat(c->eq)) dsp_eq_apply_float(c->eq, c->mix, c->period);
+    if (c->gain && !dsp_gain_is_unity(c->gain)) dsp_gain_apply_float(c->gain, c->mix, c->period, ao->channels);
+    dsp_from_float(c->out, c->mix, c->period * ao->channels, ao->format);
+
+    failed = pace_write(&c->pace, c->out, c->period * c->frame) != 0;
+    uv_mutex_lock(&c->lock);
+    if (failed) {
+      c->error = 1;
+      break;
+    }
+  }
+  c->state = CLIPS_STOPPED;
+  uv_mutex_unlock(&c->lock);
+}
+
+int clips_start(clips *c) {
+  if (!c->ready) return -1;
+
+  uv_mutex_lock(&c->lock);
+  if (c->running) {
+    uv_mutex_unlock(&c->lock);
+    return -1;
+  }
+  c->state = CLIPS_RUNNING;
+  c->error = 0;
+  pace_init(&c->pace, c->ao);
+  if (uv_thread_create(&c->thread, clips_thread, c) != 0) {
+    c->state = CLIPS_STOPPED;
+    uv_mutex_unlock(&c->lock);
+    return -1;
+  }
+  c->running = 1;
+  uv_mutex_unlock(&c->lock);
+  return 0;
+}
+
+void clips_get_stats(clips *c, clips_stats *stats) {
+  if (!c->ready) {
+    memset(stats, 0, sizeof(*stats));
+    return;
+  }
+  uv_mutex_lock(&c->lock);
+  *stats = c->stats;
+  uv_mutex_unlock(&c->lock);
+}
+
+void clips_stop(clips *c, int drain) {
+  if (!c->ready) return;
+
+  uv_mutex_lock(&c->lock);
+  if (!c->running) {
+    uv_mutex_unlock(&c->lock);
+    return;
+  }
+  if (!drain) {
+    c->state = CLIPS_STOPPED;
+  } else if (c->state == CLIPS_RUNNING) {
+    c->state = CLIPS_ENDING;
+  }
+  uv_cond_broadcast(&c->cond);
+  if (c->joining) {
+    /* the first stop joins the thread */
+    while (c->running) uv_cond_wait(&c->cond, &c->lock);
+    uv_mutex_unlock(&c->lock);
+    return;
+  }
+  c->joining = 1;
+  uv_mutex_unlock(&c->lock);
+
+  uv_thread_join(&c->thread);
+
+  uv_mutex_lock(&c->lock);
+  c->running = 0;
+  c->joining = 0;
+  uv_cond_broadcast(&c->cond);
+  uv_mutex_unlock(&c->lock);
+}
+
+void clips_free(clips *c) {
+  size_t i;
+
+  if (!c->ready) return;
+  /* waits for a stop on the threadpool too, the loads are waited for in JS */
+  clips_stop(c, 0);
+  uv_cond_destroy(&c->cond);
+  uv_mutex_destroy(&c->lock);
+
+  for (i = 0; i < c->count; i++) free(c->slots[i].id);
+  free(c->slots);
+  free(c->arena);
+  free(c->mix);
+  free(c->scratch);
+  free(c->out);
+  c->slots = NULL;
+  c->arena = c->out = NULL;
+  c->mix = c->scratch = NULL;
+  c->ready = 0;
+}
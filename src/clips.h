@@ -0,0 +1,147 @@
+#ifndef SPEAKER_CLIPS_H
+#define SPEAKER_CLIPS_H
+
+#include <stdint.h>
+#include <uv.h>
+
+#include "output.h"
+#include "dsp.h"
+#include "pace.h"
+
+/* A cache of short sounds (notifications, UI clicks, ...) that are decoded
+ * or converted to the output format once, when they are loaded, and from
+ * then on mixed straight into the device by a native thread of its own
+ * whenever they are played.
+ *
+ * The samples of all clips live in one arena of `budget` bytes. A clip that
+ * doesn't fit evicts the least recently used clips that aren't playing, and
+ * the ones that are left get moved down so that the free space is in one
+ * piece at the end. Voices refer to clips by slot, so they carry on across
+ * such moves.
+ *
+ * The lock only guards the bookkeeping, no samples get copied under it: a
+ * clip gets its bytes set aside at the end of the arena and copied in before
+ * it shows up, the thread mixes what it took from the voices after letting
+ * go, and a move waits for both of those to be done, and they for it.
+ *
+ * The thread mixes a period of CLIPS_PERIOD_MS at a time and keeps about one
+ * period queued in the device, going by its delay or by the clock if the
+ * backend can't tell. It writes silence while nothing is playing, so that the
+ * device keeps running and a clip that gets played only waits for what is
+ * queued already. */
+
+#define CLIPS_PERIOD_MS 10
+#define CLIPS_VOICES 32
+
+#define CLIPS_RUNNING 0
+#define CLIPS_ENDING 1            /* play the voices out, then stop */
+#define CLIPS_STOPPED 2
+
+typedef struct {
+  char *id;                       /* NULL for a free slot */
+  size_t offset;                  /* bytes into the arena */
+  size_t frames;
+  uint64_t used;                  /* `tick` of the last load or play */
+  int playing;                    /* voices playing it */
+} clip;
+
+typedef struct {
+  int slot;                       /* -1 while the voice is free */
+  size_t pos;                     /* frames */
+  float gain;
+} clip_voice;
+
+typedef struct {
+  uint64_t hits;                  /* plays of clips that were cached */
+  uint64_t misses;                /* plays of clips that weren't, or were evicted */
+  uint64_t evictions;
+  uint64_t dropped;               /* plays that found all voices busy */
+  size_t clips;
+  size_t bytes;
+  size_t budget;
+  int voices;                     /* playing right now */
+} clips_stats;
+
+typedef struct {
+  audio_output_t *ao;
+  dsp_gain *gain;
+  dsp_eq *eq;
+  size_t frame;                   /* bytes per frame */
+
+  unsigned char *arena;
+  size_t budget;
+  size_t used;                    /* bytes at the start of the arena that hold clips */
+  clip *slots;
+  size_t count;
+  uint64_t tick;
+
+  clip_voice voices[CLIPS_VOICES];
+  size_t period;                  /* frames */
+  float *mix;
+  float *scratch;
+  unsigned char *out;
+
+  uv_mutex_t lock;
+  uv_cond_t cond;
+  uv_thread_t thread;
+  int ready;                      /* clips_init() went through */
+  int running;
+  int joining;                    /* a clips_stop() is waiting for the thread */
+  int state;                      /* CLIPS_RUNNING, CLIPS_ENDING or CLIPS_STOPPED */
+  int error;                      /* set when the device stopped taking audio */
+
+  int copying;                    /* clips being copied into the arena */
+  int mixing;                     /* the thread is reading from the arena */
+  int moving;                     /* clips are being moved down the arena */
+
+  pace pace;
+
+  clips_stats stats;
+} clips;
+
+/* Sets up an empty cache for `ao`, which is open. Returns -1 if out of
+ * memory. */
+int clips_init(clips *c, audio_output_t *ao, size_t budget);
+
+/* Decodes the MPEG audio file at `path` into `*pcm`, a buffer of `*frames`
+ * frames in `ao`'s format for the caller to free(). Doesn't touch the cache,
+ * so it can run on any thread. Returns an MPG123_* error, MPG123_OK on
+ * success. */
+int clips_decode(audio_output_t *ao, const char *path, unsigned char **pcm, size_t *frames);
+
+/* Converts `frames` frames of `channels` channels of `encoding` at `ao`'s
+ * rate into `*pcm`, a buffer in `ao`'s format for the caller to free(). A
+ * mono clip plays on the front left and right, anything else into a mono
+ * device gets mixed down. Returns -1 if out of memory. */
+int clips_convert(audio_output_t *ao, const unsigned char *in, size_t frames, int encoding, int channels, unsigned char **pcm);
+
+/* Caches `frames` frames in `ao`'s format as `id`, from any thread, in place
+ * of a clip of the same id that isn't playing. Returns -1 if it can't be
+ * made to fit. */
+int clips_put(clips *c, const char *id, const unsigned char *pcm, size_t frames);
+
+/* Drops the clip from the cache, from any thread, stopping its voices.
+ * Returns -1 if there is no such clip. */
+int clips_remove(clips *c, const char *id);
+
+/* Starts playing the clip at `gain` on the next period, from any thread.
+ * Returns -1 if it isn't cached, or all voices are busy, and -2 if the
+ * thread isn't playing: it is stopping, or the device failed (`error`). */
+int clips_play(clips *c, const char *id, float gain);
+
+/* Starts the thread. `gain` and `eq` are to be set up beforehand, or NULL.
+ * Returns -1 if it couldn't be started. */
+int clips_start(clips *c);
+
+/* Copies the statistics, from any thread. */
+void clips_get_stats(clips *c, clips_stats *stats);
+
+/* Asks the thread to stop, right away or once the voices played out, and
+ * waits for it, or for the stop that got there first. Does nothing if it
+ * isn't running. */
+void clips_stop(clips *c, int drain);
+
+/* Stops the thread and frees the cache. Does nothing if it wasn't set up. */
+void clips_free(clips *c);
+
+#endif
@@ -0,0 +1,37 @@
+#include <string.h>
+
+#include "decode.h"
+#include "dsp.h"
+
+int decode_channels(int channels) {
+  return channels == 1 ? 1 : 2;
+}
+
+int decode_format(mpg123_handle *mh, long rate, int channels, int *encoding) {
+  int mode = decode_channels(channels) == 1 ? MPG123_MONO : MPG123_STEREO;
+
+  /* prefer float output; fixed point builds of libmpg123 only give us integers */
+  *encoding = MPG123_ENC_FLOAT_32;
+  if (mpg123_format(mh, rate, mode, *encoding) == MPG123_OK) return MPG123_OK;
+
+  /* non-standard rates need the NtoM resampler to be forced */
+  mpg123_param(mh, MPG123_FORCE_RATE, rate, 0);
+  if (mpg123_format(mh, rate, mode, *encoding) == MPG123_OK) return MPG123_OK;
+
+  *encoding = MPG123_ENC_SIGNED_16;
+  return mpg123_format(mh, rate, mode, *encoding);
+}
+
+void decode_to_float(float *out, const unsigned char *in, size_t frames, int decoded, int channels, int encoding) {
+  size_t frame_size = dsp_sample_size(encoding) * decoded;
+  size_t i;
+
+  if (decoded == channels) {
+    dsp_to_float(out, in, frames * channels, encoding);
+    return;
+  }
+  for (i = 0; i < frames; i++, out += channels) {
+    memset(out, 0, channels * sizeof(float));
+    dsp_to_float(out, in + i * frame_size, decoded, encoding);
+  }
+}
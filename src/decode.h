@@ -0,0 +1,26 @@
+#ifndef SPEAKER_DECODE_H
+#define SPEAKER_DECODE_H
+
+#include <stddef.h>
+
+#include "output.h"
+
+/* The decoder setup that the playlist, streams and the clip cache share.
+ * They decode to stereo, or to mono for a mono device, at the device's rate,
+ * and lay the audio out for the device as floats. */
+
+/* Returns the channels to decode to for a device of `channels`. */
+int decode_channels(int channels);
+
+/* Sets `mh` up to decode to `rate` in decode_channels(`channels`), as floats,
+ * or as 16-bit integers from fixed point builds of libmpg123, forcing the
+ * resampler for rates that aren't decoded to natively. Stores the encoding
+ * in `*encoding`. Returns an MPG123_* error, MPG123_OK on success. */
+int decode_format(mpg123_handle *mh, long rate, int channels, int *encoding);
+
+/* Converts `frames` frames of `decoded` channels of `encoding` into floats
+ * for a device of `channels`: the front left and right get stereo, the
+ * other channels stay silent. */
+void decode_to_float(float *out, const unsigned char *in, size_t frames, int decoded, int channels, int encoding);
+
+#endif
@@ -0,0 +1,149 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "drift.h"
+#include "atomic.h"
+#include "dsp.h"
+
+/* the fill gets smoothed over this many seconds, which evens out the
+ * sawtooth of devices that take audio a period at a time */
+#define DRIFT_SMOOTHING 1.0
+
+/* proportional gain, per second of latency error, and an integral gain that
+ * damps the loop critically (Ki = Kp^2 / 4): small steps settle in about
+ * 2 / DRIFT_KP seconds, bigger ones close at DRIFT_MAX_PPM first */
+#define DRIFT_KP 0.05
+#define DRIFT_KI (DRIFT_KP * DRIFT_KP / 4)
+
+/* frames of input kept from one block to the next, for the interpolation */
+#define DRIFT_HISTORY 3
+
+static void publish(volatile uint32_t *bits, double value) {
+  float f = (float) value;
+  uint32_t u;
+  memcpy(&u, &f, sizeof(u));
+  atomic_store_u32(bits, u);
+}
+
+static double read_published(volatile uint32_t *bits) {
+  uint32_t u = atomic_load_u32(bits);
+  float f;
+  memcpy(&f, &u, sizeof(f));
+  return f;
+}
+
+int drift_init(drift *d, long rate, int channels, double target) {
+  memset(d, 0, sizeof(drift));
+  d->rate = rate;
+  d->channels = channels;
+  d->target = target * rate / 1000;
+  d->fill = -1;
+  d->ratio = 1;
+  d->pos = 1;
+  d->history_frames = DRIFT_HISTORY;
+  d->history = calloc(DRIFT_HISTORY * channels, sizeof(float));
+  publish(&d->fill_bits, -1);
+  return d->history ? 0 : -1;
+}
+
+void drift_free(drift *d) {
+  free(d->history);
+  free(d->out);
+  free(d->bytes);
+  d->history = NULL;
+  d->out = NULL;
+  d->bytes = NULL;
+}
+
+/* Moves the ratio on, after `dt` seconds more of the stream with `queued`
+ * frames downstream. */
+static void steer(drift *d, long queued, double dt) {
+  double max = DRIFT_MAX_PPM / 1e6;
+  double error, correction;
+
+  if (d->fill < 0) d->fill = (double) queued;
+  else d->fill += dt / (DRIFT_SMOOTHING + dt) * ((double) queued - d->fill);
+
+  error = (d->fill - d->target) / d->rate;
+  correction = DRIFT_KP * error + DRIFT_KI * (d->integral + error * dt);
+
+  /* the integral only moves while the correction isn't pinned at the limit,
+   * or to get it off the limit, so that it doesn't wind up on big errors and
+   * overshoot once they are gone */
+  if (correction > max) {
+    correction = max;
+    if (error < 0) d->integral += error * dt;
+  } else if (correction < -max) {
+    correction = -max;
+    if (error > 0) d->integral += error * dt;
+  } else {
+    d->integral += error * dt;
+  }
+  d->ratio = 1 + correction;
+
+  publish(&d->ppm_bits, correction * 1e6);
+  publish(&d->fill_bits, d->fill * 1000 / d->rate);
+}
+
+static int reserve(void **p, size_t *have, size_t want, size_t size) {
+  void *grown;
+  if (*have >= want) return 0;
+  grown = realloc(*p, want * size);
+  if (!grown) return -1;
+  *p = grown;
+  *have = want;
+  return 0;
+}
+
+size_t drift_process(drift *d, const unsigned char *in, size_t frames, int encoding, long queued, unsigned char **out) {
+  size_t channels = d->channels;
+  size_t total = frames + DRIFT_HISTORY;
+  size_t max_out, n = 0, c;
+  double pos = d->pos;
+  float *h;
+
+  if (queued >= 0) steer(d, queued, (double) frames / d->rate);
+
+  /* the history, followed by this block as floats */
+  if (reserve((void **) &d->history, &d->history_frames, total, channels * sizeof(float)) != 0) return 0;
+  dsp_to_float(d->history + DRIFT_HISTORY * channels, in, frames * channels, encoding);
+  h = d->history;
+
+  max_out = (size_t) ((total - pos) / d->ratio) + 2;
+  if (reserve((void **) &d->out, &d->out_frames, max_out, channels * sizeof(float)) != 0) return 0;
+  if (reserve((void **) &d->bytes, &d->bytes_size, max_out * channels * dsp_sample_size(encoding), 1) != 0) return 0;
+
+  /* every output frame sits between input frames i and i + 1, with one more
+   * on either side */
+  while ((size_t) pos + 2 < total) {
+    size_t i = (size_t) pos;
+    float f = (float) (pos - i);
+    float wm1 = f * (-0.5f + f * (1.0f - 0.5f * f));
+    float w0 = 1.0f + f * f * (-2.5f + 1.5f * f);
+    float w1 = f * (0.5f + f * (2.0f - 1.5f * f));
+    float w2 = f * f * (-0.5f + 0.5f * f);
+    const float *x = h + (i - 1) * channels;
+    float *o = d->out + n * channels;
+
+    for (c = 0; c < channels; c++) {
+      o[c] = wm1 * x[c] + w0 * x[c + channels] + w1 * x[c + 2 * channels] + w2 * x[c + 3 * channels];
+    }
+    n++;
+    pos += d->ratio;
+  }
+
+  memmove(h, h + (total - DRIFT_HISTORY) * channels, DRIFT_HISTORY * channels * sizeof(float));
+  d->pos = pos - (double) (total - DRIFT_HISTORY);
+
+  dsp_from_float(d->bytes, d->out, n * channels, encoding);
+  *out = d->bytes;
+  return n;
+}
+
+double drift_ppm(drift *d) {
+  return read_published(&d->ppm_bits);
+}
+
+double drift_latency(drift *d) {
+  return read_published(&d->fill_bits);
+}
@@ -0,0 +1,62 @@
+#ifndef SPEAKER_DRIFT_H
+#define SPEAKER_DRIFT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Holds the output latency of a stream that arrives at a clock of its own
+ * (RTP, WebRTC, ...) at a target, by resampling it ever so slightly.
+ *
+ * Before each block, the output thread tells `drift_process()` how many
+ * frames are queued downstream of it (the device delay, plus a ring's fill).
+ * A PI controller steers the resampling ratio by parts per million from how
+ * far a smoothed fill is from the target: a sender clock that runs fast
+ * fills the queue, so more input frames get squeezed into each output frame,
+ * and the other way around. Corrections are capped at DRIFT_MAX_PPM, which
+ * shifts the pitch by less than two cents, and settle over tens of seconds.
+ *
+ * Resampling is 4-point cubic (Catmull-Rom) interpolation in float, with the
+ * weights computed once per output frame, so it costs four multiply-adds per
+ * sample on top of the format conversions. */
+
+#define DRIFT_MAX_PPM 1000
+
+typedef struct {
+  long rate;
+  int channels;
+  double target;            /* frames */
+
+  double fill;              /* smoothed frames queued downstream, < 0 until the first reading */
+  double integral;          /* of the fill error, in seconds * seconds */
+  double ratio;             /* input frames per output frame */
+  double pos;               /* of the next output frame, in frames from the start of `history` */
+  float *history;           /* the last 3 input frames, then room for a block */
+  size_t history_frames;
+  float *out;
+  size_t out_frames;
+  unsigned char *bytes;
+  size_t bytes_size;
+
+  /* the last correction and smoothed fill, for readers on other threads */
+  volatile uint32_t ppm_bits;
+  volatile uint32_t fill_bits;
+} drift;
+
+/* Returns 0 on success, or -1 if out of memory. `target` is in milliseconds. */
+int drift_init(drift *d, long rate, int channels, double target);
+void drift_free(drift *d);
+
+/* Resamples `frames` interleaved frames of `encoding`, going by `queued`
+ * frames waiting to be played downstream, or -1 if that isn't known, in
+ * which case the ratio stays where it is. Points `*out` at the result, which
+ * stays valid until the next call, and returns its length in frames; that is
+ * 0 if there wasn't enough memory. */
+size_t drift_process(drift *d, const unsigned char *in, size_t frames, int encoding, long queued, unsigned char **out);
+
+/* The current correction in parts per million (positive when the stream gets
+ * played faster), and the smoothed latency in milliseconds or -1 before the
+ * first reading, from any thread. */
+double drift_ppm(drift *d);
+double drift_latency(drift *d);
+
+#endif
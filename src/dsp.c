@@ -0,0 +1,605 @@
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "output.h"
+#include "atomic.h"
+#include "dsp.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define DSP_SSE2 1
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define DSP_NEON 1
+#include <arm_neon.h>
+#endif
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+/* gain ramps take this long, in 1/x seconds */
+#define GAIN_RAMP_RATE 100
+
+/* filter state below this gets flushed to zero, to keep decaying filters out
+ * of the slow denormal range */
+#define EQ_DENORMAL 1e-20f
+
+/* the packed 24-bit formats are stored in native endianness, like every
+ * other format that Speaker plays */
+static int is_little_endian() {
+  const uint16_t probe = 1;
+  return *(const uint8_t *) &probe == 1;
+}
+
+static float clip(float v) {
+  return v > 1.0f ? 1.0f : (v < -1.0f ? -1.0f : v);
+}
+
+/* The inverse of the conversions in dsp_to_float(), which divide by `scale`,
+ * so that samples make the round trip unchanged. +1.0 is one step past the
+ * largest sample and gets clipped to it. */
+static int32_t to_int(float v, double scale) {
+  double s = (double) clip(v) * scale;
+  s = s < 0 ? s - 0.5 : s + 0.5;
+  return s >= scale ? (int32_t) (scale - 1) : (int32_t) s;
+}
+
+size_t dsp_sample_size(int encoding) {
+  switch (encoding) {
+    case MPG123_ENC_SIGNED_8:
+    case MPG123_ENC_UNSIGNED_8:
+      return 1;
+    case MPG123_ENC_SIGNED_16:
+    case MPG123_ENC_UNSIGNED_16:
+      return 2;
+    case MPG123_ENC_SIGNED_24:
+    case MPG123_ENC_UNSIGNED_24:
+      return 3;
+    case MPG123_ENC_SIGNED_32:
+    case MPG123_ENC_UNSIGNED_32:
+    case MPG123_ENC_FLOAT_32:
+      return 4;
+    case MPG123_ENC_FLOAT_64:
+      return 8;
+    default:
+      return 0;
+  }
+}
+
+void dsp_to_float(float *out, const unsigned char *in, size_t samples, int encoding) {
+  size_t i;
+  int le = is_little_endian();
+
+  switch (encoding) {
+    case MPG123_ENC_FLOAT_32:
+      memcpy(out, in, samples * sizeof(float));
+      break;
+    case MPG123_ENC_FLOAT_64:
+      for (i = 0; i < samples; i++) {
+        double v;
+        memcpy(&v, in + i * 8, 8);
+        out[i] = (float) v;
+      }
+      break;
+    case MPG123_ENC_SIGNED_8:
+      for (i = 0; i < samples; i++) out[i] = (int8_t) in[i] / 128.0f;
+      break;
+    case MPG123_ENC_UNSIGNED_8:
+      for (i = 0; i < samples; i++) out[i] = ((int) in[i] - 128) / 128.0f;
+      break;
+    case MPG123_ENC_SIGNED_16:
+    case MPG123_ENC_UNSIGNED_16:
+      for (i = 0; i < samples; i++) {
+        uint16_t v;
+        memcpy(&v, in + i * 2, 2);
+        if (encoding == MPG123_ENC_UNSIGNED_16) v ^= 0x8000;
+        out[i] = (int16_t) v / 32768.0f;
+      }
+      break;
+    case MPG123_ENC_SIGNED_24:
+    case MPG123_ENC_UNSIGNED_24:
+      for (i = 0; i < samples; i++) {
+        const unsigned char *p = in + i * 3;
+        uint32_t v = le
+          ? (uint32_t) p[0] << 8 | (uint32_t) p[1] << 16 | (uint32_t) p[2] << 24
+          : (uint32_t) p[2] << 8 | (uint32_t) p[1] << 16 | (uint32_t) p[0] << 24;
+        if (encoding == MPG123_ENC_UNSIGNED_24) v ^= 0x80000000u;
+        out[i] = (float) ((int32_t) v / 2147483648.0);
+      }
+      break;
+    case MPG123_ENC_SIGNED_32:
+    case MPG123_ENC_UNSIGNED_32:
+      for (i = 0; i < samples; i++) {
+        uint32_t v;
+        memcpy(&v, in + i * 4, 4);
+        if (encoding == MPG123_ENC_UNSIGNED_32) v ^= 0x80000000u;
+        out[i] = (float) ((int32_t) v / 2147483648.0);
+      }
+      break;
+    default:
+      memset(out, 0, samples * sizeof(float));
+  }
+}
+
+void dsp_from_float(unsigned char *out, const float *in, size_t samples, int encoding) {
+  size_t i;
+  int le = is_little_endian();
+
+  switch (encoding) {
+    case MPG123_ENC_FLOAT_32:
+      memcpy(out, in, samples * sizeof(float));
+      break;
+    case MPG123_ENC_FLOAT_64:
+      for (i = 0; i < samples; i++) {
+        double v = in[i];
+        memcpy(out + i * 8, &v, 8);
+      }
+      break;
+    case MPG123_ENC_SIGNED_8:
+      for (i = 0; i < samples; i++) out[i] = (uint8_t) (int8_t) to_int(in[i], 128.0);
+      break;
+    case MPG123_ENC_UNSIGNED_8:
+      for (i = 0; i < samples; i++) out[i] = (uint8_t) (to_int(in[i], 128.0) + 128);
+      break;
+    case MPG123_ENC_SIGNED_16:
+    case MPG123_ENC_UNSIGNED_16:
+      for (i = 0; i < samples; i++) {
+        uint16_t v = (uint16_t) (int16_t) to_int(in[i], 32768.0);
+        if (encoding == MPG123_ENC_UNSIGNED_16) v ^= 0x8000;
+        memcpy(out + i * 2, &v, 2);
+      }
+      break;
+    case MPG123_ENC_SIGNED_24:
+    case MPG123_ENC_UNSIGNED_24:
+      for (i = 0; i < samples; i++) {
+        unsigned char *p = out + i * 3;
+        uint32_t v = (uint32_t) to_int(in[i], 8388608.0);
+        if (encoding == MPG123_ENC_UNSIGNED_24) v ^= 0x800000u;
+        p[le ? 0 : 2] = v & 0xff;
+        p[1] = (v >> 8) & 0xff;
+        p[le ? 2 : 0] = (v >> 16) & 0xff;
+      }
+      break;
+    case MPG123_ENC_SIGNED_32:
+    case MPG123_ENC_UNSIGNED_32:
+      for (i = 0; i < samples; i++) {
+        uint32_t v = (uint32_t) to_int(in[i], 2147483648.0);
+        if (encoding == MPG123_ENC_UNSIGNED_32) v ^= 0x80000000u;
+        memcpy(out + i * 4, &v, 4);
+      }
+      break;
+  }
+}
+
+/* Multiplies `frames` interleaved float frames by a gain that starts at `g` and
+ * grows by `step` per frame. The vector paths cover layouts where a vector
+ * holds whole frames, anything else takes the scalar loop. */
+static void scale_float(float *buf, size_t frames, int channels, float g, float step) {
+  size_t samples = frames * channels;
+  size_t i = 0;
+
+#if defined(DSP_SSE2) || defined(DSP_NEON)
+  if (4 % channels == 0) {
+    float lanes[4];
+    int j;
+    for (j = 0; j < 4; j++) lanes[j] = g + (j / channels) * step;
+#if defined(DSP_SSE2)
+    __m128 gv = _mm_loadu_ps(lanes);
+    __m128 inc = _mm_set1_ps((4 / channels) * step);
+    for (; i + 4 <= samples; i += 4) {
+      _mm_storeu_ps(buf + i, _mm_mul_ps(_mm_loadu_ps(buf + i), gv));
+      gv = _mm_add_ps(gv, inc);
+    }
+#else
+    float32x4_t gv = vld1q_f32(lanes);
+    float32x4_t inc = vdupq_n_f32((4 / channels) * step);
+    for (; i + 4 <= samples; i += 4) {
+      vst1q_f32(buf + i, vmulq_f32(vld1q_f32(buf + i), gv));
+      gv = vaddq_f32(gv, inc);
+    }
+#endif
+  }
+#endif
+
+  for (; i < samples; i++) {
+    buf[i] *= g + (float) (i / channels) * step;
+  }
+}
+
+/* Same as `scale_float()` for native endian signed 16-bit samples, with
+ * saturation. */
+static void scale_s16(int16_t *buf, size_t frames, int channels, float g, float step) {
+  size_t samples = frames * channels;
+  size_t i = 0;
+
+#if defined(DSP_SSE2) || defined(DSP_NEON)
+  if (4 % channels == 0) {
+    float lanes[4];
+    int j;
+    for (j = 0; j < 4; j++) lanes[j] = g + (j / channels) * step;
+#if defined(DSP_SSE2)
+    __m128 lo = _mm_loadu_ps(lanes);
+    __m128 inc = _mm_set1_ps((4 / channels) * step);
+    __m128 hi = _mm_add_ps(lo, inc);
+    inc = _mm_add_ps(inc, inc);
+    for (; i + 8 <= samples; i += 8) {
+      __m128i v = _mm_loadu_si128((const __m128i *) (buf + i));
+      __m128 a = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16));
+      __m128 b = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpackhi_epi16(v, v), 16));
+      a = _mm_mul_ps(a, lo);
+      b = _mm_mul_ps(b, hi);
+      _mm_storeu_si128((__m128i *) (buf + i), _mm_packs_epi32(_mm_cvtps_epi32(a), _mm_cvtps_epi32(b)));
+      lo = _mm_add_ps(lo, inc);
+      hi = _mm_add_ps(hi, inc);
+    }
+#else
+    float32x4_t lo = vld1q_f32(lanes);
+    float32x4_t inc = vdupq_n_f32((4 / channels) * step);
+    float32x4_t hi = vaddq_f32(lo, inc);
+    inc = vaddq_f32(inc, inc);
+    for (; i + 8 <= samples; i += 8) {
+      int16x8_t v = vld1q_s16(buf + i);
+      float32x4_t a = vmulq_f32(vcvtq_f32_s32(vmovl_s16(vget_low_s16(v))), lo);
+      float32x4_t b = vmulq_f32(vcvtq_f32_s32(vmovl_s16(vget_high_s16(v))), hi);
+#if defined(__aarch64__)
+      int32x4_t ia = vcvtnq_s32_f32(a);
+      int32x4_t ib = vcvtnq_s32_f32(b);
+#else
+      int32x4_t ia = vcvtq_s32_f32(a);
+      int32x4_t ib = vcvtq_s32_f32(b);
+#endif
+      vst1q_s16(buf + i, vcombine_s16(vqmovn_s32(ia), vqmovn_s32(ib)));
+      lo = vaddq_f32(lo, inc);
+      hi = vaddq_f32(hi, inc);
+    }
+#endif
+  }
+#endif
+
+  for (; i < samples; i++) {
+    float v = buf[i] * (g + (float) (i / channels) * step);
+    v = v < 0 ? v - 0.5f : v + 0.5f;
+    buf[i] = v >= 32767.0f ? 32767 : (v <= -32768.0f ? -32768 : (int16_t) v);
+  }
+}
+
+/* Scales samples in any other encoding by taking a detour through float. */
+static void scale_any(unsigned char *buf, size_t frames, int channels, int encoding, float g, float step) {
+  float tmp[1024];
+  size_t frame_size = dsp_sample_size(encoding) * channels;
+  size_t chunk = sizeof(tmp) / sizeof(float) / channels;
+
+  while (frames > 0) {
+    size_t n = frames > chunk ? chunk : frames;
+    dsp_to_float(tmp, buf, n * channels, encoding);
+    scale_float(tmp, n, channels, g, step);
+    dsp_from_float(buf, tmp, n * channels, encoding);
+    buf += n * frame_size;
+    frames -= n;
+    g += step * n;
+  }
+}
+
+static void scale(void *buf, size_t frames, int channels, int encoding, float g, float step) {
+  switch (encoding) {
+    case MPG123_ENC_FLOAT_32:
+      scale_float(buf, frames, channels, g, step);
+      break;
+    case MPG123_ENC_SIGNED_16:
+      scale_s16(buf, frames, channels, g, step);
+      break;
+    default:
+      scale_any(buf, frames, channels, encoding, g, step);
+  }
+}
+
+static uint32_t float_bits(float v) {
+  uint32_t bits;
+  memcpy(&bits, &v, sizeof(bits));
+  return bits;
+}
+
+static float bits_float(uint32_t bits) {
+  float v;
+  memcpy(&v, &bits, sizeof(v));
+  return v;
+}
+
+void dsp_gain_init(dsp_gain *g, long rate) {
+  g->target = float_bits(1.0f);
+  g->current = g->goal = 1.0f;
+  g->step = 0.0f;
+  g->remaining = 0;
+  g->ramp = rate / GAIN_RAMP_RATE;
+  if (g->ramp < 1) g->ramp = 1;
+}
+
+void dsp_gain_set(dsp_gain *g, float gain) {
+  atomic_store_u32(&g->target, float_bits(gain));
+}
+
+/* picks up a new target gain and starts ramping towards it */
+static void gain_update(dsp_gain *g) {
+  float target = bits_float(atomic_load_u32(&g->target));
+  if (target != g->goal) {
+    g->goal = target;
+    g->remaining = g->ramp;
+    g->step = (target - g->current) / g->ramp;
+  }
+}
+
+int dsp_gain_is_unity(dsp_gain *g) {
+  gain_update(g);
+  return g->remaining == 0 && g->current == 1.0f;
+}
+
+/* Runs the ramp over the first frames and the steady gain over the rest.
+ * `fn` is either the encoding aware scale() or scale_float(). */
+#define GAIN_APPLY(g, buf, frames, frame_size, SCALE) do {\
+    size_t n;\
+    gain_update(g);\
+    n = (g)->remaining < (frames) ? (g)->remaining : (frames);\
+    if (n > 0) {\
+      SCALE((buf), n, (g)->current, (g)->step);\
+      (g)->remaining -= n;\
+      (g)->current = (g)->remaining ? (g)->current + (g)->step * n : (g)->goal;\
+    }\
+    if ((frames) > n && (g)->current != 1.0f) {\
+      SCALE((buf) + n * (frame_size), (frames) - n, (g)->current, 0.0f);\
+    }\
+  } while (0)
+
+void dsp_gain_apply(dsp_gain *g, unsigned char *buf, size_t frames, int channels, int encoding) {
+#define SCALE(b, n, gain, step) scale(b, n, channels, encoding, gain, step)
+  GAIN_APPLY(g, buf, frames, dsp_sample_size(encoding) * channels, SCALE);
+#undef SCALE
+}
+
+void dsp_gain_apply_float(dsp_gain *g, float *buf, size_t frames, int channels) {
+#define SCALE(b, n, gain, step) scale_float(b, n, channels, gain, step)
+  GAIN_APPLY(g, buf, frames, channels, SCALE);
+#undef SCALE
+}
+
+int dsp_eq_init(dsp_eq *eq, long rate, int channels) {
+  memset(eq, 0, sizeof(dsp_eq));
+  eq->rate = rate;
+  eq->channels = channels;
+  eq->state = calloc(DSP_EQ_BANDS * 2 * channels, sizeof(float));
+  return eq->state ? 0 : -1;
+}
+
+void dsp_eq_free(dsp_eq *eq) {
+  free(eq->state);
+  eq->state = NULL;
+}
+
+/* Biquad coefficients from the "Cookbook formulae for audio EQ biquad filter
+ * coefficients" by Robert Bristow-Johnson. */
+static int biquad_design(dsp_biquad *c, const dsp_eq_band *band, long rate) {
+  double a = pow(10.0, band->gain / 40.0);
+  double w0 = 2.0 * M_PI * band->frequency / rate;
+  double cw = cos(w0);
+  double alpha = sin(w0) / (2.0 * band->q);
+  double sa = 2.0 * sqrt(a) * alpha;
+  double b0, b1, b2, a0, a1, a2;
+
+  if (!(band->frequency > 0 && band->frequency < rate / 2.0) || !(band->q > 0) || !isfinite(a)) {
+    return -1;
+  }
+
+  switch (band->type) {
+    case DSP_EQ_PEAKING:
+      b0 = 1 + alpha * a; b1 = -2 * cw; b2 = 1 - alpha * a;
+      a0 = 1 + alpha / a; a1 = -2 * cw; a2 = 1 - alpha / a;
+      break;
+    case DSP_EQ_LOWSHELF:
+      b0 = a * ((a + 1) - (a - 1) * cw + sa);
+      b1 = 2 * a * ((a - 1) - (a + 1) * cw);
+      b2 = a * ((a + 1) - (a - 1) * cw - sa);
+      a0 = (a + 1) + (a - 1) * cw + sa;
+      a1 = -2 * ((a - 1) + (a + 1) * cw);
+      a2 = (a + 1) + (a - 1) * cw - sa;
+      break;
+    case DSP_EQ_HIGHSHELF:
+      b0 = a * ((a + 1) + (a - 1) * cw + sa);
+      b1 = -2 * a * ((a - 1) + (a + 1) * cw);
+      b2 = a * ((a + 1) + (a - 1) * cw - sa);
+      a0 = (a + 1) - (a - 1) * cw + sa;
+      a1 = 2 * ((a - 1) - (a + 1) * cw);
+      a2 = (a + 1) - (a - 1) * cw - sa;
+      break;
+    case DSP_EQ_LOWPASS:
+      b0 = (1 - cw) / 2; b1 = 1 - cw; b2 = (1 - cw) / 2;
+      a0 = 1 + alpha; a1 = -2 * cw; a2 = 1 - alpha;
+      break;
+    case DSP_EQ_HIGHPASS:
+      b0 = (1 + cw) / 2; b1 = -(1 + cw); b2 = (1 + cw) / 2;
+      a0 = 1 + alpha; a1 = -2 * cw; a2 = 1 - alpha;
+      break;
+    default:
+      return -1;
+  }
+
+  c->b0 = (float) (b0 / a0);
+  c->b1 = (float) (b1 / a0);
+  c->b2 = (float) (b2 / a0);
+  c->a1 = (float) (a1 / a0);
+  c->a2 = (float) (a2 / a0);
+  return 0;
+}
+
+int dsp_eq_set(dsp_eq *eq, const dsp_eq_band *bands, int count) {
+  dsp_biquad coef[DSP_EQ_BANDS];
+  uint32_t version;
+  int i;
+
+  if (count < 0 || count > DSP_EQ_BANDS) return -1;
+  for (i = 0; i < count; i++) {
+    if (biquad_design(&coef[i], &bands[i], eq->rate) != 0) return -1;
+  }
+
+  /* this is the only writer, so the plain read is fine */
+  version = eq->version;
+  atomic_store_u32(&eq->version, version + 1);
+  atomic_fence();
+  eq->published_count = count;
+  memcpy(eq->published, coef, count * sizeof(dsp_biquad));
+  atomic_store_u32(&eq->version, version + 2);
+  return 0;
+}
+
+/* picks up the latest published bands, unless they are being written to */
+static void eq_update(dsp_eq *eq) {
+  dsp_biquad coef[DSP_EQ_BANDS];
+  uint32_t version = atomic_load_u32(&eq->version);
+  int count;
+
+  if (version == eq->seen || (version & 1)) return;
+
+  count = eq->published_count;
+  if (count < 0 || count > DSP_EQ_BANDS) return;
+  memcpy(coef, eq->published, count * sizeof(dsp_biquad));
+  atomic_fence();
+  if (atomic_load_u32(&eq->version) != version) return;
+
+  /* bands that weren't running until now start from silence */
+  if (count > eq->count) {
+    memset(eq->state + eq->count * 2 * eq->channels, 0, (count - eq->count) * 2 * eq->channels * sizeof(float));
+  }
+  memcpy(eq->coef, coef, count * sizeof(dsp_biquad));
+  eq->count = count;
+  eq->seen = version;
+}
+
+int dsp_eq_is_flat(dsp_eq *eq) {
+  eq_update(eq);
+  return eq->count == 0;
+}
+
+/* Runs one transposed direct form II biquad over a single channel. */
+static void biquad_scalar(const dsp_biquad *c, float *z1, float *z2, float *buf, size_t frames, int channels) {
+  float s1 = *z1, s2 = *z2;
+  size_t i;
+
+  for (i = 0; i < frames; i++, buf += channels) {
+    float x = *buf;
+    float y = c->b0 * x + s1;
+    s1 = c->b1 * x - c->a1 * y + s2;
+    s2 = c->b2 * x - c->a2 * y;
+    *buf = y;
+  }
+  *z1 = fabsf(s1) < EQ_DENORMAL ? 0.0f : s1;
+  *z2 = fabsf(s2) < EQ_DENORMAL ? 0.0f : s2;
+}
+
+#if defined(DSP_SSE2) || defined(DSP_NEON)
+/* The same for `lanes` (2 or 4) adjacent channels at once, one per vector
+ * lane, so that the recursion runs across channels instead of fighting the
+ * dependency between consecutive samples. */
+static void biquad_vector(const dsp_biquad *c, float *z1, float *z2, float *buf, size_t frames, int channels, int lanes) {
+  float t1[4] = { 0 }, t2[4] = { 0 };
+  size_t i;
+  int j;
+
+  for (j = 0; j < lanes; j++) {
+    t1[j] = z1[j];
+    t2[j] = z2[j];
+  }
+
+#if defined(DSP_SSE2)
+  {
+    __m128 b0 = _mm_set1_ps(c->b0), b1 = _mm_set1_ps(c->b1), b2 = _mm_set1_ps(c->b2);
+    __m128 a1 = _mm_set1_ps(c->a1), a2 = _mm_set1_ps(c->a2);
+    __m128 s1 = _mm_loadu_ps(t1), s2 = _mm_loadu_ps(t2);
+    for (i = 0; i < frames; i++, buf += channels) {
+      __m128 x = lanes == 4 ? _mm_loadu_ps(buf) : _mm_castpd_ps(_mm_load_sd((const double *) buf));
+      __m128 y = _mm_add_ps(_mm_mul_ps(b0, x), s1);
+      s1 = _mm_add_ps(_mm_sub_ps(_mm_mul_ps(b1, x), _mm_mul_ps(a1, y)), s2);
+      s2 = _mm_sub_ps(_mm_mul_ps(b2, x), _mm_mul_ps(a2, y));
+      if (lanes == 4) {
+        _mm_storeu_ps(buf, y);
+      } else {
+        _mm_store_sd((double *) buf, _mm_castps_pd(y));
+      }
+    }
+    _mm_storeu_ps(t1, s1);
+    _mm_storeu_ps(t2, s2);
+  }
+#else
+  {
+    float32x4_t b0 = vdupq_n_f32(c->b0), b1 = vdupq_n_f32(c->b1), b2 = vdupq_n_f32(c->b2);
+    float32x4_t a1 = vdupq_n_f32(c->a1), a2 = vdupq_n_f32(c->a2);
+    float32x4_t s1 = vld1q_f32(t1), s2 = vld1q_f32(t2);
+    for (i = 0; i < frames; i++, buf += channels) {
+      float32x4_t x = lanes == 4 ? vld1q_f32(buf) : vcombine_f32(vld1_f32(buf), vdup_n_f32(0.0f));
+      float32x4_t y = vmlaq_f32(s1, b0, x);
+      s1 = vaddq_f32(vmlsq_f32(vmulq_f32(b1, x), a1, y), s2);
+      s2 = vmlsq_f32(vmulq_f32(b2, x), a2, y);
+      if (lanes == 4) {
+        vst1q_f32(buf, y);
+      } else {
+        vst1_f32(buf, vget_low_f32(y));
+      }
+    }
+    vst1q_f32(t1, s1);
+    vst1q_f32(t2, s2);
+  }
+#endif
+
+  for (j = 0; j < lanes; j++) {
+    z1[j] = fabsf(t1[j]) < EQ_DENORMAL ? 0.0f : t1[j];
+    z2[j] = fabsf(t2[j]) < EQ_DENORMAL ? 0.0f : t2[j];
+  }
+}
+#endif
+
+void dsp_eq_apply_float(dsp_eq *eq, float *buf, size_t frames) {
+  int channels = eq->channels;
+  int band;
+
+  eq_update(eq);
+
+  /* band after band over the whole block, which stays in cache */
+  for (band = 0; band < eq->count; band++) {
+    const dsp_biquad *c = &eq->coef[band];
+    float *z1 = eq->state + band * 2 * channels;
+    float *z2 = z1 + channels;
+    int ch = 0;
+
+#if defined(DSP_SSE2) || defined(DSP_NEON)
+    for (; channels - ch >= 4; ch += 4) {
+      biquad_vector(c, z1 + ch, z2 + ch, buf + ch, frames, channels, 4);
+    }
+    if (channels - ch >= 2) {
+      biquad_vector(c, z1 + ch, z2 + ch, buf + ch, frames, channels, 2);
+      ch += 2;
+    }
+#endif
+    for (; ch < channels; ch++) {
+      biquad_scalar(c, z1 + ch, z2 + ch, buf + ch, frames, channels);
+    }
+  }
+}
+
+void dsp_eq_apply(dsp_eq *eq, unsigned char *buf, size_t frames, int encoding) {
+  float tmp[1024];
+  size_t frame_size = dsp_sample_size(encoding) * eq->channels;
+  size_t chunk = sizeof(tmp) / sizeof(float) / eq->channels;
+
+  if (encoding == MPG123_ENC_FLOAT_32) {
+    dsp_eq_apply_float(eq, (float *) buf, frames);
+    return;
+  }
+
+  while (frames > 0) {
+    size_t n = frames > chunk ? chunk : frames;
+    dsp_to_float(tmp, buf, n * eq->channels, encoding);
+    dsp_eq_apply_float(eq, tmp, n);
+    dsp_from_float(buf, tmp, n * eq->channels, encoding);
+    buf += n * frame_size;
+    frames -= n;
+  }
+}
@@ -0,0 +1,100 @@
+#ifndef SPEAKER_DSP_H
+#define SPEAKER_DSP_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Returns the size in bytes of one sample of the given MPG123_ENC_* encoding,
+ * or 0 for encodings that Speaker does not support. */
+size_t dsp_sample_size(int encoding);
+
+/* Converts `samples` native endian samples of `encoding` into floats in the
+ * range [-1, 1]. */
+void dsp_to_float(float *out, const unsigned char *in, size_t samples, int encoding);
+
+/* Converts `samples` floats into native endian samples of `encoding`, clipping
+ * anything outside of [-1, 1]. */
+void dsp_from_float(unsigned char *out, const float *in, size_t samples, int encoding);
+
+/* A gain control. The JS thread publishes a new target gain with
+ * `dsp_gain_set()`, which is a single atomic store; the audio thread picks it
+ * up at the start of its next block and ramps towards it linearly, so that
+ * frequent changes don't cause zipper noise. */
+typedef struct {
+  volatile uint32_t target; /* bits of the requested float gain */
+  float current;
+  float goal;
+  float step;
+  size_t remaining;         /* frames left in the current ramp */
+  size_t ramp;              /* length of a ramp, in frames */
+} dsp_gain;
+
+void dsp_gain_init(dsp_gain *g, long rate);
+
+/* Requests a new gain, from any thread. */
+void dsp_gain_set(dsp_gain *g, float gain);
+
+/* Returns non-zero when the audio is going to pass through unchanged, in which
+ * case the `dsp_gain_apply*()` calls may be skipped altogether. */
+int dsp_gain_is_unity(dsp_gain *g);
+
+/* Applies the gain to `frames` interleaved frames, in place. */
+void dsp_gain_apply(dsp_gain *g, unsigned char *buf, size_t frames, int channels, int encoding);
+void dsp_gain_apply_float(dsp_gain *g, float *buf, size_t frames, int channels);
+
+/* A parametric equalizer: up to DSP_EQ_BANDS cascaded biquad filters that
+ * process every channel the same way. `dsp_eq_set()` computes the coefficients
+ * on the calling thread and publishes them under a sequence counter; the audio
+ * thread copies them over at the start of a block, and keeps the ones it has
+ * if it catches an update half way through. Filter state carries over, so
+ * changes take effect mid-stream. */
+#define DSP_EQ_BANDS 8
+
+#define DSP_EQ_PEAKING 0
+#define DSP_EQ_LOWSHELF 1
+#define DSP_EQ_HIGHSHELF 2
+#define DSP_EQ_LOWPASS 3
+#define DSP_EQ_HIGHPASS 4
+
+typedef struct {
+  int type;                 /* DSP_EQ_* */
+  double frequency;         /* Hz */
+  double gain;              /* dB, for peaking and shelving filters */
+  double q;
+} dsp_eq_band;
+
+typedef struct {
+  float b0, b1, b2, a1, a2;
+} dsp_biquad;
+
+typedef struct {
+  long rate;
+  int channels;
+
+  volatile uint32_t version; /* odd while an update is being written */
+  int published_count;
+  dsp_biquad published[DSP_EQ_BANDS];
+
+  uint32_t seen;
+  int count;
+  dsp_biquad coef[DSP_EQ_BANDS];
+  float *state;             /* two per band and channel */
+} dsp_eq;
+
+/* Returns 0 on success. The equalizer starts out flat. */
+int dsp_eq_init(dsp_eq *eq, long rate, int channels);
+void dsp_eq_free(dsp_eq *eq);
+
+/* Replaces the bands, from any one thread at a time. Returns -1 if there are
+ * too many bands or one of them doesn't make sense. */
+int dsp_eq_set(dsp_eq *eq, const dsp_eq_band *bands, int count);
+
+/* Returns non-zero when there are no bands, in which case the
+ * `dsp_eq_apply*()` calls may be skipped. */
+int dsp_eq_is_flat(dsp_eq *eq);
+
+/* Filters `frames` interleaved frames, in place. */
+void dsp_eq_apply(dsp_eq *eq, unsigned char *buf, size_t frames, int encoding);
+void dsp_eq_apply_float(dsp_eq *eq, float *buf, size_t frames);
+
+#endif
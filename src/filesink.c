@@ -0,0 +1,289 @@
+#ifndef _WIN32
+#define _GNU_SOURCE /* O_DIRECT */
+#endif
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <io.h>
+#include <malloc.h>
+#define open _open
+#define write _write
+#define close _close
+#define lseek _lseeki64
+#else
+#include <unistd.h>
+#endif
+
+#ifndef O_BINARY
+#define O_BINARY 0
+#endif
+
+#include "filesink.h"
+#include "dsp.h"
+
+/* audio goes out in blocks of this many bytes, aligned in memory and in the
+ * file, which is what direct I/O needs */
+#define FILESINK_BLOCK (1 << 20)
+#define FILESINK_ALIGN 4096
+
+/* RIFF + a JUNK chunk that makes room for an RF64 "ds64" chunk + fmt + the
+ * data chunk header */
+#define WAV_HEADER 80
+
+typedef struct {
+  int fd;
+  int wav;
+  int direct;
+  unsigned char *block;
+  size_t used;              /* bytes in the block */
+  size_t written;           /* of those, bytes already in the file */
+  uint64_t data;            /* bytes of audio written */
+  int frame;
+} filesink;
+
+static void put16(unsigned char *p, uint32_t v) {
+  p[0] = v & 0xff;
+  p[1] = (v >> 8) & 0xff;
+}
+
+static void put32(unsigned char *p, uint32_t v) {
+  put16(p, v & 0xffff);
+  put16(p + 2, v >> 16);
+}
+
+static void put64(unsigned char *p, uint64_t v) {
+  put32(p, (uint32_t) v);
+  put32(p + 4, (uint32_t) (v >> 32));
+}
+
+/* Fills in the WAV header for `data` bytes of audio. Up to 4 GiB it is plain
+ * WAV with the ds64 room as a JUNK chunk, past that an RF64 one. */
+static void wav_header(unsigned char *h, audio_output_t *ao, uint64_t data) {
+  int bytes = (int) dsp_sample_size(ao->format);
+  int is_float = ao->format == MPG123_ENC_FLOAT_32 || ao->format == MPG123_ENC_FLOAT_64;
+  uint64_t riff = WAV_HEADER - 8 + data + (data & 1);
+  int rf64 = riff > 0xffffffffu;
+
+  memset(h, 0, WAV_HEADER);
+  memcpy(h, rf64 ? "RF64" : "RIFF", 4);
+  put32(h + 4, rf64 ? 0xffffffffu : (uint32_t) riff);
+  memcpy(h + 8, "WAVE", 4);
+
+  memcpy(h + 12, rf64 ? "ds64" : "JUNK", 4);
+  put32(h + 16, 28);
+  if (rf64) {
+    put64(h + 20, riff);
+    put64(h + 28, data);
+    put64(h + 36, data / (bytes * ao->channels));
+    /* no table */
+  }
+
+  memcpy(h + 48, "fmt ", 4);
+  put32(h + 52, 16);
+  put16(h + 56, is_float ? 3 : 1); /* WAVE_FORMAT_IEEE_FLOAT or _PCM */
+  put16(h + 58, ao->channels);
+  put32(h + 60, ao->rate);
+  put32(h + 64, ao->rate * bytes * ao->channels);
+  put16(h + 68, bytes * ao->channels);
+  put16(h + 70, bytes * 8);
+
+  memcpy(h + 72, "data", 4);
+  put32(h + 76, rf64 ? 0xffffffffu : (uint32_t) data);
+}
+
+static int wav_format_ok(audio_output_t *ao) {
+  uint16_t one = 1;
+
+  /* WAV is little endian, and it has no signed 8 bit or unsigned wider samples */
+  if (*(unsigned char *) &one != 1) return 0;
+  switch (ao->format) {
+    case MPG123_ENC_UNSIGNED_8:
+    case MPG123_ENC_SIGNED_16:
+    case MPG123_ENC_SIGNED_24:
+    case MPG123_ENC_SIGNED_32:
+    case MPG123_ENC_FLOAT_32:
+    case MPG123_ENC_FLOAT_64:
+      return 1;
+    default:
+      return 0;
+  }
+}
+
+static int write_all(int fd, const unsigned char *p, size_t n) {
+  while (n > 0) {
+    int written = write(fd, p, (unsigned) n);
+    if (written < 0 && errno == EINTR) continue;
+    if (written <= 0) return -1;
+    p += written;
+    n -= written;
+  }
+  return 0;
+}
+
+/* Writes out the block from where the last attempt stopped, and empties it. */
+static int write_block(filesink *f) {
+  while (f->written < f->used) {
+    int written = write(f->fd, f->block + f->written, (unsigned) (f->used - f->written));
+    if (written < 0 && errno == EINTR) continue;
+    if (written <= 0) return -1;
+    f->written += written;
+  }
+  f->used = 0;
+  f->written = 0;
+  return 0;
+}
+
+static int filesink_write(audio_output_t *ao, unsigned char *buf, int len) {
+  filesink *f = ao->userptr;
+  int done = 0;
+
+  while (done < len) {
+    size_t n = FILESINK_BLOCK - f->used;
+    if (n > (size_t) (len - done)) n = len - done;
+    memcpy(f->block + f->used, buf + done, n);
+    f->used += n;
+    done += n;
+    if (f->used == FILESINK_BLOCK && write_block(f) != 0) {
+#if defined(O_DIRECT) && !defined(_WIN32)
+      /* some file systems only turn down direct I/O once it is used, then the
+       * rest of the block goes through the page cache */
+      if (!f->direct || errno != EINVAL) return -1;
+      f->direct = 0;
+      fcntl(f->fd, F_SETFL, fcntl(f->fd, F_GETFL) & ~O_DIRECT);
+      if (write_block(f) != 0) return -1;
+#else
+      return -1;
+#endif
+    }
+  }
+  f->data += len;
+  return len;
+}
+
+static void filesink_flush(audio_output_t *ao) {
+  /* what has been rendered stays rendered */
+}
+
+static int filesink_close(audio_output_t *ao) {
+  filesink *f = ao->userptr;
+  unsigned char header[WAV_HEADER];
+  int r = 0;
+
+  if (f->fd < 0) return 0;
+
+#if defined(O_DIRECT) && !defined(_WIN32)
+  /* the tail isn't a whole block, so it goes through the page cache */
+  if (f->direct) fcntl(f->fd, F_SETFL, fcntl(f->fd, F_GETFL) & ~O_DIRECT);
+#endif
+  /* chunks are padded to an even size */
+  if (f->wav && (f->data & 1)) f->block[f->used++] = 0;
+  if (write_block(f) != 0) r = -1;
+
+  if (r == 0 && f->wav) {
+    wav_header(header, ao, f->data);
+    if (lseek(f->fd, 0, SEEK_SET) != 0 || write_all(f->fd, header, WAV_HEADER) != 0) r = -1;
+  }
+  if (close(f->fd) != 0) r = -1;
+  f->fd = -1;
+  return r;
+}
+
+static int filesink_deinit(audio_output_t *ao) {
+  filesink *f = ao->userptr;
+
+  if (!f) return 0;
+  if (f->fd >= 0) close(f->fd);
+#ifdef _WIN32
+  _aligned_free(f->block);
+#else
+  free(f->block);
+#endif
+  free(f);
+  ao->userptr = NULL;
+  return 0;
+}
+
+static int path_suffix_is(const char *path, const char *suffix) {
+  size_t n = strlen(path), m = strlen(suffix), i;
+
+  if (n < m) return 0;
+  for (i = 0; i < m; i++) {
+    char c = path[n - m + i];
+    if (c >= 'A' && c <= 'Z') c += 'a' - 'A';
+    if (c != suffix[i]) return 0;
+  }
+  return 1;
+}
+
+int filesink_is_wav(const char *path) {
+  return path_suffix_is(path, ".wav") || path_suffix_is(path, ".wave");
+}
+
+const char *filesink_path(const char *device, int *direct) {
+  if (device == NULL) return NULL;
+  *direct = strncmp(device, "file+direct:", 12) == 0;
+  if (*direct) return device + 12;
+  if (strncmp(device, "file:", 5) == 0) return device + 5;
+  return NULL;
+}
+
+int filesink_open(audio_output_t *ao, const char *path, int direct) {
+  int flags = O_WRONLY | O_CREAT | O_TRUNC | O_BINARY;
+  filesink *f;
+
+  f = calloc(1, sizeof(filesink));
+  if (!f) return -1;
+  f->fd = -1;
+  f->frame = (int) dsp_sample_size(ao->format) * ao->channels;
+  f->wav = filesink_is_wav(path);
+  if (f->frame == 0 || (f->wav && !wav_format_ok(ao))) {
+    free(f);
+    errno = EINVAL;
+    return -1;
+  }
+
+#ifdef _WIN32
+  f->block = _aligned_malloc(FILESINK_BLOCK, FILESINK_ALIGN);
+#else
+  if (posix_memalign((void **) &f->block, FILESINK_ALIGN, FILESINK_BLOCK) != 0) f->block = NULL;
+#endif
+  if (!f->block) {
+    free(f);
+    errno = ENOMEM;
+    return -1;
+  }
+
+#if defined(O_DIRECT) && !defined(_WIN32)
+  if (direct) {
+    f->fd = open(path, flags | O_DIRECT, 0666);
+    /* not every file system does direct I/O, fall back to buffered */
+    f->direct = f->fd >= 0;
+  }
+#endif
+  if (f->fd < 0) f->fd = open(path, flags, 0666);
+
+  ao->userptr = f;
+  ao->write = filesink_write;
+  ao->flush = filesink_flush;
+  ao->close = filesink_close;
+  ao->deinit = filesink_deinit;
+  if (f->fd < 0) {
+    int e = errno;
+    filesink_deinit(ao);
+    errno = e;
+    return -1;
+  }
+
+  /* the header goes in first with the sizes left at 0, and gets filled in
+   * on close */
+  if (f->wav) {
+    wav_header(f->block, ao, 0);
+    f->used = WAV_HEADER;
+  }
+  return 0;
+}
@@ -0,0 +1,25 @@
+#ifndef SPEAKER_FILESINK_H
+#define SPEAKER_FILESINK_H
+
+#include "output.h"
+
+/* Renders to a file rather than a device, as fast as the audio comes in.
+ *
+ * `filesink_open()` takes the part of a "file:" device name after the colon,
+ * opens the file and fills in the callbacks of `ao` so that it looks like any
+ * other opened output. Paths ending in ".wav" get a WAV header, which is
+ * patched with the final sizes on close and becomes an RF64 one past 4 GiB;
+ * anything else gets the raw PCM. Audio is written out in large blocks, and
+ * with `direct` set, bypassing the page cache where the OS supports it.
+ * Returns -1 with errno set if the file couldn't be created, or EINVAL if the
+ * format can't be written, or doesn't fit a WAV file. */
+int filesink_open(audio_output_t *ao, const char *path, int direct);
+
+/* Returns whether `filesink_open()` writes a WAV file to `path`. */
+int filesink_is_wav(const char *path);
+
+/* Returns the path of a "file:" or "file+direct:" device name and whether it
+ * asks for direct I/O, or NULL for any other device. */
+const char *filesink_path(const char *device, int *direct);
+
+#endif
@@ -0,0 +1,95 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "idle.h"
+#include "dsp.h"
+
+static void idle_thread(void *arg) {
+  idle *d = arg;
+  audio_output_t *ao = d->ao;
+  size_t size = d->period * dsp_sample_size(ao->format) * ao->channels;
+  double lead = (double) d->period / ao->rate;
+
+  uv_mutex_lock(&d->lock);
+  while (!d->stopping) {
+    double wait;
+    int failed;
+
+    uv_mutex_unlock(&d->lock);
+    wait = pace_ahead(&d->pace) - lead;
+    uv_mutex_lock(&d->lock);
+    if (d->stopping) break;
+    if (wait > 0) {
+      uv_cond_timedwait(&d->cond, &d->lock, (uint64_t) (wait * 1e9));
+      continue;
+    }
+    uv_mutex_unlock(&d->lock);
+
+    failed = pace_write(&d->pace, d->silence, size) != 0;
+    uv_mutex_lock(&d->lock);
+    if (failed) {
+      d->error = 1;
+      break;
+    }
+  }
+  uv_mutex_unlock(&d->lock);
+}
+
+int idle_start(idle *d, audio_output_t *ao) {
+  size_t samples;
+  float *zeros;
+
+  if (d->running || dsp_sample_size(ao->format) == 0) return -1;
+
+  d->ao = ao;
+  d->period = ao->rate * IDLE_PERIOD_MS / 1000;
+  if (d->period == 0) d->period = 1;
+  samples = d->period * ao->channels;
+  d->silence = malloc(samples * dsp_sample_size(ao->format));
+  zeros = calloc(samples, sizeof(float));
+  if (!d->silence || !zeros) goto fail;
+  /* silence isn't all zero bytes in the unsigned encodings */
+  dsp_from_float(d->silence, zeros, samples, ao->format);
+  free(zeros);
+  zeros = NULL;
+
+  d->stopping = 0;
+  d->error = 0;
+  pace_init(&d->pace, ao);
+
+  if (uv_mutex_init(&d->lock) != 0) goto fail;
+  if (uv_cond_init(&d->cond) != 0) {
+    uv_mutex_destroy(&d->lock);
+    goto fail;
+  }
+  if (uv_thread_create(&d->thread, idle_thread, d) != 0) {
+    uv_cond_destroy(&d->cond);
+    uv_mutex_destroy(&d->lock);
+    goto fail;
+  }
+  d->running = 1;
+  return 0;
+
+fail:
+  free(zeros);
+  free(d->silence);
+  d->silence = NULL;
+  return -1;
+}
+
+int idle_stop(idle *d) {
+  if (!d->running) return 0;
+
+  uv_mutex_lock(&d->lock);
+  d->stopping = 1;
+  uv_cond_signal(&d->cond);
+  uv_mutex_unlock(&d->lock);
+
+  uv_thread_join(&d->thread);
+  uv_cond_destroy(&d->cond);
+  uv_mutex_destroy(&d->lock);
+  free(d->silence);
+  d->silence = NULL;
+  d->running = 0;
+  return d->error ? -1 : 0;
+}
@@ -0,0 +1,46 @@
+#ifndef SPEAKER_IDLE_H
+#define SPEAKER_IDLE_H
+
+#include <stdint.h>
+#include <uv.h>
+
+#include "output.h"
+#include "pace.h"
+
+/* Keeps an open device that nothing is being played to yet running, by
+ * writing silence to it from a native thread of its own. Devices opened
+ * ahead of time by `Speaker.prepare()` idle like this until a Speaker takes
+ * them, so that its first write finds the device started rather than having
+ * to wait for the backend to get going.
+ *
+ * The thread writes IDLE_PERIOD_MS of silence at a time and keeps about one
+ * period queued in the device, going by its delay or by the clock if the
+ * backend can't tell, so that the audio written once it is stopped only
+ * waits for that. */
+
+#define IDLE_PERIOD_MS 10
+
+typedef struct {
+  audio_output_t *ao;
+  size_t period;                  /* frames */
+  unsigned char *silence;         /* a period of it */
+
+  uv_mutex_t lock;
+  uv_cond_t cond;
+  uv_thread_t thread;
+  int running;
+  int stopping;
+  int error;                      /* set when the device stopped taking audio */
+
+  pace pace;
+} idle;
+
+/* Starts the thread on `ao`, which is open. Returns -1 if it couldn't be
+ * started. */
+int idle_start(idle *d, audio_output_t *ao);
+
+/* Stops the thread and waits for it, returning -1 if the device stopped
+ * taking audio meanwhile. Does nothing if it isn't running. */
+int idle_stop(idle *d);
+
+#endif
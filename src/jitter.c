@@ -0,0 +1,311 @@
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "jitter.h"
+
+/* packets of buffering per packet period of interarrival jitter */
+#define JITTER_DEPTH_PER_JITTER 3
+
+enum { PLAY_PACKET, PLAY_CONCEALED, PLAY_SILENCE };
+
+/* Fills `j->play` with the last packet that came in, faded from where the
+ * previous concealed packet left off, or with silence. */
+static void conceal(jitter *j, int silence) {
+  audio_output_t *ao = j->ao;
+  size_t channels = ao->channels;
+  size_t samples = j->packet_frames * channels;
+  size_t i, c;
+
+  /* faded all the way out by now, with later packets still to come */
+  if (silence || !j->have_last || j->losses > JITTER_CONCEAL) {
+    memset(j->conceal, 0, samples * sizeof(float));
+  } else {
+    float from = 1.0f - (float) (j->losses - 1) / JITTER_CONCEAL;
+    float step = -1.0f / JITTER_CONCEAL / j->packet_frames;
+    dsp_to_float(j->conceal, j->last, samples, ao->format);
+    for (i = 0; i < j->packet_frames; i++) {
+      float g = from + step * i;
+      for (c = 0; c < channels; c++) j->conceal[i * channels + c] *= g;
+    }
+  }
+  dsp_from_float(j->play, j->conceal, samples, ao->format);
+}
+
+static void jitter_thread(void *arg) {
+  jitter *j = arg;
+  audio_output_t *ao = j->ao;
+  double lead = (double) j->packet_frames / ao->rate;
+
+  uv_mutex_lock(&j->lock);
+  for (;;) {
+    double wait;
+    int what = PLAY_SILENCE, failed;
+
+    if (j->state == JITTER_STOPPED) break;
+
+    /* about one packet in the device at a time, so that packets wait here,
+     * in order, rather than there; the backend isn't asked with the lock
+     * held, so pushes don't wait for it */
+    uv_mutex_unlock(&j->lock);
+    wait = pace_ahead(&j->pace) - lead;
+    uv_mutex_lock(&j->lock);
+    if (j->state == JITTER_STOPPED) break;
+    if (wait > 0) {
+      uv_cond_timedwait(&j->cond, &j->lock, (uint64_t) (wait * 1e9));
+      continue;
+    }
+
+    if (j->buffering) {
+      if (j->stats.buffered >= j->stats.target || (j->state == JITTER_ENDING && j->stats.buffered > 0)) {
+        j->buffering = 0;
+      } else if (j->state == JITTER_ENDING) {
+        break;
+      }
+    }
+    if (!j->buffering) {
+      jitter_slot *slot = &j->slots[j->next & (j->count - 1)];
+      if (slot->full && slot->seq == j->next) {
+        memcpy(j->play, slot->data, j->packet_size);
+        memcpy(j->last, slot->data, j->packet_size);
+        slot->full = 0;
+        j->stats.buffered--;
+        j->stats.played++;
+        j->have_last = 1;
+        j->losses = 0;
+        j->next++;
+        what = PLAY_PACKET;
+      } else if (j->stats.buffered == 0 && j->state == JITTER_ENDING) {
+        break;
+      } else if (j->stats.buffered == 0 && j->losses >= JITTER_CONCEAL) {
+        /* dry for a while: whatever comes next starts the stream over */
+        j->buffering = 1;
+        j->anchored = 0;
+        j->losses = 0;
+        j->stats.underruns++;
+      } else {
+        j->losses++;
+        j->stats.concealed++;
+        j->next++;
+        what = PLAY_CONCEALED;
+      }
+    }
+    uv_mutex_unlock(&j->lock);
+
+    if (what != PLAY_PACKET) conceal(j, what == PLAY_SILENCE);
+    if (what != PLAY_SILENCE) {
+      if (j->eq && !dsp_eq_is_flat(j->eq)) {
+        dsp_eq_apply(j->eq, j->play, j->packet_frames, ao->format);
+      }
+      if (j->gain && !dsp_gain_is_unity(j->gain)) {
+        dsp_gain_apply(j->gain, j->play, j->packet_frames, ao->channels, ao->format);
+      }
+    }
+
+    failed = pace_write(&j->pace, j->play, j->packet_size) != 0;
+    uv_mutex_lock(&j->lock);
+    if (failed) {
+      j->error = 1;
+      break;
+    }
+  }
+  j->state = JITTER_STOPPED;
+  uv_mutex_unlock(&j->lock);
+}
+
+int jitter_start(jitter *j, audio_output_t *ao, size_t packet_frames, int min_depth, int max_depth) {
+  size_t frame = dsp_sample_size(ao->format) * ao->channels;
+  size_t i;
+
+  if (frame == 0 || packet_frames == 0 || min_depth < 1 || max_depth < min_depth) return -1;
+
+  j->ao = ao;
+  j->packet_frames = packet_frames;
+  j->packet_size = packet_frames * frame;
+  j->min_depth = min_depth;
+  j->max_depth = max_depth;
+  for (j->count = 1; j->count < 4 * (size_t) max_depth; j->count <<= 1);
+
+  j->slots = calloc(j->count, sizeof(jitter_slot));
+  j->play = malloc(j->packet_size);
+  j->last = malloc(j->packet_size);
+  j->conceal = malloc(packet_frames * ao->channels * sizeof(float));
+  if (j->slots) j->slots[0].data = malloc(j->count * j->packet_size);
+  if (!j->slots || !j->slots[0].data || !j->play || !j->last || !j->conceal) goto fail;
+  for (i = 1; i < j->count; i++) j->slots[i].data = j->slots[0].data + i * j->packet_size;
+
+  j->state = JITTER_RUNNING;
+  j->error = 0;
+  j->anchored = 0;
+  j->buffering = 1;
+  j->losses = 0;
+  j->have_last = 0;
+  j->have_arrival = 0;
+  pace_init(&j->pace, ao);
+  memset(&j->stats, 0, sizeof(j->stats));
+  j->stats.target = min_depth;
+
+  if (!j->ready) {
+    if (uv_mutex_init(&j->lock) != 0) goto fail;
+    if (uv_cond_init(&j->cond) != 0) {
+      uv_mutex_destroy(&j->lock);
+      goto fail;
+    }
+    j->ready = 1;
+  }
+  uv_mutex_lock(&j->lock);
+  if (uv_thread_create(&j->thread, jitter_thread, j) != 0) {
+    uv_mutex_unlock(&j->lock);
+    goto fail;
+  }
+  j->running = 1;
+  uv_mutex_unlock(&j->lock);
+  return 0;
+
+fail:
+  if (j->slots) free(j->slots[0].data);
+  free(j->slots);
+  free(j->play);
+  free(j->last);
+  free(j->conceal);
+  j->slots = NULL;
+  j->play = j->last = NULL;
+  j->conceal = NULL;
+  return -1;
+}
+
+int jitter_push(jitter *j, uint16_t seq, const unsigned char *data) {
+  uint64_t now = uv_hrtime();
+  double period = (double) j->packet_frames / j->ao->rate;
+  jitter_slot *slot;
+  int ahead_of_next;
+  size_t i;
+
+  if (!j->ready) return -1;
+  uv_mutex_lock(&j->lock);
+  if (!j->running || j->state != JITTER_RUNNING) {
+    uv_mutex_unlock(&j->lock);
+    return -1;
+  }
+
+  /* RFC 3550: the difference in transit time between this packet and the
+   * one that arrived before it, smoothed with a gain of 1/16 */
+  if (j->have_arrival) {
+    double d = (now - j->last_arrival) / 1e9 - (int16_t) (seq - j->last_seq) * period;
+    int target;
+    j->stats.jitter += (fabs(d) - j->stats.jitter) / 16;
+    target = j->min_depth + (int) (JITTER_DEPTH_PER_JITTER * j->stats.jitter / period + 0.5);
+    j->stats.target = target > j->max_depth ? j->max_depth : target;
+  }
+  j->last_arrival = now;
+  j->last_seq = seq;
+  j->have_arrival = 1;
+
+  if (!j->anchored) {
+    j->next = seq;
+    j->anchored = 1;
+  }
+  ahead_of_next = (int16_t) (seq - j->next);
+
+  if (ahead_of_next < 0 && j->buffering && -ahead_of_next < (int) j->count / 2) {
+    /* nothing has been played since it was anchored, so it can move back to
+     * a packet that got overtaken */
+    j->next = seq;
+  } else if (ahead_of_next < 0) {
+    j->stats.late++;
+    uv_mutex_unlock(&j->lock);
+    return -1;
+  } else if (ahead_of_next >= (int) j->count / 2) {
+    /* a jump, the sender must have started over */
+    for (i = 0; i < j->count; i++) j->slots[i].full = 0;
+    j->stats.buffered = 0;
+    j->next = seq;
+    j->buffering = 1;
+  }
+
+  slot = &j->slots[seq & (j->count - 1)];
+  if (slot->full) {
+    j->stats.late++;
+    uv_mutex_unlock(&j->lock);
+    return -1;
+  }
+  memcpy(slot->data, data, j->packet_size);
+  slot->seq = seq;
+  slot->full = 1;
+  j->stats.buffered++;
+  j->stats.received++;
+
+  /* too deep: the oldest packets go */
+  while (j->stats.buffered > j->max_depth) {
+    slot = &j->slots[j->next & (j->count - 1)];
+    if (slot->full && slot->seq == j->next) {
+      slot->full = 0;
+      j->stats.buffered--;
+      j->stats.dropped++;
+    }
+    j->next++;
+  }
+
+  /* the cond is shared with stops waiting for each other */
+  uv_cond_broadcast(&j->cond);
+  uv_mutex_unlock(&j->lock);
+  return 0;
+}
+
+void jitter_get_stats(jitter *j, jitter_stats *stats) {
+  if (!j->ready) {
+    *stats = j->stats;
+    return;
+  }
+  uv_mutex_lock(&j->lock);
+  *stats = j->stats;
+  uv_mutex_unlock(&j->lock);
+}
+
+void jitter_stop(jitter *j, int drain) {
+  if (!j->ready) return;
+
+  uv_mutex_lock(&j->lock);
+  if (!j->running) {
+    uv_mutex_unlock(&j->lock);
+    return;
+  }
+  if (!drain) {
+    j->state = JITTER_STOPPED;
+  } else if (j->state == JITTER_RUNNING) {
+    j->state = JITTER_ENDING;
+  }
+  uv_cond_broadcast(&j->cond);
+  if (j->joining) {
+    /* the first stop joins the thread and frees the buffers */
+    while (j->running) uv_cond_wait(&j->cond, &j->lock);
+    uv_mutex_unlock(&j->lock);
+    return;
+  }
+  j->joining = 1;
+  uv_mutex_unlock(&j->lock);
+
+  uv_thread_join(&j->thread);
+
+  uv_mutex_lock(&j->lock);
+  free(j->slots[0].data);
+  free(j->slots);
+  free(j->play);
+  free(j->last);
+  free(j->conceal);
+  j->slots = NULL;
+  j->play = j->last = NULL;
+  j->conceal = NULL;
+  j->running = 0;
+  j->joining = 0;
+  uv_cond_broadcast(&j->cond);
+  uv_mutex_unlock(&j->lock);
+}
+
+void jitter_free(jitter *j) {
+  jitter_stop(j, 0);
+  if (!j->ready) return;
+  uv_cond_destroy(&j->cond);
+  uv_mutex_destroy(&j->lock);
+  j->ready = 0;
+}
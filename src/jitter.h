@@ -0,0 +1,118 @@
+#ifndef SPEAKER_JITTER_H
+#define SPEAKER_JITTER_H
+
+#include <stdint.h>
+#include <uv.h>
+
+#include "output.h"
+#include "dsp.h"
+#include "pace.h"
+
+/* A jitter buffer for packetised real-time audio (VoIP, RTP, ...): packets
+ * of a fixed number of frames come in with 16-bit sequence numbers that
+ * wrap around, in whatever order the network delivers them, and a native
+ * thread of its own plays them out in order.
+ *
+ * The thread keeps about one packet queued in the device, going by its delay
+ * or by the clock if the backend can't tell. It waits for `target` packets
+ * before it starts playing. `target` follows the interarrival jitter,
+ * estimated as in RFC 3550, between `min_depth` and `max_depth`. A packet
+ * that isn't there when its turn comes is concealed by repeating the last
+ * one, fading out over JITTER_CONCEAL packets, and by silence past that if
+ * later packets are waiting. If the buffer stays empty that long, the thread
+ * writes silence, so that the device doesn't underrun, until it has buffered
+ * `target` packets again. Packets that come
+ * in after their turn are dropped, and so is the oldest when more than
+ * `max_depth` are waiting. */
+
+#define JITTER_CONCEAL 5
+
+#define JITTER_RUNNING 0
+#define JITTER_ENDING 1           /* play what is left, then stop */
+#define JITTER_STOPPED 2
+
+typedef struct {
+  uint64_t received;
+  uint64_t played;
+  uint64_t concealed;
+  uint64_t late;                  /* came in after their turn, or twice */
+  uint64_t dropped;               /* to keep the depth at max_depth */
+  uint64_t underruns;             /* times it ran dry and buffered up again */
+  double jitter;                  /* interarrival jitter, in seconds */
+  int target;                     /* packets to buffer before playing */
+  int buffered;
+} jitter_stats;
+
+typedef struct {
+  uint16_t seq;
+  int full;
+  unsigned char *data;
+} jitter_slot;
+
+typedef struct {
+  audio_output_t *ao;
+  dsp_gain *gain;
+  dsp_eq *eq;
+
+  size_t packet_frames;
+  size_t packet_size;             /* bytes */
+  int min_depth;
+  int max_depth;
+
+  /* indexed by sequence number, a power of two of them so that the mapping
+   * carries on across the wrap around */
+  jitter_slot *slots;
+  size_t count;
+  unsigned char *play;            /* the packet being written */
+  unsigned char *last;            /* the last one that came in time, for concealment */
+  float *conceal;
+
+  /* the lock and cond are set up by the first start and live until
+   * jitter_free(), so that pushes and stops from other threads can always
+   * take the lock; `running` and `joining` are only changed under it */
+  uv_mutex_t lock;
+  uv_cond_t cond;
+  int ready;
+  uv_thread_t thread;
+  int running;
+  int joining;                    /* a stop is waiting for the thread */
+  int state;                      /* JITTER_RUNNING, JITTER_ENDING or JITTER_STOPPED */
+  int error;                      /* set when the device stopped taking audio */
+
+  int anchored;                   /* whether `next` is known */
+  int buffering;
+  uint16_t next;
+  int losses;                     /* packets concealed in a row */
+  int have_last;
+
+  uint64_t last_arrival;          /* uv_hrtime() */
+  uint16_t last_seq;
+  int have_arrival;
+
+  pace pace;
+
+  jitter_stats stats;
+} jitter;
+
+/* Starts the thread on `ao`, which is open. `gain` and `eq` are to be set up
+ * beforehand, or NULL. Returns -1 if it couldn't be started. */
+int jitter_start(jitter *j, audio_output_t *ao, size_t packet_frames, int min_depth, int max_depth);
+
+/* Inserts a packet of `packet_size` bytes, from any thread. Returns 0 if it
+ * was taken, or -1 if it was late or a duplicate, or the buffer is stopping
+ * or stopped. */
+int jitter_push(jitter *j, uint16_t seq, const unsigned char *data);
+
+/* Copies the statistics, from any thread. */
+void jitter_get_stats(jitter *j, jitter_stats *stats);
+
+/* Asks the thread to stop, right away or once the buffer ran dry, and waits
+ * for it, from any thread. A stop while another one is waiting waits for
+ * that one, hurrying it along unless `drain` is set. Does nothing if it isn't
+ * running. The statistics stay readable. */
+void jitter_stop(jitter *j, int drain);
+
+/* Stops the thread and frees the lock, once nothing else can use `j`. */
+void jitter_free(jitter *j);
+
+#endif
@@ -0,0 +1,52 @@
+#include "metrics.h"
+#include "atomic.h"
+
+metrics metrics_process;
+
+static unsigned bucket_of(uint32_t v) {
+  unsigned msb = 31;
+
+  if (v < (1u << METRICS_SUB_BITS)) return v;
+  while (!(v & (1u << msb))) msb--;
+  return ((msb - METRICS_SUB_BITS + 1) << METRICS_SUB_BITS) +
+         ((v >> (msb - METRICS_SUB_BITS)) & ((1u << METRICS_SUB_BITS) - 1));
+}
+
+/* the highest value that falls into bucket `i` */
+static uint64_t bucket_top(unsigned i) {
+  unsigned shift;
+
+  if (i < (1u << METRICS_SUB_BITS)) return i;
+  shift = (i >> METRICS_SUB_BITS) - 1;
+  return ((uint64_t) ((1u << METRICS_SUB_BITS) + (i & ((1u << METRICS_SUB_BITS) - 1)) + 1) << shift) - 1;
+}
+
+void metrics_record(metrics_histogram *h, uint64_t value) {
+  uint32_t v = value > UINT32_MAX ? UINT32_MAX : (uint32_t) value;
+
+  atomic_add_u32(&h->counts[bucket_of(v)], 1);
+  atomic_add_u64(&h->count, 1);
+  atomic_add_u64(&h->sum, v);
+  atomic_max_u64(&h->max, v);
+}
+
+uint64_t metrics_percentile(const metrics_histogram *h, double quantile) {
+  uint64_t total = 0, seen = 0, rank;
+  unsigned i;
+
+  for (i = 0; i < METRICS_BUCKETS; i++) total += h->counts[i];
+  if (total == 0) return 0;
+
+  rank = (uint64_t) (quantile * total + 0.5);
+  if (rank < 1) rank = 1;
+  if (rank > total) rank = total;
+  for (i = 0; i < METRICS_BUCKETS; i++) {
+    seen += h->counts[i];
+    if (seen >= rank) {
+      /* a bucket's top can be past the largest value that went into it */
+      uint64_t top = bucket_top(i);
+      return top < h->max ? top : h->max;
+    }
+  }
+  return h->max;
+}
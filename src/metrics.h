@@ -0,0 +1,44 @@
+#ifndef SPEAKER_METRICS_H
+#define SPEAKER_METRICS_H
+
+#include <stdint.h>
+
+/* Histograms of the native write path, kept per speaker and for the whole
+ * process. Recording is a couple of relaxed atomic adds, so the threadpool
+ * threads and the JS thread can record into the same histogram without a
+ * lock; reading one while it's being recorded into may be off by the values
+ * in flight, which is fine for statistics.
+ *
+ * Buckets are HDR-style: exact below 2^METRICS_SUB_BITS, then
+ * 2^METRICS_SUB_BITS of them per power of two, so any value lands in a bucket
+ * within 1/2^METRICS_SUB_BITS (12.5%) of it, from 1 up to 2^32. */
+
+#define METRICS_SUB_BITS 3
+#define METRICS_BUCKETS ((32 - METRICS_SUB_BITS + 1) << METRICS_SUB_BITS)
+
+typedef struct {
+  volatile uint32_t counts[METRICS_BUCKETS];
+  volatile uint64_t count;
+  volatile uint64_t sum;
+  volatile uint64_t max;
+} metrics_histogram;
+
+typedef struct {
+  metrics_histogram queue_wait;     /* µs from write() to a threadpool thread picking it up */
+  metrics_histogram write_time;     /* µs spent in ao->write() */
+  metrics_histogram write_bytes;    /* bytes per write() */
+  metrics_histogram callback_delay; /* µs from ao->write() returning to the JS thread resolving the write */
+  volatile uint32_t short_writes;   /* writes that ao->write() took less of than it was given */
+} metrics;
+
+/* the histograms of all speakers together */
+extern metrics metrics_process;
+
+/* Records `value` (clamped to 2^32 - 1). */
+void metrics_record(metrics_histogram *h, uint64_t value);
+
+/* Returns the value below which `quantile` (0 to 1) of the recorded values
+ * fall, to within the bucket precision, or 0 if nothing was recorded. */
+uint64_t metrics_percentile(const metrics_histogram *h, double quantile);
+
+#endif
@@ -0,0 +1,66 @@
+#include <uv.h>
+
+#include "pace.h"
+#include "dsp.h"
+
+void pace_init(pace *p, audio_output_t *ao) {
+  p->ao = ao;
+  p->frame = dsp_sample_size(ao->format) * ao->channels;
+  p->start = 0;
+  p->written = 0;
+  p->by_clock = 0;
+  p->delay = 0;
+  p->delay_written = 0;
+  p->delay_since = 0;
+}
+
+/* Whether the device holds `queued` frames that it isn't playing: the same
+ * as, or more than, at the last look PACE_STALL seconds or more ago, with
+ * nothing written since. */
+static int stalled(pace *p, int queued) {
+  uint64_t now = uv_hrtime();
+
+  if (queued == 0 || queued < p->delay || p->written != p->delay_written || !p->delay_since) {
+    p->delay_since = now;
+  }
+  p->delay = queued;
+  p->delay_written = p->written;
+  return (now - p->delay_since) / 1e9 >= PACE_STALL;
+}
+
+double pace_ahead(pace *p) {
+  audio_output_t *ao = p->ao;
+  int queued = ao->delay && !p->by_clock ? ao->delay(ao) : -1;
+  double behind;
+
+  if (queued >= 0 && stalled(p, queued)) {
+    p->by_clock = 1;
+    queued = -1;
+  }
+  if (queued >= 0) return (double) queued / ao->rate;
+  if (!p->start) return 0;
+  behind = (uv_hrtime() - p->start) / 1e9 - (double) p->written / ao->rate;
+  if (behind > PACE_RESYNC) {
+    p->start = 0;
+    return 0;
+  }
+  return -behind;
+}
+
+int pace_write(pace *p, const unsigned char *buf, size_t bytes) {
+  audio_output_t *ao = p->ao;
+  size_t left = bytes;
+
+  if (!p->start) {
+    p->start = uv_hrtime();
+    p->written = 0;
+  }
+  while (left > 0) {
+    int written = ao->write(ao, (unsigned char *) buf, (int) left);
+    if (written <= 0) return -1;
+    buf += written;
+    left -= written;
+  }
+  p->written += bytes / p->frame;
+  return 0;
+}
@@ -0,0 +1,46 @@
+#ifndef SPEAKER_PACE_H
+#define SPEAKER_PACE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "output.h"
+
+/* Keeps an output thread of its own (jitter buffer, clip mixer, idling
+ * device) about as far ahead of the device as it wants to be. How far ahead
+ * it is comes from the device delay, or from the clock for backends that
+ * can't tell: the time since the first write against the audio written
+ * since. Falling more than PACE_RESYNC seconds behind the clock (the device
+ * blocked, or the process was stopped) restarts it rather than catching up
+ * in a burst.
+ *
+ * A delay that doesn't drop for PACE_STALL seconds without a write in
+ * between comes from a device that waits for more than it was given before
+ * it starts; from then on the clock is gone by instead, as waiting for that
+ * delay to drop would wait forever. */
+
+#define PACE_RESYNC 0.1
+#define PACE_STALL 0.1
+
+typedef struct {
+  audio_output_t *ao;
+  size_t frame;                   /* bytes */
+  uint64_t start;                 /* uv_hrtime() of the first write, 0 before it */
+  uint64_t written;               /* frames since then */
+  int by_clock;                   /* the delay is of no use */
+  int delay;                      /* frames, at the last look */
+  uint64_t delay_written;         /* `written` then */
+  uint64_t delay_since;           /* uv_hrtime() since when it didn't drop */
+} pace;
+
+void pace_init(pace *p, audio_output_t *ao);
+
+/* Returns the seconds of audio that the device holds. Asks the backend, so
+ * it is best called without holding locks that other threads wait for. */
+double pace_ahead(pace *p);
+
+/* Writes all `bytes` of `buf` to the device, and counts them for the clock.
+ * Returns -1 if the device stopped taking audio. */
+int pace_write(pace *p, const unsigned char *buf, size_t bytes);
+
+#endif
@@ -0,0 +1,314 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "decode.h"
+#include "dsp.h"
+#include "playlist.h"
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+playlist *playlist_new(long rate, int channels, int encoding, size_t period) {
+  playlist *pl = calloc(1, sizeof(playlist));
+  if (!pl) return NULL;
+
+  pl->rate = rate;
+  pl->channels = channels;
+  pl->encoding = encoding;
+  pl->period = period;
+  pl->mix = malloc(period * channels * sizeof(float));
+  pl->fade = malloc(period * channels * sizeof(float));
+  pl->post = malloc(period * channels * sizeof(float));
+  pl->raw = malloc(period * 2 * sizeof(float));
+  pl->out = malloc(period * channels * dsp_sample_size(encoding));
+  pl->held = malloc(channels * sizeof(float));
+
+  if (!pl->held || !pl->mix || !pl->fade || !pl->post || !pl->raw || !pl->out) {
+    playlist_free(pl);
+    return NULL;
+  }
+  return pl;
+}
+
+static void track_free(playlist_track *t) {
+  if (t->mh) {
+    mpg123_close(t->mh);
+    mpg123_delete(t->mh);
+  }
+  free(t->pre);
+  free(t->path);
+  free(t);
+}
+
+void playlist_free(playlist *pl) {
+  if (!pl) return;
+  while (pl->head) {
+    playlist_track *next = pl->head->next;
+    track_free(pl->head);
+    pl->head = next;
+  }
+  free(pl->held);
+  free(pl->mix);
+  free(pl->fade);
+  free(pl->post);
+  free(pl->raw);
+  free(pl->out);
+  free(pl);
+}
+
+int playlist_add(playlist *pl, const char *path) {
+  playlist_track *t = calloc(1, sizeof(playlist_track));
+  if (!t) return -1;
+  t->path = malloc(strlen(path) + 1);
+  if (!t->path) {
+    free(t);
+    return -1;
+  }
+  strcpy(t->path, path);
+
+  if (pl->tail) {
+    pl->tail->next = t;
+  } else {
+    pl->head = t;
+  }
+  pl->tail = t;
+  return 0;
+}
+
+void playlist_set_crossfade(playlist *pl, size_t frames) {
+  pl->crossfade_next = frames;
+}
+
+/* Reads up to `frames` frames of `t`, converted to float and laid out in the
+ * playlist's channel count. Returns fewer frames once the track is done. */
+static size_t track_read(playlist *pl, playlist_track *t, float *dst, size_t frames) {
+  size_t got = 0;
+  size_t sample_size = dsp_sample_size(t->encoding);
+  size_t frame_size = sample_size * t->channels;
+
+  if (t->pre_pos < t->pre_fill) {
+    size_t n = t->pre_fill - t->pre_pos;
+    if (n > frames) n = frames;
+    memcpy(dst, t->pre + t->pre_pos * pl->channels, n * pl->channels * sizeof(float));
+    t->pre_pos += n;
+    got += n;
+  }
+
+  while (got < frames && !t->done) {
+    size_t want = frames - got;
+    size_t bytes = 0;
+    size_t n;
+    int r;
+
+    if (want > pl->period) want = pl->period;
+    r = mpg123_read(t->mh, pl->raw, want * frame_size, &bytes);
+    n = bytes / frame_size;
+
+    decode_to_float(dst + got * pl->channels, pl->raw, n, t->channels, pl->channels, t->encoding);
+    got += n;
+
+    if (r == MPG123_DONE) {
+      t->done = 1;
+    } else if (r != MPG123_OK && r != MPG123_NEW_FORMAT) {
+      t->done = 1;
+      t->error = r;
+    }
+  }
+  return got;
+}
+
+/* Records a track event for the JS side, if there is still room for it. */
+static void event(playlist_result *result, int type, const char *reason) {
+  if (result->event_count < PLAYLIST_EVENTS) {
+    result->events[result->event_count] = type;
+    result->reasons[result->event_count] = reason;
+    result->event_count++;
+  }
+}
+
+/* Opens the track and decodes its first period, so that it is ready to go the
+ * moment the previous track ends. */
+static int track_open(playlist *pl, playlist_track *t) {
+  int err = MPG123_OK;
+
+  t->mh = mpg123_new(NULL, &err);
+  if (!t->mh) goto fail;
+
+  /* cover art can run to megabytes: seek over it rather than read it in */
+  mpg123_param(t->mh, MPG123_ADD_FLAGS, MPG123_QUIET | MPG123_LAZY_ID3, 0);
+  mpg123_format_none(t->mh);
+
+  if (decode_format(t->mh, pl->rate, pl->channels, &t->encoding) != MPG123_OK) goto fail;
+  t->channels = decode_channels(pl->channels);
+
+  if (mpg123_open(t->mh, t->path) != MPG123_OK) goto fail;
+
+  t->pre = malloc(pl->period * pl->channels * sizeof(float));
+  if (!t->pre) goto fail;
+  t->pre_fill = track_read(pl, t, t->pre, pl->period);
+  t->pre_pos = 0;
+  /* nothing decodable in there at all */
+  if (t->pre_fill == 0 && t->error) {
+    t->open_error = t->error;
+    return -1;
+  }
+  return 0;
+
+fail:
+  t->open_error = t->mh ? mpg123_errcode(t->mh) : err;
+  if (t->open_error == MPG123_OK) t->open_error = MPG123_ERR;
+  return -1;
+}
+
+static int emit(playlist *pl, audio_output_t *ao, const float *buf, size_t frames, playlist_result *result) {
+  size_t frame_size = dsp_sample_size(pl->encoding) * pl->channels;
+
+  while (frames > 0) {
+    size_t n = frames > pl->period ? pl->period : frames;
+    int bytes = (int) (n * frame_size);
+
+    const float *src = buf;
+
+    int gain = pl->gain && !dsp_gain_is_unity(pl->gain);
+    int eq = pl->eq && !dsp_eq_is_flat(pl->eq);
+
+    if (gain || eq) {
+      memcpy(pl->post, buf, n * pl->channels * sizeof(float));
+      if (eq) dsp_eq_apply_float(pl->eq, pl->post, n);
+      if (gain) dsp_gain_apply_float(pl->gain, pl->post, n, pl->channels);
+      src = pl->post;
+    }
+    dsp_from_float(pl->out, src, n * pl->channels, pl->encoding);
+    if (ao->write(ao, pl->out, bytes) != bytes) {
+      result->error = "write() failed";
+      return -1;
+    }
+    result->written += bytes;
+    buf += n * pl->channels;
+    frames -= n;
+  }
+  return 0;
+}
+
+/* Writes decoded frames of the current track, holding the last `crossfade`
+ * frames back until it is known whether another track follows. */
+static int push(playlist *pl, audio_output_t *ao, const float *buf, size_t frames, playlist_result *result) {
+  size_t ch = pl->channels;
+
+  if (pl->held_fill + frames > pl->crossfade) {
+    size_t over = pl->held_fill + frames - pl->crossfade;
+    size_t from_held = over < pl->held_fill ? over : pl->held_fill;
+
+    if (emit(pl, ao, pl->held, from_held, result) != 0) return -1;
+    memmove(pl->held, pl->held + from_held * ch, (pl->held_fill - from_held) * ch * sizeof(float));
+    pl->held_fill -= from_held;
+
+    if (emit(pl, ao, buf, over - from_held, result) != 0) return -1;
+    buf += (over - from_held) * ch;
+    frames -= over - from_held;
+  }
+
+  memcpy(pl->held + pl->held_fill * ch, buf, frames * ch * sizeof(float));
+  pl->held_fill += frames;
+  return 0;
+}
+
+/* Equal power crossfade of the held back frames into the beginning of `next`. */
+static int crossfade(playlist *pl, audio_output_t *ao, playlist_track *next, playlist_result *result) {
+  size_t ch = pl->channels;
+  size_t total = pl->held_fill;
+  size_t pos = 0;
+
+  while (pos < total) {
+    size_t n = total - pos > pl->period ? pl->period : total - pos;
+    size_t got = track_read(pl, next, pl->fade, n);
+    size_t i, c;
+
+    for (i = 0; i < n; i++) {
+      double t = (pos + i + 0.5) / total;
+      float out = (float) cos(t * M_PI / 2);
+      float in = (float) sin(t * M_PI / 2);
+      for (c = 0; c < ch; c++) {
+        float a = pl->held[(pos + i) * ch + c];
+        float b = i < got ? pl->fade[i * ch + c] : 0.0f;
+        pl->mix[i * ch + c] = a * out + b * in;
+      }
+    }
+    if (emit(pl, ao, pl->mix, n, result) != 0) return -1;
+    pos += n;
+  }
+  pl->held_fill = 0;
+  return 0;
+}
+
+static int apply_crossfade(playlist *pl, audio_output_t *ao, playlist_result *result) {
+  float *held;
+
+  if (pl->crossfade_next == pl->crossfade) return 0;
+
+  if (emit(pl, ao, pl->held, pl->held_fill, result) != 0) return -1;
+  pl->held_fill = 0;
+
+  held = realloc(pl->held, (pl->crossfade_next + 1) * pl->channels * sizeof(float));
+  if (!held) {
+    result->error = "Out of memory";
+    return -1;
+  }
+  pl->held = held;
+  pl->crossfade = pl->crossfade_next;
+  return 0;
+}
+
+void playlist_play(playlist *pl, audio_output_t *ao, size_t frames, playlist_result *result) {
+  memset(result, 0, sizeof(playlist_result));
+
+  if (apply_crossfade(pl, ao, result) != 0) return;
+
+  /* stop early rather than losing events */
+  while (pl->head && result->written < frames * dsp_sample_size(pl->encoding) * pl->channels
+    && result->event_count < PLAYLIST_EVENTS - 2) {
+    playlist_track *t = pl->head;
+    playlist_track *next;
+    size_t n;
+
+    if (!t->mh || t->open_error) {
+      if (t->open_error || track_open(pl, t) != 0) {
+        event(result, PLAYLIST_SKIPPED, mpg123_plain_strerror(t->open_error));
+        pl->head = t->next;
+        if (!pl->head) pl->tail = NULL;
+        track_free(t);
+        continue;
+      }
+      event(result, PLAYLIST_STARTED, NULL);
+    }
+
+    /* prime the following track while there is still audio to play; a
+     * failure gets reported once it is that track's turn */
+    if (t->next && !t->next->mh) track_open(pl, t->next);
+
+    n = track_read(pl, t, pl->mix, pl->period);
+    if (n > 0 && push(pl, ao, pl->mix, n, result) != 0) return;
+    if (n == pl->period || !t->done) continue;
+
+    /* end of the track: either fade into the next one or let the held back
+     * frames play out as they are */
+    next = t->next;
+    if (next && !next->mh) track_open(pl, next);
+    if (next && !next->open_error) {
+      if (pl->held_fill > 0 && crossfade(pl, ao, next, result) != 0) return;
+      event(result, PLAYLIST_STARTED, NULL);
+    }
+    pl->head = next;
+    if (!next) pl->tail = NULL;
+    track_free(t);
+  }
+
+  if (!pl->head) {
+    if (emit(pl, ao, pl->held, pl->held_fill, result) != 0) return;
+    pl->held_fill = 0;
+    result->done = 1;
+  }
+}
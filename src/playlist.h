@@ -0,0 +1,80 @@
+#ifndef SPEAKER_PLAYLIST_H
+#define SPEAKER_PLAYLIST_H
+
+#include "output.h"
+#include "dsp.h"
+
+/* A queue of MPEG audio files that get decoded straight into one already open
+ * `audio_output_t`, so that consecutive tracks play back to back without
+ * reopening the device. libmpg123's gapless support trims the encoder delay and
+ * padding of each track, the following track is opened and primed before the
+ * current one ends, and the last `crossfade` frames of a track can optionally
+ * be mixed into the beginning of the next one.
+ *
+ * A playlist is not thread safe; it is only ever used from the one libuv
+ * threadpool job that is currently playing it. */
+
+typedef struct playlist_track {
+  char *path;
+  mpg123_handle *mh;
+  int encoding;             /* decoder output encoding */
+  int channels;             /* decoder output channels */
+  int done;
+  int error;                /* mpg123 error that ended the track early */
+  int open_error;           /* mpg123 error that kept the track from playing */
+  float *pre;               /* frames decoded ahead of time while priming */
+  size_t pre_fill;
+  size_t pre_pos;
+  struct playlist_track *next;
+} playlist_track;
+
+typedef struct {
+  long rate;
+  int channels;
+  int encoding;
+  size_t period;            /* frames decoded per step */
+
+  playlist_track *head;     /* the track that is currently playing */
+  playlist_track *tail;
+
+  size_t crossfade;         /* frames */
+  size_t crossfade_next;    /* requested crossfade, applied on the next step */
+  float *held;              /* the last `crossfade` frames of the current track */
+  size_t held_fill;
+
+  dsp_gain *gain;           /* applied to everything written, may be NULL */
+  dsp_eq *eq;               /* same */
+
+  float *mix;
+  float *fade;
+  float *post;              /* scratch space for the gain and EQ */
+  unsigned char *raw;
+  unsigned char *out;
+} playlist;
+
+#define PLAYLIST_STARTED 1
+#define PLAYLIST_SKIPPED 2
+#define PLAYLIST_EVENTS 16
+
+typedef struct {
+  size_t written;           /* bytes written to the device */
+  int events[PLAYLIST_EVENTS]; /* one per track that started or was skipped, in queue order */
+  const char *reasons[PLAYLIST_EVENTS]; /* why a track was skipped */
+  int event_count;
+  int done;                 /* the queue ran dry */
+  const char *error;        /* the device write failed */
+} playlist_result;
+
+playlist *playlist_new(long rate, int channels, int encoding, size_t period);
+void playlist_free(playlist *pl);
+
+/* Appends a file to the queue. Returns 0 on success. */
+int playlist_add(playlist *pl, const char *path);
+
+/* Changes the crossfade length, starting with the next playlist_play() call. */
+void playlist_set_crossfade(playlist *pl, size_t frames);
+
+/* Decodes and writes roughly `frames` frames of the queue to `ao`. */
+void playlist_play(playlist *pl, audio_output_t *ao, size_t frames, playlist_result *result);
+
+#endif
@@ -0,0 +1,173 @@
+#include <stdlib.h>
+#include <string.h>
+#include <uv.h>
+
+#include "probe.h"
+
+typedef struct probe_cached {
+  mpg123_module_t *module;
+  char *device;             /* NULL for the default device */
+  long rate;
+  int channels;
+  int formats;
+  struct probe_cached *next;
+} probe_cached;
+
+static uv_once_t once = UV_ONCE_INIT;
+static uv_mutex_t lock;
+static probe_cached *cache;
+
+static void probe_init(void) {
+  uv_mutex_init(&lock);
+}
+
+static int same_device(const char *a, const char *b) {
+  if (a == NULL || b == NULL) return a == b;
+  return strcmp(a, b) == 0;
+}
+
+/* call with the lock held */
+static probe_cached *lookup(mpg123_module_t *module, const char *device, long rate, int channels) {
+  probe_cached *c;
+
+  for (c = cache; c != NULL; c = c->next) {
+    if (c->module == module && c->rate == rate && c->channels == channels && same_device(c->device, device)) {
+      return c;
+    }
+  }
+  return NULL;
+}
+
+static void store(mpg123_module_t *module, const char *device, long rate, int channels, int formats) {
+  probe_cached *c;
+
+  uv_mutex_lock(&lock);
+  /* another thread may have probed the same device meanwhile */
+  c = lookup(module, device, rate, channels);
+  if (c == NULL) {
+    c = calloc(1, sizeof(probe_cached));
+    if (c != NULL && device != NULL && (c->device = strdup(device)) == NULL) {
+      free(c);
+      c = NULL;
+    }
+    if (c != NULL) {
+      c->module = module;
+      c->rate = rate;
+      c->channels = channels;
+      c->next = cache;
+      cache = c;
+    }
+  }
+  if (c != NULL) c->formats = formats;
+  uv_mutex_unlock(&lock);
+}
+
+/* Opens the device and asks it about every rate that libmpg123 decodes to,
+ * caching the answers. */
+static int probe_open(mpg123_module_t *module, const char *device) {
+  const long *rates;
+  size_t num_rates, i;
+  audio_output_t ao;
+  int channels;
+
+  memset(&ao, 0, sizeof(audio_output_t));
+  if (module->init_output(&ao) != 0) return -1;
+  ao.device = (char *) device;
+  ao.channels = 2;
+  ao.rate = 44100;
+  ao.format = MPG123_ENC_SIGNED_16;
+  if (ao.open(&ao) < 0) {
+    if (ao.deinit) ao.deinit(&ao);
+    return -1;
+  }
+
+  mpg123_rates(&rates, &num_rates);
+  for (channels = 1; channels <= 2; channels++) {
+    for (i = 0; i < num_rates; i++) {
+      ao.rate = rates[i];
+      ao.channels = channels;
+      store(module, device, ao.rate, channels, ao.get_formats(&ao));
+    }
+  }
+
+  ao.close(&ao);
+  if (ao.deinit) ao.deinit(&ao);
+  return 0;
+}
+
+int probe_formats(mpg123_module_t *module, const char *device, long rate, int channels) {
+  probe_cached *c;
+  int formats = -1;
+
+  uv_once(&once, probe_init);
+  uv_mutex_lock(&lock);
+  c = lookup(module, device, rate, channels);
+  if (c != NULL) formats = c->formats;
+  uv_mutex_unlock(&lock);
+  return formats;
+}
+
+/* Copies the cached entries of a device into `list`, or returns 0 if it isn't
+ * cached yet. */
+static size_t collect(mpg123_module_t *module, const char *device, probe_entry *list) {
+  const long *rates;
+  size_t num_rates, i, n = 0;
+  probe_cached *c;
+  int channels;
+
+  mpg123_rates(&rates, &num_rates);
+  uv_mutex_lock(&lock);
+  for (channels = 1; channels <= 2; channels++) {
+    for (i = 0; i < num_rates; i++) {
+      c = lookup(module, device, rates[i], channels);
+      if (c == NULL) {
+        n = 0;
+        goto done;
+      }
+      list[n].rate = rates[i];
+      list[n].channels = channels;
+      list[n].formats = c->formats;
+      n++;
+    }
+  }
+done:
+  uv_mutex_unlock(&lock);
+  return n;
+}
+
+int probe_device(mpg123_module_t *module, const char *device, probe_entry **entries, size_t *count) {
+  const long *rates;
+  size_t num_rates;
+  probe_entry *list;
+
+  uv_once(&once, probe_init);
+  mpg123_rates(&rates, &num_rates);
+  list = malloc(2 * num_rates * sizeof(probe_entry));
+  if (list == NULL) return -1;
+
+  *count = collect(module, device, list);
+  if (*count == 0) {
+    if (probe_open(module, device) != 0) {
+      free(list);
+      return -1;
+    }
+    *count = collect(module, device, list);
+  }
+  *entries = list;
+  return 0;
+}
+
+int probe_enumerate(mpg123_module_t *module, int (*store)(void *arg, const char *name, const char *description), void *arg) {
+  audio_output_t ao;
+  int r = 0;
+
+  memset(&ao, 0, sizeof(audio_output_t));
+  if (module->init_output(&ao) != 0) return -1;
+  if (ao.enumerate) {
+    r = ao.enumerate(&ao, store, arg);
+  } else {
+    r = store(arg, NULL, "Default device");
+  }
+  if (ao.deinit) ao.deinit(&ao);
+  return r;
+}
@@ -0,0 +1,39 @@
+#ifndef SPEAKER_PROBE_H
+#define SPEAKER_PROBE_H
+
+#include <stddef.h>
+
+#include "output.h"
+
+/* Finds out what a device plays by opening it, the way mpg123's
+ * `audio_capabilities()` does: the device gets opened once, and
+ * `get_formats()` is asked about each rate that libmpg123 decodes to, in mono
+ * and in stereo. Nothing is probed before it is asked for, and the answers are
+ * cached per module, device, rate and channel count for the life of the
+ * process, so that each device is only opened once. Probing is done on
+ * whatever thread asks, without holding the cache's lock, so devices can be
+ * probed in parallel. */
+
+typedef struct {
+  long rate;
+  int channels;
+  int formats;              /* MPG123_ENC_* bitmask */
+} probe_entry;
+
+/* Returns the formats that `device` of `module` (the default device for NULL)
+ * plays at `rate` and `channels` from the cache, without opening anything.
+ * Returns -1 if the device hasn't been probed yet, or not at that rate. */
+int probe_formats(mpg123_module_t *module, const char *device, long rate, int channels);
+
+/* Probes `device` of `module` at every rate and channel count, or gets it
+ * from the cache, and returns the `count` entries in a new array for the
+ * caller to free(). Returns -1 if the device couldn't be opened; failures
+ * aren't cached, since the device may show up later. */
+int probe_device(mpg123_module_t *module, const char *device, probe_entry **entries, size_t *count);
+
+/* Lists the devices of `module` through `store()`, without opening any. Modules
+ * that can't list their devices get one entry: NULL, for the default device.
+ * Returns -1 if the devices couldn't be listed, or if `store()` failed. */
+int probe_enumerate(mpg123_module_t *module, int (*store)(void *arg, const char *name, const char *description), void *arg);
+
+#endif
@@ -0,0 +1,421 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "radio.h"
+#include "decode.h"
+
+#ifndef _WIN32
+
+#include <errno.h>
+#include <unistd.h>
+#include <sys/socket.h>
+
+#include "httpget.h"
+
+/* frames decoded per write */
+#define RADIO_PERIOD 1152
+
+/* seconds to wait for the server to accept the connection */
+#define RADIO_CONNECT_TIMEOUT 10
+
+/* the ring holds this many times `prefetch`, and at least RADIO_MIN_RING */
+#define RADIO_RING_PREFETCHES 4
+#define RADIO_MIN_RING (64 * 1024)
+
+static char *copy(const char *s) {
+  char *c;
+  if (!s) return NULL;
+  c = malloc(strlen(s) + 1);
+  if (c) strcpy(c, s);
+  return c;
+}
+
+static void event_init(radio_event *ev, int type) {
+  memset(ev, 0, sizeof(*ev));
+  ev->type = type;
+}
+
+/* Queues an event, dropping the oldest if JS fell that far behind. Called with
+ * the lock held. */
+static void push_event(radio *r, radio_event *ev) {
+  if (r->event_count == RADIO_EVENTS) {
+    radio_event_free(&r->events[r->event_head]);
+    r->event_head = (r->event_head + 1) % RADIO_EVENTS;
+    r->event_count--;
+  }
+  r->events[(r->event_head + r->event_count) % RADIO_EVENTS] = *ev;
+  r->event_count++;
+}
+
+static void push_error(radio *r, const char *error) {
+  radio_event ev;
+  event_init(&ev, RADIO_ERROR);
+  ev.error = error;
+  uv_mutex_lock(&r->lock);
+  if (!r->stopping) push_event(r, &ev);
+  r->failed = 1;
+  uv_mutex_unlock(&r->lock);
+}
+
+static void fetch_thread(void *arg) {
+  radio *r = arg;
+  struct httpdata hd;
+  radio_event ev;
+  int sock;
+
+  httpdata_init(&hd);
+  sock = http_open(r->url, &hd);
+
+  uv_mutex_lock(&r->lock);
+  if (sock < 0 || r->stopping) {
+    if (sock >= 0) close(sock);
+    r->eof = 1;
+    uv_cond_broadcast(&r->cond);
+    uv_mutex_unlock(&r->lock);
+    if (sock < 0) push_error(r, "Failed to connect to the stream");
+    httpdata_free(&hd);
+    return;
+  }
+  if (hd.content_type.fill && (debunk_mime(hd.content_type.p) & IS_LIST)) {
+    close(sock);
+    r->eof = 1;
+    uv_cond_broadcast(&r->cond);
+    uv_mutex_unlock(&r->lock);
+    push_error(r, "The URL is a playlist, not a stream");
+    httpdata_free(&hd);
+    return;
+  }
+  r->sock = sock;
+  r->interval = (long) hd.icy_interval;
+  r->connected = 1;
+  event_init(&ev, RADIO_CONNECT);
+  ev.name = hd.icy_name.fill ? copy(hd.icy_name.p) : NULL;
+  ev.url = hd.icy_url.fill ? copy(hd.icy_url.p) : NULL;
+  ev.content_type = hd.content_type.fill ? copy(hd.content_type.p) : NULL;
+  ev.interval = r->interval;
+  push_event(r, &ev);
+  uv_cond_broadcast(&r->cond);
+  httpdata_free(&hd);
+
+  for (;;) {
+    size_t tail, space;
+    ssize_t n;
+
+    while (r->fill == r->size && !r->stopping) uv_cond_wait(&r->cond, &r->lock);
+    if (r->stopping) break;
+
+    /* the player only ever takes from the filled part, so the free part can
+     * be read into without the lock */
+    tail = (r->head + r->fill) % r->size;
+    space = r->size - r->fill;
+    if (space > r->size - tail) space = r->size - tail;
+    uv_mutex_unlock(&r->lock);
+
+    do {
+      n = read(sock, r->ring + tail, space);
+    } while (n < 0 && errno == EINTR);
+
+    uv_mutex_lock(&r->lock);
+    if (n <= 0) {
+      if (n < 0 && !r->stopping) {
+        uv_mutex_unlock(&r->lock);
+        push_error(r, "Failed to read from the stream");
+        uv_mutex_lock(&r->lock);
+      }
+      break;
+    }
+    r->fill += n;
+    uv_cond_broadcast(&r->cond);
+  }
+  r->sock = -1;
+  r->eof = 1;
+  uv_cond_broadcast(&r->cond);
+  uv_mutex_unlock(&r->lock);
+  close(sock);
+}
+
+/* libmpg123's reader: blocks until there is something in the ring, and
+ * buffers up to `prefetch` again if it ran dry. Returns 0 at the end. */
+static ssize_t radio_read(void *handle, void *buf, size_t count) {
+  radio *r = handle;
+  size_t n, first;
+
+  uv_mutex_lock(&r->lock);
+  if (r->fill == 0 && !r->eof && !r->stopping) {
+    r->underruns++;
+    while (r->fill < r->prefetch && !r->eof && !r->stopping) uv_cond_wait(&r->cond, &r->lock);
+  }
+  if (r->stopping) {
+    uv_mutex_unlock(&r->lock);
+    return 0;
+  }
+  n = count < r->fill ? count : r->fill;
+  first = r->size - r->head;
+  if (first > n) first = n;
+  memcpy(buf, r->ring + r->head, first);
+  memcpy((unsigned char *) buf + first, r->ring, n - first);
+  r->head = (r->head + n) % r->size;
+  r->fill -= n;
+  uv_cond_broadcast(&r->cond);
+  uv_mutex_unlock(&r->lock);
+  return (ssize_t) n;
+}
+
+/* Sets up the decoder for the device's rate and channels, like the playlist
+ * does for files. */
+static int decoder_open(radio *r, int *encoding) {
+  audio_output_t *ao = r->ao;
+  int err = MPG123_OK;
+
+  r->decode_channels = decode_channels(ao->channels);
+
+  r->mh = mpg123_new(NULL, &err);
+  if (!r->mh) return -1;
+  mpg123_param(r->mh, MPG123_ADD_FLAGS, MPG123_QUIET, 0);
+  mpg123_param(r->mh, MPG123_ICY_INTERVAL, r->interval, 0);
+  mpg123_format_none(r->mh);
+
+  if (decode_format(r->mh, ao->rate, ao->channels, encoding) != MPG123_OK) return -1;
+  if (mpg123_replace_reader_handle(r->mh, radio_read, NULL, NULL) != MPG123_OK) return -1;
+  if (mpg123_open_handle(r->mh, r) != MPG123_OK) return -1;
+  return 0;
+}
+
+static void play_thread(void *arg) {
+  radio *r = arg;
+  audio_output_t *ao = r->ao;
+  size_t channels = ao->channels;
+  int encoding;
+  size_t frame_size;
+
+  uv_mutex_lock(&r->lock);
+  while (r->fill < r->prefetch && !r->eof && !r->stopping) uv_cond_wait(&r->cond, &r->lock);
+  if (r->stopping || !r->connected) {
+    uv_mutex_unlock(&r->lock);
+    return;
+  }
+  uv_mutex_unlock(&r->lock);
+
+  if (decoder_open(r, &encoding) != 0) {
+    push_error(r, "Failed to set up the decoder");
+    return;
+  }
+  frame_size = dsp_sample_size(encoding) * r->decode_channels;
+
+  for (;;) {
+    size_t bytes = 0;
+    size_t n;
+    int ret = mpg123_read(r->mh, r->raw, RADIO_PERIOD * frame_size, &bytes);
+
+    if (mpg123_meta_check(r->mh) & MPG123_NEW_ICY) {
+      char *meta = NULL;
+      if (mpg123_icy(r->mh, &meta) == MPG123_OK && meta) {
+        radio_event ev;
+        event_init(&ev, RADIO_METADATA);
+        ev.meta = mpg123_icy2utf8(meta);
+        uv_mutex_lock(&r->lock);
+        if (ev.meta) push_event(r, &ev);
+        uv_mutex_unlock(&r->lock);
+      }
+    }
+
+    n = bytes / frame_size;
+    decode_to_float(r->mix, r->raw, n, r->decode_channels, (int) channels, encoding);
+    if (r->eq && !dsp_eq_is_flat(r->eq)) dsp_eq_apply_float(r->eq, r->mix, n);
+    if (r->gain && !dsp_gain_is_unity(r->gain)) dsp_gain_apply_float(r->gain, r->mix, n, (int) channels);
+    dsp_from_float(r->out, r->mix, n * channels, ao->format);
+
+    {
+      unsigned char *p = r->out;
+      size_t left = n * channels * dsp_sample_size(ao->format);
+      while (left > 0) {
+        int written = ao->write(ao, p, (int) left);
+        if (written <= 0) break;
+        p += written;
+        left -= written;
+      }
+      if (left > 0) {
+        push_error(r, "Failed to write to output device");
+        break;
+      }
+    }
+
+    if (ret == MPG123_DONE) {
+      radio_event ev;
+      event_init(&ev, RADIO_END);
+      uv_mutex_lock(&r->lock);
+      if (!r->stopping && !r->failed) push_event(r, &ev);
+      uv_mutex_unlock(&r->lock);
+      break;
+    }
+    if (ret != MPG123_OK && ret != MPG123_NEW_FORMAT) {
+      uv_mutex_lock(&r->lock);
+      int stopping = r->stopping;
+      uv_mutex_unlock(&r->lock);
+      if (!stopping) push_error(r, mpg123_plain_strerror(ret));
+      break;
+    }
+  }
+}
+
+int radio_start(radio *r, audio_output_t *ao, const char *url, size_t prefetch) {
+  size_t frame = dsp_sample_size(ao->format) * ao->channels;
+
+  if (frame == 0 || prefetch == 0) return -1;
+  memset(r->events, 0, sizeof(r->events));
+
+  r->ao = ao;
+  r->prefetch = prefetch;
+  r->size = prefetch * RADIO_RING_PREFETCHES;
+  if (r->size < RADIO_MIN_RING) r->size = RADIO_MIN_RING;
+  r->head = r->fill = 0;
+  r->underruns = 0;
+  r->interval = 0;
+  r->sock = -1;
+  r->connected = r->eof = r->stopping = r->failed = 0;
+  r->event_head = r->event_count = 0;
+  r->mh = NULL;
+
+  r->url = copy(url);
+  r->ring = malloc(r->size);
+  r->mix = malloc(RADIO_PERIOD * ao->channels * sizeof(float));
+  /* room for float stereo out of the decoder, and for the device's format */
+  r->raw = malloc(RADIO_PERIOD * 2 * sizeof(float));
+  r->out = malloc(RADIO_PERIOD * frame);
+  if (!r->url || !r->ring || !r->mix || !r->raw || !r->out) goto fail;
+
+  httpparam_init(RADIO_CONNECT_TIMEOUT);
+
+  if (!r->ready) {
+    if (uv_mutex_init(&r->lock) != 0) goto fail;
+    if (uv_cond_init(&r->cond) != 0) {
+      uv_mutex_destroy(&r->lock);
+      goto fail;
+    }
+    r->ready = 1;
+  }
+  if (uv_thread_create(&r->fetcher, fetch_thread, r) != 0) goto fail;
+  if (uv_thread_create(&r->player, play_thread, r) != 0) {
+    uv_mutex_lock(&r->lock);
+    r->stopping = 1;
+    if (r->sock >= 0) shutdown(r->sock, SHUT_RDWR);
+    uv_cond_broadcast(&r->cond);
+    uv_mutex_unlock(&r->lock);
+    uv_thread_join(&r->fetcher);
+    goto fail;
+  }
+  uv_mutex_lock(&r->lock);
+  r->running = 1;
+  uv_mutex_unlock(&r->lock);
+  return 0;
+
+fail:
+  free(r->url);
+  free(r->ring);
+  free(r->mix);
+  free(r->raw);
+  free(r->out);
+  r->url = NULL;
+  r->ring = r->raw = r->out = NULL;
+  r->mix = NULL;
+  return -1;
+}
+
+int radio_poll(radio *r, radio_event *ev) {
+  int found = 0;
+
+  if (!r->ready) return -1;
+  uv_mutex_lock(&r->lock);
+  if (r->running && r->event_count > 0) {
+    *ev = r->events[r->event_head];
+    memset(&r->events[r->event_head], 0, sizeof(radio_event));
+    r->event_head = (r->event_head + 1) % RADIO_EVENTS;
+    r->event_count--;
+    found = 1;
+  }
+  uv_mutex_unlock(&r->lock);
+  return found ? 0 : -1;
+}
+
+void radio_stop(radio *r) {
+  if (!r->ready) return;
+
+  /* a shutdown() wakes the fetcher up from its read() */
+  uv_mutex_lock(&r->lock);
+  if (!r->running) {
+    uv_mutex_unlock(&r->lock);
+    return;
+  }
+  r->stopping = 1;
+  if (r->sock >= 0) shutdown(r->sock, SHUT_RDWR);
+  uv_cond_broadcast(&r->cond);
+  if (r->joining) {
+    /* the first stop joins the threads and frees the rest */
+    while (r->running) uv_cond_wait(&r->cond, &r->lock);
+    uv_mutex_unlock(&r->lock);
+    return;
+  }
+  r->joining = 1;
+  uv_mutex_unlock(&r->lock);
+
+  uv_thread_join(&r->player);
+  uv_thread_join(&r->fetcher);
+
+  uv_mutex_lock(&r->lock);
+  while (r->event_count > 0) {
+    radio_event_free(&r->events[r->event_head]);
+    r->event_head = (r->event_head + 1) % RADIO_EVENTS;
+    r->event_count--;
+  }
+  if (r->mh) {
+    mpg123_close(r->mh);
+    mpg123_delete(r->mh);
+    r->mh = NULL;
+  }
+  free(r->url);
+  free(r->ring);
+  free(r->mix);
+  free(r->raw);
+  free(r->out);
+  r->url = NULL;
+  r->ring = r->raw = r->out = NULL;
+  r->mix = NULL;
+  r->running = 0;
+  r->joining = 0;
+  uv_cond_broadcast(&r->cond);
+  uv_mutex_unlock(&r->lock);
+}
+
+void radio_free(radio *r) {
+  radio_stop(r);
+  if (!r->ready) return;
+  uv_cond_destroy(&r->cond);
+  uv_mutex_destroy(&r->lock);
+  r->ready = 0;
+}
+
+#else
+
+int radio_start(radio *r, audio_output_t *ao, const char *url, size_t prefetch) {
+  return -1;
+}
+
+int radio_poll(radio *r, radio_event *ev) {
+  return -1;
+}
+
+void radio_stop(radio *r) {
+}
+
+void radio_free(radio *r) {
+}
+
+#endif
+
+void radio_event_free(radio_event *ev) {
+  free(ev->name);
+  free(ev->url);
+  free(ev->content_type);
+  free(ev->meta);
+  ev->name = ev->url = ev->content_type = ev->meta = NULL;
+}
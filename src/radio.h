@@ -0,0 +1,100 @@
+#ifndef SPEAKER_RADIO_H
+#define SPEAKER_RADIO_H
+
+#include <uv.h>
+
+#include "output.h"
+#include "dsp.h"
+
+/* Internet radio: an MPEG audio stream fetched over HTTP, with the ICY
+ * (SHOUTcast) metadata that the server interleaves with it, played natively.
+ *
+ * One thread connects with the mpg123 program's httpget, which follows
+ * redirects, goes through $http_proxy and asks for the metadata, and then
+ * reads from the socket into a prefetch ring. Another decodes from the ring,
+ * with libmpg123 cutting the metadata out of the stream, and writes to `ao`.
+ * It waits for `prefetch` bytes before it starts, and again whenever the ring
+ * ran dry. The connection, every metadata block and the end of the stream are
+ * queued up as events, which JS polls for with radio_poll() as it can't be
+ * woken by a native thread. */
+
+#define RADIO_CONNECT 1           /* name, url, content_type and interval are set */
+#define RADIO_METADATA 2          /* meta is set */
+#define RADIO_END 3               /* the server closed the stream */
+#define RADIO_ERROR 4             /* error is set */
+
+#define RADIO_EVENTS 16
+
+typedef struct {
+  int type;
+  char *name;                     /* icy-name */
+  char *url;                      /* icy-url */
+  char *content_type;
+  long interval;                  /* icy-metaint, 0 without metadata */
+  char *meta;                     /* e.g. "StreamTitle='...';", in UTF-8 */
+  const char *error;
+} radio_event;
+
+typedef struct {
+  audio_output_t *ao;
+  dsp_gain *gain;
+  dsp_eq *eq;
+  char *url;
+
+  unsigned char *ring;
+  size_t size;
+  size_t head;
+  size_t fill;
+  size_t prefetch;
+  size_t underruns;
+
+  long interval;
+  int sock;
+  int connected;
+  int eof;                        /* nothing more goes into the ring */
+  int stopping;
+  int failed;                     /* an error event went out */
+
+  radio_event events[RADIO_EVENTS];
+  int event_head;
+  int event_count;
+
+  mpg123_handle *mh;
+  int decode_channels;
+  float *mix;
+  unsigned char *raw;
+  unsigned char *out;
+
+  /* the lock and cond are set up by the first start and live until
+   * radio_free(), so that stops from other threads can always take the lock;
+   * `running` and `joining` are only changed under it */
+  uv_mutex_t lock;
+  uv_cond_t cond;
+  int ready;
+  uv_thread_t fetcher;
+  uv_thread_t player;
+  int running;
+  int joining;                    /* a stop is waiting for the threads */
+} radio;
+
+/* Starts streaming `url` to `ao`, which is open. `gain` and `eq` are to be set
+ * up beforehand, or NULL. Returns -1 if it couldn't be started, and on
+ * platforms without the mpg123 program's networking. */
+int radio_start(radio *r, audio_output_t *ao, const char *url, size_t prefetch);
+
+/* Moves the oldest event into `ev`, whose strings are then the caller's to
+ * free with radio_event_free(). Returns -1 if there is none, or the radio
+ * isn't running. */
+int radio_poll(radio *r, radio_event *ev);
+void radio_event_free(radio_event *ev);
+
+/* Drops the connection, stops both threads and waits for them, from any
+ * thread. A stop while another one is waiting waits for that one. Does
+ * nothing if the radio isn't running. This can take as long as connecting
+ * does, so it is best done off the JS thread. */
+void radio_stop(radio *r);
+
+/* Stops the threads and frees the lock, once nothing else can use `r`. */
+void radio_free(radio *r);
+
+#endif
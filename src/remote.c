@@ -0,0 +1,138 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "remote.h"
+#include "dsp.h"
+
+#ifndef _WIN32
+
+#include <errno.h>
+#include <unistd.h>
+#include <sys/select.h>
+
+#include "compat.h"
+#include "xfermem.h"
+
+/* how much audio the ring holds */
+#define REMOTE_RING_MS 250
+
+typedef struct {
+  txfermem *xf;
+  /* our own copies of the descriptors, the ones in the ring are in reach of
+   * the helper. memfd and ctlfd are -1 once the helper has its own copies */
+  int fd;
+  int memfd;
+  int ctlfd;
+  size_t piece;             /* largest write that goes into the ring at once */
+  long timeout;             /* ms that close waits for the helper to drain */
+} remote;
+
+static int remote_write(audio_output_t *ao, unsigned char *buf, int len) {
+  remote *r = ao->userptr;
+  int written = 0;
+
+  while (written < len) {
+    size_t n = len - written;
+    if (n > r->piece) n = r->piece;
+    /* blocks while the ring is full, and fails once the helper is gone */
+    if (xfermem_write(r->xf, buf + written, n)) return -1;
+    written += n;
+  }
+  return written;
+}
+
+static void remote_flush(audio_output_t *ao) {
+  remote *r = ao->userptr;
+  /* the helper drops whatever is in the ring and flushes the device */
+  xfermem_putcmd(r->fd, XF_CMD_ABORT);
+}
+
+static int remote_close(audio_output_t *ao) {
+  remote *r = ao->userptr;
+  int fd = r->fd;
+  struct timeval timeout;
+  fd_set fds;
+  byte cmds[64];
+
+  /* the helper plays what is left in the ring and exits, which is when its end
+   * of the socket goes away. if it is stuck in the driver, whoever started it
+   * is left to get rid of it */
+  if (xfermem_putcmd(fd, XF_CMD_TERMINATE) < 0) return 0;
+  timeout.tv_sec = r->timeout / 1000;
+  timeout.tv_usec = (r->timeout % 1000) * 1000;
+  for (;;) {
+    FD_ZERO(&fds);
+    FD_SET(fd, &fds);
+    int n = select(fd + 1, &fds, NULL, NULL, &timeout);
+    if (n < 0 && errno == EINTR) continue;
+    if (n <= 0) return 0;
+    n = read(fd, cmds, sizeof(cmds));
+    if (n < 0 && errno == EINTR) continue;
+    if (n <= 0) return 0;
+  }
+}
+
+static int remote_deinit(audio_output_t *ao) {
+  remote *r = ao->userptr;
+
+  remote_started(ao);
+  close(r->fd);
+  xfermem_done(r->xf);
+  free(r);
+  ao->userptr = NULL;
+  return 0;
+}
+
+int remote_open(audio_output_t *ao, int *memfd, int *ctlfd) {
+  size_t frame = dsp_sample_size(ao->format) * ao->channels;
+  size_t frames = ao->rate * REMOTE_RING_MS / 1000;
+  remote *r;
+
+  if (frame == 0) return -1;
+  if (frames < 256) frames = 256;
+
+  r = calloc(1, sizeof(remote));
+  if (!r) return -1;
+  /* a whole number of frames, so that none of them wraps around the end */
+  if (xfermem_init_shared(&r->xf, frames * frame, &r->memfd) != 0) {
+    free(r);
+    return -1;
+  }
+  r->xf->rate = ao->rate;
+  r->xf->channels = ao->channels;
+  r->xf->format = ao->format;
+  r->piece = frames / 2 * frame;
+  r->timeout = REMOTE_RING_MS + 1000;
+
+  ao->userptr = r;
+  ao->write = remote_write;
+  ao->flush = remote_flush;
+  ao->close = remote_close;
+  ao->deinit = remote_deinit;
+
+  r->fd = r->xf->fd[XF_WRITER];
+  r->ctlfd = r->xf->fd[XF_READER];
+  *memfd = r->memfd;
+  *ctlfd = r->ctlfd;
+  return 0;
+}
+
+void remote_started(audio_output_t *ao) {
+  remote *r = ao->userptr;
+
+  if (r->memfd < 0) return;
+  close(r->memfd);
+  close(r->ctlfd);
+  r->memfd = r->ctlfd = -1;
+}
+
+#else
+
+int remote_open(audio_output_t *ao, int *memfd, int *ctlfd) {
+  return -1;
+}
+
+void remote_started(audio_output_t *ao) {
+}
+
+#endif
@@ -0,0 +1,19 @@
+#ifndef SPEAKER_REMOTE_H
+#define SPEAKER_REMOTE_H
+
+#include "output.h"
+
+/* Playback through a `speakerd` helper process, so that a backend that
+ * crashes or a driver that blocks can only take the helper down with it.
+ *
+ * `remote_open()` sets up a shared memory ring (libmpg123's xfermem) and fills
+ * in the callbacks of `ao` so that it looks like any other opened output: a
+ * write is a single copy into the ring, which the helper plays straight from.
+ * The helper is to be started with `*memfd` as its descriptor 3 and `*ctlfd`
+ * as its descriptor 4, after which `remote_started()` drops our copies of
+ * them. Returns -1 if the ring couldn't be set up, or on platforms without
+ * xfermem. */
+int remote_open(audio_output_t *ao, int *memfd, int *ctlfd);
+void remote_started(audio_output_t *ao);
+
+#endif
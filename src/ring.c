@@ -0,0 +1,155 @@
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+#include "ring.h"
+#include "atomic.h"
+
+/* how long the thread sleeps when the ring is empty. JS can't wake a native
+ * thread through Atomics.notify(), so it polls */
+#define RING_POLL_US 1000
+
+static void ring_sleep(void) {
+#ifdef _WIN32
+  Sleep(RING_POLL_US / 1000);
+#else
+  struct timespec t = { 0, RING_POLL_US * 1000 };
+  nanosleep(&t, NULL);
+#endif
+}
+
+static void ring_thread(void *arg) {
+  ring *r = arg;
+  volatile uint32_t *h = r->header;
+  size_t chunk = r->size / 4 / r->frame * r->frame;
+  int playing = 0;
+
+  if (chunk == 0) chunk = r->frame;
+
+  for (;;) {
+    uint32_t state = atomic_load_u32(&h[RING_STATE]);
+    size_t w = atomic_load_u32(&h[RING_WRITE]);
+    size_t rd = h[RING_READ];
+    size_t used, n;
+
+    if (state == RING_STOPPED) break;
+    if (w >= r->size || rd >= r->size) {
+      /* someone scribbled over the header */
+      r->error = 1;
+      break;
+    }
+
+    used = w >= rd ? w - rd : r->size - rd + w;
+    if (used < r->frame) {
+      if (state == RING_ENDING) break;
+      if (playing) {
+        playing = 0;
+        atomic_store_u32(&h[RING_UNDERRUNS], h[RING_UNDERRUNS] + 1);
+      }
+      ring_sleep();
+      continue;
+    }
+    playing = 1;
+
+    n = r->size - rd;
+    if (n > used) n = used;
+    if (n > chunk) n = chunk;
+    n -= n % r->frame;
+
+    /* the frames are ours until the read index moves past them, so volume and
+     * EQ can go in place */
+    unsigned char *p = r->data + rd;
+    if (r->eq && !dsp_eq_is_flat(r->eq)) {
+      dsp_eq_apply(r->eq, p, n / r->frame, r->ao->format);
+    }
+    if (r->gain && !dsp_gain_is_unity(r->gain)) {
+      dsp_gain_apply(r->gain, p, n / r->frame, r->ao->channels, r->ao->format);
+    }
+    if (r->drift) {
+      /* resampled into a buffer of the drift's, so the block goes in one */
+      long queued = r->ao->delay ? r->ao->delay(r->ao) : -1;
+      if (queued >= 0) queued += (long) ((used - n) / r->frame);
+      size_t left = drift_process(r->drift, p, n / r->frame, r->ao->format, queued, &p) * r->frame;
+      while (left > 0) {
+        int written = r->ao->write(r->ao, p, (int) left);
+        if (written <= 0) {
+          r->error = 1;
+          atomic_store_u32(&h[RING_STATE], RING_STOPPED);
+          return;
+        }
+        p += written;
+        left -= written;
+      }
+      rd = (rd + n) % r->size;
+      atomic_store_u32(&h[RING_READ], (uint32_t) rd);
+      continue;
+    }
+    while (n > 0) {
+      int written = r->ao->write(r->ao, p, (int) n);
+      if (written <= 0) {
+        r->error = 1;
+        atomic_store_u32(&h[RING_STATE], RING_STOPPED);
+        return;
+      }
+      p += written;
+      n -= written;
+      rd = (rd + written) % r->size;
+      atomic_store_u32(&h[RING_READ], (uint32_t) rd);
+    }
+  }
+  atomic_store_u32(&h[RING_STATE], RING_STOPPED);
+}
+
+int ring_start(ring *r, audio_output_t *ao, unsigned char *mem, size_t length) {
+  size_t frame = dsp_sample_size(ao->format) * ao->channels;
+
+  if (frame == 0 || length <= RING_HEADER) return -1;
+
+  r->ao = ao;
+  r->header = (volatile uint32_t *) mem;
+  r->data = mem + RING_HEADER;
+  r->size = length - RING_HEADER;
+  r->frame = frame;
+  r->error = 0;
+  if (r->header[RING_FRAME] != frame || r->size % frame != 0 || r->size < 2 * frame) return -1;
+
+  if (!r->ready) {
+    if (uv_mutex_init(&r->lock) != 0) return -1;
+    r->ready = 1;
+  }
+  atomic_store_u32(&r->header[RING_STATE], RING_RUNNING);
+  uv_mutex_lock(&r->lock);
+  if (uv_thread_create(&r->thread, ring_thread, r) != 0) {
+    uv_mutex_unlock(&r->lock);
+    return -1;
+  }
+  r->running = 1;
+  uv_mutex_unlock(&r->lock);
+  return 0;
+}
+
+void ring_stop(ring *r, int drain) {
+  if (!r->ready) return;
+  /* the state is shared memory, so this reaches a thread that another stop
+   * is waiting for too; a stopped thread left it at RING_STOPPED */
+  if (!drain) {
+    atomic_store_u32(&r->header[RING_STATE], RING_STOPPED);
+  } else if (atomic_load_u32(&r->header[RING_STATE]) == RING_RUNNING) {
+    atomic_store_u32(&r->header[RING_STATE], RING_ENDING);
+  }
+  uv_mutex_lock(&r->lock);
+  if (r->running) {
+    uv_thread_join(&r->thread);
+    r->running = 0;
+  }
+  uv_mutex_unlock(&r->lock);
+}
+
+void ring_free(ring *r) {
+  ring_stop(r, 0);
+  if (!r->ready) return;
+  uv_mutex_destroy(&r->lock);
+  r->ready = 0;
+}
@@ -0,0 +1,68 @@
+#ifndef SPEAKER_RING_H
+#define SPEAKER_RING_H
+
+#include <stdint.h>
+#include <uv.h>
+
+#include "output.h"
+#include "dsp.h"
+#include "drift.h"
+
+/* Plays audio that JS threads write into a SharedArrayBuffer, from a native
+ * thread of its own, without a copy or a call into JS per chunk.
+ *
+ * The buffer starts with RING_HEADER bytes of 32-bit words that both sides
+ * access with atomics, followed by the data. The indices are byte offsets into
+ * the data, which is a whole number of frames long; one frame is always left
+ * empty, so that equal indices mean an empty ring. The layout is mirrored in
+ * ring.js. */
+
+#define RING_HEADER 64
+
+#define RING_WRITE 0              /* [W] where the next frame gets written */
+#define RING_READ 1               /* [R] the next frame to play */
+#define RING_STATE 2              /* RING_RUNNING, RING_ENDING or RING_STOPPED */
+#define RING_UNDERRUNS 3          /* [R] times the ring ran dry while playing */
+#define RING_FRAME 4              /* bytes per frame, set up by JS */
+
+#define RING_RUNNING 0
+#define RING_ENDING 1             /* play what is left, then stop */
+#define RING_STOPPED 2
+
+typedef struct {
+  audio_output_t *ao;
+  dsp_gain *gain;
+  dsp_eq *eq;
+  drift *drift;                   /* steered by the ring's fill plus the device delay */
+
+  volatile uint32_t *header;
+  unsigned char *data;
+  size_t size;
+  size_t frame;
+
+  /* held by a stop while it waits for the thread, so that a second stop
+   * waits for the first; set up by the first start, freed by ring_free() */
+  uv_mutex_t lock;
+  int ready;
+  uv_thread_t thread;
+  int running;
+  int error;                      /* set when the device stopped taking audio */
+} ring;
+
+/* Starts playing from `length` bytes of shared memory at `mem`, whose header
+ * has been filled in. `gain`, `eq` and `drift` are to be set up beforehand,
+ * or NULL.
+ * Returns -1 if the layout doesn't fit the output format or the thread
+ * couldn't be started. */
+int ring_start(ring *r, audio_output_t *ao, unsigned char *mem, size_t length);
+
+/* Asks the thread to stop, right away or once the ring ran dry, and waits for
+ * it, from any thread. A stop while another one is waiting waits for that
+ * one, hurrying it along unless `drain` is set. Does nothing if it isn't
+ * running. */
+void ring_stop(ring *r, int drain);
+
+/* Stops the thread and frees the lock, once nothing else can use `r`. */
+void ring_free(ring *r);
+
+#endif
@@ -0,0 +1,150 @@
+/* speakerd: plays what a Speaker with the `outOfProcess` option writes into
+ * the shared memory ring that `remote_open()` set up, so that the output
+ * backend runs in a process of its own.
+ *
+ * usage: speakerd [-b backend] [-l latency] [device] 3<ring 4<>control-socket
+ *
+ * where the backend is the name of a built in output module, the default one
+ * if not given, and the latency is the device buffering to ask for, in
+ * microseconds.
+ *
+ * The format comes from the ring. Exits with 0 once it has played everything
+ * after a terminate command, right away if the Speaker goes away, and with 1
+ * if the device fails. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "output.h"
+#include "backends.h"
+#include "dsp.h"
+#include "compat.h"
+#include "xfermem.h"
+
+#define MEM_FD 3
+#define CTL_FD 4
+
+/* Returns -1 when the Speaker is gone. */
+static int command(txfermem *xf, audio_output_t *ao, int cmd, int *done) {
+  switch (cmd) {
+    case XF_CMD_WAKEUP:
+    case XF_CMD_WAKEUP_INFO:
+      return 0;
+    case XF_CMD_TERMINATE:
+      *done = 1;
+      return 0;
+    case XF_CMD_ABORT:
+      ao->flush(ao);
+      xf->readindex = xf->freeindex;
+      if (xf->wakeme[XF_WRITER]) xfermem_putcmd(CTL_FD, XF_CMD_WAKEUP);
+      return 0;
+    default:
+      return -1;
+  }
+}
+
+/* Returns -1 if the device failed. */
+static int play(audio_output_t *ao, unsigned char *buf, size_t len) {
+  while (len > 0) {
+    int n = ao->write(ao, buf, (int) len);
+    if (n <= 0) return -1;
+    buf += n;
+    len -= n;
+  }
+  return 0;
+}
+
+int main(int argc, char **argv) {
+  audio_output_t ao;
+  mpg123_module_t *module = backend_find(NULL);
+  txfermem *xf;
+  size_t frame, chunk;
+  int done = 0, status = 0, cmd;
+
+  if (xfermem_attach(&xf, MEM_FD) != 0) {
+    fprintf(stderr, "speakerd: no audio ring on descriptor %d\n", MEM_FD);
+    return 1;
+  }
+
+  memset(&ao, 0, sizeof(audio_output_t));
+  ao.rate = xf->rate;
+  ao.channels = xf->channels;
+  ao.format = xf->format;
+  for (argv++, argc--; argc >= 2 && argv[0][0] == '-'; argv += 2, argc -= 2) {
+    if (strcmp(argv[0], "-l") == 0) {
+      ao.latency = atol(argv[1]);
+    } else if (strcmp(argv[0], "-b") == 0) {
+      module = backend_find(argv[1]);
+      if (!module) {
+        fprintf(stderr, "speakerd: no \"%s\" backend is built in\n", argv[1]);
+        return 1;
+      }
+    } else {
+      break;
+    }
+  }
+  ao.device = *argv;
+  frame = dsp_sample_size(ao.format) * ao.channels;
+  if (frame == 0 || xf->size % frame != 0) {
+    fprintf(stderr, "speakerd: unsupported format\n");
+    return 1;
+  }
+
+  if (module->init_output(&ao) != 0 || ao.open(&ao) < 0) {
+    fprintf(stderr, "speakerd: failed to open output device\n");
+    return 1;
+  }
+
+  /* play a quarter of the ring at a time, so that the Speaker can refill the
+   * rest while the device blocks */
+  chunk = xf->size / 4 / frame * frame;
+  if (chunk == 0) chunk = frame;
+
+  for (;;) {
+    size_t used = xfermem_get_usedspace(xf);
+    size_t n;
+
+    if (used < frame) {
+      if (done) break;
+      /* announce that we are going to sleep before looking one last time,
+       * a write that came in between either shows up here or wakes us */
+      xf->wakeme[XF_READER] = TRUE;
+      xfermem_barrier();
+      if (xfermem_get_usedspace(xf) >= frame) {
+        xf->wakeme[XF_READER] = FALSE;
+        continue;
+      }
+      if (xf->wakeme[XF_WRITER]) xfermem_putcmd(CTL_FD, XF_CMD_WAKEUP);
+      cmd = xfermem_getcmd(CTL_FD, TRUE);
+      xf->wakeme[XF_READER] = FALSE;
+      if (command(xf, &ao, cmd, &done) != 0) goto out;
+      continue;
+    }
+
+    n = xf->size - xf->readindex;
+    if (n > used) n = used;
+    if (n > chunk) n = chunk;
+    n -= n % frame;
+    if (play(&ao, xfermem_data(xf) + xf->readindex, n) != 0) {
+      fprintf(stderr, "speakerd: failed to write to output device\n");
+      status = 1;
+      goto out;
+    }
+    xfermem_barrier();
+    xf->readindex = (xf->readindex + n) % xf->size;
+    xfermem_barrier();
+    if (xf->wakeme[XF_WRITER]) xfermem_putcmd(CTL_FD, XF_CMD_WAKEUP);
+
+    /* commands are looked at between chunks, so that a flush doesn't have to
+     * wait for the whole ring to play */
+    while ((cmd = xfermem_getcmd(CTL_FD, FALSE)) != 0) {
+      if (command(xf, &ao, cmd, &done) != 0) goto out;
+    }
+  }
+
+out:
+  ao.close(&ao);
+  if (ao.deinit) ao.deinit(&ao);
+  return status;
+}
@@ -7,12 +7,49 @@
  */
 
 const os = require('os')
+const fs = require('fs')
+const path = require('path')
+const { spawnSync } = require('child_process')
 const assert = require('assert')
 const Speaker = require('../')
 
 const endianness = os.endianness()
 const opposite = endianness === 'LE' ? 'BE' : 'LE'
 
+// writes an MPEG 1 Layer I stream of `frames` silent frames (384 samples each,
+// 44.1 kHz stereo) to a temporary file, and returns its path
+function mpegFixture (name, frames) {
+  const frame = Buffer.alloc(136)
+  frame.writeUInt32BE(0xffff4000, 0)
+  const file = path.join(os.tmpdir(), `speaker-test-${process.pid}-${name}.mp1`)
+  fs.writeFileSync(file, Buffer.concat(new Array(frames).fill(frame)))
+  return file
+}
+
+// plays `audio` through a Speaker with the given options into a raw "file:"
+// device, and calls back with what came out
+function render (name, opts, audio, callback) {
+  const file = path.join(os.tmpdir(), `speaker-test-${process.pid}-${name}.raw`)
+  const s = new Speaker(Object.assign({ device: `file:${file}` }, opts))
+  s.on('error', callback)
+  s.once('close', function () {
+    const out = fs.readFileSync(file)
+    fs.unlinkSync(file)
+    callback(null, out)
+  })
+  s.end(audio)
+}
+
+// reads and writes native endian PCM samples of `bytes` bytes
+function readSample (buffer, i, bytes) {
+  return endianness === 'LE' ? buffer.readIntLE(i * bytes, bytes) : buffer.readIntBE(i * bytes, bytes)
+}
+
+function writeSample (buffer, i, bytes, value) {
+  if (endianness === 'LE') buffer.writeIntLE(value, i * bytes, bytes)
+  else buffer.writeIntBE(value, i * bytes, bytes)
+}
+
 describe('exports', function () {
   it('should export a Function', function () {
     assert.strictEqual('function', typeof Speaker)
@@ -32,6 +69,60 @@ describe('exports', function () {
     assert(Object.prototype.hasOwnProperty.call(Speaker, 'module_name'))
     assert('string', typeof Speaker.module_name)
   })
+
+  it('should list the built in backends, the default one first', function () {
+    const backends = Speaker.backends()
+    assert(backends.length >= 1)
+    assert.strictEqual(backends[0].name, Speaker.module_name)
+    assert.deepStrictEqual(backends.map((b) => b.default), backends.map((b, i) => i === 0))
+    for (const backend of backends) {
+      assert.strictEqual(typeof backend.description, 'string')
+      assert.strictEqual(typeof backend.formats, 'number')
+    }
+  })
+
+  it('should only know what a device plays once it has been probed', function () {
+    const bench = () => Speaker.backends().find((b) => b.name === 'bench')
+    const float64 = Speaker.getFormat({ bitDepth: 64, float: true, signed: true })
+    assert.strictEqual(bench().formats, 0)
+    assert.strictEqual(Speaker.isSupported(float64, 'bench'), true)
+    return Speaker.probe(null, 'bench').then((capabilities) => {
+      const stereo = capabilities.find((c) => c.sampleRate === 44100 && c.channels === 2)
+      assert(stereo.formats > 0)
+      assert.strictEqual(bench().formats, stereo.formats)
+      assert.strictEqual(Speaker.isSupported(float64, 'bench'), (stereo.formats & float64) !== 0)
+    })
+  })
+
+  it('should probe what a device plays at each rate and channel count', function () {
+    return Speaker.probe(null).then((capabilities) => {
+      const stereo = capabilities.find((c) => c.sampleRate === 44100 && c.channels === 2)
+      assert(stereo)
+      assert.strictEqual(stereo.formats, Speaker.backends()[0].formats)
+      assert(capabilities.some((c) => c.channels === 1))
+    })
+  })
+
+  it('should list the devices of every backend with what they play', function () {
+    return Speaker.devices().then((devices) => {
+      const names = Speaker.backends().map((b) => b.name)
+      for (const device of devices) {
+        assert(names.includes(device.backend))
+        assert.strictEqual(typeof device.description, 'string')
+        assert(device.capabilities === null || Array.isArray(device.capabilities))
+      }
+      const byDefault = devices.find((d) => d.backend === Speaker.module_name)
+      assert(byDefault)
+    })
+  })
+
+  it('should reject probes of backends that are not built in', function () {
+    return Speaker.probe(null, 'nonexistent').then(() => {
+      throw new Error('should have rejected')
+    }, (err) => {
+      assert.strictEqual(err.code, 'ERR_BACKEND')
+    })
+  })
 })
 
 describe('Speaker', function () {
@@ -128,4 +219,744 @@ describe('Speaker', function () {
     })
     speaker.write('a')
   })
+
+  it('should accept a volume option', function (done) {
+    const s = new Speaker({ volume: 0.5 })
+
+    assert.strictEqual(s.volume, 0.5)
+
+    s.on('close', done)
+    s.end(Buffer.alloc(4096))
+  })
+
+  it('should change the volume mid-stream', function (done) {
+    const s = new Speaker()
+    s.on('close', done)
+    s.write(Buffer.alloc(8192), () => {
+      s.volume = 0.25
+      s.write(Buffer.alloc(8192), () => {
+        s.volume = 1
+        s.end(Buffer.alloc(8192))
+      })
+    })
+  })
+
+  for (const bitDepth of [16, 24]) {
+    it(`should scale ${bitDepth}-bit samples exactly by the volume`, function (done) {
+      const bytes = bitDepth / 8
+      const max = 2 ** (bitDepth - 1)
+      // past the 10 ms ramp from the initial volume of 1
+      const from = 441 * 2 * 2
+      const input = [max / 4 + 3, -max / 2, max * 3 / 4]
+      const expected = [max / 2 + 6, -max, max - 1]
+      const audio = Buffer.alloc(4410 * 2 * bytes)
+      for (let i = 0; i < audio.length / bytes; i++) writeSample(audio, i, bytes, input[i % 3])
+      render(`volume-${bitDepth}`, { channels: 2, bitDepth, sampleRate: 44100, volume: 2 }, audio, function (err, out) {
+        if (err) return done(err)
+        assert.strictEqual(out.length, audio.length)
+        for (let i = from; i < out.length / bytes; i++) {
+          assert.strictEqual(readSample(out, i, bytes), expected[i % 3], `sample ${i}`)
+        }
+        done()
+      })
+    })
+  }
+
+  it('should throw an Error if the volume is not a non-negative number', function () {
+    const s = new Speaker()
+    assert.throws(() => { s.volume = -1 })
+    assert.throws(() => { s.volume = 'loud' })
+    assert.strictEqual(s.volume, 1)
+  })
+
+  it('should accept an equalizer option', function (done) {
+    const s = new Speaker({
+      equalizer: [{ type: 'lowshelf', frequency: 100, gain: 6 }]
+    })
+
+    assert.deepStrictEqual(s.equalizer, [
+      { type: 'lowshelf', frequency: 100, gain: 6, q: Math.SQRT1_2 }
+    ])
+
+    s.on('close', done)
+    s.end(Buffer.alloc(4096))
+  })
+
+  it('should change the equalizer mid-stream', function (done) {
+    const s = new Speaker()
+    s.on('close', done)
+    s.write(Buffer.alloc(8192), () => {
+      s.equalizer = [
+        { type: 'peaking', frequency: 1000, gain: -6, q: 2 },
+        { type: 'highpass', frequency: 40 }
+      ]
+      s.write(Buffer.alloc(8192), () => {
+        s.equalizer = []
+        s.end(Buffer.alloc(8192))
+      })
+    })
+  })
+
+  it('should boost and cut the bands of the equalizer', function (done) {
+    const rate = 44100
+    const frames = rate / 2
+    // a 1 kHz tone and a 10 kHz one, each on a channel of its own
+    const audio = Buffer.alloc(frames * 4)
+    for (let i = 0; i < frames; i++) {
+      writeSample(audio, i * 2, 2, Math.round(8000 * Math.sin(2 * Math.PI * 1000 * i / rate)))
+      writeSample(audio, i * 2 + 1, 2, Math.round(8000 * Math.sin(2 * Math.PI * 10000 * i / rate)))
+    }
+    const rms = (buffer, channel) => {
+      let sum = 0
+      let n = 0
+      // skip the filters settling in
+      for (let i = rate / 10; i < frames; i++, n++) sum += readSample(buffer, i * 2 + channel, 2) ** 2
+      return Math.sqrt(sum / n)
+    }
+    const equalizer = [
+      { type: 'peaking', frequency: 1000, gain: 6 },
+      { type: 'lowpass', frequency: 2000 }
+    ]
+    render('equalizer', { channels: 2, bitDepth: 16, sampleRate: rate, equalizer }, audio, function (err, out) {
+      if (err) return done(err)
+      // +6 dB at the peak, where the lowpass still lets it through
+      const boost = 20 * Math.log10(rms(out, 0) / rms(audio, 0))
+      assert(boost > 5 && boost < 7, `1 kHz came out at ${boost} dB`)
+      // a second order lowpass is down about 28 dB at 2.3 octaves above it
+      const cut = 20 * Math.log10(rms(out, 1) / rms(audio, 1))
+      assert(cut < -24, `10 kHz came out at ${cut} dB`)
+      done()
+    })
+  })
+
+  it('should throw an Error for invalid equalizer bands', function () {
+    const s = new Speaker()
+    assert.throws(() => { s.equalizer = [{ type: 'notch', frequency: 100 }] })
+    assert.throws(() => { s.equalizer = [{ type: 'peaking', frequency: -1 }] })
+    assert.throws(() => { s.equalizer = new Array(9).fill({ type: 'peaking', frequency: 100 }) })
+    assert.deepStrictEqual(s.equalizer, [])
+  })
+
+  it('should play through the backend named by the "backend" option', function (done) {
+    const backend = Speaker.backends().find((b) => !b.default && Speaker.isSupported({ bitDepth: 16, signed: true }, b.name))
+    if (!backend) return this.skip()
+    const s = new Speaker({ backend: backend.name })
+    s.on('error', done)
+    s.on('close', done)
+    s.end(Buffer.alloc(4096))
+  })
+
+  it('should emit an "error" for backends that are not built in', function (done) {
+    const s = new Speaker({ backend: 'no-such-backend' })
+    s.on('error', function (err) {
+      assert(/no-such-backend/.test(err.message))
+      done()
+    })
+    s.write(Buffer.alloc(4))
+  })
+
+  it('should accept a latency option', function (done) {
+    const s = new Speaker({ latency: 20 })
+    assert.strictEqual(s.latency, 20)
+    assert.strictEqual(s.delay(), null)
+    s.on('close', done)
+    s.write(Buffer.alloc(4096), () => {
+      const delay = s.delay()
+      assert(delay === null || delay >= 0)
+      s.end()
+    })
+  })
+
+  it('should record histograms of the write path', function (done) {
+    const before = Speaker.metrics().writeTime.count
+    const speaker = new Speaker()
+    assert.strictEqual(speaker.metrics(), null)
+    speaker.on('close', () => {
+      const metrics = speaker.metrics()
+      assert(metrics.writeTime.count >= 1)
+      assert.strictEqual(metrics.writeBytes.count, metrics.writeTime.count)
+      assert(metrics.writeBytes.max <= 4096)
+      assert(metrics.queueWait.p50 <= metrics.queueWait.max)
+      assert.strictEqual(Speaker.metrics().writeTime.count - before, metrics.writeTime.count)
+      done()
+    })
+    speaker.end(Buffer.alloc(4096))
+  })
+
+  it('should pad and trim writeAt() chunks to start on time', function (done) {
+    const s = new Speaker({ channels: 2, bitDepth: 16, sampleRate: 44100 })
+    const timings = []
+    s.on('error', done)
+    s.once('close', () => {
+      const [early, late] = timings
+      assert(early.silence > 0)
+      assert.strictEqual(early.trimmed, 0)
+      assert(Math.abs(early.error) < 0.1)
+      assert(late.trimmed > 0)
+      assert.strictEqual(late.silence, 0)
+      done()
+    })
+    s.writeAt(Buffer.alloc(4096), Speaker.now() + 50, (err, timing) => {
+      assert.ifError(err)
+      timings.push(timing)
+    })
+    s.writeAt(Buffer.alloc(4096), Speaker.now() - 10, (err, timing) => {
+      assert.ifError(err)
+      timings.push(timing)
+    })
+    s.end()
+  })
+
+  it('should resample to hold the "targetLatency"', function (done) {
+    const s = new Speaker({ targetLatency: 50 })
+    assert.strictEqual(s.targetLatency, 50)
+    assert.strictEqual(s.drift(), null)
+    s.on('error', done)
+    s.write(Buffer.alloc(16384), () => {
+      const drift = s.drift()
+      assert(Math.abs(drift.ppm) <= 1000)
+      assert(drift.latency === -1 || drift.latency >= 0)
+      s.end()
+    })
+    s.once('close', () => done())
+  })
+
+  it('should hold the latency of a simulated device with a clock of its own', function () {
+    // test/test_drift.c, built along with the addon
+    const dirs = ['Release', 'Debug'].map((type) => path.join(__dirname, '..', 'build', type))
+    const bin = dirs.map((dir) => path.join(dir, 'drift_test')).find((file) => fs.existsSync(file) || fs.existsSync(`${file}.exe`))
+    if (!bin) return this.skip()
+    const result = spawnSync(bin, { encoding: 'utf8' })
+    assert.strictEqual(result.stdout.trim().split('\n').pop(), 'OK', result.stdout)
+    assert.strictEqual(result.status, 0)
+  })
+
+  it('should pace by the clock for devices that wait for more before they start', function () {
+    // test/test_pace.c, built along with the addon
+    const dirs = ['Release', 'Debug'].map((type) => path.join(__dirname, '..', 'build', type))
+    const bin = dirs.map((dir) => path.join(dir, 'pace_test')).find((file) => fs.existsSync(file))
+    if (!bin) return this.skip()
+    const result = spawnSync(bin, { encoding: 'utf8' })
+    assert.strictEqual(result.stdout.trim().split('\n').pop(), 'OK', result.stdout)
+    assert.strictEqual(result.status, 0)
+  })
+
+  it('should throw an Error for a negative latency', function () {
+    assert.throws(() => new Speaker({ latency: -1 }))
+  })
+
+  it('should play through a helper process with the "outOfProcess" option', function (done) {
+    const s = new Speaker({ outOfProcess: true })
+    s.on('error', done)
+    s.on('close', done)
+    // more than the shared ring holds, so that writes have to wait for it
+    for (let i = 0; i < 16; i++) {
+      s.write(Buffer.alloc(8192))
+    }
+    s.end(Buffer.alloc(8192))
+  })
+
+  it('should emit an "error" when the helper process goes away', function (done) {
+    const s = new Speaker({ outOfProcess: true })
+    s.on('error', (err) => {
+      assert(/speakerd exited/.test(err.message))
+      s.close(false)
+      done()
+    })
+    s.write(Buffer.alloc(4096), () => {
+      s._remote.kill('SIGKILL')
+    })
+  })
+
+  describe('file devices', function () {
+    const wav = path.join(os.tmpdir(), `speaker-test-${process.pid}.wav`)
+    const raw = path.join(os.tmpdir(), `speaker-test-${process.pid}.raw`)
+
+    after(function () {
+      for (const file of [wav, raw]) {
+        if (fs.existsSync(file)) fs.unlinkSync(file)
+      }
+    })
+
+    it('should render a WAV file with the final sizes in its header', function (done) {
+      const s = new Speaker({ channels: 1, sampleRate: 8000, bitDepth: 32, float: true, device: `file:${wav}` })
+      const audio = Buffer.alloc(3 * 1024 * 1024 + 12)
+      for (let i = 0; i < audio.length; i += 4) audio.writeFloatLE(Math.sin(i), i)
+      s.on('error', done)
+      s.on('close', function () {
+        const file = fs.readFileSync(wav)
+        assert.strictEqual(file.toString('latin1', 0, 4), 'RIFF')
+        assert.strictEqual(file.readUInt32LE(4), file.length - 8)
+        assert.strictEqual(file.toString('latin1', 8, 16), 'WAVEJUNK')
+        assert.strictEqual(file.toString('latin1', 48, 52), 'fmt ')
+        assert.strictEqual(file.readUInt16LE(56), 3)
+        assert.strictEqual(file.readUInt16LE(58), 1)
+        assert.strictEqual(file.readUInt32LE(60), 8000)
+        assert.strictEqual(file.readUInt16LE(70), 32)
+        assert.strictEqual(file.toString('latin1', 72, 76), 'data')
+        assert.strictEqual(file.readUInt32LE(76), audio.length)
+        assert(file.subarray(80).equals(audio))
+        done()
+      })
+      s.end(audio)
+    })
+
+    it('should render raw PCM for other paths', function (done) {
+      const s = new Speaker({ device: `file+direct:${raw}` })
+      const audio = Buffer.alloc(2 * 1024 * 1024 + 4, 7)
+      s.on('error', done)
+      s.on('close', function () {
+        assert(fs.readFileSync(raw).equals(audio))
+        done()
+      })
+      s.end(audio)
+    })
+
+    it('should emit an "error" for formats that WAV files do not have', function (done) {
+      const s = new Speaker({ bitDepth: 16, signed: false, device: `file:${wav}` })
+      s.on('error', function (err) {
+        assert(/WAV/.test(err.message))
+        done()
+      })
+      s.write(Buffer.alloc(4))
+    })
+
+    it('should render those formats to raw files', function (done) {
+      const s = new Speaker({ bitDepth: 16, signed: false, device: `file:${raw}` })
+      const audio = Buffer.alloc(4096, 0x80)
+      s.on('error', done)
+      s.once('close', function () {
+        assert(fs.readFileSync(raw).equals(audio))
+        done()
+      })
+      s.end(audio)
+    })
+  })
+
+  describe('enqueue()', function () {
+    const a = mpegFixture('a', 100)
+    const b = mpegFixture('b', 50)
+
+    after(function () {
+      fs.unlinkSync(a)
+      fs.unlinkSync(b)
+    })
+
+    it('should play queued files back to back', function (done) {
+      const s = new Speaker()
+      const started = []
+      s.on('track', (file) => started.push(file))
+      s.on('queueend', function () {
+        assert.deepStrictEqual(started, [a, b])
+        s.close()
+        done()
+      })
+      s.enqueue(a).enqueue(b)
+    })
+
+    it('should crossfade queued files', function (done) {
+      const s = new Speaker({ crossfade: 100 })
+      let count = 0
+      s.on('track', () => count++)
+      s.on('queueend', function () {
+        assert.strictEqual(count, 3)
+        s.close()
+        done()
+      })
+      s.enqueue(a).enqueue(b).enqueue(a)
+    })
+
+    it('should emit an "error" for files that cannot be played', function (done) {
+      const s = new Speaker()
+      const started = []
+      let error = null
+      s.on('track', (file) => started.push(file))
+      s.on('error', (err) => { error = err })
+      s.on('queueend', function () {
+        assert(/does-not-exist/.test(error.message))
+        assert.deepStrictEqual(started, [a])
+        s.close()
+        done()
+      })
+      s.enqueue('does-not-exist.mp3').enqueue(a)
+    })
+
+    it('should play queued files only once a pending write() is done', function (done) {
+      const raw = path.join(os.tmpdir(), `speaker-test-${process.pid}-enqueue.raw`)
+      const s = new Speaker({ channels: 2, bitDepth: 16, sampleRate: 44100, device: `file:${raw}` })
+      // many "samplesPerFrame" steps, so that the write is still going on
+      const audio = Buffer.alloc(64 * 1024 * 4, 1)
+      s.on('error', done)
+      s.once('close', function () {
+        const file = fs.readFileSync(raw)
+        fs.unlinkSync(raw)
+        assert.strictEqual(file.length, audio.length + 100 * 384 * 4)
+        assert(file.subarray(0, audio.length).equals(audio))
+        assert(file.subarray(audio.length).every((byte) => byte === 0))
+        done()
+      })
+      s.write(audio)
+      s.enqueue(a)
+      s.end()
+    })
+
+    it('should wait for queued files before closing on end()', function (done) {
+      const s = new Speaker()
+      let ended = false
+      s.on('queueend', () => { ended = true })
+      s.on('close', function () {
+        assert.strictEqual(ended, true)
+        done()
+      })
+      s.enqueue(a)
+      s.end()
+    })
+  })
+
+  describe('createRing()', function () {
+    it('should play what a worker thread writes into the ring', function (done) {
+      const { Worker } = require('worker_threads')
+      const s = new Speaker()
+      const buffer = s.createRing(1024)
+      const worker = new Worker(`
+        const { workerData } = require('worker_threads')
+        const RingWriter = require(workerData.ring)
+        const writer = new RingWriter(workerData.buffer)
+        const chunk = Buffer.alloc(4096)
+        for (let i = 0; i < 64; i++) {
+          if (!writer.waitForSpace(chunk.length, 5000)) throw new Error('ring stalled')
+          writer.write(chunk)
+        }
+      `, { eval: true, workerData: { buffer, ring: path.join(__dirname, '..', 'ring.js') } })
+      worker.on('error', done)
+      worker.on('exit', () => s.end())
+      s.on('error', done)
+      s.on('close', done)
+    })
+
+    it('should play out the ring when close() follows end()', function (done) {
+      const file = path.join(os.tmpdir(), `speaker-test-${process.pid}-ring.raw`)
+      const s = new Speaker({ device: `file:${file}` })
+      const writer = new Speaker.RingWriter(s.createRing(1024))
+      const audio = Buffer.alloc(writer.available, 3)
+      assert.strictEqual(writer.write(audio), audio.length)
+      s.on('error', done)
+      // end() waits for the ring to play out, then close() releases the device
+      s.on('finish', () => setImmediate(function () {
+        const out = fs.readFileSync(file)
+        fs.unlinkSync(file)
+        assert(out.equals(audio))
+        done()
+      }))
+      s.end()
+      setImmediate(() => s.close())
+    })
+
+    it('should only write whole frames that fit', function () {
+      const ring = require('../ring')
+      const writer = new Speaker.RingWriter(ring.allocate(4, 4))
+      assert.strictEqual(writer.frameSize, 4)
+      assert.strictEqual(writer.available, 16)
+      assert.strictEqual(writer.write(Buffer.alloc(6)), 4)
+      assert.strictEqual(writer.write(Buffer.alloc(64)), 12)
+      assert.strictEqual(writer.available, 0)
+      assert.strictEqual(writer.closed, false)
+    })
+
+    it('should throw an Error for write() calls while playing from a ring', function (done) {
+      const s = new Speaker()
+      s.createRing()
+      assert.throws(() => s.enqueue('file.mp3'))
+      assert.throws(() => s.createRing())
+      s.on('error', function (err) {
+        assert(/ring/.test(err.message))
+        s.close()
+        done()
+      })
+      s.write(Buffer.alloc(4096))
+    })
+  })
+
+  describe('startJitterBuffer()', function () {
+    it('should play packets in order and conceal the missing ones', function (done) {
+      const s = new Speaker({ channels: 2, bitDepth: 16, sampleRate: 44100 })
+      s.startJitterBuffer({ packetFrames: 441, minDepth: 3 })
+      const packet = Buffer.alloc(441 * 4)
+      for (const seq of [0, 2, 1, 4, 5, 6]) {
+        assert.strictEqual(s.pushPacket(seq, packet), true)
+      }
+      assert.strictEqual(s.pushPacket(6, packet), false)
+      assert.throws(() => s.pushPacket(7, Buffer.alloc(4)), RangeError)
+      s.on('error', done)
+      s.once('close', function () {
+        const stats = s.jitterStats()
+        assert.strictEqual(stats.received, 6)
+        assert.strictEqual(stats.played, 6)
+        assert(stats.concealed >= 1)
+        assert.strictEqual(stats.late, 1)
+        assert.strictEqual(stats.buffered, 0)
+        done()
+      })
+      s.end()
+    })
+
+    it('should fade out lost packets and keep silent past that', function (done) {
+      const file = path.join(os.tmpdir(), `speaker-test-${process.pid}-jitter.raw`)
+      const s = new Speaker({ channels: 2, bitDepth: 16, sampleRate: 44100, device: `file:${file}` })
+      s.startJitterBuffer({ packetFrames: 441 })
+      const packet = Buffer.alloc(441 * 4)
+      for (let i = 0; i < 441 * 2; i++) writeSample(packet, i, 2, 0x2000)
+      // 4 to 11 go missing, with 12 to 15 waiting behind them
+      for (const seq of [0, 1, 2, 3, 12, 13, 14, 15]) s.pushPacket(seq, packet)
+      s.on('error', done)
+      // the device is closed once the stop that end() started is done
+      s.once('close', () => setImmediate(function () {
+        const audio = fs.readFileSync(file)
+        fs.unlinkSync(file)
+        const samples = []
+        for (let i = 0; i < audio.length / 2; i++) samples.push(readSample(audio, i, 2))
+        // packets of silence may come before the first one, while it buffers
+        const first = samples.findIndex((v) => v !== 0)
+        const at = (seq) => samples.slice(first + seq * 882, first + (seq + 1) * 882)
+        assert(samples.every((v) => v >= 0))
+        assert(at(4)[0] > 0 && at(8)[0] > 0)
+        for (const seq of [9, 10, 11]) assert(at(seq).every((v) => v === 0))
+        assert(at(12).every((v) => v === 0x2000))
+        assert.strictEqual(s.jitterStats().concealed, 8)
+        done()
+      }))
+      s.end()
+    })
+
+    it('should play out what end() was given when close() follows it', function (done) {
+      const s = new Speaker({ channels: 2, bitDepth: 16, sampleRate: 44100 })
+      s.startJitterBuffer({ packetFrames: 441 })
+      const packet = Buffer.alloc(441 * 4)
+      for (let seq = 0; seq < 5; seq++) s.pushPacket(seq, packet)
+      s.on('error', done)
+      s.on('finish', function () {
+        assert.strictEqual(s.jitterStats().played, 5)
+        done()
+      })
+      s.end()
+      assert.strictEqual(s.pushPacket(5, packet), false)
+      setImmediate(() => s.close())
+    })
+  })
+
+  describe('loadClip()', function () {
+    const file = mpegFixture('clip', 10)
+
+    after(function () {
+      fs.unlinkSync(file)
+    })
+
+    it('should play cached clips and count the hits and misses', function (done) {
+      const s = new Speaker({ channels: 2, bitDepth: 16, sampleRate: 44100 })
+      assert.strictEqual(s.playClip('click'), false)
+      assert.strictEqual(s.clipStats(), null)
+      Promise.all([
+        s.loadClip('click', Buffer.alloc(441 * 2), { channels: 1 }),
+        s.loadClip('chime', file)
+      ]).then(function ([click, chime]) {
+        assert.strictEqual(click, 10)
+        assert.strictEqual(Math.round(chime), Math.round(10 * 384 / 44.1))
+        assert.strictEqual(s.playClip('click'), true)
+        assert.strictEqual(s.playClip('chime', { volume: 0.5 }), true)
+        assert.strictEqual(s.playClip('nope'), false)
+        assert.throws(() => s.enqueue(file))
+        const stats = s.clipStats()
+        assert.strictEqual(stats.clips, 2)
+        assert.strictEqual(stats.hits, 2)
+        assert.strictEqual(stats.misses, 1)
+        assert.strictEqual(stats.bytes, (441 + 10 * 384) * 4)
+        assert.strictEqual(s.unloadClip('click'), true)
+        assert.strictEqual(s.unloadClip('click'), false)
+        s.once('close', done)
+        s.end()
+      }).catch(done)
+    })
+
+    it('should evict the least recently used clips once over the budget', function (done) {
+      const s = new Speaker({ channels: 2, bitDepth: 16, sampleRate: 44100, clipBudget: 4410 * 4 * 2 })
+      const clip = Buffer.alloc(4410 * 4)
+      s.loadClip('a', clip)
+        .then(() => s.loadClip('b', clip))
+        .then(() => s.loadClip('c', clip))
+        .then(function () {
+          assert.strictEqual(s.playClip('a'), false)
+          assert.strictEqual(s.playClip('c'), true)
+          const stats = s.clipStats()
+          assert.strictEqual(stats.clips, 2)
+          assert(stats.evicted >= 1)
+          return assert.rejects(s.loadClip('big', Buffer.alloc(4410 * 4 * 3)), /budget/)
+        })
+        .then(function () {
+          assert.throws(() => s.loadClip('odd', Buffer.alloc(3)), RangeError)
+          s.once('close', done)
+          s.end()
+        }).catch(done)
+    })
+
+    it('should play a clip through the moves that loads make', function (done) {
+      const file = path.join(os.tmpdir(), `speaker-test-${process.pid}-clips.raw`)
+      const s = new Speaker({ channels: 2, bitDepth: 16, sampleRate: 44100, clipBudget: 4410 * 4 * 3, device: `file:${file}` })
+      const clip = Buffer.alloc(4410 * 4)
+      const tone = Buffer.alloc(4410 * 4)
+      for (let i = 0; i < 4410 * 2; i++) writeSample(tone, i, 2, 0x1000)
+      assert.throws(() => new Speaker({ clipBudget: 2 ** 64 }), TypeError)
+      s.on('error', done)
+      s.loadClip('x', clip)
+        .then(() => s.loadClip('a', tone))
+        .then(() => s.loadClip('y', clip))
+        .then(function () {
+          assert.strictEqual(s.playClip('a'), true)
+          // evicts "x", which moves "a" down while it plays
+          return Promise.all([s.loadClip('z', clip), s.loadClip('y', clip)])
+        })
+        .then(function () {
+          assert.strictEqual(s.clipStats().evicted, 1)
+          s.once('finish', () => setImmediate(function () {
+            const audio = fs.readFileSync(file)
+            fs.unlinkSync(file)
+            const samples = []
+            for (let i = 0; i < audio.length / 2; i++) samples.push(readSample(audio, i, 2))
+            const first = samples.indexOf(0x1000)
+            assert(first >= 0)
+            assert(samples.slice(first, first + 4410 * 2).every((v) => v === 0x1000))
+            assert(samples.slice(first + 4410 * 2).every((v) => v === 0))
+            done()
+          }))
+          s.end()
+          assert.strictEqual(s.playClip('a'), false)
+        }).catch(done)
+    })
+  })
+
+  describe('Speaker.prepare()', function () {
+    const opts = { channels: 2, bitDepth: 16, sampleRate: 48000 }
+
+    after(function () {
+      Speaker.closePrepared()
+    })
+
+    it('should hand a prepared device to the next speaker with its format', function (done) {
+      Speaker.prepare(opts).then(function (count) {
+        assert.strictEqual(count, 1)
+        assert.strictEqual(Speaker.prepared(opts), 1)
+        assert.strictEqual(Speaker.prepared({ sampleRate: 44100 }), 0)
+        const s = new Speaker(opts)
+        s.on('open', function () {
+          assert.strictEqual(Speaker.prepared(opts), 0)
+        })
+        s.on('error', done)
+        s.once('close', done)
+        s.end(Buffer.alloc(4096))
+      }).catch(done)
+    })
+
+    it('should close prepared devices', function () {
+      const preparing = Speaker.prepare(opts)
+      return Speaker.prepare(opts).then(function (count) {
+        assert(count >= 1)
+        Speaker.closePrepared()
+        assert.strictEqual(Speaker.prepared(opts), 0)
+        return preparing.then(() => 0, () => 0)
+      }).then(function () {
+        assert.strictEqual(Speaker.prepared(opts), 0)
+      })
+    })
+
+    it('should reject for devices that cannot be prepared', function () {
+      return Promise.all([
+        assert.rejects(Speaker.prepare({ device: 'file:out.wav' }), TypeError),
+        assert.rejects(Speaker.prepare({ backend: 'nope' }), /nope/)
+      ])
+    })
+  })
+
+  describe('playStream()', function () {
+    const http = require('http')
+    const net = require('net')
+    const interval = 4096
+    let server
+
+    // an ICY metadata block: its length in 16 byte units, then the text
+    function icy (text) {
+      const block = Buffer.alloc(1 + Math.ceil(text.length / 16) * 16)
+      block[0] = (block.length - 1) / 16
+      block.write(text, 1)
+      return block
+    }
+
+    before(function (done) {
+      const audio = fs.readFileSync(mpegFixture('stream', 200))
+      server = http.createServer(function (req, res) {
+        const parts = []
+        for (let i = 0; i < audio.length; i += interval) {
+          parts.push(audio.subarray(i, i + interval))
+          if (i + interval <= audio.length) {
+            parts.push(icy(i === 0 ? "StreamTitle='One';" : i === 3 * interval ? "StreamTitle='It's Two';StreamUrl='http://example.com/';" : ''))
+          }
+        }
+        res.writeHead(200, {
+          'Content-Type': 'audio/mpeg',
+          'icy-name': 'Test FM',
+          'icy-metaint': req.headers['icy-metadata'] === '1' ? interval : 0
+        })
+        res.end(Buffer.concat(parts))
+      }).listen(0, '127.0.0.1', done)
+    })
+
+    after(function (done) {
+      fs.unlinkSync(path.join(os.tmpdir(), `speaker-test-${process.pid}-stream.mp1`))
+      server.close(done)
+    })
+
+    it('should play the stream and emit its metadata', function (done) {
+      const s = new Speaker()
+      let station = null
+      const metadata = []
+      s.on('connect', (info) => { station = info })
+      s.on('metadata', (meta) => metadata.push(meta))
+      s.on('error', done)
+      s.once('close', function () {
+        assert.strictEqual(station.name, 'Test FM')
+        assert.strictEqual(station.metaint, interval)
+        assert.deepStrictEqual(metadata.map((m) => m.title), ['One', "It's Two"])
+        assert.strictEqual(metadata[1].url, 'http://example.com/')
+        done()
+      })
+      s.playStream(`http://127.0.0.1:${server.address().port}/stream`, { prefetch: 8192 })
+    })
+
+    it('should emit an "error" for streams that cannot be reached', function (done) {
+      const s = new Speaker()
+      s.on('error', function (err) {
+        assert(/connect/.test(err.message))
+        done()
+      })
+      const closed = http.createServer().listen(0, '127.0.0.1', function () {
+        const port = closed.address().port
+        closed.close(() => s.playStream(`http://127.0.0.1:${port}/`))
+      })
+    })
+
+    it('should close without waiting for a stream that is still connecting', function (done) {
+      // takes the connection, and never answers
+      const sockets = []
+      const silent = net.createServer((socket) => sockets.push(socket)).listen(0, '127.0.0.1', function () {
+        const s = new Speaker()
+        s.on('error', done)
+        s.playStream(`http://127.0.0.1:${silent.address().port}/`)
+        setTimeout(function () {
+          const started = Date.now()
+          s.close()
+          assert(Date.now() - started < 500)
+          for (const socket of sockets) socket.destroy()
+          silent.close(() => done())
+        }, 100)
+      })
+    })
+  })
 })
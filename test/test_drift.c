@@ -0,0 +1,130 @@
+/*
+  Checks the drift correction against a simulated device: the stream comes in
+  at a clock a little off from the device's, and the device plays out what is
+  queued at its own rate. The PI controller has to find the clock difference
+  and hold the latency at the target; the Catmull-Rom interpolation has to put
+  every output frame where the ratio says, across blocks.
+*/
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "output.h"
+#include "../src/drift.h"
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+#define RATE 48000
+#define TARGET 100      /* ms */
+#define BLOCK 480       /* frames, 10 ms */
+
+/* Plays `seconds` of a stream whose clock is `ppm` fast into a simulated
+ * device that starts out holding `start` ms, and returns the final
+ * correction and smoothed latency. */
+static void simulate(double ppm, double start, double seconds, double *correction, double *latency) {
+  float in[BLOCK * 2];
+  unsigned char *out;
+  drift d;
+  double queued = start * RATE / 1000;
+  long blocks = (long) (seconds * RATE / BLOCK), i;
+
+  memset(in, 0, sizeof(in));
+  drift_init(&d, RATE, 2, TARGET);
+  for (i = 0; i < blocks; i++) {
+    /* what the device played while the next block was on its way */
+    queued -= BLOCK / (1 + ppm / 1e6);
+    if (queued < 0) queued = 0;
+    queued += drift_process(&d, (unsigned char *) in, BLOCK, MPG123_ENC_FLOAT_32, (long) queued, &out);
+  }
+  *correction = drift_ppm(&d);
+  *latency = drift_latency(&d);
+  drift_free(&d);
+}
+
+/* the input the interpolation gets: a ramp on the left, a 1 kHz sine on the
+ * right, at frame `j` (which may be fractional) */
+static double ramp(double j) {
+  return j / 8192;
+}
+
+static double sine(double j) {
+  return 0.5 * sin(2 * M_PI * 1000 * j / RATE);
+}
+
+/* Resamples 4000 frames by a fixed `ratio`, in blocks of odd sizes, and
+ * returns the largest error on either channel. */
+static double interpolate(double ratio, double *sine_error) {
+  static const size_t sizes[] = { 1, 37, 480, 2, 1000, 3, 777 };
+  float in[1000 * 2];
+  unsigned char *out;
+  drift d;
+  double pos = 1, worst = 0;
+  size_t i, k, n, frame = 0;
+
+  drift_init(&d, RATE, 2, TARGET);
+  d.ratio = ratio;
+  *sine_error = 0;
+  for (i = 0; frame < 4000; i = (i + 1) % (sizeof(sizes) / sizeof(sizes[0]))) {
+    for (k = 0; k < sizes[i]; k++) {
+      in[2 * k] = (float) ramp((double) (frame + k));
+      in[2 * k + 1] = (float) sine((double) (frame + k));
+    }
+    frame += sizes[i];
+    /* -1: nothing queued is known, so the ratio stays put */
+    n = drift_process(&d, (unsigned char *) in, sizes[i], MPG123_ENC_FLOAT_32, -1, &out);
+    for (k = 0; k < n; k++, pos += ratio) {
+      const float *o = (const float *) out + 2 * k;
+      /* the history starts out with 3 frames of silence; only frames with
+       * all four neighbours in the input are checked */
+      double j = pos - 3;
+      if (j < 1) continue;
+      if (fabs(o[0] - ramp(j)) > worst) worst = fabs(o[0] - ramp(j));
+      if (fabs(o[1] - sine(j)) > *sine_error) *sine_error = fabs(o[1] - sine(j));
+    }
+  }
+  drift_free(&d);
+  return worst;
+}
+
+int main () {
+  static const double clocks[] = { 300, -300, 50, -700 };
+  double correction, latency, error, sine_error;
+  int i, failed = 0;
+
+  /* clocks within reach settle at the target, corrected by their offset */
+  for (i = 0; i < (int) (sizeof(clocks) / sizeof(clocks[0])); i++) {
+    simulate(clocks[i], TARGET, 600, &correction, &latency);
+    if (fabs(correction - clocks[i]) > 10 || fabs(latency - TARGET) > 2) {
+      printf("%+.0f ppm clock: corrected by %+.1f ppm at %.1f ms\n", clocks[i], correction, latency);
+      failed = 1;
+    }
+  }
+
+  /* so does a latency that starts out far off */
+  simulate(100, 3 * TARGET, 600, &correction, &latency);
+  if (fabs(correction - 100) > 10 || fabs(latency - TARGET) > 2) {
+    printf("from %d ms: corrected by %+.1f ppm at %.1f ms\n", 3 * TARGET, correction, latency);
+    failed = 1;
+  }
+
+  /* clocks out of reach get the most correction there is, not more */
+  simulate(5000, TARGET, 60, &correction, &latency);
+  if (fabs(correction - DRIFT_MAX_PPM) > 0.01 || latency <= TARGET) {
+    printf("+5000 ppm clock: corrected by %+.1f ppm at %.1f ms\n", correction, latency);
+    failed = 1;
+  }
+
+  /* lines come out exactly, sines close to it, at either ratio and at none */
+  for (i = -1; i <= 1; i++) {
+    error = interpolate(1 + i * DRIFT_MAX_PPM / 1e6, &sine_error);
+    if (error > 1e-5 || sine_error > 1e-4) {
+      printf("ratio %.4f: off by %g on a ramp, %g on a sine\n", 1 + i * DRIFT_MAX_PPM / 1e6, error, sine_error);
+      failed = 1;
+    }
+  }
+
+  printf("%s\n", failed ? "FAIL" : "OK");
+  return failed;
+}
@@ -0,0 +1,110 @@
+/*
+  Checks the pacing of the output threads against simulated devices that
+  report their delay: one that plays what it is given right away, and one
+  that holds back two seconds of it before it starts, like PulseAudio's
+  default prebuffer. Paced by the delay alone, the second one would never
+  be given enough to start. The clock is simulated too, by this file's
+  uv_hrtime().
+*/
+#include <stdio.h>
+#include <string.h>
+
+#include <uv.h>
+
+#include "output.h"
+#include "../src/pace.h"
+
+#define RATE 48000
+#define PERIOD 480      /* frames, 10 ms, as far ahead as the threads keep */
+
+static uint64_t now = 1;          /* ns */
+static uint64_t played_at = 1;    /* ns, up to which the device played */
+static long queued;               /* frames */
+static long prebuffer;            /* frames it waits for before it starts */
+static int started;
+
+uint64_t uv_hrtime(void) {
+  return now;
+}
+
+/* what the device played up to `now` */
+static void play(void) {
+  if (!started && queued >= prebuffer) started = 1;
+  if (started) {
+    queued -= (long) ((now - played_at) * RATE / 1000000000);
+    if (queued < 0) queued = 0;
+  }
+  played_at = now;
+}
+
+static int delay_device(audio_output_t *ao) {
+  play();
+  return (int) queued;
+}
+
+static int write_device(audio_output_t *ao, unsigned char *buf, int len) {
+  play();
+  queued += len / 4;
+  return len;
+}
+
+/* Runs an output thread's loop against a device that waits for `wait`
+ * frames before it starts for `seconds`, and returns the frames written. */
+static long simulate(long wait, double seconds, int *by_clock) {
+  unsigned char silence[PERIOD * 4];
+  audio_output_t ao;
+  pace p;
+  long written = 0;
+  uint64_t end;
+
+  memset(&ao, 0, sizeof(ao));
+  memset(silence, 0, sizeof(silence));
+  ao.rate = RATE;
+  ao.channels = 2;
+  ao.format = MPG123_ENC_SIGNED_16;
+  ao.delay = delay_device;
+  ao.write = write_device;
+
+  queued = 0;
+  prebuffer = wait;
+  started = 0;
+  played_at = now;
+  end = now + (uint64_t) (seconds * 1e9);
+
+  pace_init(&p, &ao);
+  while (now < end) {
+    double ahead = pace_ahead(&p) - (double) PERIOD / RATE;
+    if (ahead > 0) {
+      /* the timed wait on the thread's condition */
+      now += (uint64_t) (ahead * 1e9) + 1;
+      continue;
+    }
+    if (pace_write(&p, silence, sizeof(silence)) != 0) break;
+    written += PERIOD;
+  }
+  *by_clock = p.by_clock;
+  return written;
+}
+
+int main () {
+  long written;
+  int by_clock, failed = 0;
+
+  /* a device that plays right away is paced by its delay: a period ahead */
+  written = simulate(0, 3, &by_clock);
+  if (by_clock || written < 3 * RATE || written > 3 * RATE + 3 * PERIOD) {
+    printf("playing device: %ld frames in 3 s, %s\n", written, by_clock ? "by the clock" : "by the delay");
+    failed = 1;
+  }
+
+  /* one that waits for 2 s of audio gets them by the clock, and then plays */
+  written = simulate(2 * RATE, 3, &by_clock);
+  if (!by_clock || written < 3 * RATE - 3 * PERIOD || !started) {
+    printf("prebuffering device: %ld frames in 3 s, %s, %s\n", written,
+           by_clock ? "by the clock" : "by the delay", started ? "started" : "never started");
+    failed = 1;
+  }
+
+  printf("%s\n", failed ? "FAIL" : "OK");
+  return failed;
+}